@@ -0,0 +1,242 @@
+/**
+ * @file Benchmark.cpp
+ * @brief Implementation of the Benchmark class.
+ */
+
+#include "core/Benchmark.h"
+#include "core/Housekeeping.h"
+#include "core/SandboxManager.h"
+#include "core/Logger.h"
+#include "utils/Syscalls.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+using json = nlohmann::json;
+
+namespace sandbox {
+
+Benchmark::Benchmark(const SandboxConfiguration& config, const BenchOptions& options,
+                     ModuleRegistrar registrar)
+    : config_(config)
+    , options_(options)
+    , registrar_(std::move(registrar))
+{
+}
+
+std::vector<int> Benchmark::pickCpus(const std::vector<int>& available, int cpuQuotaPercent) {
+    size_t wanted = static_cast<size_t>(std::max(1, (cpuQuotaPercent + 99) / 100));
+    wanted = std::min(wanted, available.size());
+    return std::vector<int>(available.end() - wanted, available.end());
+}
+
+BenchReport Benchmark::run() {
+    BenchReport report;
+    report.command = config_.sandbox.command;
+    report.failedRuns = 0;
+
+    // Every run uses identical limits, pinned to the same CPUs
+    SandboxConfiguration config = config_;
+    if (!options_.cpus.empty()) {
+        config.resources.cpuset_cpus = options_.cpus;
+    } else if (!config.supervisor.workload_cpus.empty()) {
+        // The supervisor runs on housekeeping CPUs; pick from the rest
+        config.resources.cpuset_cpus = Syscall::formatCpuList(
+            pickCpus(*Syscall::parseCpuList(config.supervisor.workload_cpus), config.resources.cpu_quota_percent));
+    } else if (config.resources.cpuset_cpus.empty()) {
+        config.resources.cpuset_cpus = Syscall::formatCpuList(
+            pickCpus(Syscall::getAffinityCpus(), config.resources.cpu_quota_percent));
+    }
+    config.resources.perf_counters = true;
+    config.resources.drop_page_cache = options_.dropCaches;
+    config.restart.policy = "never";
+    config.fanout.inputs.clear();
+    report.cpus = Housekeeping::sandboxCpus(config);
+    if (!options_.cpus.empty() &&
+        report.cpus != Syscall::formatCpuList(Syscall::parseCpuList(options_.cpus).value_or(std::vector<int>()))) {
+        SANDBOX_WARNING("Housekeeping CPUs left out of --cpus " + options_.cpus);
+    }
+
+    SANDBOX_INFO("Benchmarking on CPUs " + report.cpus + ": " +
+                 std::to_string(options_.warmup) + " warm-up and " +
+                 std::to_string(options_.runs) + " measured runs");
+
+    for (int i = 0; i < options_.warmup + options_.runs; ++i) {
+        SandboxManager manager;
+        manager.setConfig(config);
+        registrar_(manager);
+
+        SandboxResult result = manager.run();
+        if (i < options_.warmup) {
+            continue;
+        }
+
+        BenchSample sample;
+        sample.wallMs = (result.wallTimeUs - result.setupTimeUs) / 1000.0;
+        sample.setupMs = result.setupTimeUs / 1000.0;
+        sample.userMs = result.usage.cpuUserUs / 1000.0;
+        sample.systemMs = result.usage.cpuSystemUs / 1000.0;
+        sample.memoryPeakBytes = result.usage.memoryPeakBytes;
+        sample.counters = result.usage.perfCounters;
+        sample.exitCode = result.exitCode;
+        if (result.exitCode != 0) {
+            report.failedRuns++;
+        }
+        report.samples.push_back(sample);
+    }
+
+    computeStats(report);
+    return report;
+}
+
+BenchStats Benchmark::summarize(const std::vector<double>& values) {
+    BenchStats stats{0, 0, 0, 0, 0, 0};
+    if (values.empty()) {
+        return stats;
+    }
+
+    std::vector<double> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    size_t n = sorted.size();
+
+    auto median = [](const std::vector<double>& v) {
+        size_t mid = v.size() / 2;
+        return v.size() % 2 ? v[mid] : (v[mid - 1] + v[mid]) / 2;
+    };
+
+    stats.min = sorted.front();
+    stats.max = sorted.back();
+    stats.median = median(sorted);
+
+    double sum = 0;
+    for (double v : sorted) {
+        sum += v;
+    }
+    stats.mean = sum / n;
+
+    if (n > 1) {
+        double squares = 0;
+        for (double v : sorted) {
+            squares += (v - stats.mean) * (v - stats.mean);
+        }
+        stats.stddev = std::sqrt(squares / (n - 1));
+    }
+
+    // Modified Z-score (Iglewicz and Hoaglin), robust against the very
+    // outliers it is looking for
+    std::vector<double> deviations;
+    for (double v : sorted) {
+        deviations.push_back(std::fabs(v - stats.median));
+    }
+    std::sort(deviations.begin(), deviations.end());
+    double mad = median(deviations);
+    if (mad > 0) {
+        for (double v : sorted) {
+            if (std::fabs(0.6745 * (v - stats.median) / mad) > 3.5) {
+                stats.outliers++;
+            }
+        }
+    }
+
+    return stats;
+}
+
+void Benchmark::computeStats(BenchReport& report) {
+    std::vector<double> wall, setup, user, system, memory;
+    std::map<std::string, std::vector<double>> counters;
+
+    for (const auto& sample : report.samples) {
+        wall.push_back(sample.wallMs);
+        setup.push_back(sample.setupMs);
+        user.push_back(sample.userMs);
+        system.push_back(sample.systemMs);
+        memory.push_back(sample.memoryPeakBytes / (1024.0 * 1024.0));
+        for (const auto& [name, value] : sample.counters) {
+            counters[name].push_back(static_cast<double>(value));
+        }
+    }
+
+    report.wall = summarize(wall);
+    report.setup = summarize(setup);
+    report.user = summarize(user);
+    report.system = summarize(system);
+    report.memoryPeakMb = summarize(memory);
+    for (const auto& [name, values] : counters) {
+        report.counters[name] = summarize(values);
+    }
+}
+
+std::string Benchmark::formatReport(const BenchReport& report) {
+    std::ostringstream out;
+    char line[256];
+
+    std::string command;
+    for (const auto& arg : report.command) {
+        command += (command.empty() ? "" : " ") + arg;
+    }
+
+    out << "Benchmark: " << command << "\n";
+    std::snprintf(line, sizeof(line), "  Time (mean +/- sd):   %10.3f ms +/- %8.3f ms    [User: %.3f ms, System: %.3f ms]\n",
+                  report.wall.mean, report.wall.stddev, report.user.mean, report.system.mean);
+    out << line;
+    std::snprintf(line, sizeof(line), "  Range (min ... max):  %10.3f ms ... %8.3f ms    %zu runs on CPUs %s\n",
+                  report.wall.min, report.wall.max, report.samples.size(), report.cpus.c_str());
+    out << line;
+    std::snprintf(line, sizeof(line), "  Setup (mean +/- sd):  %10.3f ms +/- %8.3f ms    (not in Time)\n",
+                  report.setup.mean, report.setup.stddev);
+    out << line;
+    std::snprintf(line, sizeof(line), "  Peak memory:          %10.2f MiB +/- %.2f MiB\n",
+                  report.memoryPeakMb.mean, report.memoryPeakMb.stddev);
+    out << line;
+
+    for (const auto& [name, stats] : report.counters) {
+        std::snprintf(line, sizeof(line), "  %-20s  %14.0f +/- %.0f\n",
+                      (name + ":").c_str(), stats.mean, stats.stddev);
+        out << line;
+    }
+
+    if (report.wall.outliers > 0) {
+        out << "\n  Warning: " << report.wall.outliers << " statistical outliers were detected. "
+            << "Consider more warm-up runs or a quieter host.\n";
+    }
+    if (report.failedRuns > 0) {
+        out << "  Warning: " << report.failedRuns << " runs exited with a non-zero code.\n";
+    }
+
+    return out.str();
+}
+
+std::string Benchmark::toJson(const BenchReport& report) {
+    auto statsJson = [](const BenchStats& stats) {
+        return json{{"mean", stats.mean}, {"stddev", stats.stddev}, {"median", stats.median},
+                    {"min", stats.min}, {"max", stats.max}, {"outliers", stats.outliers}};
+    };
+
+    json j;
+    j["command"] = report.command;
+    j["cpus"] = report.cpus;
+    j["failed_runs"] = report.failedRuns;
+    j["wall_ms"] = statsJson(report.wall);
+    j["setup_ms"] = statsJson(report.setup);
+    j["user_ms"] = statsJson(report.user);
+    j["system_ms"] = statsJson(report.system);
+    j["memory_peak_mb"] = statsJson(report.memoryPeakMb);
+    for (const auto& [name, stats] : report.counters) {
+        j["counters"][name] = statsJson(stats);
+    }
+
+    j["samples"] = json::array();
+    for (const auto& sample : report.samples) {
+        j["samples"].push_back({{"wall_ms", sample.wallMs}, {"setup_ms", sample.setupMs},
+                                {"user_ms", sample.userMs},
+                                {"system_ms", sample.systemMs},
+                                {"memory_peak_bytes", sample.memoryPeakBytes},
+                                {"counters", sample.counters}, {"exit_code", sample.exitCode}});
+    }
+
+    return j.dump(2);
+}
+
+} // namespace sandbox
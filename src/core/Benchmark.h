@@ -0,0 +1,155 @@
+/**
+ * @file Benchmark.h
+ * @brief Repeated, pinned workload runs with statistics.
+ *
+ * This header defines the Benchmark class behind `sandbox bench-run`.
+ * It runs a workload repeatedly in identically configured sandboxes
+ * pinned to dedicated CPUs and summarizes the measurements.
+ */
+
+#ifndef SANDBOX_BENCHMARK_H
+#define SANDBOX_BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include "ConfigParser.h"
+
+namespace sandbox {
+
+class SandboxManager;
+
+/**
+ * @struct BenchOptions
+ * @brief Options of a benchmark.
+ */
+struct BenchOptions {
+    int runs = 10;             ///< Measured runs
+    int warmup = 0;            ///< Unmeasured runs before the measured ones
+    std::string cpus;          ///< CPUs to pin to, empty to pick automatically
+    bool dropCaches = false;   ///< Drop the sandbox's page cache between runs
+    std::string exportJson;    ///< Path of a JSON report, empty for none
+};
+
+/**
+ * @struct BenchSample
+ * @brief Measurements of one run.
+ */
+struct BenchSample {
+    double wallMs;             ///< From the start of the command to its exit
+    double setupMs;            ///< Sandbox setup before the command started
+    double userMs;
+    double systemMs;
+    long long memoryPeakBytes;
+    std::map<std::string, long long> counters;  ///< Perf event counts
+    int exitCode;
+};
+
+/**
+ * @struct BenchStats
+ * @brief Summary statistics of one measurement.
+ */
+struct BenchStats {
+    double mean;
+    double stddev;             ///< Sample standard deviation
+    double median;
+    double min;
+    double max;
+    size_t outliers;           ///< Samples with a modified Z-score above 3.5
+};
+
+/**
+ * @struct BenchReport
+ * @brief Result of a benchmark.
+ */
+struct BenchReport {
+    std::vector<std::string> command;
+    std::string cpus;                          ///< CPUs the runs were pinned to
+    std::vector<BenchSample> samples;
+    BenchStats wall;
+    BenchStats setup;
+    BenchStats user;
+    BenchStats system;
+    BenchStats memoryPeakMb;
+    std::map<std::string, BenchStats> counters;
+    int failedRuns;                            ///< Runs with a non-zero exit code
+};
+
+/**
+ * @class Benchmark
+ * @brief Runs a workload repeatedly in fresh, pinned sandboxes.
+ *
+ * Every run gets a new sandbox from the same configuration, pinned with
+ * cpuset to the same CPUs, with perf counters enabled on its cgroup.
+ * Warm-up runs are executed but not measured.
+ */
+class Benchmark {
+public:
+    /// Registers the modules of each per-run SandboxManager.
+    using ModuleRegistrar = std::function<void(SandboxManager&)>;
+
+    /**
+     * @brief Construct a Benchmark.
+     * @param config Configuration of every run.
+     * @param options Benchmark options.
+     * @param registrar Registers the modules of each run.
+     */
+    Benchmark(const SandboxConfiguration& config, const BenchOptions& options,
+              ModuleRegistrar registrar);
+
+    /**
+     * @brief Execute the warm-up and measured runs.
+     * @return The report.
+     */
+    BenchReport run();
+
+    /**
+     * @brief Pick the CPUs a benchmark is pinned to.
+     *
+     * Takes one CPU per full CPU of the quota from the end of the
+     * available CPUs, away from CPU 0 which usually handles most
+     * interrupts.
+     *
+     * @param available CPUs the supervisor may use.
+     * @param cpuQuotaPercent CPU quota of the sandbox.
+     * @return The chosen CPUs.
+     */
+    static std::vector<int> pickCpus(const std::vector<int>& available, int cpuQuotaPercent);
+
+    /**
+     * @brief Summarize a series of measurements.
+     * @param values The measurements.
+     * @return The statistics; all zero for an empty series.
+     */
+    static BenchStats summarize(const std::vector<double>& values);
+
+    /**
+     * @brief Format a report for the terminal.
+     * @param report The report.
+     * @return The formatted report.
+     */
+    static std::string formatReport(const BenchReport& report);
+
+    /**
+     * @brief Serialize a report as JSON.
+     * @param report The report.
+     * @return The JSON document.
+     */
+    static std::string toJson(const BenchReport& report);
+
+private:
+    /**
+     * @brief Compute the statistics of a finished report.
+     * @param report The report to complete.
+     */
+    static void computeStats(BenchReport& report);
+
+    SandboxConfiguration config_;
+    BenchOptions options_;
+    ModuleRegistrar registrar_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_BENCHMARK_H
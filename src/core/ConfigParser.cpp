@@ -5,11 +5,44 @@
 
 #include "core/ConfigParser.h"
 #include "core/Logger.h"
+#include "utils/Syscalls.h"
 #include <fstream>
 #include <algorithm>
+#include <sys/resource.h>
 
 namespace sandbox {
 
+namespace {
+
+/// Read a limit given as a number or "unlimited"
+unsigned long long parseRlimitValue(const json& value, const std::string& name) {
+    if (value.is_string() && value.get<std::string>() == "unlimited") {
+        return RLIM_INFINITY;
+    }
+    if (!value.is_number_integer() || value.get<long long>() < 0) {
+        throw std::runtime_error("Invalid value for rlimit " + name);
+    }
+    return value.get<unsigned long long>();
+}
+
+/// Read a limit given as one value for both or as {"soft", "hard"}
+RlimitConfig parseRlimit(const std::string& name, const json& value) {
+    RlimitConfig limit;
+    limit.resource = name;
+    if (value.is_object()) {
+        if (!value.contains("soft") || !value.contains("hard")) {
+            throw std::runtime_error("Rlimit " + name + " must contain 'soft' and 'hard'");
+        }
+        limit.soft = parseRlimitValue(value["soft"], name);
+        limit.hard = parseRlimitValue(value["hard"], name);
+    } else {
+        limit.soft = limit.hard = parseRlimitValue(value, name);
+    }
+    return limit;
+}
+
+} // namespace
+
 ConfigParser::ConfigParser(const std::filesystem::path& configPath)
     : configPath_(configPath)
     , useFile_(true)
@@ -85,12 +118,44 @@ SandboxConfiguration ConfigParser::createDefaultConfig() {
     config.sandbox.auto_bootstrap = false;
     config.sandbox.distro = "ubuntu";
     config.sandbox.release = "focal";
+    config.sandbox.bootstrap_mirror = "http://archive.ubuntu.com/ubuntu/";
+    config.sandbox.bootstrap_threads = 0;
 
     // Resources config
     config.resources.memory_mb = 512;
     config.resources.cpu_quota_percent = 50;
+    config.resources.cpu_burst_percent = 0;
+    config.resources.cpu_burst_interval_ms = 50;
     config.resources.max_pids = 100;
     config.resources.enable_swap = false;
+    config.resources.drop_page_cache = false;
+    config.resources.perf_counters = false;
+    config.resources.memory_merge = false;
+    config.resources.runtime_hints = true;
+    config.resources.quota_affinity = false;
+    config.resources.virtual_proc = false;
+
+    // Restart config
+    config.restart.policy = "never";
+    config.restart.backoff_initial_ms = 100;
+    config.restart.backoff_max_ms = 30000;
+    config.restart.backoff_multiplier = 2.0;
+    config.restart.crash_loop_window_s = 60;
+    config.restart.crash_loop_max_restarts = 5;
+
+    // Fan-out defaults
+    config.fanout.max_parallel = 0;
+    config.fanout.memory_mb = 0;
+    config.fanout.cpu_quota_percent = 0;
+    config.fanout.max_pids = 0;
+    config.fanout.timeout_ms = 0;
+    config.fanout.max_output_bytes = 1024 * 1024;
+    config.fanout.idempotent = false;
+    config.fanout.speculate = false;
+    config.fanout.speculate_percentile = 95;
+    config.fanout.speculate_slots = 1;
+    config.fanout.history_dir = "/var/lib/sandbox/history";
+    config.fanout.order = "submission";
 
     // Isolation config
     config.isolation.namespaces = {"pid", "net", "ipc", "uts", "mount", "user"};
@@ -104,23 +169,64 @@ SandboxConfiguration ConfigParser::createDefaultConfig() {
 
     // Mounts config
     config.mounts.bind_mounts = {{"/tmp", "/tmp", false}};
+    config.mounts.dev_template = "/run/sandbox/dev";
+
+    // IPC defaults
+    config.ipc.channel_dir = "/run/sandbox/channels";
+    config.ipc.dataset_dir = "/run/sandbox/datasets";
+    config.ipc.dataset_cgroup = "sandbox-datasets";
+    config.ipc.dataset_mount_dir = "/run/datasets";
 
     // AI module config
     config.ai_module.enabled = false;
     config.ai_module.provider = "openai";
     config.ai_module.api_key_env = "OPENAI_API_KEY";
     config.ai_module.base_url = "https://api.openai.com/v1";
+    config.ai_module.hedge_after_ms = 2000;
+    config.ai_module.breaker_failures = 3;
+    config.ai_module.breaker_cooldown_ms = 30000;
     config.ai_module.model = "gpt-4-turbo";
     config.ai_module.temperature = 0.2;
     config.ai_module.max_tokens = 1000;
     config.ai_module.system_prompt = "You are a sandbox assistant that helps analyze and configure sandbox environments.";
     config.ai_module.auto_report_errors = true;
+    config.ai_module.failure_index_dir = "/var/lib/sandbox/diagnoses";
+    config.ai_module.failure_match_bits = 3;
+    config.ai_module.context_window_tokens = 128000;
+    config.ai_module.max_prompt_tokens = 8000;
 
     // Logging config
     config.logging.level = "info";
     config.logging.output = "stdout";
     config.logging.log_file = "/var/log/sandbox/sandbox.log";
 
+    // Supervisor config
+    config.supervisor.state_dir = "/var/lib/sandbox/state";
+    config.supervisor.hold_output = true;
+    config.supervisor.reap_parallelism = 8;
+    config.supervisor.housekeeping_cpus = "";
+    config.supervisor.workload_cpus = "";
+
+    // Images defaults
+    config.images.store_dirs = {"/var/lib/sandbox/rootfs", "/var/lib/sandbox/images",
+                                "/var/lib/sandbox/blob-cache"};
+    config.images.disk_budget_mb = 0;
+    config.images.min_idle_s = 3600;
+    config.images.gc_interval_s = 600;
+    config.images.blob_cache_dir = "/var/lib/sandbox/blob-cache";
+    config.images.lazy_run_dir = "/run/sandbox/lazy";
+    config.images.lazy_threads = 4;
+    config.images.verify_integrity = false;
+    config.images.integrity_dir = "/var/lib/sandbox/integrity";
+    config.images.integrity_threads = 0;
+    config.images.slim_allowlist = {"/etc/passwd", "/etc/group", "/etc/nsswitch.conf", "/etc/hosts"};
+
+    // Core dump defaults
+    config.cores.enabled = false;
+    config.cores.output_dir = "/var/lib/sandbox/cores";
+    config.cores.max_mb = 256;
+    config.cores.registry_dir = "/run/sandbox/cores";
+
     return config;
 }
 
@@ -150,8 +256,108 @@ void ConfigParser::validate() {
 
     // Validate sandbox section
     const auto& sandbox = json_["sandbox"];
-    if (!sandbox.contains("command")) {
-        throw std::runtime_error("Sandbox config must contain 'command'");
+    if (!sandbox.contains("command") && !sandbox.contains("processes")) {
+        throw std::runtime_error("Sandbox config must contain 'command' or 'processes'");
+    }
+
+    // Validate process group
+    if (sandbox.contains("processes")) {
+        std::vector<std::string> names;
+        for (const auto& process : sandbox["processes"]) {
+            if (!process.contains("name") || !process.contains("command")) {
+                throw std::runtime_error("Each process must contain 'name' and 'command'");
+            }
+            std::string name = process["name"];
+            if (std::find(names.begin(), names.end(), name) != names.end()) {
+                throw std::runtime_error("Duplicate process name: " + name);
+            }
+            names.push_back(name);
+
+            std::string policy = process.value("restart", "never");
+            if (policy != "never" && policy != "on-failure" && policy != "always") {
+                throw std::runtime_error("Invalid restart policy for process " + name + ": " + policy);
+            }
+        }
+    }
+
+    // Validate restart section
+    if (json_.contains("restart")) {
+        std::string policy = json_["restart"].value("policy", "never");
+        if (policy != "never" && policy != "on-failure" && policy != "always") {
+            throw std::runtime_error("Invalid restart policy: " + policy);
+        }
+    }
+
+    if (sandbox.contains("bootstrap_threads") && sandbox["bootstrap_threads"].get<int>() < 0) {
+        throw std::runtime_error("Sandbox bootstrap_threads must not be negative");
+    }
+
+    // Validate fan-out section
+    if (json_.contains("fanout")) {
+        if (sandbox.contains("processes")) {
+            throw std::runtime_error("Fan-out cannot be combined with a process group");
+        }
+        if (json_["fanout"].value("max_parallel", 0) < 0) {
+            throw std::runtime_error("Fan-out max_parallel must not be negative");
+        }
+        if (json_["fanout"].value("speculate", false) && !json_["fanout"].value("idempotent", false)) {
+            throw std::runtime_error("Fan-out speculate requires idempotent runs");
+        }
+        int percentile = json_["fanout"].value("speculate_percentile", 95);
+        if (percentile < 1 || percentile > 100) {
+            throw std::runtime_error("Fan-out speculate_percentile must be between 1 and 100");
+        }
+        if (json_["fanout"].value("speculate_slots", 1) < 1) {
+            throw std::runtime_error("Fan-out speculate_slots must be at least 1");
+        }
+        std::string order = json_["fanout"].value("order", "submission");
+        if (order != "submission" && order != "sjf" && order != "lpt" && order != "memory") {
+            throw std::runtime_error("Invalid fan-out order: " + order);
+        }
+    }
+
+    // Validate IPC channels
+    if (json_.contains("ipc") && json_["ipc"].contains("channels")) {
+        std::vector<std::string> names;
+        for (const auto& channel : json_["ipc"]["channels"]) {
+            if (!channel.contains("name")) {
+                throw std::runtime_error("Each channel must contain 'name'");
+            }
+            std::string name = channel["name"];
+            if (name.empty() || name.find('/') != std::string::npos || name[0] == '.') {
+                throw std::runtime_error("Invalid channel name: " + name);
+            }
+            if (std::find(names.begin(), names.end(), name) != names.end()) {
+                throw std::runtime_error("Duplicate channel name: " + name);
+            }
+            names.push_back(name);
+
+            std::string type = channel.value("type", "socket");
+            if (type != "socket" && type != "shm") {
+                throw std::runtime_error("Invalid channel type for " + name + ": " + type);
+            }
+            if (type == "shm" && channel.value("size_mb", 1) <= 0) {
+                throw std::runtime_error("Channel " + name + " must have a positive size_mb");
+            }
+        }
+    }
+
+    // Validate datasets
+    if (json_.contains("ipc") && json_["ipc"].contains("datasets")) {
+        std::vector<std::string> names;
+        for (const auto& dataset : json_["ipc"]["datasets"]) {
+            if (!dataset.contains("name") || !dataset.contains("source")) {
+                throw std::runtime_error("Each dataset must contain 'name' and 'source'");
+            }
+            std::string name = dataset["name"];
+            if (name.empty() || name.find('/') != std::string::npos || name[0] == '.') {
+                throw std::runtime_error("Invalid dataset name: " + name);
+            }
+            if (std::find(names.begin(), names.end(), name) != names.end()) {
+                throw std::runtime_error("Duplicate dataset name: " + name);
+            }
+            names.push_back(name);
+        }
     }
 
     // Validate resources section
@@ -159,6 +365,91 @@ void ConfigParser::validate() {
     if (!resources.contains("memory_mb")) {
         throw std::runtime_error("Resources config must contain 'memory_mb'");
     }
+    if (resources.contains("cpuset_cpus") &&
+        !Syscall::parseCpuList(resources["cpuset_cpus"].get<std::string>())) {
+        throw std::runtime_error("Invalid cpuset_cpus: " + resources["cpuset_cpus"].get<std::string>());
+    }
+    if (resources.contains("cpu_burst_percent") && resources["cpu_burst_percent"].get<int>() != 0 &&
+        resources["cpu_burst_percent"].get<int>() < resources.value("cpu_quota_percent", 50)) {
+        throw std::runtime_error("Resources cpu_burst_percent must not be below cpu_quota_percent");
+    }
+    if (resources.contains("cpu_burst_interval_ms") && resources["cpu_burst_interval_ms"].get<int>() < 1) {
+        throw std::runtime_error("Resources cpu_burst_interval_ms must be at least 1");
+    }
+
+    if (json_.contains("supervisor") && json_["supervisor"].contains("reap_parallelism") &&
+        json_["supervisor"]["reap_parallelism"].get<int>() < 1) {
+        throw std::runtime_error("Supervisor reap_parallelism must be at least 1");
+    }
+    if (json_.contains("supervisor") && json_["supervisor"].contains("housekeeping_cpus")) {
+        std::string list = json_["supervisor"]["housekeeping_cpus"];
+        auto housekeeping = Syscall::parseCpuList(list);
+        if (!housekeeping) {
+            throw std::runtime_error("Invalid housekeeping_cpus: " + list);
+        }
+        if (resources.contains("cpuset_cpus")) {
+            auto cpuset = Syscall::parseCpuList(resources["cpuset_cpus"].get<std::string>());
+            if (!cpuset->empty() && std::all_of(cpuset->begin(), cpuset->end(), [&](int cpu) {
+                    return std::find(housekeeping->begin(), housekeeping->end(), cpu) != housekeeping->end();
+                })) {
+                throw std::runtime_error("Resources cpuset_cpus lies entirely within housekeeping_cpus");
+            }
+        }
+    }
+
+    if (json_.contains("images")) {
+        for (const char* key : {"disk_budget_mb", "min_idle_s", "gc_interval_s", "integrity_threads"}) {
+            if (json_["images"].contains(key) && json_["images"][key].get<long long>() < 0) {
+                throw std::runtime_error("Images " + std::string(key) + " must not be negative");
+            }
+        }
+        if (json_["images"].contains("lazy_threads") && json_["images"]["lazy_threads"].get<int>() < 1) {
+            throw std::runtime_error("Images lazy_threads must be at least 1");
+        }
+    }
+
+    if (json_.contains("rlimits")) {
+        if (!json_["rlimits"].is_object()) {
+            throw std::runtime_error("Rlimits must be an object");
+        }
+        for (const auto& [name, value] : json_["rlimits"].items()) {
+            if (Syscall::rlimitResource(name) < 0) {
+                throw std::runtime_error("Unknown rlimit: " + name);
+            }
+            RlimitConfig limit = parseRlimit(name, value);
+            if (limit.soft > limit.hard) {
+                throw std::runtime_error("Rlimit " + name + " soft value exceeds hard value");
+            }
+        }
+    }
+
+    if (json_.contains("cores") && json_["cores"].contains("max_mb") &&
+        json_["cores"]["max_mb"].get<long long>() < 1) {
+        throw std::runtime_error("Cores max_mb must be at least 1");
+    }
+
+    if (json_.contains("ai_module")) {
+        int bits = json_["ai_module"].value("failure_match_bits", 3);
+        if (bits < 0 || bits > 32) {
+            throw std::runtime_error("AI module failure_match_bits must be between 0 and 32");
+        }
+        int window = json_["ai_module"].value("context_window_tokens", 128000);
+        if (window <= json_["ai_module"].value("max_tokens", 1000)) {
+            throw std::runtime_error("AI module context_window_tokens must exceed max_tokens");
+        }
+        if (json_["ai_module"].value("max_prompt_tokens", 8000) < 0) {
+            throw std::runtime_error("AI module max_prompt_tokens must not be negative");
+        }
+        if (json_["ai_module"].value("hedge_after_ms", 2000) < 0) {
+            throw std::runtime_error("AI module hedge_after_ms must not be negative");
+        }
+        if (json_["ai_module"].value("breaker_failures", 3) < 1) {
+            throw std::runtime_error("AI module breaker_failures must be at least 1");
+        }
+        if (json_["ai_module"].value("breaker_cooldown_ms", 30000) < 0) {
+            throw std::runtime_error("AI module breaker_cooldown_ms must not be negative");
+        }
+    }
 }
 
 void ConfigParser::applyDefaults() {
@@ -170,14 +461,36 @@ void ConfigParser::applyDefaults() {
         if (sandbox.contains("name")) config_.sandbox.name = sandbox["name"];
         if (sandbox.contains("hostname")) config_.sandbox.hostname = sandbox["hostname"];
         if (sandbox.contains("rootfs_path")) config_.sandbox.rootfs_path = sandbox["rootfs_path"];
+        if (sandbox.contains("rootfs_manifest")) config_.sandbox.rootfs_manifest = sandbox["rootfs_manifest"];
         if (sandbox.contains("command")) {
             for (const auto& cmd : sandbox["command"]) {
                 config_.sandbox.command.push_back(cmd.get<std::string>());
             }
         }
+        if (sandbox.contains("processes")) {
+            for (const auto& process : sandbox["processes"]) {
+                ProcessConfig pc;
+                pc.name = process["name"];
+                for (const auto& arg : process["command"]) {
+                    pc.command.push_back(arg.get<std::string>());
+                }
+                pc.restart_policy = process.value("restart", "never");
+                pc.stdout_path = process.value("stdout", "");
+                pc.stderr_path = process.value("stderr", "");
+                pc.memory_mb = process.value("memory_mb", 0);
+                pc.cpu_quota_percent = process.value("cpu_quota_percent", 0);
+                pc.max_pids = process.value("max_pids", 0);
+                config_.sandbox.processes.push_back(pc);
+            }
+        }
         if (sandbox.contains("auto_bootstrap")) config_.sandbox.auto_bootstrap = sandbox["auto_bootstrap"];
         if (sandbox.contains("distro")) config_.sandbox.distro = sandbox["distro"];
         if (sandbox.contains("release")) config_.sandbox.release = sandbox["release"];
+        if (sandbox.contains("bootstrap_mirror")) config_.sandbox.bootstrap_mirror = sandbox["bootstrap_mirror"];
+        if (sandbox.contains("bootstrap_packages")) config_.sandbox.bootstrap_packages = sandbox["bootstrap_packages"];
+        if (sandbox.contains("bootstrap_include")) config_.sandbox.bootstrap_include = sandbox["bootstrap_include"].get<std::vector<std::string>>();
+        if (sandbox.contains("bootstrap_arch")) config_.sandbox.bootstrap_arch = sandbox["bootstrap_arch"];
+        if (sandbox.contains("bootstrap_threads")) config_.sandbox.bootstrap_threads = sandbox["bootstrap_threads"];
     }
 
     // Apply resources settings
@@ -185,8 +498,29 @@ void ConfigParser::applyDefaults() {
         const auto& resources = json_["resources"];
         if (resources.contains("memory_mb")) config_.resources.memory_mb = resources["memory_mb"];
         if (resources.contains("cpu_quota_percent")) config_.resources.cpu_quota_percent = resources["cpu_quota_percent"];
+        if (resources.contains("cpu_burst_percent")) config_.resources.cpu_burst_percent = resources["cpu_burst_percent"];
+        if (resources.contains("cpu_burst_interval_ms")) config_.resources.cpu_burst_interval_ms = resources["cpu_burst_interval_ms"];
         if (resources.contains("max_pids")) config_.resources.max_pids = resources["max_pids"];
         if (resources.contains("enable_swap")) config_.resources.enable_swap = resources["enable_swap"];
+        if (resources.contains("cpuset_cpus")) config_.resources.cpuset_cpus = resources["cpuset_cpus"];
+        if (resources.contains("cpuset_mems")) config_.resources.cpuset_mems = resources["cpuset_mems"];
+        if (resources.contains("drop_page_cache")) config_.resources.drop_page_cache = resources["drop_page_cache"];
+        if (resources.contains("perf_counters")) config_.resources.perf_counters = resources["perf_counters"];
+        if (resources.contains("memory_merge")) config_.resources.memory_merge = resources["memory_merge"];
+        if (resources.contains("runtime_hints")) config_.resources.runtime_hints = resources["runtime_hints"];
+        if (resources.contains("quota_affinity")) config_.resources.quota_affinity = resources["quota_affinity"];
+        if (resources.contains("virtual_proc")) config_.resources.virtual_proc = resources["virtual_proc"];
+    }
+
+    // Apply restart settings
+    if (json_.contains("restart")) {
+        const auto& restart = json_["restart"];
+        if (restart.contains("policy")) config_.restart.policy = restart["policy"];
+        if (restart.contains("backoff_initial_ms")) config_.restart.backoff_initial_ms = restart["backoff_initial_ms"];
+        if (restart.contains("backoff_max_ms")) config_.restart.backoff_max_ms = restart["backoff_max_ms"];
+        if (restart.contains("backoff_multiplier")) config_.restart.backoff_multiplier = restart["backoff_multiplier"];
+        if (restart.contains("crash_loop_window_s")) config_.restart.crash_loop_window_s = restart["crash_loop_window_s"];
+        if (restart.contains("crash_loop_max_restarts")) config_.restart.crash_loop_max_restarts = restart["crash_loop_max_restarts"];
     }
 
     // Apply isolation settings
@@ -238,6 +572,37 @@ void ConfigParser::applyDefaults() {
                 config_.mounts.bind_mounts.push_back(bm);
             }
         }
+        if (mounts.contains("dev_template")) config_.mounts.dev_template = mounts["dev_template"];
+    }
+
+    // Apply IPC settings
+    if (json_.contains("ipc")) {
+        const auto& ipc = json_["ipc"];
+        if (ipc.contains("channel_dir")) config_.ipc.channel_dir = ipc["channel_dir"];
+        if (ipc.contains("channels")) {
+            config_.ipc.channels.clear();
+            for (const auto& channel : ipc["channels"]) {
+                ChannelConfig cc;
+                cc.name = channel["name"];
+                cc.type = channel.value("type", "socket");
+                cc.target = channel.value("target", "/run/channels/" + cc.name);
+                cc.size_mb = channel.value("size_mb", 1);
+                config_.ipc.channels.push_back(cc);
+            }
+        }
+        if (ipc.contains("dataset_dir")) config_.ipc.dataset_dir = ipc["dataset_dir"];
+        if (ipc.contains("dataset_cgroup")) config_.ipc.dataset_cgroup = ipc["dataset_cgroup"];
+        if (ipc.contains("dataset_mount_dir")) config_.ipc.dataset_mount_dir = ipc["dataset_mount_dir"];
+        if (ipc.contains("datasets")) {
+            config_.ipc.datasets.clear();
+            for (const auto& dataset : ipc["datasets"]) {
+                DatasetConfig dc;
+                dc.name = dataset["name"];
+                dc.source = dataset["source"];
+                dc.huge_pages = dataset.value("huge_pages", false);
+                config_.ipc.datasets.push_back(dc);
+            }
+        }
     }
 
     // Apply AI module settings
@@ -247,11 +612,19 @@ void ConfigParser::applyDefaults() {
         if (ai.contains("provider")) config_.ai_module.provider = ai["provider"];
         if (ai.contains("api_key_env")) config_.ai_module.api_key_env = ai["api_key_env"];
         if (ai.contains("base_url")) config_.ai_module.base_url = ai["base_url"];
+        if (ai.contains("endpoints")) config_.ai_module.endpoints = ai["endpoints"].get<std::vector<std::string>>();
+        if (ai.contains("hedge_after_ms")) config_.ai_module.hedge_after_ms = ai["hedge_after_ms"];
+        if (ai.contains("breaker_failures")) config_.ai_module.breaker_failures = ai["breaker_failures"];
+        if (ai.contains("breaker_cooldown_ms")) config_.ai_module.breaker_cooldown_ms = ai["breaker_cooldown_ms"];
         if (ai.contains("model")) config_.ai_module.model = ai["model"];
         if (ai.contains("temperature")) config_.ai_module.temperature = ai["temperature"];
         if (ai.contains("max_tokens")) config_.ai_module.max_tokens = ai["max_tokens"];
         if (ai.contains("system_prompt")) config_.ai_module.system_prompt = ai["system_prompt"];
         if (ai.contains("auto_report_errors")) config_.ai_module.auto_report_errors = ai["auto_report_errors"];
+        if (ai.contains("failure_index_dir")) config_.ai_module.failure_index_dir = ai["failure_index_dir"];
+        if (ai.contains("failure_match_bits")) config_.ai_module.failure_match_bits = ai["failure_match_bits"];
+        if (ai.contains("context_window_tokens")) config_.ai_module.context_window_tokens = ai["context_window_tokens"];
+        if (ai.contains("max_prompt_tokens")) config_.ai_module.max_prompt_tokens = ai["max_prompt_tokens"];
     }
 
     // Apply logging settings
@@ -261,6 +634,70 @@ void ConfigParser::applyDefaults() {
         if (logging.contains("output")) config_.logging.output = logging["output"];
         if (logging.contains("log_file")) config_.logging.log_file = logging["log_file"];
     }
+
+    // Apply fan-out settings
+    if (json_.contains("fanout")) {
+        const auto& fanout = json_["fanout"];
+        if (fanout.contains("inputs")) {
+            config_.fanout.inputs.clear();
+            for (const auto& input : fanout["inputs"]) {
+                config_.fanout.inputs.push_back(input.get<std::string>());
+            }
+        }
+        if (fanout.contains("max_parallel")) config_.fanout.max_parallel = fanout["max_parallel"];
+        if (fanout.contains("memory_mb")) config_.fanout.memory_mb = fanout["memory_mb"];
+        if (fanout.contains("cpu_quota_percent")) config_.fanout.cpu_quota_percent = fanout["cpu_quota_percent"];
+        if (fanout.contains("max_pids")) config_.fanout.max_pids = fanout["max_pids"];
+        if (fanout.contains("timeout_ms")) config_.fanout.timeout_ms = fanout["timeout_ms"];
+        if (fanout.contains("max_output_bytes")) config_.fanout.max_output_bytes = fanout["max_output_bytes"];
+        if (fanout.contains("idempotent")) config_.fanout.idempotent = fanout["idempotent"];
+        if (fanout.contains("speculate")) config_.fanout.speculate = fanout["speculate"];
+        if (fanout.contains("speculate_percentile")) config_.fanout.speculate_percentile = fanout["speculate_percentile"];
+        if (fanout.contains("speculate_slots")) config_.fanout.speculate_slots = fanout["speculate_slots"];
+        if (fanout.contains("history_dir")) config_.fanout.history_dir = fanout["history_dir"];
+        if (fanout.contains("order")) config_.fanout.order = fanout["order"];
+    }
+
+    // Apply supervisor settings
+    if (json_.contains("supervisor")) {
+        const auto& supervisor = json_["supervisor"];
+        if (supervisor.contains("state_dir")) config_.supervisor.state_dir = supervisor["state_dir"];
+        if (supervisor.contains("hold_output")) config_.supervisor.hold_output = supervisor["hold_output"];
+        if (supervisor.contains("reap_parallelism")) config_.supervisor.reap_parallelism = supervisor["reap_parallelism"];
+        if (supervisor.contains("housekeeping_cpus")) config_.supervisor.housekeeping_cpus = supervisor["housekeeping_cpus"];
+    }
+
+    // Apply image store settings
+    if (json_.contains("images")) {
+        const auto& images = json_["images"];
+        if (images.contains("store_dirs")) config_.images.store_dirs = images["store_dirs"].get<std::vector<std::string>>();
+        if (images.contains("disk_budget_mb")) config_.images.disk_budget_mb = images["disk_budget_mb"];
+        if (images.contains("min_idle_s")) config_.images.min_idle_s = images["min_idle_s"];
+        if (images.contains("gc_interval_s")) config_.images.gc_interval_s = images["gc_interval_s"];
+        if (images.contains("blob_cache_dir")) config_.images.blob_cache_dir = images["blob_cache_dir"];
+        if (images.contains("lazy_run_dir")) config_.images.lazy_run_dir = images["lazy_run_dir"];
+        if (images.contains("lazy_threads")) config_.images.lazy_threads = images["lazy_threads"];
+        if (images.contains("verify_integrity")) config_.images.verify_integrity = images["verify_integrity"];
+        if (images.contains("integrity_dir")) config_.images.integrity_dir = images["integrity_dir"];
+        if (images.contains("integrity_threads")) config_.images.integrity_threads = images["integrity_threads"];
+        if (images.contains("slim_allowlist")) config_.images.slim_allowlist = images["slim_allowlist"].get<std::vector<std::string>>();
+    }
+
+    // Apply resource limits
+    if (json_.contains("rlimits")) {
+        for (const auto& [name, value] : json_["rlimits"].items()) {
+            config_.rlimits.push_back(parseRlimit(name, value));
+        }
+    }
+
+    // Apply core dump settings
+    if (json_.contains("cores")) {
+        const auto& cores = json_["cores"];
+        if (cores.contains("enabled")) config_.cores.enabled = cores["enabled"];
+        if (cores.contains("output_dir")) config_.cores.output_dir = cores["output_dir"];
+        if (cores.contains("max_mb")) config_.cores.max_mb = cores["max_mb"];
+        if (cores.contains("registry_dir")) config_.cores.registry_dir = cores["registry_dir"];
+    }
 }
 
 SandboxConfiguration ConfigParser::parse() {
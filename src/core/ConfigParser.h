@@ -50,6 +50,24 @@ struct BindMount {
     bool read_only;
 };
 
+/**
+ * @struct ProcessConfig
+ * @brief One process of a multi-process sandbox group.
+ *
+ * All processes of a group share the sandbox namespaces, root filesystem
+ * and parent cgroup. Each one runs in its own sub-cgroup.
+ */
+struct ProcessConfig {
+    std::string name;
+    std::vector<std::string> command;
+    std::string restart_policy;    ///< "never", "on-failure" or "always"
+    std::string stdout_path;       ///< Empty to inherit the sandbox stdout
+    std::string stderr_path;       ///< Empty to inherit the sandbox stderr
+    int memory_mb;                 ///< 0 to share the sandbox limit
+    int cpu_quota_percent;         ///< 0 to share the sandbox limit
+    int max_pids;                  ///< 0 to share the sandbox limit
+};
+
 /**
  * @struct SandboxConfig
  * @brief Core sandbox configuration.
@@ -58,10 +76,17 @@ struct SandboxConfig {
     std::string name;
     std::string hostname;
     std::string rootfs_path;
+    std::string rootfs_manifest;           ///< Packed image served lazily instead of rootfs_path
     std::vector<std::string> command;
+    std::vector<ProcessConfig> processes;  ///< Process group; first entry is the primary
     bool auto_bootstrap;
     std::string distro;
     std::string release;
+    std::string bootstrap_mirror;          ///< Mirror debootstrap fetches from
+    std::string bootstrap_packages;        ///< Local mirror or .deb directory, bootstraps offline when set
+    std::vector<std::string> bootstrap_include;  ///< Packages beyond the minimal set
+    std::string bootstrap_arch;            ///< Target architecture, empty for the host's
+    int bootstrap_threads;                 ///< Parallel unpackers, 0 for one per CPU
 };
 
 /**
@@ -71,8 +96,58 @@ struct SandboxConfig {
 struct ResourcesConfig {
     int memory_mb;
     int cpu_quota_percent;
+    int cpu_burst_percent;         ///< Quota to lend up to while the host is idle, 0 for none
+    int cpu_burst_interval_ms;     ///< How often the lent quota is adjusted
     int max_pids;
     bool enable_swap;
+    std::string cpuset_cpus;       ///< CPUs the sandbox is pinned to, empty for all
+    std::string cpuset_mems;       ///< Memory nodes the sandbox may use, empty for all
+    bool drop_page_cache;          ///< Reclaim the sandbox's page cache on teardown
+    bool perf_counters;            ///< Count perf events of the sandbox cgroup
+    bool memory_merge;             ///< Let KSM merge identical anonymous pages
+    bool runtime_hints;            ///< Export thread pool sizes matching the CPU quota
+    bool quota_affinity;           ///< Pin to as many CPUs as the CPU quota covers
+    bool virtual_proc;             ///< Show the limits in /proc/cpuinfo, /proc/meminfo and /proc/stat
+};
+
+/**
+ * @struct RestartConfig
+ * @brief Restart policy for long-running sandboxed commands.
+ *
+ * Restarts are warm: the command is executed again inside the existing
+ * namespaces, mounts and cgroup instead of rebuilding the sandbox.
+ */
+struct RestartConfig {
+    std::string policy;            ///< "never", "on-failure" or "always"
+    int backoff_initial_ms;        ///< Delay before the first restart
+    int backoff_max_ms;            ///< Upper bound for the delay
+    double backoff_multiplier;     ///< Delay growth per consecutive restart
+    int crash_loop_window_s;       ///< Window for crash-loop detection
+    int crash_loop_max_restarts;   ///< Restarts allowed per window (0 = unlimited)
+};
+
+/**
+ * @struct FanOutConfig
+ * @brief Runs the sandbox command once per input inside one sandbox.
+ *
+ * The sandbox is set up once; every input then runs in its own
+ * sub-cgroup with its own stdio. An argument of "{}" is replaced with
+ * the input path and the input is also provided on stdin.
+ */
+struct FanOutConfig {
+    std::vector<std::string> inputs;   ///< Input paths inside the sandbox
+    int max_parallel;                  ///< 0 to derive from the CPU quota
+    int memory_mb;                     ///< Per-run memory limit, 0 for none
+    int cpu_quota_percent;             ///< Per-run CPU quota, 0 for none
+    int max_pids;                      ///< Per-run PID limit, 0 for none
+    int timeout_ms;                    ///< Per-run wall-clock limit, 0 for none
+    int max_output_bytes;              ///< Captured bytes per stream and run
+    bool idempotent;                   ///< Runs may be repeated without side effects
+    bool speculate;                    ///< Duplicate runs that take unusually long
+    int speculate_percentile;          ///< Run time percentile past which a run is duplicated
+    int speculate_slots;               ///< Extra slots reserved for duplicates
+    std::string history_dir;           ///< Run times of earlier batches
+    std::string order;                 ///< "submission", "sjf", "lpt" or "memory"
 };
 
 /**
@@ -102,6 +177,50 @@ struct SecurityConfig {
 struct MountsConfig {
     std::vector<BindMount> bind_mounts;
     std::vector<std::string> volumes;
+    std::string dev_template;      ///< Shared /dev prepared on the host, empty for a bare tmpfs
+};
+
+/**
+ * @struct ChannelConfig
+ * @brief A named IPC channel shared with other sandboxes.
+ *
+ * Sandboxes that declare a channel with the same name share it. A
+ * "socket" channel is a host directory mounted into the sandbox for
+ * AF_UNIX sockets; a "shm" channel is a shared memory segment passed to
+ * the sandbox as an inherited descriptor.
+ */
+struct ChannelConfig {
+    std::string name;
+    std::string type;              ///< "socket" or "shm"
+    std::string target;            ///< Mount point of a socket channel
+    int size_mb;                   ///< Size of a shm channel
+};
+
+/**
+ * @struct DatasetConfig
+ * @brief A read-only file loaded once into memory and shared by sandboxes.
+ *
+ * Sandboxes that declare a dataset with the same name and source share
+ * one sealed memfd, so its pages are neither read from disk nor charged
+ * to the memory cgroup of every sandbox again.
+ */
+struct DatasetConfig {
+    std::string name;
+    std::string source;            ///< Host file to load
+    bool huge_pages;               ///< Back the memfd with hugetlb pages
+};
+
+/**
+ * @struct IpcConfig
+ * @brief Inter-sandbox communication configuration.
+ */
+struct IpcConfig {
+    std::string channel_dir;       ///< Host directory holding socket channels
+    std::vector<ChannelConfig> channels;
+    std::string dataset_dir;       ///< Host directory of the dataset registries
+    std::string dataset_cgroup;    ///< Cgroup charged for dataset memory, empty for the supervisor's
+    std::string dataset_mount_dir; ///< Directory of dataset links in the sandbox, empty for none
+    std::vector<DatasetConfig> datasets;
 };
 
 /**
@@ -113,11 +232,19 @@ struct AIModuleConfig {
     std::string provider;
     std::string api_key_env;
     std::string base_url;
+    std::vector<std::string> endpoints; ///< Base URLs tried in turn, empty for base_url alone
+    int hedge_after_ms;                ///< Hedge delay until an endpoint's p95 is known, 0 to never hedge
+    int breaker_failures;              ///< Failures in a row that take an endpoint out
+    int breaker_cooldown_ms;           ///< How long a failing endpoint stays out
     std::string model;
     double temperature;
     int max_tokens;
     std::string system_prompt;
     bool auto_report_errors;
+    std::string failure_index_dir;     ///< Diagnoses of earlier failures, empty to disable
+    int failure_match_bits;            ///< Fingerprint bits a similar failure may differ in
+    int context_window_tokens;         ///< Model context window, prompt and reply together
+    int max_prompt_tokens;             ///< Prompt cap below the window, 0 for the whole window
 };
 
 /**
@@ -130,6 +257,57 @@ struct LoggingConfig {
     std::string log_file;
 };
 
+/**
+ * @struct SupervisorConfig
+ * @brief Settings of the supervising sandbox process.
+ */
+struct SupervisorConfig {
+    std::string state_dir;         ///< Directory for persisted sandbox records
+    bool hold_output;              ///< Keep output pipes in a holder process
+    int reap_parallelism;          ///< Concurrent reaps during the startup scan
+    std::string housekeeping_cpus; ///< CPUs of the supervisor, kept free of sandboxes; empty for none
+    std::string workload_cpus;     ///< CPUs left to sandboxes, derived from housekeeping_cpus at startup
+};
+
+/**
+ * @struct ImagesConfig
+ * @brief Garbage collection of cached rootfs images.
+ */
+struct ImagesConfig {
+    std::vector<std::string> store_dirs;  ///< Directories whose entries are cached images
+    long long disk_budget_mb;      ///< Size to keep the stores under, 0 disables collection
+    int min_idle_s;                ///< Never evict images used more recently than this
+    int gc_interval_s;             ///< Minimum time between background collections
+    std::string blob_cache_dir;    ///< Blobs fetched for lazily served images
+    std::string lazy_run_dir;      ///< Mount points of lazily served root filesystems
+    int lazy_threads;              ///< Request threads serving each lazy rootfs
+    bool verify_integrity;         ///< Check directory rootfs images against their manifest
+    std::string integrity_dir;     ///< Integrity manifests of directory rootfs images
+    int integrity_threads;         ///< Hashing threads, 0 for one per CPU
+    std::vector<std::string> slim_allowlist;  ///< Paths kept by slim-image whether used or not
+};
+
+/**
+ * @struct RlimitConfig
+ * @brief Soft and hard value of one resource limit of the sandbox.
+ */
+struct RlimitConfig {
+    std::string resource;          ///< "nofile", "nproc", "stack", "as", "core" or "memlock"
+    unsigned long long soft;       ///< RLIM_INFINITY for unlimited
+    unsigned long long hard;       ///< RLIM_INFINITY for unlimited
+};
+
+/**
+ * @struct CoresConfig
+ * @brief Collection of core dumps of sandboxed processes.
+ */
+struct CoresConfig {
+    bool enabled;                  ///< Collect cores of this sandbox instead of dropping them
+    std::string output_dir;        ///< Cores go to <output_dir>/<sandbox id>
+    long long max_mb;              ///< Compressed size at which a core is cut off
+    std::string registry_dir;      ///< Where the collector finds the sandbox owning a core
+};
+
 /**
  * @struct SandboxConfiguration
  * @brief Complete sandbox configuration container.
@@ -137,11 +315,18 @@ struct LoggingConfig {
 struct SandboxConfiguration {
     SandboxConfig sandbox;
     ResourcesConfig resources;
+    RestartConfig restart;
+    FanOutConfig fanout;
     IsolationConfig isolation;
     SecurityConfig security;
     MountsConfig mounts;
+    IpcConfig ipc;
     AIModuleConfig ai_module;
     LoggingConfig logging;
+    SupervisorConfig supervisor;
+    ImagesConfig images;
+    std::vector<RlimitConfig> rlimits;
+    CoresConfig cores;
 };
 
 /**
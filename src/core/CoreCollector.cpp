@@ -0,0 +1,509 @@
+/**
+ * @file CoreCollector.cpp
+ * @brief Implementation of the CoreCollector class.
+ */
+
+#include "core/CoreCollector.h"
+#include "core/Logger.h"
+#include "utils/Syscalls.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <sstream>
+#include <grp.h>
+#include <unistd.h>
+#include <linux/openat2.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <zlib.h>
+
+namespace sandbox {
+
+namespace {
+
+const char* const kCorePatternPath = "/proc/sys/kernel/core_pattern";
+const char* const kPipeLimitPath = "/proc/sys/kernel/core_pipe_limit";
+
+/// Saved core_pattern and core_pipe_limit, restored by uninstall
+const char* const kSavedPattern = ".core_pattern";
+
+/// Collectors the kernel waits for at once; more cores are not waited for
+const char* const kPipeLimit = "16";
+
+/// The kernel truncates longer core patterns
+const size_t kMaxPatternLength = 127;
+
+/// Output the compressor may still hold when input stops
+const long long kFinishSlack = 64 * 1024;
+
+/// Cores kept per sandbox, so that a crash loop cannot fill the disk
+const size_t kMaxCores = 16;
+
+bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool writeAll(int fd, const unsigned char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/// Keep the executable name safe for a file name
+std::string fileSafe(const std::string& name) {
+    std::string safe = name.empty() ? "unknown" : name;
+    for (char& c : safe) {
+        if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.') {
+            c = '_';
+        }
+    }
+    return safe;
+}
+
+/// First or, with last set, last value of a /proc/<pid>/status line
+std::string statusValue(const std::string& status, const std::string& key, bool last) {
+    std::istringstream lines(status);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.compare(0, key.size() + 1, key + ":") != 0) {
+            continue;
+        }
+        std::istringstream values(line.substr(key.size() + 1));
+        std::string value;
+        std::string result;
+        while (values >> value) {
+            result = value;
+            if (!last) {
+                break;
+            }
+        }
+        return result;
+    }
+    return "";
+}
+
+/// Soft RLIMIT_CORE of a process
+unsigned long long coreLimit(pid_t pid) {
+    const std::string key = "Max core file size";
+    std::istringstream lines(Syscall::readFile("/proc/" + std::to_string(pid) + "/limits").value_or(""));
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.compare(0, key.size(), key) == 0) {
+            std::istringstream values(line.substr(key.size()));
+            std::string soft;
+            values >> soft;
+            return soft == "unlimited" ? ULLONG_MAX : std::strtoull(soft.c_str(), nullptr, 10);
+        }
+    }
+    return 0;
+}
+
+/// Hand a core no sandbox collects to the handler saved by install()
+int forwardCore(const std::string& registryDir, pid_t pid, int signal, const std::string& exe, int input) {
+    auto saved = Syscall::readFile(registryDir + "/" + kSavedPattern);
+    if (!saved) {
+        return 0;
+    }
+    std::istringstream in(*saved);
+    std::string limit;
+    std::string pattern;
+    std::getline(in, limit);
+    std::getline(in, pattern);
+    if (pattern.empty()) {
+        pattern = "core";
+    }
+    // A saved pattern running the collector again would loop
+    if (pattern.find(" core-collect ") != std::string::npos) {
+        return 0;
+    }
+
+    std::string proc = "/proc/" + std::to_string(pid);
+    std::string status = Syscall::readFile(proc + "/status").value_or("");
+    std::string nsPid = statusValue(status, "NSpid", true);
+    if (nsPid.empty()) {
+        nsPid = std::to_string(pid);
+    }
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::read_symlink(proc + "/exe", ec);
+    std::string flatPath = path.string();
+    std::replace(flatPath.begin(), flatPath.end(), '/', '!');
+    char host[256] = {};
+    gethostname(host, sizeof(host) - 1);
+    unsigned long long maxSize = coreLimit(pid);
+
+    std::map<char, std::string> values = {
+        {'p', nsPid}, {'P', std::to_string(pid)}, {'i', nsPid}, {'I', std::to_string(pid)},
+        {'u', statusValue(status, "Uid", false)}, {'g', statusValue(status, "Gid", false)},
+        {'d', "1"}, {'s', std::to_string(signal)}, {'t', std::to_string(time(nullptr))},
+        {'h', host}, {'e', exe}, {'E', flatPath}, {'f', path.filename().string()},
+        {'c', std::to_string(maxSize)},
+    };
+
+    if (pattern[0] == '|') {
+        // The helper may ask for a pidfd of the crashed process
+        int pidFd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+        if (pidFd >= 0) {
+            values['F'] = std::to_string(pidFd);
+        }
+
+        // Split before expansion, as the kernel does
+        std::vector<std::string> args;
+        std::istringstream words(pattern.substr(1));
+        std::string word;
+        while (words >> word) {
+            args.push_back(CoreCollector::expandPattern(word, values));
+        }
+        if (args.empty() || (input != STDIN_FILENO && dup2(input, STDIN_FILENO) < 0)) {
+            return 1;
+        }
+        std::vector<char*> argv;
+        for (auto& arg : args) {
+            argv.push_back(arg.data());
+        }
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        return 127;
+    }
+
+    // A file is written as the kernel would: in the crashed process's
+    // root and working directory, up to its core limit
+    std::string file = CoreCollector::expandPattern(pattern, values);
+    if (pattern.find("%p") == std::string::npos &&
+        Syscall::readFile("/proc/sys/kernel/core_uses_pid").value_or("0").compare(0, 1, "1") == 0) {
+        file += "." + nsPid;
+    }
+    if (maxSize == 0) {
+        return 0;
+    }
+
+    // Open the file as the crashed process would: with its credentials and
+    // inside its root, without following /proc magic links. A relative
+    // pattern stays below its working directory.
+    ScopedFd dir(open((proc + (file[0] == '/' ? "/root" : "/cwd")).c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC));
+    if (!dir.isValid()) {
+        return 1;
+    }
+    uid_t uid = static_cast<uid_t>(std::atoi(statusValue(status, "Uid", true).c_str()));
+    gid_t gid = static_cast<gid_t>(std::atoi(statusValue(status, "Gid", true).c_str()));
+    std::vector<gid_t> groups;
+    std::istringstream lines(status);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.compare(0, 7, "Groups:") == 0) {
+            std::istringstream ids(line.substr(7));
+            for (gid_t group; ids >> group;) {
+                groups.push_back(group);
+            }
+        }
+    }
+
+    pid_t child = fork();
+    if (child < 0) {
+        return 1;
+    }
+    if (child == 0) {
+        if ((getuid() == 0 && setgroups(groups.size(), groups.data()) < 0) ||
+            setresgid(gid, gid, gid) < 0 || setresuid(uid, uid, uid) < 0) {
+            _exit(1);
+        }
+        struct open_how how;
+        memset(&how, 0, sizeof(how));
+        how.flags = O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC;
+        how.mode = 0600;
+        how.resolve = RESOLVE_IN_ROOT | RESOLVE_NO_MAGICLINKS;
+        int out = static_cast<int>(syscall(SYS_openat2, dir.get(), file.c_str(), &how, sizeof(how)));
+        if (out < 0) {
+            _exit(1);
+        }
+
+        unsigned char buffer[64 * 1024];
+        unsigned long long copied = 0;
+        while (copied < maxSize) {
+            size_t wanted = static_cast<size_t>(std::min<unsigned long long>(sizeof(buffer), maxSize - copied));
+            ssize_t n = read(input, buffer, wanted);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            if (!writeAll(out, buffer, static_cast<size_t>(n))) {
+                _exit(1);
+            }
+            copied += static_cast<unsigned long long>(n);
+        }
+        _exit(0);
+    }
+
+    int childStatus = 0;
+    while (waitpid(child, &childStatus, 0) < 0 && errno == EINTR) {
+    }
+    return WIFEXITED(childStatus) ? WEXITSTATUS(childStatus) : 1;
+}
+
+} // namespace
+
+bool CoreCollector::registerSandbox(const std::string& registryDir, const std::string& cgroupName,
+                                    const Entry& entry) {
+    if (!Syscall::mkdirRecursive(registryDir, 0700) || !Syscall::mkdirRecursive(entry.outputDir, 0700)) {
+        SANDBOX_ERROR("Failed to create core directories for " + cgroupName);
+        return false;
+    }
+
+    // Written whole, so a collector never reads half an entry
+    std::string path = registryDir + "/" + cgroupName;
+    std::string tmp = path + ".tmp";
+    if (!Syscall::writeFile(tmp, std::to_string(entry.maxBytes) + " " + entry.outputDir + "\n") ||
+        chmod(tmp.c_str(), 0600) < 0 || rename(tmp.c_str(), path.c_str()) < 0) {
+        SANDBOX_ERROR("Failed to register " + cgroupName + " for core collection");
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+void CoreCollector::unregisterSandbox(const std::string& registryDir, const std::string& cgroupName) {
+    unlink((registryDir + "/" + cgroupName).c_str());
+}
+
+std::optional<CoreCollector::Entry> CoreCollector::lookup(const std::string& registryDir,
+                                                          const std::string& cgroupPath) {
+    std::stringstream components(cgroupPath);
+    std::string component;
+    while (std::getline(components, component, '/')) {
+        if (component.empty() || component[0] == '.') {
+            continue;
+        }
+
+        // Only entries written by root count
+        std::string path = registryDir + "/" + component;
+        struct stat st;
+        if (lstat(path.c_str(), &st) < 0 || !S_ISREG(st.st_mode) || st.st_uid != 0 ||
+            (st.st_mode & 0077) != 0) {
+            continue;
+        }
+        auto content = Syscall::readFile(path);
+        if (!content) {
+            continue;
+        }
+        Entry entry;
+        std::istringstream in(*content);
+        if (!(in >> entry.maxBytes) || entry.maxBytes <= 0) {
+            return std::nullopt;
+        }
+        std::getline(in >> std::ws, entry.outputDir);
+        if (entry.outputDir.empty()) {
+            return std::nullopt;
+        }
+        return entry;
+    }
+    return std::nullopt;
+}
+
+bool CoreCollector::compress(int input, const std::string& path, long long maxBytes, bool& truncated) {
+    truncated = false;
+    ScopedFd out(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600));
+    if (!out.isValid()) {
+        return false;
+    }
+
+    // Fastest level: the crashed process is held until the core is read
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, 1, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    unsigned char in[64 * 1024];
+    unsigned char buffer[64 * 1024];
+    long long written = 0;
+    bool ok = true;
+    bool done = false;
+    while (ok && !done) {
+        ssize_t n = 0;
+        if (written + kFinishSlack >= maxBytes) {
+            // Stop reading; closing the pipe ends the dump
+            truncated = true;
+        } else {
+            n = read(input, in, sizeof(in));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                truncated = true;
+                n = 0;
+            }
+        }
+        done = n == 0;
+
+        zs.next_in = in;
+        zs.avail_in = static_cast<uInt>(n);
+        do {
+            zs.next_out = buffer;
+            zs.avail_out = sizeof(buffer);
+            if (deflate(&zs, done ? Z_FINISH : Z_NO_FLUSH) == Z_STREAM_ERROR) {
+                ok = false;
+                break;
+            }
+            size_t produced = sizeof(buffer) - zs.avail_out;
+            ok = writeAll(out.get(), buffer, produced);
+            written += static_cast<long long>(produced);
+        } while (ok && zs.avail_out == 0);
+    }
+    deflateEnd(&zs);
+    return ok;
+}
+
+int CoreCollector::collect(const std::string& registryDir, pid_t pid, int signal, const std::string& exe,
+                           int input) {
+    // Read /proc/<pid>/cgroup while the kernel holds the crashed process
+    auto cgroups = Syscall::readFile("/proc/" + std::to_string(pid) + "/cgroup");
+    if (!cgroups) {
+        return 1;
+    }
+    std::string cgroupPath;
+    std::istringstream lines(*cgroups);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.compare(0, 3, "0::") == 0) {
+            cgroupPath = line.substr(3);
+        }
+    }
+
+    // Not a sandbox collecting cores: the host's own handler takes it
+    auto entry = lookup(registryDir, cgroupPath);
+    if (!entry) {
+        return forwardCore(registryDir, pid, signal, exe, input);
+    }
+    if (listCores(entry->outputDir).size() >= kMaxCores) {
+        return 0;
+    }
+
+    // Stay out of the way of every other sandbox's disk I/O
+    Syscall::setIdleIoPriority();
+
+    std::string base = entry->outputDir + "/core." + fileSafe(exe) + "." + std::to_string(pid);
+    std::string partial = base + ".gz.partial";
+    bool truncated = false;
+    if (!compress(input, partial, entry->maxBytes, truncated)) {
+        unlink(partial.c_str());
+        return 1;
+    }
+    std::string final = base + (truncated ? kTruncatedSuffix : ".gz");
+    if (rename(partial.c_str(), final.c_str()) < 0) {
+        unlink(partial.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+std::string CoreCollector::expandPattern(const std::string& pattern, const std::map<char, std::string>& values) {
+    std::string expanded;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] != '%' || i + 1 == pattern.size()) {
+            expanded += pattern[i];
+            continue;
+        }
+        char specifier = pattern[++i];
+        if (specifier == '%') {
+            expanded += '%';
+        } else if (auto it = values.find(specifier); it != values.end()) {
+            expanded += it->second;
+        }
+    }
+    return expanded;
+}
+
+std::vector<std::string> CoreCollector::listCores(const std::string& outputDir) {
+    std::vector<std::string> cores;
+    std::error_code ec;
+    for (const auto& file : std::filesystem::directory_iterator(outputDir, ec)) {
+        std::string name = file.path().filename().string();
+        if (name.compare(0, 5, "core.") == 0 && endsWith(name, ".gz")) {
+            cores.push_back(file.path().string());
+        }
+    }
+    std::sort(cores.begin(), cores.end());
+    return cores;
+}
+
+bool CoreCollector::install(const std::string& registryDir) {
+    std::error_code ec;
+    std::string exe = std::filesystem::read_symlink("/proc/self/exe", ec).string();
+    if (ec) {
+        SANDBOX_ERROR("Cannot resolve the sandbox executable: " + ec.message());
+        return false;
+    }
+
+    // The executable name goes last: it may contain spaces
+    std::string pattern = "|" + exe + " core-collect " + registryDir + " %P %s %e";
+    if (pattern.size() > kMaxPatternLength) {
+        SANDBOX_ERROR("Core pattern longer than the kernel allows: " + pattern);
+        return false;
+    }
+    if (!Syscall::mkdirRecursive(registryDir, 0700)) {
+        SANDBOX_ERROR("Failed to create " + registryDir);
+        return false;
+    }
+
+    // Keep the host's own handler for uninstall
+    std::string saved = registryDir + "/" + kSavedPattern;
+    if (!isInstalled() && !Syscall::exists(saved)) {
+        auto previous = Syscall::readFile(kCorePatternPath);
+        auto previousLimit = Syscall::readFile(kPipeLimitPath);
+        if (!previous || !previousLimit ||
+            !Syscall::writeFile(saved, *previousLimit + *previous)) {
+            SANDBOX_ERROR("Failed to save the current core pattern");
+            return false;
+        }
+    }
+
+    if (!Syscall::writeFile(kPipeLimitPath, kPipeLimit) || !Syscall::writeFile(kCorePatternPath, pattern)) {
+        SANDBOX_ERROR("Failed to install the core handler");
+        return false;
+    }
+    SANDBOX_INFO("Core dumps are collected by " + exe);
+    return true;
+}
+
+bool CoreCollector::uninstall(const std::string& registryDir) {
+    std::string saved = registryDir + "/" + kSavedPattern;
+    auto content = Syscall::readFile(saved);
+    if (!content) {
+        SANDBOX_ERROR("No saved core pattern in " + registryDir);
+        return false;
+    }
+
+    // First line is core_pipe_limit, second the pattern
+    std::istringstream in(*content);
+    std::string limit;
+    std::string pattern;
+    std::getline(in, limit);
+    std::getline(in, pattern);
+    if (!Syscall::writeFile(kCorePatternPath, pattern) || !Syscall::writeFile(kPipeLimitPath, limit)) {
+        SANDBOX_ERROR("Failed to restore the core pattern");
+        return false;
+    }
+    unlink(saved.c_str());
+    SANDBOX_INFO("Restored core pattern: " + pattern);
+    return true;
+}
+
+bool CoreCollector::isInstalled() {
+    auto pattern = Syscall::readFile(kCorePatternPath);
+    return pattern && pattern->find(" core-collect ") != std::string::npos;
+}
+
+} // namespace sandbox
@@ -0,0 +1,146 @@
+/**
+ * @file CoreCollector.h
+ * @brief Core dump collection for sandboxed processes.
+ *
+ * This header defines the CoreCollector class that the kernel runs for
+ * every core dump and that writes the cores of sandboxed processes,
+ * compressed and size-capped, into the directory of their sandbox.
+ */
+
+#ifndef SANDBOX_CORE_COLLECTOR_H
+#define SANDBOX_CORE_COLLECTOR_H
+
+#include <sys/types.h>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace sandbox {
+
+/**
+ * @class CoreCollector
+ * @brief Routes core dumps to the sandbox that produced them.
+ *
+ * `sandbox core-handler install` points kernel.core_pattern at
+ * `sandbox core-collect`, so the kernel pipes every core into the
+ * collector instead of writing it to disk. The collector reads the cgroup
+ * of the crashed process from /proc and looks up the sandbox owning it
+ * in the registry directory, where each supervisor records the output
+ * directory and size cap of its sandbox while it runs. The core is then
+ * gzip-compressed as it streams in, at idle I/O priority, and cut off at
+ * the cap. Cores of processes outside any registered sandbox, or of
+ * sandboxes without collection, go to the core_pattern saved by
+ * install(): a pipe helper is executed with the core on stdin, a file
+ * pattern is written as the kernel would, so host services keep their
+ * handler.
+ *
+ * With kernel.core_pipe_limit set, the kernel waits for the collector
+ * before it reaps the crashed process, so a core is complete by the
+ * time the supervisor sees its sandbox exit.
+ */
+class CoreCollector {
+public:
+    /// Suffix of a core cut off at the size cap
+    static constexpr const char* kTruncatedSuffix = ".truncated.gz";
+
+    /**
+     * @struct Entry
+     * @brief Registration of one sandbox.
+     */
+    struct Entry {
+        std::string outputDir;     ///< Directory the cores are written to
+        long long maxBytes;        ///< Compressed size at which a core is cut off
+    };
+
+    /**
+     * @brief Register a sandbox so that its cores are collected.
+     * @param registryDir The registry directory.
+     * @param cgroupName Name of the sandbox cgroup.
+     * @param entry Where and how large the cores may be written.
+     * @return true if successful.
+     */
+    static bool registerSandbox(const std::string& registryDir, const std::string& cgroupName,
+                                const Entry& entry);
+
+    /**
+     * @brief Remove the registration of a sandbox.
+     * @param registryDir The registry directory.
+     * @param cgroupName Name of the sandbox cgroup.
+     */
+    static void unregisterSandbox(const std::string& registryDir, const std::string& cgroupName);
+
+    /**
+     * @brief Find the sandbox owning a cgroup.
+     *
+     * The outermost registered component of the path wins, so that a
+     * sandbox cannot route its cores elsewhere by creating cgroups.
+     *
+     * @param registryDir The registry directory.
+     * @param cgroupPath The cgroup v2 path of the process.
+     * @return The registration, or nullopt if no sandbox owns the cgroup.
+     */
+    static std::optional<Entry> lookup(const std::string& registryDir, const std::string& cgroupPath);
+
+    /**
+     * @brief Compress a stream into a file, stopping at a size cap.
+     * @param input Descriptor to read until end of file.
+     * @param path The gzip file to write.
+     * @param maxBytes Largest size of the compressed file.
+     * @param truncated Output whether the input did not fit.
+     * @return true if successful.
+     */
+    static bool compress(int input, const std::string& path, long long maxBytes, bool& truncated);
+
+    /**
+     * @brief Collect one core dump; run by the kernel through core_pattern.
+     * @param registryDir The registry directory.
+     * @param pid PID of the crashed process in the initial PID namespace.
+     * @param signal Signal that caused the dump.
+     * @param exe Name of the crashed executable.
+     * @param input Descriptor the core is read from.
+     * @return 0 if the core was written or dropped as intended; does
+     *         not return when a saved pipe helper takes the core.
+     */
+    static int collect(const std::string& registryDir, pid_t pid, int signal, const std::string& exe,
+                       int input);
+
+    /**
+     * @brief Expand the % specifiers of a core_pattern.
+     * @param pattern The pattern, or one argument of a pipe pattern.
+     * @param values Expansion of each specifier letter; others expand to nothing.
+     * @return The expanded pattern.
+     */
+    static std::string expandPattern(const std::string& pattern, const std::map<char, std::string>& values);
+
+    /**
+     * @brief List the cores collected in a directory.
+     * @param outputDir The directory.
+     * @return Paths of the finished cores.
+     */
+    static std::vector<std::string> listCores(const std::string& outputDir);
+
+    /**
+     * @brief Point kernel.core_pattern at this executable.
+     * @param registryDir The registry directory the collector uses.
+     * @return true if successful.
+     */
+    static bool install(const std::string& registryDir);
+
+    /**
+     * @brief Restore the core_pattern saved by install().
+     * @param registryDir The registry directory the collector uses.
+     * @return true if successful.
+     */
+    static bool uninstall(const std::string& registryDir);
+
+    /**
+     * @brief Check whether the collector is the kernel's core handler.
+     * @return true if core_pattern runs the collector.
+     */
+    static bool isInstalled();
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_CORE_COLLECTOR_H
@@ -0,0 +1,551 @@
+/**
+ * @file FanOut.cpp
+ * @brief Implementation of the FanOutRunner class.
+ */
+
+#include "core/FanOut.h"
+#include "core/Logger.h"
+#include "utils/Syscalls.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <sstream>
+#include <cstdlib>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using json = nlohmann::json;
+
+namespace sandbox {
+
+namespace {
+
+/// CPU a process last ran on, from field 39 of /proc/<pid>/stat
+int lastCpu(pid_t pid) {
+    auto stat = Syscall::readFile("/proc/" + std::to_string(pid) + "/stat");
+    if (!stat) {
+        return -1;
+    }
+    // The command name may contain spaces; fields are counted after it
+    size_t paren = stat->rfind(')');
+    if (paren == std::string::npos) {
+        return -1;
+    }
+    std::istringstream fields(stat->substr(paren + 1));
+    std::string field;
+    for (int i = 3; i <= 39 && fields >> field; ++i) {
+        if (i == 39) {
+            return std::atoi(field.c_str());
+        }
+    }
+    return -1;
+}
+
+/// Estimate of an input, falling back to the median of the known ones
+RunEstimate estimateOf(const std::map<std::string, RunEstimate>& estimates, const std::string& input) {
+    auto it = estimates.find(input);
+    if (it != estimates.end()) {
+        return it->second;
+    }
+    std::vector<long> times;
+    std::vector<long long> peaks;
+    for (const auto& [name, estimate] : estimates) {
+        times.push_back(estimate.timeMs);
+        if (estimate.peakBytes >= 0) {
+            peaks.push_back(estimate.peakBytes);
+        }
+    }
+    RunEstimate median{0, -1};
+    if (!times.empty()) {
+        std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+        median.timeMs = times[times.size() / 2];
+    }
+    if (!peaks.empty()) {
+        std::nth_element(peaks.begin(), peaks.begin() + peaks.size() / 2, peaks.end());
+        median.peakBytes = peaks[peaks.size() / 2];
+    }
+    return median;
+}
+
+} // namespace
+
+FanOutRunner::FanOutRunner(const std::vector<std::string>& command, const FanOutConfig& config)
+    : command_(command)
+    , config_(config)
+    , inputSlots_(0)
+    , speculateAfterMs_(-1)
+    , memoryBudgetBytes_(0)
+    , allSucceeded_(true)
+{
+}
+
+void FanOutRunner::setSlots(const std::vector<FanOutSlot>& slots) {
+    slots_ = slots;
+}
+
+void FanOutRunner::setSpeculationThreshold(long thresholdMs) {
+    speculateAfterMs_ = config_.speculate ? thresholdMs : -1;
+}
+
+void FanOutRunner::setEstimates(const std::map<std::string, RunEstimate>& estimates,
+                                long long memoryBudgetBytes) {
+    // Unknown inputs get the median once, not on every dispatch
+    estimates_ = estimates;
+    for (const auto& input : config_.inputs) {
+        if (!estimates.count(input)) {
+            estimates_[input] = estimateOf(estimates, input);
+        }
+    }
+    memoryBudgetBytes_ = memoryBudgetBytes;
+}
+
+int FanOutRunner::slotCount(const SandboxConfiguration& config) {
+    int slots = config.fanout.max_parallel;
+    if (slots <= 0) {
+        slots = (config.resources.cpu_quota_percent + 99) / 100;
+    }
+    slots = std::min<int>(slots, static_cast<int>(config.fanout.inputs.size()));
+    slots = std::max(slots, 1);
+    if (config.fanout.speculate) {
+        slots += config.fanout.speculate_slots;
+    }
+    return slots;
+}
+
+std::vector<std::string> FanOutRunner::orderInputs(const std::vector<std::string>& inputs,
+                                                   const std::map<std::string, RunEstimate>& estimates,
+                                                   const std::string& order) {
+    if (order == "submission") {
+        return inputs;
+    }
+    std::vector<std::pair<RunEstimate, std::string>> keyed;
+    for (const auto& input : inputs) {
+        keyed.emplace_back(estimateOf(estimates, input), input);
+    }
+
+    // Stable, so equal estimates keep submission order
+    std::stable_sort(keyed.begin(), keyed.end(), [&order](const auto& a, const auto& b) {
+        if (order == "sjf") {
+            return a.first.timeMs < b.first.timeMs;
+        }
+        if (order == "lpt") {
+            return a.first.timeMs > b.first.timeMs;
+        }
+        // First fit decreasing: the large inputs are the hard ones to place
+        return a.first.peakBytes > b.first.peakBytes;
+    });
+
+    std::vector<std::string> ordered;
+    for (auto& [estimate, input] : keyed) {
+        ordered.push_back(std::move(input));
+    }
+    return ordered;
+}
+
+std::vector<std::string> FanOutRunner::substitute(const std::vector<std::string>& command,
+                                                  const std::string& input) {
+    std::vector<std::string> args = command;
+    for (auto& arg : args) {
+        if (arg == "{}") {
+            arg = input;
+        }
+    }
+    return args;
+}
+
+std::string FanOutRunner::toJsonLine(const InputResult& result) {
+    json j;
+    j["input"] = result.input;
+    j["exit_code"] = result.exitCode;
+    j["timed_out"] = result.timedOut;
+    j["execution_time_ms"] = result.executionTimeMs;
+    j["memory_peak_bytes"] = result.memoryPeakBytes;
+    j["stdout"] = result.stdout;
+    j["stderr"] = result.stderr;
+    j["speculated"] = result.speculated;
+
+    // Program output need not be valid UTF-8
+    return j.dump(-1, ' ', false, json::error_handler_t::replace) + "\n";
+}
+
+std::vector<InputResult> FanOutRunner::parseResults(const std::string& lines) {
+    std::vector<InputResult> results;
+    std::istringstream stream(lines);
+    std::string line;
+
+    while (std::getline(stream, line)) {
+        json j = json::parse(line, nullptr, false);
+        if (j.is_discarded() || !j.is_object()) {
+            continue;
+        }
+
+        InputResult result;
+        result.input = j.value("input", "");
+        result.exitCode = j.value("exit_code", -1);
+        result.timedOut = j.value("timed_out", false);
+        result.executionTimeMs = j.value("execution_time_ms", 0L);
+        result.memoryPeakBytes = j.value("memory_peak_bytes", -1LL);
+        result.stdout = j.value("stdout", "");
+        result.stderr = j.value("stderr", "");
+        result.speculated = j.value("speculated", false);
+        results.push_back(result);
+    }
+
+    return results;
+}
+
+int FanOutRunner::run(int resultFd) {
+    if (slots_.empty()) {
+        slots_.push_back({-1, -1, -1});
+    }
+    runs_.assign(slots_.size(), Run{});
+
+    // Slots reserved for duplicates exist whether or not the history
+    // allows speculating yet; at least one slot runs inputs
+    size_t reserved = config_.speculate ? static_cast<size_t>(std::max(config_.speculate_slots, 0)) : 0;
+    inputSlots_ = slots_.size() - std::min(reserved, slots_.size() - 1);
+
+    SANDBOX_INFO("Running " + std::to_string(config_.inputs.size()) + " inputs in " +
+                 std::to_string(slots_.size()) + " slots, " + config_.order + " order");
+
+    std::vector<std::string> ordered = orderInputs(config_.inputs, estimates_, config_.order);
+    std::list<std::string> pending(ordered.begin(), ordered.end());
+    while (true) {
+        // Fill free slots
+        for (size_t i = 0; i < inputSlots_ && !pending.empty(); ++i) {
+            if (runs_[i].active) {
+                continue;
+            }
+            auto next = pickNext(pending);
+            if (next == pending.end()) {
+                break;
+            }
+            std::string input = *next;
+            pending.erase(next);
+            if (!start(i, input)) {
+                finish(i, resultFd);
+            }
+        }
+
+        std::vector<struct pollfd> fds;
+        std::vector<std::pair<size_t, bool>> owners;  // slot, is stdout
+        bool anyActive = false;
+        for (size_t i = 0; i < runs_.size(); ++i) {
+            if (!runs_[i].active) {
+                continue;
+            }
+            anyActive = true;
+            if (runs_[i].stdoutFd >= 0) {
+                fds.push_back({runs_[i].stdoutFd, POLLIN, 0});
+                owners.emplace_back(i, true);
+            }
+            if (runs_[i].stderrFd >= 0) {
+                fds.push_back({runs_[i].stderrFd, POLLIN, 0});
+                owners.emplace_back(i, false);
+            }
+        }
+        if (!anyActive) {
+            break;
+        }
+
+        poll(fds.data(), fds.size(), 100);
+        for (size_t k = 0; k < fds.size(); ++k) {
+            if (fds[k].revents & (POLLIN | POLLHUP | POLLERR)) {
+                Run& r = runs_[owners[k].first];
+                if (owners[k].second) {
+                    drain(r.stdoutFd, r.result.stdout);
+                } else {
+                    drain(r.stderrFd, r.result.stderr);
+                }
+            }
+        }
+
+        // Reap exited runs
+        int status = 0;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            for (auto& r : runs_) {
+                if (r.active && r.pid == pid) {
+                    r.exited = true;
+                    r.result.exitCode = WIFEXITED(status) ? WEXITSTATUS(status)
+                                      : WIFSIGNALED(status) ? -WTERMSIG(status) : -1;
+                }
+            }
+        }
+
+        auto now = Clock::now();
+        for (size_t i = 0; i < runs_.size(); ++i) {
+            Run& r = runs_[i];
+            if (!r.active) {
+                continue;
+            }
+            if (r.exited) {
+                finish(i, resultFd);
+            } else if (config_.timeout_ms > 0 && !r.result.timedOut &&
+                       now - r.start > std::chrono::milliseconds(config_.timeout_ms)) {
+                SANDBOX_DEBUG("Input " + r.result.input + " timed out");
+                r.result.timedOut = true;
+                killSlot(i);
+            }
+        }
+        speculate(now);
+    }
+
+    return allSucceeded_ ? 0 : 1;
+}
+
+bool FanOutRunner::start(size_t slot, const std::string& input, const std::vector<int>& cpus) {
+    Run& r = runs_[slot];
+    r.active = true;
+    r.pid = -1;
+    r.stdoutFd = -1;
+    r.stderrFd = -1;
+    r.exited = false;
+    r.start = Clock::now();
+    r.firstStart = r.start;
+    r.result = InputResult{input, 127, false, 0, -1, "", "", false};
+    r.twin = -1;
+    r.lost = false;
+
+    // Start a fresh memory measurement for this run
+    const FanOutSlot& s = slots_[slot];
+    if (s.peakFd >= 0 && write(s.peakFd, "reset\n", 6) < 0) {
+        SANDBOX_DEBUG("Failed to reset memory.peak: " + std::string(strerror(errno)));
+    }
+
+    int out[2];
+    int err[2];
+    if (pipe2(out, O_CLOEXEC) < 0) {
+        return false;
+    }
+    if (pipe2(err, O_CLOEXEC) < 0) {
+        close(out[0]);
+        close(out[1]);
+        return false;
+    }
+
+    // Build argv before forking
+    std::vector<std::string> args = substitute(command_, input);
+    std::vector<char*> argv;
+    for (auto& arg : args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &cpuSet);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        SANDBOX_ERROR("Failed to fork run for " + input + ": " + std::string(strerror(errno)));
+        close(out[0]);
+        close(out[1]);
+        close(err[0]);
+        close(err[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        if (s.procsFd >= 0 && write(s.procsFd, "0", 1) < 0) {
+            _exit(127);
+        }
+        if (!cpus.empty()) {
+            sched_setaffinity(0, sizeof(cpuSet), &cpuSet);
+        }
+        int in = open(input.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0 || dup2(in, STDIN_FILENO) < 0 ||
+            dup2(out[1], STDOUT_FILENO) < 0 || dup2(err[1], STDERR_FILENO) < 0) {
+            _exit(127);
+        }
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    close(out[1]);
+    close(err[1]);
+    fcntl(out[0], F_SETFL, O_NONBLOCK);
+    fcntl(err[0], F_SETFL, O_NONBLOCK);
+
+    r.pid = pid;
+    r.stdoutFd = out[0];
+    r.stderrFd = err[0];
+    return true;
+}
+
+std::list<std::string>::iterator FanOutRunner::pickNext(std::list<std::string>& pending) {
+    if (config_.order != "memory" || memoryBudgetBytes_ <= 0) {
+        return pending.begin();
+    }
+
+    long long used = 0;
+    bool anyActive = false;
+    for (size_t i = 0; i < inputSlots_; ++i) {
+        if (runs_[i].active) {
+            used += std::max(estimateOf(estimates_, runs_[i].result.input).peakBytes, 0LL);
+            anyActive = true;
+        }
+    }
+    for (auto it = pending.begin(); it != pending.end(); ++it) {
+        if (used + std::max(estimateOf(estimates_, *it).peakBytes, 0LL) <= memoryBudgetBytes_) {
+            return it;
+        }
+    }
+
+    // An input larger than the budget still runs, alone
+    return anyActive ? pending.end() : pending.begin();
+}
+
+void FanOutRunner::speculate(Clock::time_point now) {
+    if (speculateAfterMs_ < 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < inputSlots_; ++i) {
+        Run& r = runs_[i];
+        if (!r.active || r.exited || r.result.speculated || r.result.timedOut ||
+            now - r.start < std::chrono::milliseconds(speculateAfterMs_)) {
+            continue;
+        }
+
+        size_t free = inputSlots_;
+        while (free < runs_.size() && runs_[free].active) {
+            ++free;
+        }
+        if (free == runs_.size()) {
+            return;
+        }
+
+        std::string input = r.result.input;
+        if (!start(free, input, idleCpus())) {
+            runs_[free].active = false;
+            continue;
+        }
+        SANDBOX_DEBUG("Input " + input + " still running after " + std::to_string(speculateAfterMs_) +
+                      "ms, started a duplicate");
+        r.twin = static_cast<int>(free);
+        runs_[free].twin = static_cast<int>(i);
+        runs_[free].firstStart = r.firstStart;
+        r.result.speculated = true;
+        runs_[free].result.speculated = true;
+    }
+}
+
+std::vector<int> FanOutRunner::idleCpus() const {
+    std::vector<int> cpus = Syscall::getAffinityCpus();
+    for (const auto& r : runs_) {
+        if (r.active && !r.exited && r.pid > 0) {
+            cpus.erase(std::remove(cpus.begin(), cpus.end(), lastCpu(r.pid)), cpus.end());
+        }
+    }
+    return cpus;
+}
+
+void FanOutRunner::killSlot(size_t slot) {
+    // cgroup.kill also takes whatever the run started
+    if (slots_[slot].killFd >= 0 && write(slots_[slot].killFd, "1", 1) == 1) {
+        return;
+    }
+    if (runs_[slot].pid > 0) {
+        kill(runs_[slot].pid, SIGKILL);
+    }
+}
+
+void FanOutRunner::drain(int& fd, std::string& sink) {
+    char buffer[4096];
+    while (fd >= 0) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            // Keep reading past the cap so the run never blocks on a full pipe
+            size_t cap = static_cast<size_t>(config_.max_output_bytes);
+            if (config_.max_output_bytes <= 0) {
+                sink.append(buffer, n);
+            } else if (sink.size() < cap) {
+                sink.append(buffer, std::min(cap - sink.size(), static_cast<size_t>(n)));
+            }
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (n == 0 || errno != EAGAIN) {
+                close(fd);
+                fd = -1;
+            }
+            return;
+        }
+    }
+}
+
+void FanOutRunner::finish(size_t slot, int resultFd) {
+    Run& r = runs_[slot];
+
+    // Pick up output written just before the exit
+    drain(r.stdoutFd, r.result.stdout);
+    drain(r.stderrFd, r.result.stderr);
+    for (int* fd : {&r.stdoutFd, &r.stderrFd}) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+
+    // A duplicate reports the time since the input first started
+    r.result.executionTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        Clock::now() - r.firstStart).count();
+
+    if (slots_[slot].peakFd >= 0) {
+        char buffer[32] = {};
+        if (pread(slots_[slot].peakFd, buffer, sizeof(buffer) - 1, 0) > 0) {
+            r.result.memoryPeakBytes = std::atoll(buffer);
+        }
+    }
+
+    // Of two runs of an input, the first to succeed reports it; one that
+    // failed or timed out leaves the input to a twin still running or one
+    // that succeeded in the same round
+    bool report = !r.lost;
+    if (r.twin >= 0) {
+        Run& twin = runs_[r.twin];
+        bool failed = r.result.timedOut || r.result.exitCode != 0;
+        bool twinSucceeded = twin.exited && !twin.result.timedOut && twin.result.exitCode == 0;
+        if (report && failed && (!twin.exited || twinSucceeded)) {
+            report = false;
+        } else if (report) {
+            twin.lost = true;
+            if (!twin.exited) {
+                killSlot(static_cast<size_t>(r.twin));
+            }
+        }
+        twin.twin = -1;
+        r.twin = -1;
+    }
+    if (!report) {
+        r.active = false;
+        return;
+    }
+
+    allSucceeded_ = allSucceeded_ && r.result.exitCode == 0;
+
+    std::string line = toJsonLine(r.result);
+    size_t written = 0;
+    while (written < line.size()) {
+        ssize_t n = write(resultFd, line.data() + written, line.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            SANDBOX_ERROR("Failed to report result for " + r.result.input);
+            break;
+        }
+        written += n;
+    }
+
+    r.active = false;
+}
+
+} // namespace sandbox
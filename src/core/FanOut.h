@@ -0,0 +1,236 @@
+/**
+ * @file FanOut.h
+ * @brief Fan-out execution of one command over many inputs.
+ *
+ * This header defines the FanOutRunner class that runs the sandbox
+ * command once per input inside an already prepared sandbox. Judges and
+ * test runners use it to avoid a complete sandbox setup and teardown
+ * for every input.
+ */
+
+#ifndef SANDBOX_FAN_OUT_H
+#define SANDBOX_FAN_OUT_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <sys/types.h>
+#include "ConfigParser.h"
+#include "RuntimeHistory.h"
+
+namespace sandbox {
+
+/**
+ * @struct InputResult
+ * @brief Result of running the command over one input.
+ */
+struct InputResult {
+    std::string input;             ///< Input path
+    int exitCode;                  ///< Exit code, negative signal number if killed
+    bool timedOut;                 ///< Whether the run hit its timeout
+    long executionTimeMs;          ///< Wall-clock time since the input first started
+    long long memoryPeakBytes;     ///< Peak memory of the run's sub-cgroup, -1 if unknown
+    std::string stdout;            ///< Captured stdout
+    std::string stderr;            ///< Captured stderr
+    bool speculated;               ///< A duplicate run was started for the input
+};
+
+/**
+ * @struct FanOutSlot
+ * @brief Sub-cgroup in which one run at a time executes.
+ */
+struct FanOutSlot {
+    int procsFd;                   ///< cgroup.procs of the slot, -1 if none
+    int peakFd;                    ///< Read-write memory.peak of the slot, -1 if none
+    int killFd;                    ///< cgroup.kill of the slot, -1 if none
+};
+
+/**
+ * @class FanOutRunner
+ * @brief Runs a command over many inputs with bounded parallelism.
+ *
+ * Every slot runs one input at a time in its own sub-cgroup, so the
+ * number of slots bounds the concurrency. Results are streamed to the
+ * supervisor as one JSON line per input.
+ *
+ * With speculation, the last `speculate_slots` slots are reserved for
+ * duplicates. A run that is still going after the threshold taken from
+ * the run time history is started a second time in a free reserved slot,
+ * on CPUs the other runs are not using. The first of the two to finish
+ * reports the input and the other is killed through its slot cgroup.
+ *
+ * Inputs start in submission order unless `order` asks for an order
+ * taken from the estimates of earlier runs: shortest first ("sjf")
+ * lowers the mean completion time, longest first ("lpt") the time to
+ * finish the batch. "memory" starts the largest input whose expected
+ * peak still fits next to the running ones in the sandbox memory.
+ */
+class FanOutRunner {
+public:
+    /**
+     * @brief Construct a FanOutRunner.
+     * @param command The command; "{}" arguments are replaced by the input.
+     * @param config Fan-out settings.
+     */
+    FanOutRunner(const std::vector<std::string>& command, const FanOutConfig& config);
+
+    /**
+     * @brief Set the sub-cgroups runs execute in.
+     * @param slots One entry per concurrent run.
+     */
+    void setSlots(const std::vector<FanOutSlot>& slots);
+
+    /**
+     * @brief Duplicate runs that take longer than a threshold.
+     *
+     * Has no effect unless the configuration allows speculation.
+     *
+     * @param thresholdMs Run time after which a run is duplicated, -1 for never.
+     */
+    void setSpeculationThreshold(long thresholdMs);
+
+    /**
+     * @brief Set what earlier runs of the inputs cost.
+     * @param estimates Estimates by input; inputs without one are assumed
+     *                  to cost the median of the others.
+     * @param memoryBudgetBytes Memory the runs share, 0 for no limit.
+     */
+    void setEstimates(const std::map<std::string, RunEstimate>& estimates, long long memoryBudgetBytes);
+
+    /**
+     * @brief Run the command over all inputs.
+     * @param resultFd Descriptor the JSON result lines are written to.
+     * @return 0 if every run exited successfully, 1 otherwise.
+     */
+    int run(int resultFd);
+
+    /**
+     * @brief Number of concurrent runs for a configuration.
+     *
+     * Defaults to one run per full CPU of the sandbox quota, so that the
+     * runs do not throttle each other. Slots reserved for duplicates come
+     * on top.
+     *
+     * @param config The sandbox configuration.
+     * @return The number of slots, at least 1.
+     */
+    static int slotCount(const SandboxConfiguration& config);
+
+    /**
+     * @brief Order inputs for dispatch.
+     * @param inputs The inputs in submission order.
+     * @param estimates Estimates by input, see setEstimates().
+     * @param order The ordering policy.
+     * @return The inputs in the order they are offered to free slots.
+     */
+    static std::vector<std::string> orderInputs(const std::vector<std::string>& inputs,
+                                                const std::map<std::string, RunEstimate>& estimates,
+                                                const std::string& order);
+
+    /**
+     * @brief Build the command line for an input.
+     * @param command The command template.
+     * @param input The input path.
+     * @return The command with "{}" arguments replaced.
+     */
+    static std::vector<std::string> substitute(const std::vector<std::string>& command,
+                                               const std::string& input);
+
+    /**
+     * @brief Serialize a result as a JSON line.
+     * @param result The result.
+     * @return The line, including the trailing newline.
+     */
+    static std::string toJsonLine(const InputResult& result);
+
+    /**
+     * @brief Parse JSON result lines.
+     * @param lines The lines written by run().
+     * @return The parsed results; unreadable lines are skipped.
+     */
+    static std::vector<InputResult> parseResults(const std::string& lines);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @struct Run
+     * @brief State of the run occupying a slot.
+     */
+    struct Run {
+        bool active;
+        pid_t pid;
+        int stdoutFd;
+        int stderrFd;
+        bool exited;
+        Clock::time_point start;
+        Clock::time_point firstStart;  ///< Start of the input's first run
+        InputResult result;
+        int twin;                  ///< Slot running the same input, -1 if none
+        bool lost;                 ///< Killed because its twin finished first
+    };
+
+    /**
+     * @brief Start the next input in a slot.
+     * @param slot Index of the slot.
+     * @param input The input path.
+     * @param cpus CPUs to run on, empty to keep the runner's.
+     * @return true if the run was started.
+     */
+    bool start(size_t slot, const std::string& input, const std::vector<int>& cpus = {});
+
+    /**
+     * @brief Choose the pending input to start next.
+     * @param pending Inputs not started yet, in dispatch order.
+     * @return The input, or end if none fits the memory left.
+     */
+    std::list<std::string>::iterator pickNext(std::list<std::string>& pending);
+
+    /**
+     * @brief Start duplicates of runs past the speculation threshold.
+     * @param now The current time.
+     */
+    void speculate(Clock::time_point now);
+
+    /**
+     * @brief Pick CPUs for a duplicate away from the active runs.
+     * @return The CPUs, empty if every CPU is in use.
+     */
+    std::vector<int> idleCpus() const;
+
+    /**
+     * @brief Kill the run in a slot with everything it started.
+     * @param slot Index of the slot.
+     */
+    void killSlot(size_t slot);
+
+    /**
+     * @brief Read available output of a run.
+     * @param fd The pipe to read, set to -1 on end of file.
+     * @param sink Where the output is appended.
+     */
+    void drain(int& fd, std::string& sink);
+
+    /**
+     * @brief Complete a run and report its result.
+     * @param slot Index of the slot.
+     * @param resultFd Descriptor the result line is written to.
+     */
+    void finish(size_t slot, int resultFd);
+
+    std::vector<std::string> command_;
+    FanOutConfig config_;
+    std::vector<FanOutSlot> slots_;
+    std::vector<Run> runs_;
+    size_t inputSlots_;            ///< Slots for first runs; the rest take duplicates
+    long speculateAfterMs_;
+    std::map<std::string, RunEstimate> estimates_;
+    long long memoryBudgetBytes_;
+    bool allSucceeded_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_FAN_OUT_H
@@ -0,0 +1,87 @@
+/**
+ * @file Housekeeping.cpp
+ * @brief Implementation of the Housekeeping class.
+ */
+
+#include "core/Housekeeping.h"
+#include "core/Logger.h"
+#include "utils/Syscalls.h"
+#include <algorithm>
+
+namespace sandbox {
+
+std::vector<int> Housekeeping::workloadCpus(const std::vector<int>& allowed,
+                                            const std::vector<int>& housekeeping) {
+    std::vector<int> cpus;
+    for (int cpu : allowed) {
+        if (std::find(housekeeping.begin(), housekeeping.end(), cpu) == housekeeping.end()) {
+            cpus.push_back(cpu);
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::string Housekeeping::sandboxCpus(const SandboxConfiguration& config) {
+    if (config.supervisor.workload_cpus.empty() || config.resources.cpuset_cpus.empty()) {
+        return config.supervisor.workload_cpus.empty() ? config.resources.cpuset_cpus
+                                                       : config.supervisor.workload_cpus;
+    }
+    std::vector<int> workload = Syscall::parseCpuList(config.supervisor.workload_cpus).value_or(std::vector<int>());
+    std::vector<int> cpus;
+    for (int cpu : Syscall::parseCpuList(config.resources.cpuset_cpus).value_or(std::vector<int>())) {
+        if (std::find(workload.begin(), workload.end(), cpu) != workload.end()) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus.empty() ? "" : Syscall::formatCpuList(cpus);
+}
+
+bool Housekeeping::apply(SandboxConfiguration& config) {
+    if (config.supervisor.housekeeping_cpus.empty()) {
+        return true;
+    }
+
+    // Only CPUs the supervisor may run on can be reserved
+    std::vector<int> affinity = Syscall::getAffinityCpus();
+    std::vector<int> housekeeping;
+    std::vector<int> unavailable;
+    for (int cpu : Syscall::parseCpuList(config.supervisor.housekeeping_cpus).value_or(std::vector<int>())) {
+        if (std::find(affinity.begin(), affinity.end(), cpu) != affinity.end()) {
+            housekeeping.push_back(cpu);
+        } else {
+            unavailable.push_back(cpu);
+        }
+    }
+    if (!unavailable.empty()) {
+        SANDBOX_WARNING("Housekeeping CPUs " + Syscall::formatCpuList(unavailable) +
+                        " are outside the supervisor's affinity and are not used");
+    }
+    if (housekeeping.empty()) {
+        SANDBOX_ERROR("No housekeeping CPU of " + config.supervisor.housekeeping_cpus + " is available");
+        return false;
+    }
+
+    std::vector<int> allowed = affinity;
+    if (!config.resources.cpuset_cpus.empty()) {
+        allowed = Syscall::parseCpuList(config.resources.cpuset_cpus).value_or(affinity);
+    }
+    std::vector<int> workload = workloadCpus(allowed, housekeeping);
+    if (workload.empty()) {
+        SANDBOX_ERROR("Housekeeping CPUs " + Syscall::formatCpuList(housekeeping) +
+                      " leave no CPU for sandboxes");
+        return false;
+    }
+
+    if (!Syscall::setAffinityCpus(housekeeping)) {
+        return false;
+    }
+
+    config.supervisor.workload_cpus = Syscall::formatCpuList(workload);
+    SANDBOX_INFO("Supervisor on CPUs " + Syscall::formatCpuList(housekeeping) + ", sandboxes on " +
+                 config.supervisor.workload_cpus);
+    return true;
+}
+
+} // namespace sandbox
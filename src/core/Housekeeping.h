@@ -0,0 +1,69 @@
+/**
+ * @file Housekeeping.h
+ * @brief Separation of supervisor CPUs from workload CPUs.
+ *
+ * This header defines the Housekeeping class that confines the
+ * supervisor to a set of housekeeping CPUs and keeps the sandboxes it
+ * starts off them.
+ */
+
+#ifndef SANDBOX_HOUSEKEEPING_H
+#define SANDBOX_HOUSEKEEPING_H
+
+#include "core/ConfigParser.h"
+#include <string>
+#include <vector>
+
+namespace sandbox {
+
+/**
+ * @class Housekeeping
+ * @brief Pins the supervisor to housekeeping CPUs.
+ *
+ * Output relays, usage samplers, the FUSE server of lazy images, AI
+ * requests and image collection all run in the supervisor. On a host
+ * whose CPUs are saturated by sandboxes they wait behind the workloads,
+ * which shows up as spawn latency, and their bursts in turn preempt the
+ * workloads. With `supervisor.housekeeping_cpus` set, the supervisor
+ * moves itself to those CPUs before it starts any thread, so every
+ * thread and helper process inherits the affinity. The sandboxes get
+ * the remaining CPUs: the configured cpuset_cpus less the housekeeping
+ * CPUs, or everything else the supervisor was allowed to run on. They
+ * are pinned there by affinity, so this works without the cpuset
+ * controller; cpuset.cpus is only narrowed when cpuset_cpus is set.
+ */
+class Housekeeping {
+public:
+    /**
+     * @brief Compute the CPUs left to sandboxes.
+     * @param allowed CPUs the sandboxes could use otherwise.
+     * @param housekeeping CPUs reserved for the supervisor.
+     * @return allowed without housekeeping, in ascending order.
+     */
+    static std::vector<int> workloadCpus(const std::vector<int>& allowed,
+                                         const std::vector<int>& housekeeping);
+
+    /**
+     * @brief Compute the CPUs a sandbox may run on.
+     * @param config The configuration after apply().
+     * @return cpuset_cpus less the housekeeping CPUs, empty if none is
+     *         left; whichever of the two is set otherwise.
+     */
+    static std::string sandboxCpus(const SandboxConfiguration& config);
+
+    /**
+     * @brief Pin the calling process and move sandboxes off its CPUs.
+     *
+     * Must run before the supervisor starts threads, which keep the
+     * affinity they were created with. Sets supervisor.workload_cpus
+     * to the CPUs left to sandboxes.
+     *
+     * @param config The configuration; unchanged without housekeeping CPUs.
+     * @return true if successful or no housekeeping CPUs are configured.
+     */
+    static bool apply(SandboxConfiguration& config);
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_HOUSEKEEPING_H
@@ -0,0 +1,328 @@
+/**
+ * @file ImageStore.cpp
+ * @brief Implementation of the ImageStore class.
+ */
+
+#include "core/ImageStore.h"
+#include "core/Logger.h"
+#include "utils/Syscalls.h"
+#include <algorithm>
+#include <ctime>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+namespace sandbox {
+
+namespace {
+
+const char* const kEvictingPrefix = ".evicting-";
+
+std::string normalize(const std::string& path) {
+    std::string normal = std::filesystem::path(path).lexically_normal().string();
+    while (normal.size() > 1 && normal.back() == '/') {
+        normal.pop_back();
+    }
+    return normal;
+}
+
+// Remove a tree depth-first, giving up as soon as stop is set
+bool removeTree(const std::string& path, const std::atomic<bool>& stop) {
+    struct stat st;
+    if (lstat(path.c_str(), &st) < 0) {
+        return errno == ENOENT;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(path, ec)) {
+            if (stop || !removeTree(entry.path().string(), stop)) {
+                return false;
+            }
+        }
+        if (rmdir(path.c_str()) < 0) {
+            SANDBOX_WARNING("Failed to remove " + path + ": " + std::string(strerror(errno)));
+            return false;
+        }
+        return true;
+    }
+
+    return unlink(path.c_str()) == 0 || errno == ENOENT;
+}
+
+} // namespace
+
+ImageStore::ImageStore(const ImagesConfig& config)
+    : config_(config)
+{
+}
+
+bool ImageStore::locate(const std::string& path, std::string& storeDir, std::string& name) const {
+    std::string normal = normalize(path);
+    for (const auto& dir : config_.store_dirs) {
+        std::string store = normalize(dir);
+        if (normal.compare(0, store.size() + 1, store + "/") != 0) {
+            continue;
+        }
+        std::string rest = normal.substr(store.size() + 1);
+        name = rest.substr(0, rest.find('/'));
+        if (name.empty() || name[0] == '.') {
+            return false;
+        }
+        storeDir = store;
+        return true;
+    }
+    return false;
+}
+
+bool ImageStore::markUsed(const std::string& path) const {
+    std::string storeDir;
+    std::string name;
+    if (!locate(path, storeDir, name)) {
+        return false;
+    }
+
+    std::string lruDir = storeDir + "/.lru";
+    if (!Syscall::isDirectory(lruDir) && mkdir(lruDir.c_str(), 0755) < 0 && errno != EEXIST) {
+        SANDBOX_WARNING("Failed to create " + lruDir + ": " + std::string(strerror(errno)));
+        return false;
+    }
+
+    std::string stamp = lruDir + "/" + name;
+    int fd = open(stamp.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        SANDBOX_WARNING("Failed to stamp image " + name + ": " + std::string(strerror(errno)));
+        return false;
+    }
+    bool stamped = futimens(fd, nullptr) == 0;
+    close(fd);
+    return stamped;
+}
+
+long long ImageStore::diskUsage(const std::string& path) {
+    struct stat root;
+    if (lstat(path.c_str(), &root) < 0) {
+        return 0;
+    }
+
+    long long total = static_cast<long long>(root.st_blocks) * 512;
+    if (!S_ISDIR(root.st_mode)) {
+        return total;
+    }
+
+    std::set<std::pair<dev_t, ino_t>> seen;
+    std::error_code ec;
+    std::filesystem::recursive_directory_iterator it(
+        path, std::filesystem::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        struct stat st;
+        if (lstat(it->path().c_str(), &st) < 0) {
+            continue;
+        }
+        // Stay on the image's filesystem
+        if (st.st_dev != root.st_dev) {
+            it.disable_recursion_pending();
+            continue;
+        }
+        if (st.st_nlink > 1 && !S_ISDIR(st.st_mode) && !seen.insert({st.st_dev, st.st_ino}).second) {
+            continue;
+        }
+        total += static_cast<long long>(st.st_blocks) * 512;
+    }
+
+    return total;
+}
+
+std::vector<ImageInfo> ImageStore::scan(const std::set<std::string>& referenced) const {
+    std::vector<ImageInfo> images;
+
+    for (const auto& dir : config_.store_dirs) {
+        std::string store = normalize(dir);
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(store, ec)) {
+            std::string name = entry.path().filename().string();
+            if (name.empty() || name[0] == '.') {
+                continue;
+            }
+
+            ImageInfo image;
+            image.path = store + "/" + name;
+            image.sizeBytes = diskUsage(image.path);
+            image.referenced = false;
+
+            struct stat st;
+            std::string stamp = store + "/.lru/" + name;
+            if (stat(stamp.c_str(), &st) == 0 || lstat(image.path.c_str(), &st) == 0) {
+                image.lastUsed = st.st_mtime;
+            } else {
+                image.lastUsed = 0;
+            }
+
+            for (const auto& rootfs : referenced) {
+                std::string normal = normalize(rootfs);
+                if (normal == image.path || normal.compare(0, image.path.size() + 1, image.path + "/") == 0) {
+                    image.referenced = true;
+                    break;
+                }
+            }
+
+            images.push_back(image);
+        }
+    }
+
+    return images;
+}
+
+std::vector<std::string> ImageStore::pickEvictions(std::vector<ImageInfo> images,
+                                                   long long budgetBytes, long long idleBefore) {
+    long long total = 0;
+    for (const auto& image : images) {
+        total += image.sizeBytes;
+    }
+
+    std::vector<std::string> evictions;
+    if (total <= budgetBytes) {
+        return evictions;
+    }
+
+    std::stable_sort(images.begin(), images.end(), [](const ImageInfo& a, const ImageInfo& b) {
+        return a.lastUsed < b.lastUsed;
+    });
+
+    for (const auto& image : images) {
+        if (total <= budgetBytes) {
+            break;
+        }
+        if (image.referenced || image.lastUsed >= idleBefore) {
+            continue;
+        }
+        evictions.push_back(image.path);
+        total -= image.sizeBytes;
+    }
+
+    return evictions;
+}
+
+GcReport ImageStore::collect(const std::set<std::string>& referenced, const std::atomic<bool>& stop) {
+    GcReport report{0, 0, {}};
+
+    // Finish evictions an interrupted collection left behind
+    for (const auto& dir : config_.store_dirs) {
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+            if (entry.path().filename().string().rfind(kEvictingPrefix, 0) == 0 && !stop) {
+                removeTree(entry.path().string(), stop);
+            }
+        }
+    }
+
+    std::vector<ImageInfo> images = scan(referenced);
+    std::map<std::string, long long> sizes;
+    for (const auto& image : images) {
+        report.usedBytes += image.sizeBytes;
+        sizes[image.path] = image.sizeBytes;
+    }
+
+    if (config_.disk_budget_mb <= 0) {
+        return report;
+    }
+
+    long long budget = config_.disk_budget_mb * 1024 * 1024;
+    long long idleBefore = static_cast<long long>(time(nullptr)) - config_.min_idle_s;
+
+    for (const auto& path : pickEvictions(images, budget, idleBefore)) {
+        if (stop) {
+            break;
+        }
+
+        std::string storeDir;
+        std::string name;
+        if (!locate(path, storeDir, name)) {
+            continue;
+        }
+
+        // A sandbox may have started from the image since the scan
+        struct stat st;
+        std::string stamp = storeDir + "/.lru/" + name;
+        if (stat(stamp.c_str(), &st) == 0 && st.st_mtime >= idleBefore) {
+            continue;
+        }
+
+        std::string doomed = storeDir + "/" + kEvictingPrefix + name;
+        if (::rename(path.c_str(), doomed.c_str()) < 0) {
+            SANDBOX_WARNING("Failed to evict image " + path + ": " + std::string(strerror(errno)));
+            continue;
+        }
+        unlink(stamp.c_str());
+
+        report.freedBytes += sizes[path];
+        report.evicted.push_back(path);
+        SANDBOX_INFO("Evicting image " + path + " (" + std::to_string(sizes[path] / (1024 * 1024)) + " MiB)");
+
+        removeTree(doomed, stop);
+    }
+
+    return report;
+}
+
+void ImageStore::collectInBackground(const StateStore& store, const std::atomic<bool>& stop) {
+    if (config_.disk_budget_mb <= 0 || config_.store_dirs.empty() ||
+        !Syscall::isDirectory(config_.store_dirs.front())) {
+        return;
+    }
+
+    Syscall::setIdleIoPriority();
+
+    std::string lruDir = normalize(config_.store_dirs.front()) + "/.lru";
+    if (!Syscall::isDirectory(lruDir) && mkdir(lruDir.c_str(), 0755) < 0 && errno != EEXIST) {
+        return;
+    }
+
+    // Only one collection at a time, across all supervisors
+    std::string gcPath = lruDir + "/.gc";
+    int fd = open(gcPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        close(fd);
+        return;
+    }
+
+    // The file is empty until the first collection completes
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && time(nullptr) - st.st_mtime < config_.gc_interval_s) {
+        close(fd);
+        return;
+    }
+
+    GcReport report = collect(referencedImages(store), stop);
+    if (!stop) {
+        std::string now = std::to_string(time(nullptr)) + "\n";
+        if (ftruncate(fd, 0) < 0 || pwrite(fd, now.data(), now.size(), 0) < 0) {
+            SANDBOX_WARNING("Failed to record image collection time");
+        }
+    }
+    close(fd);
+
+    if (!report.evicted.empty()) {
+        SANDBOX_INFO("Image collection evicted " + std::to_string(report.evicted.size()) +
+                     " images, freed " + std::to_string(report.freedBytes / (1024 * 1024)) + " MiB");
+    }
+}
+
+std::set<std::string> ImageStore::referencedImages(const StateStore& store) {
+    std::set<std::string> referenced;
+    for (const auto& record : store.list()) {
+        if (!record.rootfsPath.empty() && StateStore::isAlive(record.pid, record.startTime)) {
+            referenced.insert(normalize(record.rootfsPath));
+        }
+    }
+    return referenced;
+}
+
+} // namespace sandbox
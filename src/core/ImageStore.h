@@ -0,0 +1,143 @@
+/**
+ * @file ImageStore.h
+ * @brief Garbage collection of cached rootfs images.
+ *
+ * This header defines the ImageStore class that tracks when cached
+ * rootfs images were last used and evicts the least recently used ones
+ * to keep the image stores under a disk budget.
+ */
+
+#ifndef SANDBOX_IMAGE_STORE_H
+#define SANDBOX_IMAGE_STORE_H
+
+#include "core/ConfigParser.h"
+#include "core/StateStore.h"
+#include <atomic>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace sandbox {
+
+/**
+ * @struct ImageInfo
+ * @brief One cached image.
+ */
+struct ImageInfo {
+    std::string path;          ///< Image directory or file
+    long long sizeBytes;       ///< Disk usage, hard links counted once
+    long long lastUsed;        ///< Last use (seconds since epoch)
+    bool referenced;           ///< In use by a running sandbox
+};
+
+/**
+ * @struct GcReport
+ * @brief Result of one collection.
+ */
+struct GcReport {
+    long long usedBytes;               ///< Store size before the collection
+    long long freedBytes;              ///< Size of the evicted images
+    std::vector<std::string> evicted;  ///< Evicted image paths
+};
+
+/**
+ * @class ImageStore
+ * @brief Evicts least recently used images beyond a disk budget.
+ *
+ * Every entry of a store directory is an image. Its last use is the
+ * modification time of a stamp, `<store>/.lru/<name>`, refreshed each
+ * time a sandbox starts from it; images without a stamp fall back to
+ * their own modification time. Images that are the rootfs of a running
+ * sandbox, according to the sandbox records, are never evicted, nor are
+ * images used within the last min_idle_s.
+ *
+ * An evicted image is first renamed to `<store>/.evicting-<name>`, so a
+ * sandbox never starts from a half-deleted image; leftovers of an
+ * interrupted collection are removed by the next one.
+ */
+class ImageStore {
+public:
+    /**
+     * @brief Construct an ImageStore.
+     * @param config The image store settings.
+     */
+    explicit ImageStore(const ImagesConfig& config);
+
+    /**
+     * @brief Record the use of an image.
+     * @param path The image, or any path inside it.
+     * @return true if the path belongs to a store and was stamped.
+     */
+    bool markUsed(const std::string& path) const;
+
+    /**
+     * @brief List the images of all stores.
+     * @param referenced Root filesystems of running sandboxes.
+     * @return The images.
+     */
+    std::vector<ImageInfo> scan(const std::set<std::string>& referenced) const;
+
+    /**
+     * @brief Evict images until the stores fit the disk budget.
+     * @param referenced Root filesystems of running sandboxes.
+     * @param stop Abandons the collection when set.
+     * @return The collection report.
+     */
+    GcReport collect(const std::set<std::string>& referenced, const std::atomic<bool>& stop);
+
+    /**
+     * @brief Run a collection at idle I/O priority, if one is due.
+     *
+     * Meant for a background thread of the supervisor. Collections are
+     * at least gc_interval_s apart across all supervisors, and only one
+     * runs at a time.
+     *
+     * @param store The sandbox records, to find images in use.
+     * @param stop Abandons the collection when set.
+     */
+    void collectInBackground(const StateStore& store, const std::atomic<bool>& stop);
+
+    /**
+     * @brief Get the root filesystems of running sandboxes.
+     * @param store The sandbox records.
+     * @return The rootfs paths.
+     */
+    static std::set<std::string> referencedImages(const StateStore& store);
+
+    /**
+     * @brief Choose the images to evict.
+     *
+     * Unreferenced images last used before @p idleBefore are taken
+     * oldest first until the total size is within the budget.
+     *
+     * @param images The images.
+     * @param budgetBytes The disk budget.
+     * @param idleBefore Only images last used before this time qualify.
+     * @return Paths of the images to evict, in eviction order.
+     */
+    static std::vector<std::string> pickEvictions(std::vector<ImageInfo> images,
+                                                  long long budgetBytes, long long idleBefore);
+
+    /**
+     * @brief Measure the disk usage of a directory tree.
+     * @param path The tree.
+     * @return Allocated bytes, hard links counted once.
+     */
+    static long long diskUsage(const std::string& path);
+
+private:
+    /**
+     * @brief Find the store directory and image name of a path.
+     * @param path The path.
+     * @param storeDir Output store directory.
+     * @param name Output image name.
+     * @return true if the path is inside a store.
+     */
+    bool locate(const std::string& path, std::string& storeDir, std::string& name) const;
+
+    ImagesConfig config_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_IMAGE_STORE_H
@@ -0,0 +1,251 @@
+/**
+ * @file ProcessGroup.cpp
+ * @brief Implementation of the ProcessGroup class.
+ */
+
+#include "core/ProcessGroup.h"
+#include "core/Logger.h"
+#include "utils/Syscalls.h"
+#include <thread>
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace sandbox {
+
+ProcessGroup::ProcessGroup(const std::vector<ProcessConfig>& processes, const RestartConfig& restart)
+    : peakResetFd_(-1)
+    , primaryExitCode_(1)
+{
+    for (const auto& process : processes) {
+        Member member;
+        member.config = process;
+        member.cgroupFd = -1;
+        member.pid = -1;
+        member.tracker = std::make_unique<RestartTracker>(process.restart_policy, restart);
+        member.restartPending = false;
+        members_.push_back(std::move(member));
+    }
+}
+
+void ProcessGroup::setCgroupFd(const std::string& processName, int fd) {
+    for (auto& member : members_) {
+        if (member.config.name == processName) {
+            member.cgroupFd = fd;
+        }
+    }
+}
+
+void ProcessGroup::setPeakResetFd(int fd) {
+    peakResetFd_ = fd;
+}
+
+int ProcessGroup::exitCodeFromStatus(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    if (WIFSIGNALED(status)) {
+        return -WTERMSIG(status);
+    }
+    return -1;
+}
+
+int ProcessGroup::run() {
+    if (members_.empty()) {
+        SANDBOX_ERROR("Process group is empty");
+        return 1;
+    }
+
+    // Receive child exits and termination requests synchronously
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGINT);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+
+    for (auto& member : members_) {
+        if (!spawn(member)) {
+            terminateAll(2000);
+            return 1;
+        }
+    }
+
+    while (true) {
+        // Reap every exited member
+        int status = 0;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            for (size_t i = 0; i < members_.size(); ++i) {
+                if (members_[i].pid == pid && handleExit(i, status)) {
+                    terminateAll(2000);
+                    return primaryExitCode_;
+                }
+            }
+        }
+
+        // Start members whose backoff has elapsed
+        auto now = Clock::now();
+        auto nextWake = now + std::chrono::seconds(1);
+        for (auto& member : members_) {
+            if (!member.restartPending) {
+                continue;
+            }
+            if (member.restartAt <= now) {
+                member.restartPending = false;
+                resetCounters();
+                if (!spawn(member)) {
+                    terminateAll(2000);
+                    return 1;
+                }
+            } else {
+                nextWake = std::min(nextWake, member.restartAt);
+            }
+        }
+
+        auto waitNs = std::chrono::duration_cast<std::chrono::nanoseconds>(nextWake - now).count();
+        struct timespec timeout;
+        timeout.tv_sec = waitNs / 1000000000;
+        timeout.tv_nsec = waitNs % 1000000000;
+
+        int sig = sigtimedwait(&signals, nullptr, &timeout);
+        if (sig == SIGTERM || sig == SIGINT) {
+            SANDBOX_INFO("Termination requested, stopping process group");
+            terminateAll(2000);
+            return primaryExitCode_;
+        }
+    }
+}
+
+bool ProcessGroup::handleExit(size_t index, int status) {
+    Member& member = members_[index];
+    member.pid = -1;
+
+    int exitCode = exitCodeFromStatus(status);
+    SANDBOX_INFO("Process " + member.config.name + " exited with code " + std::to_string(exitCode));
+
+    RestartDecision decision = member.tracker->onExit(status, Clock::now());
+    if (decision == RestartDecision::RESTART) {
+        long delayMs = member.tracker->getBackoffMs();
+        SANDBOX_INFO("Restarting process " + member.config.name + " in " +
+                     std::to_string(delayMs) + "ms (restart " +
+                     std::to_string(member.tracker->getRestartCount()) + ")");
+        member.restartPending = true;
+        member.restartAt = Clock::now() + std::chrono::milliseconds(delayMs);
+        return false;
+    }
+
+    if (decision == RestartDecision::CRASH_LOOP) {
+        SANDBOX_ERROR("Process " + member.config.name + " is crash-looping after " +
+                      std::to_string(member.tracker->getRestartCount()) + " restarts, giving up");
+    }
+
+    // The group lives as long as its primary
+    if (index == 0) {
+        primaryExitCode_ = exitCode;
+        return true;
+    }
+    return false;
+}
+
+void ProcessGroup::resetCounters() {
+    // Writing to memory.peak resets the watermark seen through this
+    // open file, which the supervisor shares with us across the fork
+    if (peakResetFd_ >= 0 && write(peakResetFd_, "reset\n", 6) < 0) {
+        SANDBOX_DEBUG("Failed to reset memory.peak: " + std::string(strerror(errno)));
+    }
+}
+
+bool ProcessGroup::spawn(Member& member) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        SANDBOX_ERROR("Failed to fork process " + member.config.name + ": " +
+                      std::string(strerror(errno)));
+        return false;
+    }
+
+    if (pid == 0) {
+        execMember(member);
+    }
+
+    member.pid = pid;
+    member.tracker->onStart(Clock::now());
+    SANDBOX_DEBUG("Started process " + member.config.name + " with PID " + std::to_string(pid));
+    return true;
+}
+
+void ProcessGroup::execMember(const Member& member) {
+    // The signal mask survives exec; give the command a clean one
+    sigset_t empty;
+    sigemptyset(&empty);
+    sigprocmask(SIG_SETMASK, &empty, nullptr);
+
+    // Join the per-process sub-cgroup
+    if (member.cgroupFd >= 0) {
+        if (write(member.cgroupFd, "0", 1) < 0) {
+            SANDBOX_ERROR("Failed to join cgroup for " + member.config.name);
+            _exit(127);
+        }
+    }
+
+    // Redirect stdio
+    auto redirect = [](const std::string& path, int targetFd) {
+        if (path.empty()) {
+            return true;
+        }
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0 || dup2(fd, targetFd) < 0) {
+            return false;
+        }
+        close(fd);
+        return true;
+    };
+
+    if (!redirect(member.config.stdout_path, STDOUT_FILENO) ||
+        !redirect(member.config.stderr_path, STDERR_FILENO)) {
+        SANDBOX_ERROR("Failed to redirect output for " + member.config.name);
+        _exit(127);
+    }
+
+    Syscall::execCommand(member.config.command);
+    _exit(127);
+}
+
+void ProcessGroup::terminateAll(int timeoutMs) {
+    for (auto& member : members_) {
+        member.restartPending = false;
+        if (member.pid > 0) {
+            kill(member.pid, SIGTERM);
+        }
+    }
+
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (Clock::now() < deadline) {
+        bool anyRunning = false;
+        for (auto& member : members_) {
+            if (member.pid > 0 && waitpid(member.pid, nullptr, WNOHANG) == member.pid) {
+                member.pid = -1;
+            }
+            anyRunning = anyRunning || member.pid > 0;
+        }
+        if (!anyRunning) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    for (auto& member : members_) {
+        if (member.pid > 0) {
+            SANDBOX_WARNING("Process " + member.config.name + " did not stop, sending SIGKILL");
+            kill(member.pid, SIGKILL);
+            waitpid(member.pid, nullptr, 0);
+            member.pid = -1;
+        }
+    }
+}
+
+} // namespace sandbox
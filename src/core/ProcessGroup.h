@@ -0,0 +1,125 @@
+/**
+ * @file ProcessGroup.h
+ * @brief Supervisor for multi-process sandboxes.
+ *
+ * This header defines the ProcessGroup class that starts and supervises
+ * the cooperating processes of a sandbox. It runs inside the sandbox
+ * after all modules have been applied, so every process shares the
+ * same namespaces, root filesystem and parent cgroup.
+ */
+
+#ifndef SANDBOX_PROCESS_GROUP_H
+#define SANDBOX_PROCESS_GROUP_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <sys/types.h>
+#include "ConfigParser.h"
+#include "RestartPolicy.h"
+
+namespace sandbox {
+
+/**
+ * @class ProcessGroup
+ * @brief Starts and supervises the processes of a sandbox group.
+ *
+ * The first process of the group is the primary. The group runs until
+ * the primary exits and its restart policy does not restart it; the
+ * remaining processes are then terminated. Restarts are warm: the
+ * command is executed again inside the existing namespaces, mounts and
+ * cgroup, after an exponential backoff.
+ */
+class ProcessGroup {
+public:
+    /**
+     * @brief Construct a ProcessGroup.
+     * @param processes The processes of the group, primary first.
+     * @param restart Backoff and crash-loop settings.
+     */
+    ProcessGroup(const std::vector<ProcessConfig>& processes, const RestartConfig& restart);
+
+    /**
+     * @brief Set the cgroup.procs descriptor a process joins on start.
+     * @param processName Name of the process.
+     * @param fd Open descriptor of the sub-cgroup's cgroup.procs file.
+     */
+    void setCgroupFd(const std::string& processName, int fd);
+
+    /**
+     * @brief Set the memory.peak descriptor reset on every warm restart.
+     * @param fd Open read-write descriptor of memory.peak, or -1.
+     */
+    void setPeakResetFd(int fd);
+
+    /**
+     * @brief Start all processes and supervise them.
+     * @return Exit code of the primary process.
+     */
+    int run();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @struct Member
+     * @brief Runtime state of one process of the group.
+     */
+    struct Member {
+        ProcessConfig config;
+        int cgroupFd;
+        pid_t pid;
+        std::unique_ptr<RestartTracker> tracker;
+        bool restartPending;
+        Clock::time_point restartAt;
+    };
+
+    /**
+     * @brief Fork and exec a member of the group.
+     * @param member The member to start.
+     * @return true if the process was started.
+     */
+    bool spawn(Member& member);
+
+    /**
+     * @brief Set up the child side of a member and exec its command.
+     * @param member The member being started.
+     */
+    [[noreturn]] void execMember(const Member& member);
+
+    /**
+     * @brief Handle the exit of a member.
+     * @param index Index of the member in the group.
+     * @param status Wait status of the exited process.
+     * @return true if the group must stop.
+     */
+    bool handleExit(size_t index, int status);
+
+    /**
+     * @brief Reset per-run cgroup counters before a warm restart.
+     */
+    void resetCounters();
+
+    /**
+     * @brief Terminate all running members.
+     * @param timeoutMs Time to wait before sending SIGKILL.
+     */
+    void terminateAll(int timeoutMs);
+
+    /**
+     * @brief Convert a wait status to an exit code.
+     * @param status The wait status.
+     * @return The exit code, negative signal number if killed.
+     */
+    static int exitCodeFromStatus(int status);
+
+    std::vector<Member> members_;
+    int peakResetFd_;
+    int primaryExitCode_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_PROCESS_GROUP_H
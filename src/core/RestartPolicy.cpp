@@ -0,0 +1,73 @@
+/**
+ * @file RestartPolicy.cpp
+ * @brief Implementation of the RestartTracker class.
+ */
+
+#include "core/RestartPolicy.h"
+#include <algorithm>
+#include <sys/wait.h>
+
+namespace sandbox {
+
+RestartTracker::RestartTracker(const std::string& policy, const RestartConfig& config)
+    : policy_(policy)
+    , config_(config)
+    , lastStart_(Clock::now())
+    , backoffMs_(config.backoff_initial_ms)
+    , restartCount_(0)
+{
+}
+
+bool RestartTracker::policyAllows(const std::string& policy, int status) {
+    if (policy == "always") {
+        return true;
+    }
+    if (policy == "on-failure") {
+        return !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    return false;
+}
+
+void RestartTracker::onStart(Clock::time_point now) {
+    lastStart_ = now;
+}
+
+RestartDecision RestartTracker::onExit(int status, Clock::time_point now) {
+    if (!policyAllows(policy_, status)) {
+        return RestartDecision::STOP;
+    }
+
+    auto window = std::chrono::seconds(config_.crash_loop_window_s);
+
+    // A process that stayed up for a whole window starts over
+    if (now - lastStart_ >= window) {
+        backoffMs_ = config_.backoff_initial_ms;
+        recentRestarts_.clear();
+    } else if (!recentRestarts_.empty()) {
+        backoffMs_ = std::min<long>(static_cast<long>(backoffMs_ * config_.backoff_multiplier),
+                                    config_.backoff_max_ms);
+    }
+
+    while (!recentRestarts_.empty() && now - recentRestarts_.front() > window) {
+        recentRestarts_.pop_front();
+    }
+
+    if (config_.crash_loop_max_restarts > 0 &&
+        static_cast<int>(recentRestarts_.size()) >= config_.crash_loop_max_restarts) {
+        return RestartDecision::CRASH_LOOP;
+    }
+
+    recentRestarts_.push_back(now);
+    restartCount_++;
+    return RestartDecision::RESTART;
+}
+
+long RestartTracker::getBackoffMs() const {
+    return backoffMs_;
+}
+
+int RestartTracker::getRestartCount() const {
+    return restartCount_;
+}
+
+} // namespace sandbox
@@ -0,0 +1,95 @@
+/**
+ * @file RestartPolicy.h
+ * @brief Restart decisions for supervised sandbox processes.
+ *
+ * This header defines the RestartTracker class that applies a restart
+ * policy with exponential backoff and crash-loop detection to the
+ * exits of one supervised process.
+ */
+
+#ifndef SANDBOX_RESTART_POLICY_H
+#define SANDBOX_RESTART_POLICY_H
+
+#include <string>
+#include <deque>
+#include <chrono>
+#include "ConfigParser.h"
+
+namespace sandbox {
+
+/**
+ * @enum RestartDecision
+ * @brief Outcome of a process exit under a restart policy.
+ */
+enum class RestartDecision {
+    STOP,        ///< The policy does not restart the process
+    RESTART,     ///< Restart the process after the backoff delay
+    CRASH_LOOP   ///< The process is crash-looping; give up
+};
+
+/**
+ * @class RestartTracker
+ * @brief Tracks the exits of one process and decides on restarts.
+ *
+ * Each restart doubles the backoff delay (by the configured multiplier)
+ * up to a maximum. A process that stays up longer than the crash-loop
+ * window resets the backoff. More restarts than allowed within the
+ * window is reported as a crash loop.
+ */
+class RestartTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Construct a RestartTracker.
+     * @param policy The restart policy ("never", "on-failure", "always").
+     * @param config Backoff and crash-loop settings.
+     */
+    RestartTracker(const std::string& policy, const RestartConfig& config);
+
+    /**
+     * @brief Record a process start.
+     * @param now Time of the start.
+     */
+    void onStart(Clock::time_point now);
+
+    /**
+     * @brief Record a process exit and decide what to do.
+     * @param status Wait status of the exited process.
+     * @param now Time of the exit.
+     * @return The restart decision.
+     */
+    RestartDecision onExit(int status, Clock::time_point now);
+
+    /**
+     * @brief Get the delay before the next restart.
+     * @return Delay in milliseconds.
+     */
+    long getBackoffMs() const;
+
+    /**
+     * @brief Get the number of restarts so far.
+     * @return The restart count.
+     */
+    int getRestartCount() const;
+
+    /**
+     * @brief Check whether a policy restarts a process with an exit status.
+     * @param policy The restart policy.
+     * @param status Wait status of the exited process.
+     * @return true if the policy asks for a restart.
+     */
+    static bool policyAllows(const std::string& policy, int status);
+
+private:
+    std::string policy_;
+    RestartConfig config_;
+    Clock::time_point lastStart_;
+    std::deque<Clock::time_point> recentRestarts_;
+    long backoffMs_;
+    int restartCount_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_RESTART_POLICY_H
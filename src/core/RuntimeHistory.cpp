@@ -0,0 +1,158 @@
+/**
+ * @file RuntimeHistory.cpp
+ * @brief Implementation of the RuntimeHistory class.
+ */
+
+#include "core/RuntimeHistory.h"
+#include "core/Logger.h"
+#include "utils/Hash.h"
+#include "utils/Syscalls.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <sys/file.h>
+
+namespace sandbox {
+
+namespace {
+
+std::vector<RunSample> parseSamples(const std::string& content) {
+    std::vector<RunSample> samples;
+    std::istringstream in(content);
+    std::string line;
+    while (std::getline(in, line)) {
+        // The input comes last and may contain spaces
+        std::istringstream fields(line);
+        RunSample sample{-1, -1, ""};
+        if (!(fields >> sample.timeMs) || sample.timeMs < 0) {
+            continue;
+        }
+        if (fields >> sample.peakBytes) {
+            fields.get();
+            std::getline(fields, sample.input);
+        }
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+} // namespace
+
+RuntimeHistory::RuntimeHistory(const std::string& dir, const std::string& key)
+    : path_(dir + "/" + key)
+{
+}
+
+std::string RuntimeHistory::keyFor(const SandboxConfiguration& config) {
+    Xxh64 hash;
+    auto add = [&hash](const std::string& field) {
+        hash.update(field.data(), field.size());
+        hash.update("", 1);
+    };
+    for (const auto& arg : config.sandbox.command) {
+        add(arg);
+    }
+    add(config.sandbox.rootfs_path);
+    add(config.sandbox.rootfs_manifest);
+    add(std::to_string(config.resources.memory_mb));
+    add(std::to_string(config.resources.cpu_quota_percent));
+    add(std::to_string(config.fanout.memory_mb));
+    add(std::to_string(config.fanout.cpu_quota_percent));
+    add(std::to_string(config.fanout.max_parallel));
+    return Xxh64::toHex(hash.digest());
+}
+
+bool RuntimeHistory::load() {
+    samples_.clear();
+    if (!Syscall::exists(path_)) {
+        return true;
+    }
+    auto content = Syscall::readFile(path_);
+    if (!content) {
+        SANDBOX_WARNING("Failed to read run time history " + path_);
+        return false;
+    }
+    samples_ = parseSamples(*content);
+    return true;
+}
+
+bool RuntimeHistory::record(const std::vector<RunSample>& runs) {
+    if (runs.empty()) {
+        return true;
+    }
+    std::string dir = path_.substr(0, path_.rfind('/'));
+    if (!Syscall::mkdirRecursive(dir)) {
+        SANDBOX_WARNING("Failed to create " + dir);
+        return false;
+    }
+
+    // Other supervisors of the same configuration append concurrently
+    ScopedFd lock(open((path_ + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644));
+    if (!lock.isValid() || flock(lock.get(), LOCK_EX) < 0) {
+        SANDBOX_WARNING("Failed to lock run time history " + path_);
+        return false;
+    }
+
+    std::vector<RunSample> samples = parseSamples(Syscall::readFile(path_).value_or(""));
+    samples.insert(samples.end(), runs.begin(), runs.end());
+    if (samples.size() > kMaxSamples) {
+        samples.erase(samples.begin(), samples.end() - kMaxSamples);
+    }
+
+    std::string content;
+    for (const auto& sample : samples) {
+        content += std::to_string(sample.timeMs) + " " + std::to_string(sample.peakBytes) + " " +
+                   sample.input + "\n";
+    }
+    std::string tmp = path_ + ".tmp";
+    if (!Syscall::writeFile(tmp, content) || rename(tmp.c_str(), path_.c_str()) < 0) {
+        SANDBOX_WARNING("Failed to write run time history " + path_);
+        unlink(tmp.c_str());
+        return false;
+    }
+    samples_ = samples;
+    return true;
+}
+
+long RuntimeHistory::percentile(int percentile) const {
+    if (samples_.size() < kMinSamples) {
+        return -1;
+    }
+    // Nearest rank
+    std::vector<long> sorted;
+    for (const auto& sample : samples_) {
+        sorted.push_back(sample.timeMs);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    size_t rank = (static_cast<size_t>(std::clamp(percentile, 1, 100)) * sorted.size() + 99) / 100;
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+std::optional<RunEstimate> RuntimeHistory::estimate(const std::string& input) const {
+    long long totalTime = 0;
+    long long totalPeak = 0;
+    size_t runs = 0;
+    size_t peaks = 0;
+    for (auto it = samples_.rbegin(); it != samples_.rend() && runs < kEstimateRuns; ++it) {
+        if (it->input != input) {
+            continue;
+        }
+        totalTime += it->timeMs;
+        ++runs;
+        if (it->peakBytes >= 0) {
+            totalPeak += it->peakBytes;
+            ++peaks;
+        }
+    }
+    if (runs == 0) {
+        return std::nullopt;
+    }
+    return RunEstimate{static_cast<long>(totalTime / static_cast<long long>(runs)),
+                       peaks > 0 ? totalPeak / static_cast<long long>(peaks) : -1};
+}
+
+const std::vector<RunSample>& RuntimeHistory::getSamples() const {
+    return samples_;
+}
+
+} // namespace sandbox
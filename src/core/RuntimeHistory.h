@@ -0,0 +1,116 @@
+/**
+ * @file RuntimeHistory.h
+ * @brief Run times of past fan-out runs.
+ *
+ * This header defines the RuntimeHistory class that keeps the run times
+ * and memory peaks of the inputs of earlier fan-out batches with the
+ * same configuration, so that stragglers of a new batch can be
+ * recognized and its inputs ordered.
+ */
+
+#ifndef SANDBOX_RUNTIME_HISTORY_H
+#define SANDBOX_RUNTIME_HISTORY_H
+
+#include "core/ConfigParser.h"
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace sandbox {
+
+/**
+ * @struct RunSample
+ * @brief One recorded run.
+ */
+struct RunSample {
+    long timeMs;                   ///< Wall-clock time of the run
+    long long peakBytes;           ///< Peak memory of the run, -1 if unknown
+    std::string input;             ///< Input path, empty if not recorded
+};
+
+/**
+ * @struct RunEstimate
+ * @brief Expected cost of running an input.
+ */
+struct RunEstimate {
+    long timeMs;                   ///< Expected wall-clock time
+    long long peakBytes;           ///< Expected peak memory, -1 if unknown
+};
+
+/**
+ * @class RuntimeHistory
+ * @brief Bounded record of per-input run times of one configuration.
+ *
+ * The history lives in `<history_dir>/<key>`, one run per line, oldest
+ * first: the run time in milliseconds, the memory peak in bytes and the
+ * input. The key hashes everything that decides how long a run takes:
+ * the command, the root filesystem and the limits of the sandbox and of
+ * each run. Supervisors running the
+ * same configuration at once append under an flock.
+ */
+class RuntimeHistory {
+public:
+    /// Runs kept per configuration
+    static constexpr size_t kMaxSamples = 10000;
+
+    /// Latest runs of an input averaged into its estimate
+    static constexpr size_t kEstimateRuns = 5;
+
+    /// Run times needed before a percentile is trusted
+    static constexpr size_t kMinSamples = 20;
+
+    /**
+     * @brief Construct the history of a configuration.
+     * @param dir The history directory.
+     * @param key Key of the configuration, see keyFor().
+     */
+    RuntimeHistory(const std::string& dir, const std::string& key);
+
+    /**
+     * @brief Compute the history key of a configuration.
+     * @param config The sandbox configuration.
+     * @return 16 hex digits.
+     */
+    static std::string keyFor(const SandboxConfiguration& config);
+
+    /**
+     * @brief Read the recorded run times.
+     * @return true if the history was read or does not exist yet.
+     */
+    bool load();
+
+    /**
+     * @brief Append runs and drop the oldest beyond kMaxSamples.
+     * @param samples The runs of a batch.
+     * @return true if successful.
+     */
+    bool record(const std::vector<RunSample>& samples);
+
+    /**
+     * @brief Get a percentile of the loaded run times.
+     * @param percentile The percentile, 1 to 100.
+     * @return The run time in milliseconds, -1 with fewer than kMinSamples.
+     */
+    long percentile(int percentile) const;
+
+    /**
+     * @brief Estimate the cost of an input from its latest runs.
+     * @param input The input path.
+     * @return The mean of up to kEstimateRuns runs, nullopt if it never ran.
+     */
+    std::optional<RunEstimate> estimate(const std::string& input) const;
+
+    /**
+     * @brief Get the loaded runs.
+     * @return The runs, oldest first.
+     */
+    const std::vector<RunSample>& getSamples() const;
+
+private:
+    std::string path_;
+    std::vector<RunSample> samples_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_RUNTIME_HISTORY_H
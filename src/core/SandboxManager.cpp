@@ -5,23 +5,41 @@
 
 #include "core/SandboxManager.h"
 #include "core/Logger.h"
+#include "core/ProcessGroup.h"
+#include "core/CoreCollector.h"
+#include "core/RuntimeHistory.h"
 #include "modules/interface/IModule.h"
+#include "modules/filesystem/RootFS.h"
+#include "utils/Syscalls.h"
+#include <set>
+#include <algorithm>
 #include <chrono>
 #include <thread>
 #include <csignal>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <poll.h>
 #include <fcntl.h>
+#include <cstring>
 
 namespace sandbox {
 
 SandboxManager::SandboxManager()
     : state_(SandboxState::CREATED)
     , childPid_(-1)
+    , holderPid_(-1)
+    , speculateAfterMs_(-1)
 {
     pipeFd_[0] = -1;
     pipeFd_[1] = -1;
+    errPipeFd_[0] = -1;
+    errPipeFd_[1] = -1;
+    resultPipeFd_[0] = -1;
+    resultPipeFd_[1] = -1;
+    startedPipeFd_[0] = -1;
+    startedPipeFd_[1] = -1;
 }
 
 SandboxManager::~SandboxManager() {
@@ -44,6 +62,10 @@ void SandboxManager::setConfig(const SandboxConfiguration& config) {
     config_ = config;
 }
 
+void SandboxManager::setChildStartedHook(std::function<void()> hook) {
+    childStartedHook_ = std::move(hook);
+}
+
 const SandboxConfiguration& SandboxManager::getConfig() const {
     return config_;
 }
@@ -101,10 +123,22 @@ SandboxResult SandboxManager::run() {
     result.exitCode = -1;
     result.success = false;
     result.childPid = -1;
+    result.wallTimeUs = 0;
+    result.setupTimeUs = 0;
+    result.usage = {};
+    result.network = {};
 
     SANDBOX_INFO("Starting sandbox: " + config_.sandbox.name);
     setState(SandboxState::INITIALIZING);
 
+    // The child runs either; ConfigParser rejects configurations with both
+    if (!config_.sandbox.processes.empty() && !config_.fanout.inputs.empty()) {
+        result.errorMessage = "Fan-out cannot be combined with a process group";
+        SANDBOX_ERROR(result.errorMessage);
+        setState(SandboxState::ERROR);
+        return result;
+    }
+
     // Resolve module dependencies
     resolveDependencies();
 
@@ -115,16 +149,65 @@ SandboxResult SandboxManager::run() {
         return result;
     }
 
-    // Create pipe for output capture
-    if (pipe(pipeFd_) < 0) {
+    if (auto* rootfs = dynamic_cast<RootFS*>(getModule("rootfs"))) {
+        result.imageDigest = rootfs->getImageDigest();
+    }
+
+    // Create pipes for output capture
+    if (pipe2(pipeFd_, O_CLOEXEC) < 0 || pipe2(errPipeFd_, O_CLOEXEC) < 0) {
         result.errorMessage = "Failed to create pipe";
         SANDBOX_ERROR(result.errorMessage);
         setState(SandboxState::ERROR);
         return result;
     }
 
+    bool fanOut = !config_.fanout.inputs.empty();
+    if (fanOut && pipe2(resultPipeFd_, O_CLOEXEC) < 0) {
+        result.errorMessage = "Failed to create result pipe";
+        SANDBOX_ERROR(result.errorMessage);
+        close(pipeFd_[0]);
+        close(pipeFd_[1]);
+        close(errPipeFd_[0]);
+        close(errPipeFd_[1]);
+        setState(SandboxState::ERROR);
+        return result;
+    }
+
+    // Stragglers and input order are taken from earlier batches of this configuration
+    speculateAfterMs_ = -1;
+    runEstimates_.clear();
+    if (fanOut && usesRunHistory()) {
+        RuntimeHistory history(config_.fanout.history_dir, RuntimeHistory::keyFor(config_));
+        history.load();
+        if (config_.fanout.speculate) {
+            speculateAfterMs_ = history.percentile(config_.fanout.speculate_percentile);
+            SANDBOX_DEBUG(speculateAfterMs_ < 0 ? std::string("Too little run time history to speculate")
+                          : "Duplicating runs after " + std::to_string(speculateAfterMs_) + "ms");
+        }
+        for (const auto& input : config_.fanout.inputs) {
+            if (auto estimate = history.estimate(input)) {
+                runEstimates_[input] = *estimate;
+            }
+        }
+    }
+
+    // Keep the read ends alive across a supervisor restart
+    if (config_.supervisor.hold_output) {
+        holderPid_ = spawnOutputHolder();
+    }
+
+    // Route core dumps of the sandbox to its own directory
+    registerCores();
+
+    // Without it the setup time is simply not told apart
+    if (pipe2(startedPipeFd_, O_CLOEXEC) < 0) {
+        startedPipeFd_[0] = -1;
+        startedPipeFd_[1] = -1;
+    }
+
     // Fork child process
     SANDBOX_INFO("Forking child process");
+    auto forkTime = std::chrono::steady_clock::now();
     childPid_ = fork();
 
     if (childPid_ < 0) {
@@ -132,13 +215,30 @@ SandboxResult SandboxManager::run() {
         SANDBOX_ERROR(result.errorMessage);
         close(pipeFd_[0]);
         close(pipeFd_[1]);
+        close(errPipeFd_[0]);
+        close(errPipeFd_[1]);
+        if (fanOut) {
+            close(resultPipeFd_[0]);
+            close(resultPipeFd_[1]);
+        }
+        closeStartedPipe();
+        stopOutputHolder();
+        unregisterCores(result);
         setState(SandboxState::ERROR);
         return result;
     }
 
     if (childPid_ == 0) {
         // Child process
-        close(pipeFd_[0]);  // Close read end
+        close(pipeFd_[0]);  // Close read ends
+        close(errPipeFd_[0]);
+        if (startedPipeFd_[0] >= 0) {
+            close(startedPipeFd_[0]);
+            startedPipeFd_[0] = -1;
+        }
+        if (fanOut) {
+            close(resultPipeFd_[0]);
+        }
 
         // Set process title
         prctl(PR_SET_NAME, config_.sandbox.name.c_str(), 0, 0, 0);
@@ -148,29 +248,102 @@ SandboxResult SandboxManager::run() {
     }
 
     // Parent process
-    close(pipeFd_[1]);  // Close write end
+    close(pipeFd_[1]);  // Close write ends
+    close(errPipeFd_[1]);
+    if (fanOut) {
+        close(resultPipeFd_[1]);
+    }
+    if (startedPipeFd_[1] >= 0) {
+        close(startedPipeFd_[1]);
+        startedPipeFd_[1] = -1;
+    }
     result.childPid = childPid_;
     setState(SandboxState::RUNNING);
     SANDBOX_INFO("Child process started with PID: " + std::to_string(childPid_));
 
+    // Relay output while the child runs so it never blocks on a full pipe
+    std::atomic<bool> exited{false};
+    std::thread relay(relayOutput, pipeFd_[0], errPipeFd_[0], std::cref(exited),
+                      std::ref(result.stdout), std::ref(result.stderr));
+
+    // Collect per-input results of a fan-out run
+    std::string resultLines;
+    std::string unused;
+    std::thread resultRelay;
+    if (fanOut) {
+        resultRelay = std::thread(relayOutput, resultPipeFd_[0], -1, std::cref(exited),
+                                  std::ref(resultLines), std::ref(unused));
+    }
+
+    // Attach to the sandbox network namespace once the child has entered
+    // it, and sample KSM savings while the sandbox runs
+    auto* cgroups = dynamic_cast<Cgroups*>(getModule("cgroups"));
+    bool sampleMerge = cgroups && config_.resources.memory_merge;
+    std::thread usageSampler([this, cgroups, sampleMerge, &exited]() {
+        for (int tick = 0; !exited; ++tick) {
+            if (!netStats_.isOpen()) {
+                netStats_.open(childPid_);
+            }
+            if (sampleMerge && tick % 10 == 0) {
+                cgroups->sampleMemoryMerge();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    });
+
     // Prepare child process (move to cgroups, etc.)
     if (!prepareChildProcess()) {
         SANDBOX_ERROR("Failed to prepare child process");
         kill(childPid_, SIGKILL);
+    } else {
+        persistState();
+        if (childStartedHook_) {
+            childStartedHook_();
+        }
+    }
+
+    // The child closes its end when the command starts, or dies trying
+    if (startedPipeFd_[0] >= 0) {
+        char byte;
+        while (read(startedPipeFd_[0], &byte, 1) < 0 && errno == EINTR) {
+        }
+        result.setupTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - forkTime).count();
+        closeStartedPipe();
     }
 
     // Wait for child to exit
     int status = 0;
     pid_t waitedPid = waitpid(childPid_, &status, 0);
+    result.wallTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - forkTime).count();
 
-    // Read output from pipe
-    char buffer[4096];
-    ssize_t bytesRead;
-    while ((bytesRead = read(pipeFd_[0], buffer, sizeof(buffer) - 1)) > 0) {
-        buffer[bytesRead] = '\0';
-        result.stdout += buffer;
-    }
+    exited = true;
+    relay.join();
     close(pipeFd_[0]);
+    close(errPipeFd_[0]);
+    usageSampler.join();
+
+    // The namespace outlives the child while our socket references it
+    if (netStats_.sample(result.network)) {
+        SANDBOX_DEBUG("Network: rx " + std::to_string(result.network.rxBytes) + " bytes, tx " +
+                      std::to_string(result.network.txBytes) + " bytes");
+    }
+    netStats_.close();
+    if (fanOut) {
+        resultRelay.join();
+        close(resultPipeFd_[0]);
+        result.inputs = FanOutRunner::parseResults(resultLines);
+        if (usesRunHistory()) {
+            std::vector<RunSample> samples;
+            for (const auto& input : result.inputs) {
+                if (input.exitCode == 0 && !input.timedOut) {
+                    samples.push_back({input.executionTimeMs, input.memoryPeakBytes, input.input});
+                }
+            }
+            RuntimeHistory(config_.fanout.history_dir, RuntimeHistory::keyFor(config_)).record(samples);
+        }
+    }
 
     if (waitedPid == childPid_) {
         if (WIFEXITED(status)) {
@@ -183,8 +356,19 @@ SandboxResult SandboxManager::run() {
         }
     }
 
+    // Collect usage before the cgroup is removed
+    if (cgroups) {
+        result.usage = cgroups->collectUsage();
+    }
+    unregisterCores(result);
+
     setState(SandboxState::STOPPING);
     cleanupModules();
+    stopOutputHolder();
+    if (!recordId_.empty()) {
+        StateStore(config_.supervisor.state_dir).remove(recordId_);
+        recordId_.clear();
+    }
     setState(SandboxState::STOPPED);
 
     auto endTime = std::chrono::steady_clock::now();
@@ -197,6 +381,61 @@ SandboxResult SandboxManager::run() {
     return result;
 }
 
+SandboxResult SandboxManager::adopt(const AdoptedSandbox& adopted) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    SandboxResult result;
+    result.exitCode = -1;
+    result.success = false;
+    result.childPid = adopted.record.pid;
+    result.wallTimeUs = 0;
+    result.setupTimeUs = 0;
+    result.usage = {};
+
+    SANDBOX_INFO("Adopting sandbox: " + adopted.record.id);
+    setState(SandboxState::RUNNING);
+
+    std::atomic<bool> exited{false};
+    std::thread relay(relayOutput, adopted.stdoutFd, adopted.stderrFd, std::cref(exited),
+                      std::ref(result.stdout), std::ref(result.stderr));
+
+    // A pidfd becomes readable when the process exits
+    struct pollfd pfd = {adopted.pidFd, POLLIN, 0};
+    while (poll(&pfd, 1, -1) < 0 && errno == EINTR) {
+    }
+
+    exited = true;
+    relay.join();
+
+    if (adopted.cgroupFd >= 0) {
+        int peakFd = openat(adopted.cgroupFd, "memory.peak", O_RDONLY | O_CLOEXEC);
+        if (peakFd >= 0) {
+            char buffer[32] = {};
+            if (read(peakFd, buffer, sizeof(buffer) - 1) > 0) {
+                result.usage.memoryPeakBytes = std::atoll(buffer);
+            }
+            close(peakFd);
+        }
+        close(adopted.cgroupFd);
+    }
+    for (int fd : {adopted.pidFd, adopted.stdoutFd, adopted.stderrFd}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    setState(SandboxState::STOPPING);
+    StateStore(config_.supervisor.state_dir).reap(adopted.record);
+    setState(SandboxState::STOPPED);
+
+    result.errorMessage = "Exit status unavailable for adopted sandbox";
+    result.executionTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+
+    SANDBOX_INFO("Adopted sandbox " + adopted.record.id + " exited");
+    return result;
+}
+
 std::future<SandboxResult> SandboxManager::runAsync() {
     return std::async(std::launch::async, [this]() {
         return run();
@@ -233,6 +472,35 @@ bool SandboxManager::stop(int timeoutMs) {
     return true;
 }
 
+bool SandboxManager::updateResources(const ResourceUpdate& update) {
+    auto* cgroups = dynamic_cast<Cgroups*>(getModule("cgroups"));
+    if (childPid_ < 0 || !cgroups) {
+        SANDBOX_ERROR("No running sandbox to update");
+        return false;
+    }
+
+    std::string error;
+    if (!cgroups->updateResources(update, error)) {
+        SANDBOX_ERROR("Resource update rejected: " + error);
+        return false;
+    }
+    if (update.memoryMb) {
+        config_.resources.memory_mb = *update.memoryMb;
+    }
+    if (update.cpuQuotaPercent) {
+        config_.resources.cpu_quota_percent = *update.cpuQuotaPercent;
+    }
+    if (update.maxPids) {
+        config_.resources.max_pids = *update.maxPids;
+    }
+
+    if (!recordId_.empty() &&
+        !StateStore(config_.supervisor.state_dir).recordUpdate(recordId_, Cgroups::describeUpdate(update))) {
+        SANDBOX_WARNING("Resource update of " + recordId_ + " not recorded");
+    }
+    return true;
+}
+
 SandboxState SandboxManager::getState() const {
     return state_;
 }
@@ -245,6 +513,12 @@ bool SandboxManager::isRunning() const {
     return state_ == SandboxState::RUNNING && childPid_ > 0;
 }
 
+NetworkUsage SandboxManager::getNetworkUsage() {
+    NetworkUsage usage{};
+    netStats_.sample(usage);
+    return usage;
+}
+
 void SandboxManager::registerDefaultModules() {
     // Default modules will be registered by the main application
     SANDBOX_DEBUG("Default modules registration point");
@@ -324,6 +598,11 @@ bool SandboxManager::prepareChildProcess() {
 
 int SandboxManager::executeChild() {
     try {
+        // Still privileged on the host here, so hard limits can be raised
+        if (!applyResourceLimits()) {
+            return 1;
+        }
+
         // Apply child-side module configurations
         for (IModule* module : executionOrder_) {
             if (!module->applyChild(config_)) {
@@ -332,14 +611,264 @@ int SandboxManager::executeChild() {
             }
         }
 
-        // Execute modules
-        return execute(config_);
+        // Send output to the supervisor from here on
+        if (!redirectOutput()) {
+            return 1;
+        }
+
+        // Setup is over; the supervisor times the command from here
+        closeStartedPipe();
+
+        if (!config_.fanout.inputs.empty()) {
+            return runFanOut();
+        }
+
+        // Run a process group when one is configured, or supervise the
+        // command in place when it has a restart policy
+        if (!config_.sandbox.processes.empty() || config_.restart.policy != "never") {
+            return runProcessGroup();
+        }
+
+        // Replace the child with the sandboxed command
+        Syscall::execCommand(config_.sandbox.command);
+        return 127;
     } catch (const std::exception& e) {
         SANDBOX_ERROR("Exception in child process: " + std::string(e.what()));
         return 1;
     }
 }
 
+bool SandboxManager::applyResourceLimits() {
+    std::vector<RlimitConfig> limits = config_.rlimits;
+
+    // Without collection a core would go wherever the host puts it
+    bool coreLimit = std::any_of(limits.begin(), limits.end(),
+                                 [](const RlimitConfig& limit) { return limit.resource == "core"; });
+    if (!config_.cores.enabled && !coreLimit) {
+        limits.push_back({"core", 0, 0});
+    }
+
+    for (const auto& limit : limits) {
+        if (!Syscall::setResourceLimit(0, Syscall::rlimitResource(limit.resource), limit.soft, limit.hard)) {
+            SANDBOX_ERROR("Failed to apply rlimit " + limit.resource);
+            return false;
+        }
+    }
+    return true;
+}
+
+void SandboxManager::registerCores() {
+    auto* cgroups = dynamic_cast<Cgroups*>(getModule("cgroups"));
+    if (!config_.cores.enabled || !cgroups) {
+        return;
+    }
+    if (!CoreCollector::isInstalled()) {
+        SANDBOX_WARNING("Core handler not installed, run 'sandbox core-handler install' to collect cores");
+    }
+
+    CoreCollector::Entry entry;
+    entry.outputDir = config_.cores.output_dir + "/" + cgroups->getCgroupName();
+    entry.maxBytes = config_.cores.max_mb * 1024 * 1024;
+    if (CoreCollector::registerSandbox(config_.cores.registry_dir, cgroups->getCgroupName(), entry)) {
+        coreName_ = cgroups->getCgroupName();
+        coreDir_ = entry.outputDir;
+    }
+}
+
+void SandboxManager::unregisterCores(SandboxResult& result) {
+    if (coreName_.empty()) {
+        return;
+    }
+
+    // The kernel waits for the collector before the crashed process is
+    // reaped, so every core is complete by now
+    CoreCollector::unregisterSandbox(config_.cores.registry_dir, coreName_);
+    result.coreFiles = CoreCollector::listCores(coreDir_);
+    for (const auto& core : result.coreFiles) {
+        SANDBOX_WARNING("Core dump collected: " + core);
+    }
+    coreName_.clear();
+}
+
+int SandboxManager::runProcessGroup() {
+    std::vector<ProcessConfig> processes = config_.sandbox.processes;
+    if (processes.empty()) {
+        // A single supervised command restarts warm inside this sandbox
+        ProcessConfig main;
+        main.name = "main";
+        main.command = config_.sandbox.command;
+        main.restart_policy = config_.restart.policy;
+        main.memory_mb = 0;
+        main.cpu_quota_percent = 0;
+        main.max_pids = 0;
+        processes.push_back(main);
+    }
+
+    ProcessGroup group(processes, config_.restart);
+
+    auto* cgroups = dynamic_cast<Cgroups*>(getModule("cgroups"));
+    if (cgroups) {
+        for (const auto& process : config_.sandbox.processes) {
+            group.setCgroupFd(process.name, cgroups->getProcessCgroupFd(process.name));
+        }
+        group.setPeakResetFd(cgroups->getMemoryPeakFd());
+    }
+
+    SANDBOX_INFO("Starting process group with " + std::to_string(processes.size()) + " processes");
+    return group.run();
+}
+
+int SandboxManager::runFanOut() {
+    FanOutRunner runner(config_.sandbox.command, config_.fanout);
+
+    auto* cgroups = dynamic_cast<Cgroups*>(getModule("cgroups"));
+    if (cgroups) {
+        runner.setSlots(cgroups->getFanOutSlots());
+    } else {
+        runner.setSlots(std::vector<FanOutSlot>(FanOutRunner::slotCount(config_), FanOutSlot{-1, -1, -1}));
+    }
+    runner.setSpeculationThreshold(speculateAfterMs_);
+    runner.setEstimates(runEstimates_, static_cast<long long>(config_.resources.memory_mb) * 1024 * 1024);
+
+    return runner.run(resultPipeFd_[1]);
+}
+
+bool SandboxManager::usesRunHistory() const {
+    return config_.fanout.speculate || config_.fanout.order != "submission";
+}
+
+bool SandboxManager::redirectOutput() {
+    if (dup2(pipeFd_[1], STDOUT_FILENO) < 0 || dup2(errPipeFd_[1], STDERR_FILENO) < 0) {
+        SANDBOX_ERROR("Failed to redirect output: " + std::string(strerror(errno)));
+        return false;
+    }
+    close(pipeFd_[1]);
+    close(errPipeFd_[1]);
+    return true;
+}
+
+void SandboxManager::relayOutput(int stdoutFd, int stderrFd, const std::atomic<bool>& exited,
+                                 std::string& out, std::string& err) {
+    struct pollfd fds[2] = {{stdoutFd, POLLIN, 0}, {stderrFd, POLLIN, 0}};
+    std::string* sinks[2] = {&out, &err};
+    char buffer[4096];
+
+    while (fds[0].fd >= 0 || fds[1].fd >= 0) {
+        int ready = poll(fds, 2, 100);
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+        // Descendants may keep the pipes open after the child exits
+        if (ready == 0 && exited) {
+            break;
+        }
+
+        for (int i = 0; i < 2; ++i) {
+            if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            ssize_t n = read(fds[i].fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                sinks[i]->append(buffer, n);
+            } else if (n == 0 || errno != EINTR) {
+                fds[i].fd = -1;
+            }
+        }
+    }
+}
+
+pid_t SandboxManager::spawnOutputHolder() {
+    pid_t pid = fork();
+    if (pid < 0) {
+        SANDBOX_WARNING("Failed to start output holder: " + std::string(strerror(errno)));
+        return -1;
+    }
+
+    if (pid == 0) {
+        // Detach from the supervisor's session so its signals do not reach us
+        setsid();
+        signal(SIGTERM, SIG_DFL);
+
+        // Park the read ends on well-known descriptors for pidfd_getfd()
+        int out = fcntl(pipeFd_[0], F_DUPFD, 10);
+        int err = fcntl(errPipeFd_[0], F_DUPFD, 10);
+        dup2(out, 3);
+        dup2(err, 4);
+        syscall(SYS_close_range, 5, ~0U, 0);
+
+        // Wait for the writers to go away, then linger so a restarted
+        // supervisor can still fetch output that is buffered in the pipes
+        struct pollfd fds[2] = {{3, 0, 0}, {4, 0, 0}};
+        int hungUp = 0;
+        while (hungUp < 2) {
+            if (poll(fds, 2, -1) < 0) {
+                continue;
+            }
+            for (auto& fd : fds) {
+                if (fd.fd >= 0 && (fd.revents & POLLHUP)) {
+                    fd.fd = -1;
+                    hungUp++;
+                }
+            }
+        }
+        sleep(300);
+        _exit(0);
+    }
+
+    return pid;
+}
+
+void SandboxManager::closeStartedPipe() {
+    for (int& fd : startedPipeFd_) {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+}
+
+void SandboxManager::stopOutputHolder() {
+    if (holderPid_ > 0) {
+        kill(holderPid_, SIGTERM);
+        waitpid(holderPid_, nullptr, 0);
+        holderPid_ = -1;
+    }
+}
+
+void SandboxManager::persistState() {
+    auto* cgroups = dynamic_cast<Cgroups*>(getModule("cgroups"));
+
+    SandboxRecord record;
+    record.id = cgroups ? cgroups->getCgroupName()
+                        : "sandbox-" + config_.sandbox.name + "-" + std::to_string(getpid());
+    record.name = config_.sandbox.name;
+    record.pid = childPid_;
+    record.startTime = StateStore::readStartTime(childPid_);
+    record.supervisorPid = getpid();
+    record.supervisorStartTime = StateStore::readStartTime(getpid());
+    record.holderPid = holderPid_;
+    record.holderStartTime = holderPid_ > 0 ? StateStore::readStartTime(holderPid_) : 0;
+    record.holderStdoutFd = holderPid_ > 0 ? 3 : -1;
+    record.holderStderrFd = holderPid_ > 0 ? 4 : -1;
+    record.cgroupPath = cgroups ? cgroups->getCgroupPath() + "/" + cgroups->getCgroupName() : "";
+    record.rootfsPath = config_.sandbox.rootfs_manifest.empty() ? config_.sandbox.rootfs_path
+                                                                : config_.sandbox.rootfs_manifest;
+    if (auto* rootfs = dynamic_cast<RootFS*>(getModule("rootfs"))) {
+        record.mounts = rootfs->getHostMounts();
+        record.scratchDirs = rootfs->getScratchDirs();
+    }
+    record.createdAt = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.cpuBurstPercent = config_.resources.cpu_burst_percent > config_.resources.cpu_quota_percent
+                                 ? config_.resources.cpu_burst_percent : 0;
+
+    if (StateStore(config_.supervisor.state_dir).save(record)) {
+        recordId_ = record.id;
+    } else {
+        SANDBOX_WARNING("Sandbox state not persisted; it cannot be recovered after a restart");
+    }
+}
+
 bool SandboxManager::cleanupModules() {
     bool success = true;
 
@@ -15,9 +15,13 @@
 #include <functional>
 #include <future>
 #include <memory>
+#include <atomic>
 #include <sys/types.h>
 #include "ConfigParser.h"
+#include "StateStore.h"
 #include "modules/interface/IModule.h"
+#include "modules/isolation/Cgroups.h"
+#include "utils/NetworkStats.h"
 
 namespace sandbox {
 
@@ -44,9 +48,16 @@ struct SandboxResult {
     bool success;                  ///< Whether the sandbox ran successfully
     std::string errorMessage;      ///< Error message if failed
     long executionTimeMs;          ///< Execution time in milliseconds
+    long long wallTimeUs;          ///< Wall time from fork to exit of the child
+    long long setupTimeUs;         ///< Part of wallTimeUs before the command started
     std::string stdout;            ///< Captured stdout
     std::string stderr;            ///< Captured stderr
     pid_t childPid;                ///< PID of the child process
+    ResourceUsage usage;           ///< Resource usage reported by the cgroup
+    NetworkUsage network;          ///< Traffic of the sandbox network namespace
+    std::string imageDigest;       ///< Digest of the verified rootfs image, if checked
+    std::vector<InputResult> inputs;  ///< Per-input results of a fan-out run
+    std::vector<std::string> coreFiles;  ///< Core dumps collected from the sandbox
 };
 
 /**
@@ -83,6 +94,17 @@ public:
      */
     void setConfig(const SandboxConfiguration& config);
 
+    /**
+     * @brief Set a function to run once the child has been forked.
+     *
+     * Called from run() in the supervisor after the modules prepared
+     * the child. Supervisor threads that log belong here: a child
+     * forked while one of them holds the logger lock would deadlock.
+     *
+     * @param hook The function, or an empty one for none.
+     */
+    void setChildStartedHook(std::function<void()> hook);
+
     /**
      * @brief Get the current configuration.
      * @return Reference to the current configuration.
@@ -122,6 +144,19 @@ public:
      */
     SandboxResult run();
 
+    /**
+     * @brief Take over a sandbox started by a previous supervisor.
+     *
+     * Relays the sandbox output from the recovered pipes, waits for
+     * the sandbox to exit through its pidfd and then releases its
+     * cgroup, mounts and record. The exit status of an adopted sandbox
+     * is not available, since it is not a child of this process.
+     *
+     * @param adopted Handles reopened by StateStore::recover().
+     * @return SandboxResult for the adopted sandbox.
+     */
+    SandboxResult adopt(const AdoptedSandbox& adopted);
+
     /**
      * @brief Run the sandbox asynchronously.
      * @return Future containing the SandboxResult.
@@ -135,6 +170,18 @@ public:
      */
     bool stop(int timeoutMs = 5000);
 
+    /**
+     * @brief Change the resource limits of the running sandbox.
+     *
+     * Rewrites the cgroup limits in place, so a long-running sandbox
+     * keeps its state; see Cgroups::updateLimits() for the checks. The
+     * change is appended to the sandbox record.
+     *
+     * @param update The limits to change.
+     * @return true if every limit was changed.
+     */
+    bool updateResources(const ResourceUpdate& update);
+
     /**
      * @brief Get the current state of the sandbox.
      * @return The current SandboxState.
@@ -153,6 +200,15 @@ public:
      */
     bool isRunning() const;
 
+    /**
+     * @brief Sample the traffic of the running sandbox.
+     *
+     * Zero until the sandbox has entered its own network namespace.
+     *
+     * @return Counters summed over the sandbox interfaces, without loopback.
+     */
+    NetworkUsage getNetworkUsage();
+
     /**
      * @brief Initialize the logger with configuration settings.
      */
@@ -170,6 +226,19 @@ private:
     bool initializeModules();
     bool prepareChildProcess();
     int executeChild();
+    bool applyResourceLimits();
+    void registerCores();
+    void unregisterCores(SandboxResult& result);
+    int runProcessGroup();
+    int runFanOut();
+    bool usesRunHistory() const;
+    bool redirectOutput();
+    void closeStartedPipe();
+    pid_t spawnOutputHolder();
+    void stopOutputHolder();
+    void persistState();
+    static void relayOutput(int stdoutFd, int stderrFd, const std::atomic<bool>& exited,
+                            std::string& out, std::string& err);
     bool cleanupModules();
     void resolveDependencies();
     std::vector<IModule*> getExecutionOrder();
@@ -180,7 +249,18 @@ private:
     std::map<std::string, std::unique_ptr<IModule>> modules_;
     std::vector<IModule*> executionOrder_;
     pid_t childPid_;
-    int pipeFd_[2];  ///< Pipe for capturing output
+    int pipeFd_[2];     ///< Pipe for capturing output
+    int errPipeFd_[2];  ///< Pipe for capturing error output
+    int resultPipeFd_[2];  ///< Pipe for per-input fan-out results
+    int startedPipeFd_[2];  ///< Closed by the child once its command starts
+    pid_t holderPid_;   ///< Process keeping the output pipes open, or -1
+    std::string recordId_;  ///< Id of the persisted sandbox record
+    NetworkStats netStats_;  ///< Counters of the sandbox network namespace
+    std::string coreName_;  ///< Cgroup registered for core collection
+    std::string coreDir_;   ///< Directory the sandbox's cores are written to
+    long speculateAfterMs_;  ///< Run time after which fan-out runs are duplicated, -1 for never
+    std::map<std::string, RunEstimate> runEstimates_;  ///< Cost of fan-out inputs in earlier batches
+    std::function<void()> childStartedHook_;  ///< Run after the child is prepared
 };
 
 } // namespace sandbox
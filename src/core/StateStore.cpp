@@ -0,0 +1,327 @@
+/**
+ * @file StateStore.cpp
+ * @brief Implementation of the StateStore class.
+ */
+
+#include "core/StateStore.h"
+#include "core/Logger.h"
+#include "utils/Syscalls.h"
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/syscall.h>
+
+using json = nlohmann::json;
+
+namespace sandbox {
+
+StateStore::StateStore(const std::string& stateDir)
+    : stateDir_(stateDir)
+{
+}
+
+const std::string& StateStore::getStateDir() const {
+    return stateDir_;
+}
+
+std::string StateStore::recordPath(const std::string& id) const {
+    return stateDir_ + "/" + id + ".json";
+}
+
+bool StateStore::save(const SandboxRecord& record) {
+    if (!Syscall::isDirectory(stateDir_) && !Syscall::mkdirRecursive(stateDir_, 0700)) {
+        SANDBOX_ERROR("Failed to create state directory: " + stateDir_);
+        return false;
+    }
+
+    json j;
+    j["id"] = record.id;
+    j["name"] = record.name;
+    j["pid"] = record.pid;
+    j["start_time"] = record.startTime;
+    j["supervisor_pid"] = record.supervisorPid;
+    j["supervisor_start_time"] = record.supervisorStartTime;
+    j["holder_pid"] = record.holderPid;
+    j["holder_start_time"] = record.holderStartTime;
+    j["holder_stdout_fd"] = record.holderStdoutFd;
+    j["holder_stderr_fd"] = record.holderStderrFd;
+    j["cgroup_path"] = record.cgroupPath;
+    j["rootfs_path"] = record.rootfsPath;
+    j["mounts"] = record.mounts;
+    j["scratch_dirs"] = record.scratchDirs;
+    j["created_at"] = record.createdAt;
+    j["resource_updates"] = record.resourceUpdates;
+    j["cpu_burst_percent"] = record.cpuBurstPercent;
+
+    // Write to a temporary file and rename so readers never see a partial record
+    std::string path = recordPath(record.id);
+    std::string tmpPath = path + ".tmp";
+    if (!Syscall::writeFile(tmpPath, j.dump(2))) {
+        return false;
+    }
+    if (::rename(tmpPath.c_str(), path.c_str()) < 0) {
+        SANDBOX_ERROR("Failed to store sandbox record: " + std::string(strerror(errno)));
+        ::unlink(tmpPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool StateStore::remove(const std::string& id) {
+    if (::unlink(recordPath(id).c_str()) < 0 && errno != ENOENT) {
+        SANDBOX_WARNING("Failed to remove sandbox record " + id + ": " + std::string(strerror(errno)));
+        return false;
+    }
+    return true;
+}
+
+bool StateStore::recordUpdate(const std::string& id, const std::string& change) {
+    auto record = load(id);
+    if (!record) {
+        return false;
+    }
+    long long now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record->resourceUpdates.push_back(std::to_string(now) + " " + change);
+    return save(*record);
+}
+
+std::optional<SandboxRecord> StateStore::load(const std::string& id) const {
+    auto content = Syscall::readFile(recordPath(id));
+    if (!content) {
+        return std::nullopt;
+    }
+
+    try {
+        json j = json::parse(*content);
+
+        SandboxRecord record;
+        record.id = j.value("id", id);
+        record.name = j.value("name", "");
+        record.pid = j.value("pid", -1);
+        record.startTime = j.value("start_time", 0ULL);
+        record.supervisorPid = j.value("supervisor_pid", -1);
+        record.supervisorStartTime = j.value("supervisor_start_time", 0ULL);
+        record.holderPid = j.value("holder_pid", -1);
+        record.holderStartTime = j.value("holder_start_time", 0ULL);
+        record.holderStdoutFd = j.value("holder_stdout_fd", -1);
+        record.holderStderrFd = j.value("holder_stderr_fd", -1);
+        record.cgroupPath = j.value("cgroup_path", "");
+        record.rootfsPath = j.value("rootfs_path", "");
+        record.mounts = j.value("mounts", std::vector<std::string>{});
+        record.scratchDirs = j.value("scratch_dirs", std::vector<std::string>{});
+        record.createdAt = j.value("created_at", 0LL);
+        record.resourceUpdates = j.value("resource_updates", std::vector<std::string>{});
+        record.cpuBurstPercent = j.value("cpu_burst_percent", 0);
+        return record;
+    } catch (const json::exception& e) {
+        SANDBOX_WARNING("Ignoring unreadable sandbox record " + id + ": " + std::string(e.what()));
+        return std::nullopt;
+    }
+}
+
+std::vector<SandboxRecord> StateStore::list() const {
+    std::vector<SandboxRecord> records;
+
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(stateDir_, ec)) {
+        if (entry.path().extension() != ".json") {
+            continue;
+        }
+        if (auto record = load(entry.path().stem().string())) {
+            records.push_back(*record);
+        }
+    }
+
+    return records;
+}
+
+unsigned long long StateStore::readStartTime(pid_t pid) {
+    auto stat = Syscall::readFile("/proc/" + std::to_string(pid) + "/stat");
+    if (!stat) {
+        return 0;
+    }
+
+    // The command name may contain spaces; fields resume after the last ')'
+    size_t pos = stat->rfind(')');
+    if (pos == std::string::npos) {
+        return 0;
+    }
+
+    std::istringstream fields(stat->substr(pos + 2));
+    std::string field;
+    for (int i = 3; i <= 22 && fields >> field; ++i) {
+        if (i == 22) {
+            return std::stoull(field);
+        }
+    }
+    return 0;
+}
+
+bool StateStore::isAlive(pid_t pid, unsigned long long startTime) {
+    if (pid <= 0) {
+        return false;
+    }
+    unsigned long long current = readStartTime(pid);
+    return current != 0 && current == startTime;
+}
+
+RecoveryReport StateStore::recover(bool adopt, int parallelism) {
+    RecoveryReport report;
+    std::vector<SandboxRecord> dead;
+
+    for (const auto& record : list()) {
+        // Sandboxes of a live supervisor are not orphans
+        if (isAlive(record.supervisorPid, record.supervisorStartTime)) {
+            continue;
+        }
+
+        if (isAlive(record.pid, record.startTime)) {
+            if (!adopt) {
+                continue;
+            }
+            AdoptedSandbox adopted;
+            if (adoptRecord(record, adopted)) {
+                SANDBOX_INFO("Re-adopted sandbox " + record.id + " (PID " + std::to_string(record.pid) + ")");
+                report.adopted.push_back(adopted);
+            } else {
+                report.failed.push_back(record.id);
+            }
+        } else {
+            dead.push_back(record);
+        }
+    }
+
+    // Reap dead sandboxes in parallel; each reap mostly waits on the kernel
+    std::atomic<size_t> next{0};
+    std::mutex reportMutex;
+    auto worker = [&]() {
+        for (size_t i = next++; i < dead.size(); i = next++) {
+            bool ok = reap(dead[i]);
+            std::lock_guard<std::mutex> lock(reportMutex);
+            (ok ? report.reaped : report.failed).push_back(dead[i].id);
+        }
+    };
+
+    size_t threadCount = std::min<size_t>(dead.size(), std::max(1, parallelism));
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (!report.reaped.empty()) {
+        SANDBOX_INFO("Reaped " + std::to_string(report.reaped.size()) + " orphaned sandboxes");
+    }
+
+    return report;
+}
+
+bool StateStore::reap(const SandboxRecord& record) {
+    bool ok = true;
+    SANDBOX_DEBUG("Reaping sandbox " + record.id);
+
+    // Release the output holder
+    if (isAlive(record.holderPid, record.holderStartTime)) {
+        kill(record.holderPid, SIGTERM);
+    }
+
+    // Kill anything left in the cgroup, then remove it
+    if (!record.cgroupPath.empty() && Syscall::isDirectory(record.cgroupPath)) {
+        Syscall::writeFile(record.cgroupPath + "/cgroup.kill", "1");
+
+        for (int i = 0; i < 100; ++i) {
+            auto events = Syscall::readFile(record.cgroupPath + "/cgroup.events");
+            if (!events || events->find("populated 0") != std::string::npos) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        std::filesystem::path cgroup(record.cgroupPath);
+        if (!Syscall::removeCgroup(cgroup.parent_path().string(), cgroup.filename().string())) {
+            ok = false;
+        }
+    }
+
+    // Detach host-side mounts, innermost first
+    for (auto it = record.mounts.rbegin(); it != record.mounts.rend(); ++it) {
+        if (::umount2(it->c_str(), MNT_DETACH) < 0 && errno != EINVAL && errno != ENOENT) {
+            SANDBOX_WARNING("Failed to detach " + *it + ": " + std::string(strerror(errno)));
+            ok = false;
+        }
+    }
+
+    for (const auto& dir : record.scratchDirs) {
+        if (!Syscall::removeRecursive(dir)) {
+            SANDBOX_WARNING("Failed to remove scratch directory " + dir);
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        remove(record.id);
+    }
+    return ok;
+}
+
+bool StateStore::adoptRecord(const SandboxRecord& record, AdoptedSandbox& adopted) {
+    adopted.record = record;
+    adopted.pidFd = -1;
+    adopted.cgroupFd = -1;
+    adopted.stdoutFd = -1;
+    adopted.stderrFd = -1;
+
+    adopted.pidFd = static_cast<int>(syscall(SYS_pidfd_open, record.pid, 0));
+    // Re-check after opening so a PID reused in between is not adopted
+    if (adopted.pidFd < 0 || !isAlive(record.pid, record.startTime)) {
+        SANDBOX_WARNING("Failed to open pidfd for sandbox " + record.id);
+        if (adopted.pidFd >= 0) {
+            close(adopted.pidFd);
+        }
+        return false;
+    }
+
+    adopted.cgroupFd = open(record.cgroupPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (adopted.cgroupFd < 0) {
+        SANDBOX_WARNING("Failed to open cgroup of sandbox " + record.id);
+    }
+
+    // Fetch the output pipes kept alive by the holder
+    if (isAlive(record.holderPid, record.holderStartTime)) {
+        int holderFd = static_cast<int>(syscall(SYS_pidfd_open, record.holderPid, 0));
+        if (holderFd >= 0) {
+            if (record.holderStdoutFd >= 0) {
+                adopted.stdoutFd = static_cast<int>(syscall(SYS_pidfd_getfd, holderFd, record.holderStdoutFd, 0));
+            }
+            if (record.holderStderrFd >= 0) {
+                adopted.stderrFd = static_cast<int>(syscall(SYS_pidfd_getfd, holderFd, record.holderStderrFd, 0));
+            }
+            close(holderFd);
+        }
+        if (adopted.stdoutFd < 0) {
+            SANDBOX_WARNING("Output of sandbox " + record.id + " could not be recovered");
+        }
+    }
+
+    // Take ownership
+    adopted.record.supervisorPid = getpid();
+    adopted.record.supervisorStartTime = readStartTime(getpid());
+    save(adopted.record);
+
+    return true;
+}
+
+} // namespace sandbox
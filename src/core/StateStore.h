@@ -0,0 +1,180 @@
+/**
+ * @file StateStore.h
+ * @brief Persistent per-sandbox state for supervisor restarts.
+ *
+ * This header defines the StateStore class that records every running
+ * sandbox on disk, so that a restarted or upgraded supervisor can
+ * re-adopt live sandboxes and reap the cgroups, mounts and scratch
+ * directories of dead ones.
+ */
+
+#ifndef SANDBOX_STATE_STORE_H
+#define SANDBOX_STATE_STORE_H
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <sys/types.h>
+
+namespace sandbox {
+
+/**
+ * @struct SandboxRecord
+ * @brief Persisted state of one running sandbox.
+ *
+ * Processes are identified by PID plus start time so that a reused PID
+ * is never mistaken for the original process.
+ */
+struct SandboxRecord {
+    std::string id;                        ///< Unique id (the cgroup name)
+    std::string name;                      ///< Sandbox name from the config
+    pid_t pid;                             ///< Sandbox child PID
+    unsigned long long startTime;          ///< Child start time (clock ticks)
+    pid_t supervisorPid;                   ///< Owning supervisor PID
+    unsigned long long supervisorStartTime;///< Supervisor start time (clock ticks)
+    pid_t holderPid;                       ///< Output holder PID, -1 if none
+    unsigned long long holderStartTime;    ///< Holder start time (clock ticks)
+    int holderStdoutFd;                    ///< Stdout read end inside the holder
+    int holderStderrFd;                    ///< Stderr read end inside the holder
+    std::string cgroupPath;                ///< Full path of the sandbox cgroup
+    std::string rootfsPath;                ///< Root filesystem in use
+    std::vector<std::string> mounts;       ///< Host-side mounts to detach on reap
+    std::vector<std::string> scratchDirs;  ///< Directories to remove on reap
+    long long createdAt;                   ///< Creation time (seconds since epoch)
+    std::vector<std::string> resourceUpdates;  ///< Limit changes, "<seconds since epoch> <changes>"
+    int cpuBurstPercent;                   ///< Quota the supervisor lends up to, 0 if it does not
+};
+
+/**
+ * @struct AdoptedSandbox
+ * @brief Handles reopened for a live sandbox after a supervisor restart.
+ */
+struct AdoptedSandbox {
+    SandboxRecord record;
+    int pidFd;        ///< pidfd of the sandbox child
+    int cgroupFd;     ///< Directory descriptor of the sandbox cgroup
+    int stdoutFd;     ///< Stdout read end fetched from the holder, or -1
+    int stderrFd;     ///< Stderr read end fetched from the holder, or -1
+};
+
+/**
+ * @struct RecoveryReport
+ * @brief Result of a startup scan.
+ */
+struct RecoveryReport {
+    std::vector<AdoptedSandbox> adopted;   ///< Live orphans that were re-adopted
+    std::vector<std::string> reaped;       ///< Ids of dead sandboxes cleaned up
+    std::vector<std::string> failed;       ///< Ids that could not be handled
+};
+
+/**
+ * @class StateStore
+ * @brief Stores sandbox records and recovers them after a restart.
+ *
+ * Each record is a JSON file named after the sandbox id, replaced
+ * atomically on every save. Only sandboxes whose supervisor is gone
+ * are considered orphans; sandboxes of other live supervisors are
+ * left alone.
+ */
+class StateStore {
+public:
+    /**
+     * @brief Construct a StateStore.
+     * @param stateDir Directory holding the records.
+     */
+    explicit StateStore(const std::string& stateDir = "/var/lib/sandbox/state");
+
+    /**
+     * @brief Save or replace a record.
+     * @param record The record to save.
+     * @return true if successful.
+     */
+    bool save(const SandboxRecord& record);
+
+    /**
+     * @brief Remove a record.
+     * @param id The sandbox id.
+     * @return true if successful.
+     */
+    bool remove(const std::string& id);
+
+    /**
+     * @brief Append a resource update to a record.
+     * @param id The sandbox id.
+     * @param change Description of the changed limits.
+     * @return true if successful.
+     */
+    bool recordUpdate(const std::string& id, const std::string& change);
+
+    /**
+     * @brief Load a single record.
+     * @param id The sandbox id.
+     * @return The record if present and readable.
+     */
+    std::optional<SandboxRecord> load(const std::string& id) const;
+
+    /**
+     * @brief Load all records.
+     * @return The stored records.
+     */
+    std::vector<SandboxRecord> list() const;
+
+    /**
+     * @brief Scan the store for orphaned sandboxes.
+     *
+     * Dead orphans have their cgroups, mounts and scratch directories
+     * removed in parallel. Live orphans are re-adopted when @p adopt
+     * is set: their pidfd, cgroup and output descriptors are reopened
+     * and the record is taken over by the calling supervisor.
+     *
+     * @param adopt Whether to re-adopt live orphans.
+     * @param parallelism Maximum number of concurrent reaps.
+     * @return The recovery report.
+     */
+    RecoveryReport recover(bool adopt, int parallelism);
+
+    /**
+     * @brief Release the resources of a sandbox and delete its record.
+     * @param record The sandbox to reap.
+     * @return true if everything was removed.
+     */
+    bool reap(const SandboxRecord& record);
+
+    /**
+     * @brief Check whether a recorded process is still the same process.
+     * @param pid The process ID.
+     * @param startTime The recorded start time.
+     * @return true if alive and not a reused PID.
+     */
+    static bool isAlive(pid_t pid, unsigned long long startTime);
+
+    /**
+     * @brief Read the start time of a process from /proc.
+     * @param pid The process ID.
+     * @return Start time in clock ticks since boot, 0 if unavailable.
+     */
+    static unsigned long long readStartTime(pid_t pid);
+
+    /**
+     * @brief Get the state directory.
+     * @return The state directory path.
+     */
+    const std::string& getStateDir() const;
+
+private:
+    /**
+     * @brief Reopen the handles of a live sandbox.
+     * @param record The sandbox record.
+     * @param adopted Output handles.
+     * @return true if the sandbox was adopted.
+     */
+    bool adoptRecord(const SandboxRecord& record, AdoptedSandbox& adopted);
+
+    std::string recordPath(const std::string& id) const;
+
+    std::string stateDir_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_STATE_STORE_H
@@ -9,14 +9,31 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <filesystem>
+#include <fstream>
 #include <cstring>
+#include <future>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <climits>
+#include <optional>
 #include <getopt.h>
 #include <unistd.h>
+#include <sys/syscall.h>
 
 #include "core/Logger.h"
 #include "core/ConfigParser.h"
 #include "core/SandboxManager.h"
+#include "core/StateStore.h"
+#include "core/Benchmark.h"
+#include "core/ImageStore.h"
+#include "core/CoreCollector.h"
+#include "core/Housekeeping.h"
+#include "utils/Syscalls.h"
+#include "utils/NetworkStats.h"
 #include "modules/interface/IModule.h"
 #include "modules/isolation/Namespaces.h"
 #include "modules/isolation/Cgroups.h"
@@ -24,6 +41,12 @@
 #include "modules/security/Caps.h"
 #include "modules/filesystem/RootFS.h"
 #include "modules/filesystem/Mounts.h"
+#include "modules/filesystem/ImagePack.h"
+#include "modules/filesystem/IntegrityManifest.h"
+#include "modules/filesystem/AccessTracer.h"
+#include "modules/filesystem/ImageSlimmer.h"
+#include "modules/ipc/Channels.h"
+#include "modules/ipc/Datasets.h"
 #include "modules/ai/AIAgent.h"
 
 using namespace sandbox;
@@ -42,14 +65,39 @@ void printUsage(const char* programName) {
               << "  -d, --debug           Enable debug logging\n"
               << "  --ai                  Enable AI module\n\n"
               << "Commands:\n"
-              << "  run                   Run a command in the sandbox\n"
+              << "  run                   Run a command in the sandbox (optional with sandbox.processes)\n"
               << "  exec                  Execute a command in a running sandbox\n"
               << "  list                  List running sandboxes\n"
-              << "  stop                  Stop a running sandbox\n\n"
+              << "  recover               Re-adopt sandboxes left by a previous supervisor\n"
+              << "  stop ID               Stop a running sandbox\n"
+              << "  update NAME|ID        Change the limits of a running sandbox\n"
+              << "  bench-run             Benchmark a command in pinned sandboxes\n"
+              << "  gc                    Evict unused images beyond the disk budget\n"
+              << "  pack-image DIR OUT    Pack a rootfs for lazy loading (sandbox.rootfs_manifest)\n"
+              << "  seal-image DIR        Record the integrity manifest of a rootfs\n"
+              << "  verify-image DIR      Check a rootfs against its manifest (--full rehashes all)\n"
+              << "  slim-image OUT [CMD]  Run a workload and keep only the files it uses in OUT\n"
+              << "  core-handler install|uninstall\n"
+              << "                        Collect core dumps of sandboxes (cores.enabled)\n\n"
+              << "Benchmark options:\n"
+              << "  -n, --runs N          Measured runs (default: 10)\n"
+              << "  -w, --warmup N        Unmeasured warm-up runs (default: 0)\n"
+              << "  --cpus LIST           CPUs to pin to (default: picked from the quota)\n"
+              << "  --drop-caches         Drop the sandbox's page cache between runs\n"
+              << "  --export-json FILE    Write the full report as JSON\n"
+              << "  -c, --name, -d and --ai are accepted after bench-run as well\n\n"
+              << "Update options:\n"
+              << "  --memory SIZE         Memory limit, in MB or with a M, G or T suffix\n"
+              << "  --cpu PERCENT         CPU quota, 100 per CPU\n"
+              << "  --pids N              PID limit\n"
+              << "  --io \"MAJ:MIN KEY=VALUE...\"\n"
+              << "                        io.max line of one device (rbps, wbps, riops, wiops)\n\n"
               << "Examples:\n"
               << "  " << programName << " run --config /etc/sandbox/default.json -- /bin/bash\n"
               << "  " << programName << " run -n mysandbox -- /bin/ls -la\n"
-              << "  " << programName << " --ai run -c config.json -- echo 'Hello'\n";
+              << "  " << programName << " --ai run -c config.json -- echo 'Hello'\n"
+              << "  " << programName << " -c config.json bench-run -n 50 -w 3 -- ./workload\n"
+              << "  " << programName << " update mysandbox --memory 2G --cpu 150 --pids 500\n";
 }
 
 /**
@@ -73,6 +121,8 @@ void registerDefaultModules(SandboxManager& manager) {
     manager.registerModule(std::make_unique<Caps>());
     manager.registerModule(std::make_unique<RootFS>());
     manager.registerModule(std::make_unique<Mounts>());
+    manager.registerModule(std::make_unique<Channels>());
+    manager.registerModule(std::make_unique<Datasets>());
 
     // Register AI module
     manager.registerModule(std::make_unique<AIAgent>());
@@ -104,9 +154,10 @@ bool parseArgs(int argc, char* argv[],
     };
 
     int opt;
-    bool hasCommand = false;
+    optind = 0;
 
-    while ((opt = getopt_long(argc, argv, "c:n:hvd", longOptions, nullptr)) != -1) {
+    // Stop at the first non-option so subcommands can have their own options
+    while ((opt = getopt_long(argc, argv, "+c:n:hvd", longOptions, nullptr)) != -1) {
         switch (opt) {
             case 'c':
                 configPath = optarg;
@@ -135,17 +186,498 @@ bool parseArgs(int argc, char* argv[],
     // Collect remaining arguments as command
     for (int i = optind; i < argc; ++i) {
         command.push_back(argv[i]);
-        hasCommand = true;
     }
 
-    if (!hasCommand) {
-        std::cerr << "No command specified\n";
+    return true;
+}
+
+/**
+ * @brief Parse the options of bench-run.
+ *
+ * The general options are accepted here too, except -n, which is
+ * --runs after the subcommand; the name can be given as --name.
+ *
+ * @param args Arguments following the subcommand.
+ * @param options Output benchmark options.
+ * @param configPath Output path to config file.
+ * @param sandboxName Output sandbox name.
+ * @param enableAI Output AI enable flag.
+ * @param command Output command to benchmark.
+ * @return true if parsing succeeded.
+ */
+bool parseBenchArgs(std::vector<std::string> args, BenchOptions& options, std::string& configPath,
+                    std::string& sandboxName, bool& enableAI, std::vector<std::string>& command) {
+    static struct option longOptions[] = {
+        {"runs", required_argument, nullptr, 'n'},
+        {"warmup", required_argument, nullptr, 'w'},
+        {"cpus", required_argument, nullptr, 'C'},
+        {"drop-caches", no_argument, nullptr, 'D'},
+        {"export-json", required_argument, nullptr, 'J'},
+        {"config", required_argument, nullptr, 'c'},
+        {"name", required_argument, nullptr, 'N'},
+        {"debug", no_argument, nullptr, 'd'},
+        {"ai", no_argument, nullptr, 'a'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    std::vector<char*> argv{const_cast<char*>("bench-run")};
+    for (auto& arg : args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+    int argc = static_cast<int>(argv.size()) - 1;
+
+    int opt;
+    optind = 0;
+    try {
+        while ((opt = getopt_long(argc, argv.data(), "+n:w:c:d", longOptions, nullptr)) != -1) {
+            switch (opt) {
+                case 'n':
+                    options.runs = std::stoi(optarg);
+                    break;
+                case 'w':
+                    options.warmup = std::stoi(optarg);
+                    break;
+                case 'C':
+                    options.cpus = optarg;
+                    break;
+                case 'D':
+                    options.dropCaches = true;
+                    break;
+                case 'J':
+                    options.exportJson = optarg;
+                    break;
+                case 'c':
+                    configPath = optarg;
+                    break;
+                case 'N':
+                    sandboxName = optarg;
+                    break;
+                case 'd':
+                    Logger::getInstance().setLevel(LogLevel::DEBUG);
+                    break;
+                case 'a':
+                    enableAI = true;
+                    break;
+                default:
+                    return false;
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Invalid number: " << optarg << "\n";
         return false;
     }
 
+    if (options.runs < 1 || options.warmup < 0) {
+        std::cerr << "Invalid number of runs\n";
+        return false;
+    }
+    if (!options.cpus.empty() && !Syscall::parseCpuList(options.cpus)) {
+        std::cerr << "Invalid CPU list: " << options.cpus << "\n";
+        return false;
+    }
+
+    for (int i = optind; i < argc; ++i) {
+        command.push_back(argv[i]);
+    }
     return true;
 }
 
+/**
+ * @brief Parse a memory size.
+ * @param value A number of MB, or a number with a M, G or T suffix.
+ * @return The size in MB, nullopt if invalid.
+ */
+std::optional<int> parseMemoryMb(const std::string& value) {
+    size_t end = 0;
+    long long size = 0;
+    try {
+        size = std::stoll(value, &end);
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+    std::string suffix = value.substr(end);
+    if (suffix == "G" || suffix == "g") {
+        size *= 1024;
+    } else if (suffix == "T" || suffix == "t") {
+        size *= 1024 * 1024;
+    } else if (!suffix.empty() && suffix != "M" && suffix != "m") {
+        return std::nullopt;
+    }
+    if (size < 1 || size > INT_MAX) {
+        return std::nullopt;
+    }
+    return static_cast<int>(size);
+}
+
+/**
+ * @brief Parse the options of update.
+ * @param args Arguments following the sandbox name.
+ * @param update Output limits to change.
+ * @return true if parsing succeeded and something is to be changed.
+ */
+bool parseUpdateArgs(std::vector<std::string> args, ResourceUpdate& update) {
+    static struct option longOptions[] = {
+        {"memory", required_argument, nullptr, 'm'},
+        {"cpu", required_argument, nullptr, 'C'},
+        {"pids", required_argument, nullptr, 'p'},
+        {"io", required_argument, nullptr, 'i'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    std::vector<char*> argv{const_cast<char*>("update")};
+    for (auto& arg : args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+    int argc = static_cast<int>(argv.size()) - 1;
+
+    int opt;
+    optind = 0;
+    try {
+        while ((opt = getopt_long(argc, argv.data(), "", longOptions, nullptr)) != -1) {
+            switch (opt) {
+                case 'm':
+                    update.memoryMb = parseMemoryMb(optarg);
+                    if (!update.memoryMb) {
+                        std::cerr << "Invalid memory size: " << optarg << "\n";
+                        return false;
+                    }
+                    break;
+                case 'C':
+                    update.cpuQuotaPercent = std::stoi(optarg);
+                    break;
+                case 'p':
+                    update.maxPids = std::stoi(optarg);
+                    break;
+                case 'i':
+                    update.ioMax = optarg;
+                    break;
+                default:
+                    return false;
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Invalid number: " << optarg << "\n";
+        return false;
+    }
+
+    return optind == argc &&
+           (update.memoryMb || update.cpuQuotaPercent || update.maxPids || update.ioMax);
+}
+
+/**
+ * @brief Run a benchmark and print its report.
+ * @param config The sandbox configuration.
+ * @param options Benchmark options.
+ * @return Exit code.
+ */
+int benchRun(const SandboxConfiguration& config, const BenchOptions& options) {
+    SandboxConfiguration pinned = config;
+    pinned.resources.cpuset_cpus = options.cpus;
+    if (!options.cpus.empty() && Housekeeping::sandboxCpus(pinned).empty()) {
+        std::cerr << "No CPU of " << options.cpus << " is left outside the housekeeping CPUs\n";
+        return 1;
+    }
+
+    Benchmark benchmark(config, options, registerDefaultModules);
+    BenchReport report = benchmark.run();
+
+    std::cout << Benchmark::formatReport(report);
+
+    if (!options.exportJson.empty()) {
+        std::ofstream file(options.exportJson);
+        file << Benchmark::toJson(report) << "\n";
+        if (!file) {
+            std::cerr << "Failed to write " << options.exportJson << "\n";
+            return 1;
+        }
+    }
+
+    return report.failedRuns == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Print the recorded sandboxes.
+ * @param store The state store.
+ * @return Exit code.
+ */
+int listSandboxes(StateStore& store) {
+    for (const auto& record : store.list()) {
+        bool alive = StateStore::isAlive(record.pid, record.startTime);
+        bool supervised = StateStore::isAlive(record.supervisorPid, record.supervisorStartTime);
+        std::cout << record.id << "  " << record.name << "  pid=" << record.pid
+                  << "  " << (alive ? "running" : "dead")
+                  << (supervised ? "" : "  orphaned");
+
+        NetworkStats netStats;
+        NetworkUsage network{};
+        if (alive && netStats.open(record.pid) && netStats.sample(network)) {
+            std::cout << "  rx=" << network.rxBytes << "B/" << network.rxPackets << "p"
+                      << "  tx=" << network.txBytes << "B/" << network.txPackets << "p"
+                      << "  drops=" << network.rxDropped + network.txDropped;
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
+
+/**
+ * @brief Evict least recently used images until the stores fit the budget.
+ * @param store The state store.
+ * @param config The sandbox configuration.
+ * @return Exit code.
+ */
+int collectImages(StateStore& store, const SandboxConfiguration& config) {
+    if (config.images.disk_budget_mb <= 0) {
+        std::cerr << "No image disk budget configured (images.disk_budget_mb)\n";
+        return 1;
+    }
+
+    Syscall::setIdleIoPriority();
+    std::atomic<bool> stop{false};
+    ImageStore images(config.images);
+    GcReport report = images.collect(ImageStore::referencedImages(store), stop);
+
+    for (const auto& path : report.evicted) {
+        std::cout << "evicted  " << path << "\n";
+    }
+    std::cout << "Images used " << report.usedBytes / (1024 * 1024) << " MiB, freed "
+              << report.freedBytes / (1024 * 1024) << " MiB, budget "
+              << config.images.disk_budget_mb << " MiB\n";
+    return 0;
+}
+
+/**
+ * @brief Hash every file of a rootfs and store its integrity manifest.
+ * @param root The rootfs directory.
+ * @param config The sandbox configuration.
+ * @return Exit code.
+ */
+int sealImage(const std::string& root, const SandboxConfiguration& config) {
+    IntegrityManifest manifest;
+    if (!manifest.scan(root, config.images.integrity_threads)) {
+        std::cerr << "Failed to read " << root << "\n";
+        return 1;
+    }
+
+    std::string path = IntegrityManifest::pathFor(config.images.integrity_dir, root);
+    if (!manifest.save(path)) {
+        std::cerr << "Failed to write " << path << "\n";
+        return 1;
+    }
+    std::cout << "Sealed " << manifest.entries().size() << " files, digest " << manifest.digest()
+              << "\n";
+    return 0;
+}
+
+/**
+ * @brief Check a rootfs against its integrity manifest.
+ * @param root The rootfs directory.
+ * @param full Rehash every file instead of only changed ones.
+ * @param config The sandbox configuration.
+ * @return Exit code.
+ */
+int verifyImage(const std::string& root, bool full, const SandboxConfiguration& config) {
+    std::string path = IntegrityManifest::pathFor(config.images.integrity_dir, root);
+    IntegrityManifest manifest;
+    if (!manifest.load(path)) {
+        std::cerr << "No integrity manifest for " << root << "; run seal-image first\n";
+        return 1;
+    }
+
+    IntegrityReport report = manifest.verify(root, config.images.integrity_threads, full);
+    for (const auto& file : report.modified) {
+        std::cout << "modified " << file << "\n";
+    }
+    for (const auto& file : report.missing) {
+        std::cout << "missing  " << file << "\n";
+    }
+    for (const auto& file : report.added) {
+        std::cout << "added    " << file << "\n";
+    }
+    std::cout << report.files << " files checked, " << report.rehashed << " rehashed\n";
+
+    if (!report.ok()) {
+        return 1;
+    }
+    if (report.rehashed > 0) {
+        manifest.save(path);
+    }
+    std::cout << "Digest " << manifest.digest() << "\n";
+    return 0;
+}
+
+/**
+ * @brief Run a workload and build an image of the files it opened.
+ * @param outputDir The slimmed image to create.
+ * @param config The sandbox configuration, with the workload as command.
+ * @return Exit code.
+ */
+int slimImage(const std::string& outputDir, const SandboxConfiguration& config) {
+    if (!config.sandbox.rootfs_manifest.empty()) {
+        std::cerr << "Slimming needs a directory rootfs (sandbox.rootfs_path)\n";
+        return 1;
+    }
+
+    AccessTracer tracer;
+    if (!tracer.start(config.sandbox.rootfs_path)) {
+        return 1;
+    }
+
+    SandboxManager manager;
+    registerDefaultModules(manager);
+    manager.setConfig(config);
+    SandboxResult result = manager.run();
+    tracer.stop();
+
+    std::cout << result.stdout;
+    std::cerr << result.stderr;
+    if (!result.success || result.exitCode != 0) {
+        std::cerr << "Workload failed (exit " << result.exitCode << "); not slimming on a partial trace\n";
+        return 1;
+    }
+    if (!tracer.complete()) {
+        std::cerr << "File access events were lost; not slimming on a partial trace\n";
+        return 1;
+    }
+
+    ImageSlimmer slimmer(config.sandbox.rootfs_path);
+    for (const auto& file : tracer.files()) {
+        slimmer.addFile(file);
+    }
+    for (const auto& path : config.images.slim_allowlist) {
+        slimmer.addAllowed(path);
+    }
+
+    SlimReport report;
+    if (!slimmer.build(outputDir, report)) {
+        return 1;
+    }
+    std::cout << "Kept " << report.files << " of " << report.sourceFiles << " files ("
+              << report.libraries << " as library dependencies), "
+              << report.bytes / (1024 * 1024) << " of " << report.sourceBytes / (1024 * 1024)
+              << " MiB\n";
+    return 0;
+}
+
+/**
+ * @brief Re-adopt orphaned sandboxes and supervise them until they exit.
+ * @param store The state store.
+ * @param config The sandbox configuration.
+ * @return Exit code.
+ */
+int recoverSandboxes(StateStore& store, const SandboxConfiguration& config) {
+    RecoveryReport report = store.recover(true, config.supervisor.reap_parallelism);
+
+    std::vector<std::future<SandboxResult>> pending;
+    for (const auto& adopted : report.adopted) {
+        pending.push_back(std::async(std::launch::async, [&config, adopted]() {
+            SandboxManager manager;
+            manager.setConfig(config);
+            return manager.adopt(adopted);
+        }));
+    }
+
+    for (auto& future : pending) {
+        SandboxResult result = future.get();
+        if (!result.stdout.empty()) {
+            std::cout << result.stdout;
+        }
+        if (!result.stderr.empty()) {
+            std::cerr << result.stderr;
+        }
+    }
+
+    return report.failed.empty() ? 0 : 1;
+}
+
+/**
+ * @brief Stop a recorded sandbox.
+ * @param store The state store.
+ * @param id The sandbox id.
+ * @return Exit code.
+ */
+int stopSandbox(StateStore& store, const std::string& id) {
+    auto record = store.load(id);
+    if (!record) {
+        std::cerr << "No such sandbox: " << id << "\n";
+        return 1;
+    }
+
+    // Signal through a pidfd so a reused PID cannot be hit
+    int pidFd = static_cast<int>(syscall(SYS_pidfd_open, record->pid, 0));
+    if (pidFd >= 0 && StateStore::isAlive(record->pid, record->startTime)) {
+        syscall(SYS_pidfd_send_signal, pidFd, SIGTERM, nullptr, 0);
+
+        for (int i = 0; i < 50 && StateStore::isAlive(record->pid, record->startTime); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    if (pidFd >= 0) {
+        close(pidFd);
+    }
+
+    // Whatever did not stop is killed with the cgroup; an orphaned
+    // sandbox has nobody else to clean up after it
+    if (!StateStore::isAlive(record->supervisorPid, record->supervisorStartTime)) {
+        return store.reap(*record) ? 0 : 1;
+    }
+    if (!record->cgroupPath.empty()) {
+        Syscall::writeFile(record->cgroupPath + "/cgroup.kill", "1");
+    }
+    return 0;
+}
+
+/**
+ * @brief Change the limits of a recorded sandbox.
+ * @param store The state store.
+ * @param nameOrId The sandbox id, or a name only one sandbox has.
+ * @param update The limits to change.
+ * @return Exit code.
+ */
+int updateSandbox(StateStore& store, const std::string& nameOrId, const ResourceUpdate& update) {
+    auto record = store.load(nameOrId);
+    if (!record) {
+        for (const auto& candidate : store.list()) {
+            if (candidate.name != nameOrId) {
+                continue;
+            }
+            if (record) {
+                std::cerr << "Several sandboxes are named " << nameOrId << "; use the id\n";
+                return 1;
+            }
+            record = candidate;
+        }
+    }
+    if (!record) {
+        std::cerr << "No such sandbox: " << nameOrId << "\n";
+        return 1;
+    }
+    if (!StateStore::isAlive(record->pid, record->startTime) || record->cgroupPath.empty()) {
+        std::cerr << "Sandbox " << record->id << " is not running\n";
+        return 1;
+    }
+
+    // The supervisor's quota controller owns cpu.max and would undo the change
+    if (update.cpuQuotaPercent && record->cpuBurstPercent > 0) {
+        std::cerr << "Update of " << record->id << " rejected: its CPU quota is lent up to "
+                  << record->cpuBurstPercent << "% by its supervisor; --cpu cannot be changed\n";
+        return 1;
+    }
+
+    std::string error;
+    if (!Cgroups::updateLimits(record->cgroupPath, update, error)) {
+        std::cerr << "Update of " << record->id << " rejected: " << error << "\n";
+        return 1;
+    }
+    if (!store.recordUpdate(record->id, Cgroups::describeUpdate(update))) {
+        std::cerr << "Limits of " << record->id << " changed but not recorded\n";
+    }
+    std::cout << record->id << ": " << Cgroups::describeUpdate(update) << "\n";
+    return 0;
+}
+
 /**
  * @brief Main entry point.
  */
@@ -155,12 +687,100 @@ int main(int argc, char* argv[]) {
     bool enableAI = false;
     std::vector<std::string> command;
 
+    // Run by the kernel for each core dump, with the core on stdin; the
+    // executable name comes last and may contain spaces
+    if (argc >= 6 && std::string(argv[1]) == "core-collect") {
+        std::string exe = argv[5];
+        for (int i = 6; i < argc; ++i) {
+            exe += std::string(" ") + argv[i];
+        }
+        return CoreCollector::collect(argv[2], static_cast<pid_t>(std::atoi(argv[3])), std::atoi(argv[4]),
+                                      exe, STDIN_FILENO);
+    }
+
     // Parse command line arguments
     if (!parseArgs(argc, argv, configPath, sandboxName, enableAI, command)) {
         printUsage(argv[0]);
         return 1;
     }
 
+    if (command.empty()) {
+        std::cerr << "No command specified\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Split off the subcommand; a bare command means "run"
+    std::string subcommand = "run";
+    if (command[0] == "run" || command[0] == "list" || command[0] == "recover" ||
+        command[0] == "stop" || command[0] == "bench-run" || command[0] == "gc" ||
+        command[0] == "pack-image" || command[0] == "seal-image" || command[0] == "verify-image" ||
+        command[0] == "slim-image" || command[0] == "core-handler" || command[0] == "update") {
+        subcommand = command[0];
+        command.erase(command.begin());
+    }
+
+    bool fullVerify = false;
+    if (subcommand == "verify-image") {
+        auto it = std::find(command.begin(), command.end(), "--full");
+        if (it != command.end()) {
+            fullVerify = true;
+            command.erase(it);
+        }
+    }
+
+    // Options may also follow the subcommand
+    BenchOptions benchOptions;
+    ResourceUpdate resourceUpdate;
+    if (subcommand == "update") {
+        if (command.empty() || !parseUpdateArgs({command.begin() + 1, command.end()}, resourceUpdate)) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    } else if (subcommand == "bench-run") {
+        std::vector<std::string> args = command;
+        command.clear();
+        if (!parseBenchArgs(args, benchOptions, configPath, sandboxName, enableAI, command)) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    } else if (!command.empty() && command[0][0] == '-') {
+        std::vector<char*> rest{argv[0]};
+        for (auto& arg : command) {
+            rest.push_back(arg.data());
+        }
+        rest.push_back(nullptr);
+        std::vector<std::string> remaining;
+        if (!parseArgs(static_cast<int>(rest.size()) - 1, rest.data(), configPath, sandboxName,
+                       enableAI, remaining)) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        command = remaining;
+    }
+
+    if ((subcommand == "stop" || subcommand == "bench-run") && command.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (subcommand == "pack-image" && command.size() != 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (subcommand == "slim-image" && command.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if ((subcommand == "seal-image" || subcommand == "verify-image") && command.size() != 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (subcommand == "core-handler" &&
+        (command.size() != 1 || (command[0] != "install" && command[0] != "uninstall"))) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
     // Load configuration
     SandboxConfiguration config;
     if (!configPath.empty()) {
@@ -185,6 +805,12 @@ int main(int argc, char* argv[]) {
         config.ai_module.enabled = true;
     }
 
+    // A process group brings its own commands
+    if (subcommand == "run" && command.empty() && config.sandbox.processes.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
     // Initialize logger
     Logger::getInstance().initialize(
         stringToLogLevel(config.logging.level),
@@ -192,19 +818,93 @@ int main(int argc, char* argv[]) {
         config.logging.log_file
     );
 
+    // Before any thread is started, so that all of them inherit it
+    if (!Housekeeping::apply(config)) {
+        Logger::getInstance().shutdown();
+        return 1;
+    }
+
+    StateStore store(config.supervisor.state_dir);
+    if (subcommand == "list") {
+        return listSandboxes(store);
+    }
+    if (subcommand == "recover") {
+        return recoverSandboxes(store, config);
+    }
+    if (subcommand == "stop") {
+        return stopSandbox(store, command[0]);
+    }
+    if (subcommand == "update") {
+        return updateSandbox(store, command[0], resourceUpdate);
+    }
+    if (subcommand == "gc") {
+        return collectImages(store, config);
+    }
+    if (subcommand == "pack-image") {
+        return ImagePack::build(command[0], command[1]) ? 0 : 1;
+    }
+    if (subcommand == "seal-image") {
+        return sealImage(command[0], config);
+    }
+    if (subcommand == "verify-image") {
+        return verifyImage(command[0], fullVerify, config);
+    }
+    if (subcommand == "core-handler") {
+        bool ok = command[0] == "install" ? CoreCollector::install(config.cores.registry_dir)
+                                          : CoreCollector::uninstall(config.cores.registry_dir);
+        return ok ? 0 : 1;
+    }
+
+    // Clean up after sandboxes whose supervisor died
+    store.recover(false, config.supervisor.reap_parallelism);
+
+    if (subcommand == "slim-image") {
+        auto workload = command.begin() + 1;
+        if (workload != command.end() && *workload == "--") {
+            ++workload;
+        }
+        if (workload != command.end()) {
+            config.sandbox.command.assign(workload, command.end());
+        }
+        int exitCode = slimImage(command[0], config);
+        Logger::getInstance().shutdown();
+        return exitCode;
+    }
+
+    if (subcommand == "bench-run") {
+        config.sandbox.command = command;
+        int exitCode = benchRun(config, benchOptions);
+        Logger::getInstance().shutdown();
+        return exitCode;
+    }
+
     SANDBOX_INFO("Starting sandbox platform");
-    SANDBOX_INFO("Command: " + command[0]);
+    if (!command.empty()) {
+        SANDBOX_INFO("Command: " + command[0]);
+    }
 
     // Create sandbox manager
     SandboxManager manager;
     manager.setConfig(config);
 
+    // Collect unused images while the sandbox runs; started after the
+    // fork, since the collector logs
+    std::atomic<bool> stopCollection{false};
+    std::thread collector;
+    manager.setChildStartedHook([&collector, images = config.images, &store, &stopCollection]() {
+        collector = std::thread([images, &store, &stopCollection]() {
+            ImageStore(images).collectInBackground(store, stopCollection);
+        });
+    });
+
     // Register default modules
     registerDefaultModules(manager);
 
-    // Update command in config
-    config.sandbox.command = command;
-    manager.setConfig(config);
+    // Update command in config; a process group may run without one
+    if (!command.empty()) {
+        config.sandbox.command = command;
+        manager.setConfig(config);
+    }
 
     // Run the sandbox
     SandboxResult result = manager.run();
@@ -220,6 +920,14 @@ int main(int argc, char* argv[]) {
     if (!result.stdout.empty()) {
         std::cout << result.stdout;
     }
+    if (!result.stderr.empty()) {
+        std::cerr << result.stderr;
+    }
+
+    stopCollection = true;
+    if (collector.joinable()) {
+        collector.join();
+    }
 
     // Shutdown logger
     Logger::getInstance().shutdown();
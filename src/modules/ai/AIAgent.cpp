@@ -4,8 +4,10 @@
  */
 
 #include "modules/ai/AIAgent.h"
+#include "modules/ai/PromptBudget.h"
 #include "core/Logger.h"
 #include "nlohmann/json.hpp"
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <sstream>
@@ -14,9 +16,21 @@ using json = nlohmann::json;
 
 namespace sandbox {
 
+namespace {
+
+/// One request to one endpoint
+struct Transfer {
+    CURL* handle;
+    size_t endpoint;
+    std::string body;
+    EndpointPool::Clock::time_point started;
+};
+
+} // namespace
+
 AIAgent::AIAgent()
     : state_(ModuleState::UNINITIALIZED)
-    , curlHandle_(nullptr)
+    , multiHandle_(nullptr)
 {
 }
 
@@ -46,8 +60,20 @@ bool AIAgent::initialize(const SandboxConfiguration& config) {
         return true;
     }
 
+    // Earlier diagnoses answer near-duplicate failures without a request
+    if (!config.ai_module.failure_index_dir.empty()) {
+        failureIndex_ = std::make_unique<FailureIndex>(config.ai_module.failure_index_dir);
+        failureIndex_->load();
+    }
+
     // Get configuration
-    baseUrl_ = config.ai_module.base_url;
+    std::vector<std::string> urls = config.ai_module.endpoints;
+    if (urls.empty()) {
+        urls.push_back(config.ai_module.base_url);
+    }
+    pool_ = std::make_unique<EndpointPool>(urls, config.ai_module.breaker_failures,
+                                           std::chrono::milliseconds(config.ai_module.breaker_cooldown_ms),
+                                           std::chrono::milliseconds(config.ai_module.hedge_after_ms));
     model_ = config.ai_module.model;
     systemPrompt_ = config.ai_module.system_prompt;
     apiKey_ = getApiKey();
@@ -67,7 +93,9 @@ bool AIAgent::initialize(const SandboxConfiguration& config) {
     state_ = ModuleState::INITIALIZED;
     SANDBOX_INFO("AI Agent module initialized successfully");
     SANDBOX_DEBUG("Using model: " + model_);
-    SANDBOX_DEBUG("API endpoint: " + baseUrl_);
+    for (const auto& url : urls) {
+        SANDBOX_DEBUG("API endpoint: " + url);
+    }
 
     return true;
 }
@@ -114,6 +142,7 @@ AIResponse AIAgent::sendPrompt(const AIPrompt& prompt) {
     AIResponse response;
     response.success = false;
     response.statusCode = 0;
+    response.cached = false;
 
     if (!isEnabled()) {
         response.errorMessage = "AI module is not enabled or API key not configured";
@@ -128,63 +157,178 @@ AIResponse AIAgent::sendPrompt(const AIPrompt& prompt) {
     headers = curl_slist_append(headers, "Content-Type: application/json");
     headers = curl_slist_append(headers, ("Authorization: Bearer " + apiKey_).c_str());
 
-    curl_easy_setopt(curlHandle_, CURLOPT_URL, (baseUrl_ + "/chat/completions").c_str());
-    curl_easy_setopt(curlHandle_, CURLOPT_POST, 1);
-    curl_easy_setopt(curlHandle_, CURLOPT_POSTFIELDS, payload.c_str());
-    curl_easy_setopt(curlHandle_, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curlHandle_, CURLOPT_WRITEFUNCTION, writeCallback);
-    curl_easy_setopt(curlHandle_, CURLOPT_WRITEDATA, this);
-    curl_easy_setopt(curlHandle_, CURLOPT_TIMEOUT, 30);
-
-    responseBuffer_.clear();
-
-    // Execute request
-    CURLcode res = curl_easy_perform(curlHandle_);
-
-    if (res != CURLE_OK) {
-        response.errorMessage = curl_easy_strerror(res);
-        response.statusCode = -1;
-        SANDBOX_ERROR("AI API request failed: " + response.errorMessage);
-    } else {
-        long httpCode = 0;
-        curl_easy_getinfo(curlHandle_, CURLINFO_RESPONSE_CODE, &httpCode);
-        response.statusCode = static_cast<int>(httpCode);
+    using Clock = EndpointPool::Clock;
+    std::vector<size_t> order = pool_->route(Clock::now());
+    size_t next = 0;
+    std::vector<std::unique_ptr<Transfer>> active;
+    Clock::time_point hedgeAt = Clock::time_point::max();
+
+    // Start a request on the next endpoint in the route; a handle that
+    // cannot be created is no fault of the endpoint, so move on
+    auto launch = [&]() {
+        hedgeAt = Clock::time_point::max();
+        auto transfer = std::make_unique<Transfer>();
+        while (next < order.size() && !transfer->handle) {
+            transfer->endpoint = order[next++];
+            transfer->handle = curl_easy_init();
+        }
+        transfer->started = Clock::now();
+        if (!transfer->handle) {
+            response.errorMessage = "Failed to create cURL handle";
+            return;
+        }
+        CURL* handle = transfer->handle;
+        curl_easy_setopt(handle, CURLOPT_URL, (pool_->url(transfer->endpoint) + "/chat/completions").c_str());
+        curl_easy_setopt(handle, CURLOPT_POST, 1);
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDS, payload.c_str());
+        curl_easy_setopt(handle, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, writeCallback);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, &transfer->body);
+        curl_easy_setopt(handle, CURLOPT_PRIVATE, transfer.get());
+        curl_easy_setopt(handle, CURLOPT_TIMEOUT, 30);
+        curl_multi_add_handle(multiHandle_, handle);
+
+        if (config_.ai_module.hedge_after_ms > 0 && next < order.size()) {
+            hedgeAt = transfer->started + pool_->hedgeDelay(transfer->endpoint);
+        }
+        active.push_back(std::move(transfer));
+    };
+
+    auto finish = [&](Transfer* transfer) {
+        curl_multi_remove_handle(multiHandle_, transfer->handle);
+        curl_easy_cleanup(transfer->handle);
+        active.erase(std::find_if(active.begin(), active.end(),
+                                  [transfer](const auto& t) { return t.get() == transfer; }));
+    };
+
+    bool answered = false;
+    launch();
+    while (!active.empty() && !answered) {
+        int running = 0;
+        curl_multi_perform(multiHandle_, &running);
+
+        CURLMsg* msg;
+        int queued = 0;
+        while (!answered && (msg = curl_multi_info_read(multiHandle_, &queued))) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            char* priv = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &priv);
+            Transfer* transfer = reinterpret_cast<Transfer*>(priv);
+            CURLcode res = msg->data.result;
+            long httpCode = 0;
+            curl_easy_getinfo(transfer->handle, CURLINFO_RESPONSE_CODE, &httpCode);
+            Clock::time_point now = Clock::now();
+
+            if (res == CURLE_OK && httpCode == 200) {
+                pool_->recordSuccess(transfer->endpoint,
+                                     std::chrono::duration_cast<std::chrono::milliseconds>(now - transfer->started));
+                response = parseResponse(transfer->body);
+                answered = true;
+            } else if (res == CURLE_OK && httpCode != 429 && httpCode < 500) {
+                // The endpoint rejected the request itself; another endpoint would too
+                pool_->recordSuccess(transfer->endpoint,
+                                     std::chrono::duration_cast<std::chrono::milliseconds>(now - transfer->started));
+                response.statusCode = static_cast<int>(httpCode);
+                response.errorMessage = "HTTP " + std::to_string(httpCode);
+                answered = true;
+            } else {
+                response.statusCode = res == CURLE_OK ? static_cast<int>(httpCode) : -1;
+                response.errorMessage = res == CURLE_OK ? "HTTP " + std::to_string(httpCode)
+                                                        : std::string(curl_easy_strerror(res));
+                SANDBOX_WARNING("AI API request to " + pool_->url(transfer->endpoint) +
+                                " failed: " + response.errorMessage);
+                pool_->recordFailure(transfer->endpoint, now);
+            }
+            finish(transfer);
+
+            // Fail over at once unless a hedge is still on its way
+            if (!answered && active.empty() && next < order.size()) {
+                launch();
+            }
+        }
+        if (answered || active.empty()) {
+            break;
+        }
 
-        if (httpCode == 200) {
-            response = parseResponse(responseBuffer_);
-        } else {
-            response.errorMessage = "HTTP " + std::to_string(httpCode);
-            response.success = false;
+        if (Clock::now() >= hedgeAt) {
+            SANDBOX_DEBUG("AI API request slower than expected, hedging to " + pool_->url(order[next]));
+            launch();
         }
+        long waitMs = 1000;
+        if (hedgeAt != Clock::time_point::max()) {
+            waitMs = std::clamp<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                          hedgeAt - Clock::now()).count(), 0, 1000);
+        }
+        curl_multi_poll(multiHandle_, nullptr, 0, static_cast<int>(waitMs), nullptr);
     }
 
+    // Cancel the losers; the time they ran is a lower bound of their latency
+    while (!active.empty()) {
+        Transfer* loser = active.back().get();
+        pool_->recordCancelled(loser->endpoint, std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                    Clock::now() - loser->started));
+        finish(loser);
+    }
     curl_slist_free_all(headers);
 
+    if (!answered) {
+        SANDBOX_ERROR("AI API request failed: " + response.errorMessage);
+    }
+
     return response;
 }
 
 AIResponse AIAgent::analyzeError(const std::string& errorMessage,
                                  const std::vector<std::string>& context) {
+    // Fingerprinted only with an index, and only as much as it reads
+    uint64_t fingerprint = 0;
+    if (failureIndex_) {
+        std::string failure = errorMessage.substr(0, FailureIndex::kMaxTextBytes);
+        for (auto c = context.begin(); c != context.end() && failure.size() < FailureIndex::kMaxTextBytes; ++c) {
+            failure += "\n" + c->substr(0, FailureIndex::kMaxTextBytes - failure.size());
+        }
+        fingerprint = FailureIndex::fingerprint(failure);
+        if (auto diagnosis = failureIndex_->lookup(fingerprint, config_.ai_module.failure_match_bits)) {
+            SANDBOX_DEBUG("Reusing the diagnosis of a similar failure");
+            return AIResponse{*diagnosis, 200, "", true, true};
+        }
+    }
+
     AIPrompt prompt;
     prompt.systemPrompt = systemPrompt_;
     prompt.temperature = config_.ai_module.temperature;
     prompt.maxTokens = config_.ai_module.max_tokens;
 
+    const std::string intro = "Analyze the following sandbox error and suggest a solution:\n\n";
+    const std::string outro = "\nProvide a brief explanation of the error and how to resolve it.";
+
+    // The error may take half of what is left, the context the rest
+    int available = PromptBudget::budgetFor(config_.ai_module) -
+                    PromptBudget::estimateTokens(prompt.systemPrompt + intro + outro);
+    std::string error = PromptBudget::fit(errorMessage, available / 2);
+    available -= PromptBudget::estimateTokens(error);
+
     std::stringstream ss;
-    ss << "Analyze the following sandbox error and suggest a solution:\n\n";
-    ss << "Error: " << errorMessage << "\n\n";
+    ss << intro;
+    ss << "Error: " << error << "\n\n";
 
     if (!context.empty()) {
         ss << "Context:\n";
-        for (const auto& c : context) {
+        for (const auto& c : PromptBudget::fitLines(context, available)) {
             ss << "- " << c << "\n";
         }
     }
 
-    ss << "\nProvide a brief explanation of the error and how to resolve it.";
+    ss << outro;
     prompt.userPrompt = ss.str();
 
-    return sendPrompt(prompt);
+    AIResponse response = sendPrompt(prompt);
+    if (response.success && failureIndex_) {
+        failureIndex_->add(fingerprint, response.content);
+    }
+    return response;
 }
 
 AIResponse AIAgent::generateSeccompPolicy(const std::string& command) {
@@ -233,14 +377,15 @@ AIResponse AIAgent::optimizeConfiguration(const SandboxConfiguration& currentCon
 }
 
 bool AIAgent::initCurl() {
-    curlHandle_ = curl_easy_init();
-    return curlHandle_ != nullptr;
+    // Requests to all endpoints share the connection cache of one multi handle
+    multiHandle_ = curl_multi_init();
+    return multiHandle_ != nullptr;
 }
 
 void AIAgent::cleanupCurl() {
-    if (curlHandle_) {
-        curl_easy_cleanup(curlHandle_);
-        curlHandle_ = nullptr;
+    if (multiHandle_) {
+        curl_multi_cleanup(multiHandle_);
+        multiHandle_ = nullptr;
     }
 }
 
@@ -276,7 +421,16 @@ std::string AIAgent::buildPayload(const AIPrompt& prompt) {
         }
     }
 
-    userMessage["content"] = content.str();
+    // Whatever the caller built, never send more than the model takes
+    int budget = PromptBudget::budgetFor(config_.ai_module) -
+                 PromptBudget::estimateTokens(prompt.systemPrompt);
+    std::string text = content.str();
+    if (PromptBudget::estimateTokens(text) > budget) {
+        SANDBOX_DEBUG("Prompt over budget, shrinking it to " + std::to_string(budget) + " tokens");
+        text = PromptBudget::fit(text, budget);
+    }
+
+    userMessage["content"] = text;
     messages.push_back(userMessage);
 
     payload["messages"] = messages;
@@ -284,13 +438,15 @@ std::string AIAgent::buildPayload(const AIPrompt& prompt) {
     payload["temperature"] = prompt.temperature;
     payload["max_tokens"] = prompt.maxTokens;
 
-    return payload.dump();
+    // Program output need not be valid UTF-8
+    return payload.dump(-1, ' ', false, json::error_handler_t::replace);
 }
 
 AIResponse AIAgent::parseResponse(const std::string& response) {
     AIResponse result;
     result.success = false;
     result.statusCode = 200;
+    result.cached = false;
 
     try {
         json resp = json::parse(response);
@@ -314,10 +470,10 @@ AIResponse AIAgent::parseResponse(const std::string& response) {
 }
 
 size_t AIAgent::writeCallback(char* contents, size_t size, size_t nmemb, void* userp) {
-    AIAgent* agent = static_cast<AIAgent*>(userp);
+    std::string* body = static_cast<std::string*>(userp);
     size_t totalSize = size * nmemb;
 
-    agent->responseBuffer_.append(contents, totalSize);
+    body->append(contents, totalSize);
     return totalSize;
 }
 
@@ -12,6 +12,9 @@
 
 #include "modules/interface/IModule.h"
 #include "core/ConfigParser.h"
+#include "modules/ai/EndpointPool.h"
+#include "modules/ai/FailureIndex.h"
+#include <memory>
 #include <string>
 #include <vector>
 #include <curl/curl.h>
@@ -27,6 +30,7 @@ struct AIResponse {
     int statusCode;
     std::string errorMessage;
     bool success;
+    bool cached;                   ///< Diagnosis of a similar earlier failure, no request made
 };
 
 /**
@@ -78,6 +82,12 @@ public:
 
     /**
      * @brief Send a prompt to the AI API.
+     *
+     * The request goes to the best endpoint of the pool. A failed request
+     * moves on to the next endpoint at once; a request slower than its
+     * endpoint's p95 latency gets a duplicate on the next endpoint, and
+     * whichever answers first wins while the other is cancelled.
+     *
      * @param prompt The prompt to send.
      * @return AIResponse from the API.
      */
@@ -85,6 +95,10 @@ public:
 
     /**
      * @brief Analyze an error message and suggest a fix.
+     *
+     * An error similar enough to one analyzed before gets the earlier
+     * diagnosis from the failure index instead of a new request.
+     *
      * @param errorMessage The error to analyze.
      * @param context Additional context information.
      * @return AIResponse with suggestions.
@@ -110,13 +124,13 @@ public:
 
 private:
     /**
-     * @brief Initialize cURL handle.
+     * @brief Initialize the cURL multi handle.
      * @return true if successful.
      */
     bool initCurl();
 
     /**
-     * @brief Cleanup cURL handle.
+     * @brief Cleanup the cURL multi handle.
      */
     void cleanupCurl();
 
@@ -145,19 +159,19 @@ private:
      * @param contents Data received.
      * @param size Element size.
      * @param nmemb Number of elements.
-     * @param userp User pointer.
+     * @param userp The std::string receiving the body.
      * @return Bytes processed.
      */
     static size_t writeCallback(char* contents, size_t size, size_t nmemb, void* userp);
 
     ModuleState state_;
     SandboxConfiguration config_;
-    CURL* curlHandle_;
+    CURLM* multiHandle_;
     std::string apiKey_;
-    std::string baseUrl_;
     std::string model_;
     std::string systemPrompt_;
-    std::string responseBuffer_;
+    std::unique_ptr<EndpointPool> pool_;
+    std::unique_ptr<FailureIndex> failureIndex_;
 };
 
 } // namespace sandbox
@@ -0,0 +1,101 @@
+/**
+ * @file EndpointPool.cpp
+ * @brief Implementation of the EndpointPool class.
+ */
+
+#include "modules/ai/EndpointPool.h"
+#include "core/Logger.h"
+#include <algorithm>
+
+namespace sandbox {
+
+EndpointPool::EndpointPool(const std::vector<std::string>& urls, int failureThreshold,
+                           std::chrono::milliseconds cooldown, std::chrono::milliseconds initialHedgeDelay)
+    : failureThreshold_(std::max(failureThreshold, 1))
+    , cooldown_(cooldown)
+    , initialHedgeDelay_(initialHedgeDelay)
+{
+    for (const auto& url : urls) {
+        endpoints_.push_back({url, {}, 0, Clock::time_point{}});
+    }
+}
+
+std::vector<size_t> EndpointPool::route(Clock::time_point now) const {
+    std::vector<size_t> order;
+    for (size_t i = 0; i < endpoints_.size(); ++i) {
+        if (!isOpen(i, now)) {
+            order.push_back(i);
+        }
+    }
+    if (order.empty()) {
+        for (size_t i = 0; i < endpoints_.size(); ++i) {
+            order.push_back(i);
+        }
+        return order;
+    }
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return percentile(endpoints_[a], 50) < percentile(endpoints_[b], 50);
+    });
+    return order;
+}
+
+std::chrono::milliseconds EndpointPool::hedgeDelay(size_t endpoint) const {
+    const Endpoint& e = endpoints_[endpoint];
+    if (e.latenciesMs.size() < kMinSamples) {
+        return initialHedgeDelay_;
+    }
+    return std::chrono::milliseconds(percentile(e, 95));
+}
+
+void EndpointPool::recordSuccess(size_t endpoint, std::chrono::milliseconds latency) {
+    recordCancelled(endpoint, latency);
+    Endpoint& e = endpoints_[endpoint];
+    if (e.failures >= failureThreshold_) {
+        SANDBOX_INFO("AI endpoint " + e.url + " recovered");
+    }
+    e.failures = 0;
+}
+
+void EndpointPool::recordCancelled(size_t endpoint, std::chrono::milliseconds elapsed) {
+    Endpoint& e = endpoints_[endpoint];
+    e.latenciesMs.push_back(static_cast<long>(elapsed.count()));
+    if (e.latenciesMs.size() > kMaxSamples) {
+        e.latenciesMs.pop_front();
+    }
+}
+
+void EndpointPool::recordFailure(size_t endpoint, Clock::time_point now) {
+    Endpoint& e = endpoints_[endpoint];
+    // A failed retry after the cooldown opens the breaker again
+    if (++e.failures >= failureThreshold_) {
+        e.openUntil = now + cooldown_;
+        SANDBOX_WARNING("AI endpoint " + e.url + " failed " + std::to_string(e.failures) +
+                        " times in a row, skipping it for " + std::to_string(cooldown_.count()) + " ms");
+    }
+}
+
+bool EndpointPool::isOpen(size_t endpoint, Clock::time_point now) const {
+    const Endpoint& e = endpoints_[endpoint];
+    return e.failures >= failureThreshold_ && now < e.openUntil;
+}
+
+const std::string& EndpointPool::url(size_t endpoint) const {
+    return endpoints_[endpoint].url;
+}
+
+size_t EndpointPool::size() const {
+    return endpoints_.size();
+}
+
+long EndpointPool::percentile(const Endpoint& endpoint, int percentile) const {
+    if (endpoint.latenciesMs.empty()) {
+        return 0;
+    }
+    // Nearest rank
+    std::vector<long> sorted(endpoint.latenciesMs.begin(), endpoint.latenciesMs.end());
+    std::sort(sorted.begin(), sorted.end());
+    size_t rank = (static_cast<size_t>(percentile) * sorted.size() + 99) / 100;
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+} // namespace sandbox
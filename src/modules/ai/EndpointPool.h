@@ -0,0 +1,133 @@
+/**
+ * @file EndpointPool.h
+ * @brief Routing and health tracking for AI endpoints.
+ *
+ * This header defines the EndpointPool class that orders the configured
+ * API endpoints by observed latency, decides when a slow request gets a
+ * hedged duplicate, and skips endpoints that keep failing.
+ */
+
+#ifndef SANDBOX_ENDPOINT_POOL_H
+#define SANDBOX_ENDPOINT_POOL_H
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace sandbox {
+
+/**
+ * @class EndpointPool
+ * @brief Latency-aware endpoint selection with circuit breaking.
+ *
+ * Endpoints are tried fastest first by median latency of their recent
+ * successes; an endpoint not measured yet counts as fastest so that it
+ * gets measured, and ties keep the configured order.
+ *
+ * After failureThreshold failures in a row an endpoint's breaker opens
+ * and route() skips it for the cooldown. Then one request may try it
+ * again: success closes the breaker, failure opens it for another
+ * cooldown. If every breaker is open, route() returns all endpoints in
+ * configured order rather than nothing.
+ */
+class EndpointPool {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Latencies kept per endpoint
+    static constexpr size_t kMaxSamples = 64;
+
+    /// Successes needed before the p95 replaces the initial hedge delay
+    static constexpr size_t kMinSamples = 8;
+
+    /**
+     * @brief Construct a pool.
+     * @param urls The endpoint base URLs, preferred first.
+     * @param failureThreshold Failures in a row that open a breaker.
+     * @param cooldown How long an open breaker skips its endpoint.
+     * @param initialHedgeDelay Hedge delay until an endpoint has kMinSamples.
+     */
+    EndpointPool(const std::vector<std::string>& urls, int failureThreshold,
+                 std::chrono::milliseconds cooldown, std::chrono::milliseconds initialHedgeDelay);
+
+    /**
+     * @brief Get the order to try endpoints in.
+     * @param now The current time.
+     * @return Endpoint indices, best first.
+     */
+    std::vector<size_t> route(Clock::time_point now) const;
+
+    /**
+     * @brief Get how long to wait for an endpoint before hedging.
+     * @param endpoint The endpoint index.
+     * @return The p95 latency of its recent successes.
+     */
+    std::chrono::milliseconds hedgeDelay(size_t endpoint) const;
+
+    /**
+     * @brief Record a successful request.
+     * @param endpoint The endpoint index.
+     * @param latency Time to the complete response.
+     */
+    void recordSuccess(size_t endpoint, std::chrono::milliseconds latency);
+
+    /**
+     * @brief Record a request cancelled because another endpoint answered first.
+     *
+     * The time it ran is a lower bound of its latency; it is kept as a
+     * sample so that a slow endpoint ranks by its slowness, but does
+     * not count as a success for the breaker.
+     *
+     * @param endpoint The endpoint index.
+     * @param elapsed Time the request ran before it was cancelled.
+     */
+    void recordCancelled(size_t endpoint, std::chrono::milliseconds elapsed);
+
+    /**
+     * @brief Record a failed request.
+     * @param endpoint The endpoint index.
+     * @param now The current time.
+     */
+    void recordFailure(size_t endpoint, Clock::time_point now);
+
+    /**
+     * @brief Check whether an endpoint's breaker is open.
+     * @param endpoint The endpoint index.
+     * @param now The current time.
+     * @return true if route() skips the endpoint.
+     */
+    bool isOpen(size_t endpoint, Clock::time_point now) const;
+
+    /**
+     * @brief Get an endpoint's base URL.
+     * @param endpoint The endpoint index.
+     * @return The URL.
+     */
+    const std::string& url(size_t endpoint) const;
+
+    /**
+     * @brief Get the number of endpoints.
+     * @return The endpoint count.
+     */
+    size_t size() const;
+
+private:
+    struct Endpoint {
+        std::string url;
+        std::deque<long> latenciesMs;
+        int failures;
+        Clock::time_point openUntil;
+    };
+
+    long percentile(const Endpoint& endpoint, int percentile) const;
+
+    std::vector<Endpoint> endpoints_;
+    int failureThreshold_;
+    std::chrono::milliseconds cooldown_;
+    std::chrono::milliseconds initialHedgeDelay_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_ENDPOINT_POOL_H
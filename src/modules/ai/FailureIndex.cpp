@@ -0,0 +1,248 @@
+/**
+ * @file FailureIndex.cpp
+ * @brief Implementation of the FailureIndex class.
+ */
+
+#include "modules/ai/FailureIndex.h"
+#include "core/Logger.h"
+#include "utils/Hash.h"
+#include "utils/Syscalls.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstdio>
+#include <sstream>
+#include <string_view>
+#include <sys/file.h>
+
+using json = nlohmann::json;
+
+namespace sandbox {
+
+namespace {
+
+std::vector<std::pair<uint64_t, std::string>> parseEntries(const std::string& content) {
+    std::vector<std::pair<uint64_t, std::string>> entries;
+    std::istringstream in(content);
+    std::string line;
+    while (std::getline(in, line)) {
+        json j = json::parse(line, nullptr, false);
+        if (j.is_discarded() || !j.is_object() || !j.contains("fingerprint") || !j.contains("diagnosis")) {
+            continue;
+        }
+        try {
+            entries.emplace_back(std::stoull(j["fingerprint"].get<std::string>(), nullptr, 16),
+                                 j["diagnosis"].get<std::string>());
+        } catch (const std::exception&) {
+            continue;
+        }
+    }
+    return entries;
+}
+
+} // namespace
+
+FailureIndex::FailureIndex(const std::string& dir)
+    : dir_(dir)
+    , path_(dir + "/diagnoses")
+{
+}
+
+std::string FailureIndex::normalize(const std::string& text) {
+    // A single linear pass; std::regex recurses per character and
+    // overflows the stack on long tokens
+    std::string normalized;
+    normalized.reserve(text.size());
+    auto lower = [&text](size_t i) { return static_cast<char>(std::tolower(static_cast<unsigned char>(text[i]))); };
+    auto isWord = [&lower](size_t i) { return std::isalnum(static_cast<unsigned char>(lower(i))) || lower(i) == '_'; };
+    auto isHex = [&lower](size_t i) { return std::isxdigit(static_cast<unsigned char>(lower(i))) != 0; };
+    auto isSegment = [&text](size_t i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        return !std::isspace(c) && std::string_view("/:'\"()[],").find(c) == std::string_view::npos;
+    };
+
+    for (size_t i = 0; i < text.size();) {
+        char c = lower(i);
+        char previous = normalized.empty() ? ' ' : normalized.back();
+
+        // Paths keep only their last component
+        if (c == '/' && (std::isspace(static_cast<unsigned char>(previous)) ||
+                         std::string_view("'\"(=").find(previous) != std::string_view::npos)) {
+            size_t j = i;
+            size_t last = i;
+            while (j + 1 < text.size() && text[j] == '/' && isSegment(j + 1)) {
+                last = j + 1;
+                for (j = last; j < text.size() && isSegment(j); ++j) {
+                }
+            }
+            if (j > i) {
+                normalized += "<path>/" + normalize(text.substr(last, j - last));
+                i = j;
+                continue;
+            }
+        }
+
+        if (c == '0' && i + 2 < text.size() && lower(i + 1) == 'x' && isHex(i + 2)) {
+            for (i += 2; i < text.size() && isHex(i); ++i) {
+            }
+            normalized += "<addr>";
+            continue;
+        }
+
+        if (isWord(i) && (i == 0 || !isWord(i - 1))) {
+            size_t j = i;
+            bool digit = false;
+            while (j < text.size() && isWord(j)) {
+                digit = digit || std::isdigit(static_cast<unsigned char>(text[j]));
+                ++j;
+            }
+            bool hex = j - i >= 8 && digit;
+            for (size_t k = i; hex && k < j; ++k) {
+                hex = isHex(k);
+            }
+            if (hex) {
+                normalized += "<hex>";
+                i = j;
+                continue;
+            }
+        }
+
+        if (std::isdigit(static_cast<unsigned char>(c))) {
+            while (i < text.size() && std::isdigit(static_cast<unsigned char>(text[i]))) {
+                ++i;
+            }
+            normalized += "<n>";
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            while (i < text.size() && std::isspace(static_cast<unsigned char>(text[i]))) {
+                ++i;
+            }
+            if (!normalized.empty()) {
+                normalized += ' ';
+            }
+        } else {
+            normalized += c;
+            ++i;
+        }
+    }
+
+    if (!normalized.empty() && normalized.back() == ' ') {
+        normalized.pop_back();
+    }
+    return normalized;
+}
+
+uint64_t FailureIndex::fingerprint(const std::string& text) {
+    std::istringstream words(normalize(text.substr(0, kMaxTextBytes)));
+    std::vector<std::string> features;
+    std::string previous;
+    std::string word;
+    while (words >> word) {
+        features.push_back(word);
+        if (!previous.empty()) {
+            // Word pairs keep some of the order
+            features.push_back(previous + " " + word);
+        }
+        previous = word;
+    }
+
+    int votes[64] = {};
+    for (const auto& feature : features) {
+        uint64_t hash = Xxh64::hash(feature.data(), feature.size());
+        for (int bit = 0; bit < 64; ++bit) {
+            votes[bit] += (hash >> bit) & 1 ? 1 : -1;
+        }
+    }
+
+    uint64_t result = 0;
+    for (int bit = 0; bit < 64; ++bit) {
+        if (votes[bit] > 0) {
+            result |= 1ULL << bit;
+        }
+    }
+    return result;
+}
+
+int FailureIndex::distance(uint64_t a, uint64_t b) {
+    return std::popcount(a ^ b);
+}
+
+bool FailureIndex::load() {
+    entries_.clear();
+    if (!Syscall::exists(path_)) {
+        return true;
+    }
+    auto content = Syscall::readFile(path_);
+    if (!content) {
+        SANDBOX_WARNING("Failed to read failure index " + path_);
+        return false;
+    }
+    for (auto& [fingerprint, diagnosis] : parseEntries(*content)) {
+        entries_.push_back({fingerprint, std::move(diagnosis)});
+    }
+    return true;
+}
+
+std::optional<std::string> FailureIndex::lookup(uint64_t fingerprint, int maxDistance) const {
+    const Entry* best = nullptr;
+    int bestDistance = maxDistance + 1;
+
+    // Newest first, so that a refreshed diagnosis wins a tie
+    for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+        int d = distance(fingerprint, it->fingerprint);
+        if (d < bestDistance) {
+            best = &*it;
+            bestDistance = d;
+        }
+    }
+    if (!best) {
+        return std::nullopt;
+    }
+    return best->diagnosis;
+}
+
+bool FailureIndex::add(uint64_t fingerprint, const std::string& diagnosis) {
+    if (!Syscall::mkdirRecursive(dir_, 0700)) {
+        SANDBOX_WARNING("Failed to create " + dir_);
+        return false;
+    }
+
+    // Other supervisors add concurrently
+    ScopedFd lock(open((path_ + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600));
+    if (!lock.isValid() || flock(lock.get(), LOCK_EX) < 0) {
+        SANDBOX_WARNING("Failed to lock failure index " + path_);
+        return false;
+    }
+
+    auto entries = parseEntries(Syscall::readFile(path_).value_or(""));
+    entries.emplace_back(fingerprint, diagnosis);
+    if (entries.size() > kMaxEntries) {
+        entries.erase(entries.begin(), entries.end() - kMaxEntries);
+    }
+
+    std::string content;
+    for (const auto& [entryFingerprint, entryDiagnosis] : entries) {
+        json j;
+        j["fingerprint"] = Xxh64::toHex(entryFingerprint);
+        j["diagnosis"] = entryDiagnosis;
+        content += j.dump(-1, ' ', false, json::error_handler_t::replace) + "\n";
+    }
+    std::string tmp = path_ + ".tmp";
+    if (!Syscall::writeFile(tmp, content) || rename(tmp.c_str(), path_.c_str()) < 0) {
+        SANDBOX_WARNING("Failed to write failure index " + path_);
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    entries_.clear();
+    for (auto& [entryFingerprint, entryDiagnosis] : entries) {
+        entries_.push_back({entryFingerprint, std::move(entryDiagnosis)});
+    }
+    return true;
+}
+
+size_t FailureIndex::size() const {
+    return entries_.size();
+}
+
+} // namespace sandbox
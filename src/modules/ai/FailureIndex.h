@@ -0,0 +1,112 @@
+/**
+ * @file FailureIndex.h
+ * @brief Local index of diagnosed failures.
+ *
+ * This header defines the FailureIndex class that remembers the
+ * diagnoses of earlier failures by a similarity fingerprint, so that a
+ * failure differing only in PIDs, timestamps, paths or addresses gets
+ * the earlier diagnosis without another AI request.
+ */
+
+#ifndef SANDBOX_FAILURE_INDEX_H
+#define SANDBOX_FAILURE_INDEX_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace sandbox {
+
+/**
+ * @class FailureIndex
+ * @brief Bounded store of diagnoses keyed by SimHash fingerprints.
+ *
+ * Failure text is normalized first: addresses, long hex strings,
+ * numbers and directory parts of paths become placeholders, and case
+ * and spacing are folded. The 64-bit SimHash of the normalized words
+ * and word pairs then changes in only a few bits when a few words
+ * change, so near-duplicates are found by Hamming distance.
+ *
+ * The index lives in `<dir>/diagnoses`, one JSON object per line,
+ * oldest first. Supervisors add to it under an flock and the oldest
+ * entries beyond kMaxEntries are dropped.
+ */
+class FailureIndex {
+public:
+    /// Diagnoses kept
+    static constexpr size_t kMaxEntries = 10000;
+
+    /// Leading bytes of failure text that are fingerprinted
+    static constexpr size_t kMaxTextBytes = 64 * 1024;
+
+    /**
+     * @brief Construct the index kept in a directory.
+     * @param dir The index directory.
+     */
+    explicit FailureIndex(const std::string& dir);
+
+    /**
+     * @brief Replace the parts of failure text that vary between runs.
+     * @param text The failure text.
+     * @return The normalized text.
+     */
+    static std::string normalize(const std::string& text);
+
+    /**
+     * @brief Compute the SimHash fingerprint of failure text.
+     * @param text The failure text; its first kMaxTextBytes are normalized.
+     * @return The fingerprint.
+     */
+    static uint64_t fingerprint(const std::string& text);
+
+    /**
+     * @brief Count the bits two fingerprints differ in.
+     * @param a A fingerprint.
+     * @param b Another fingerprint.
+     * @return The Hamming distance, 0 to 64.
+     */
+    static int distance(uint64_t a, uint64_t b);
+
+    /**
+     * @brief Read the stored diagnoses.
+     * @return true if the index was read or does not exist yet.
+     */
+    bool load();
+
+    /**
+     * @brief Find the diagnosis of the most similar earlier failure.
+     * @param fingerprint Fingerprint of the failure.
+     * @param maxDistance Bits the fingerprints may differ in.
+     * @return The diagnosis, nullopt if no failure is close enough.
+     */
+    std::optional<std::string> lookup(uint64_t fingerprint, int maxDistance) const;
+
+    /**
+     * @brief Store the diagnosis of a failure.
+     * @param fingerprint Fingerprint of the failure.
+     * @param diagnosis The diagnosis.
+     * @return true if successful.
+     */
+    bool add(uint64_t fingerprint, const std::string& diagnosis);
+
+    /**
+     * @brief Get the number of loaded diagnoses.
+     * @return The number of entries.
+     */
+    size_t size() const;
+
+private:
+    struct Entry {
+        uint64_t fingerprint;
+        std::string diagnosis;
+    };
+
+    std::string dir_;
+    std::string path_;
+    std::vector<Entry> entries_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_FAILURE_INDEX_H
@@ -0,0 +1,194 @@
+/**
+ * @file PromptBudget.cpp
+ * @brief Implementation of the PromptBudget class.
+ */
+
+#include "modules/ai/PromptBudget.h"
+#include <algorithm>
+#include <cctype>
+#include <regex>
+#include <sstream>
+
+namespace sandbox {
+
+namespace {
+
+/// Cut marker between the kept head and tail of a long line
+const char* const kLineCut = " [...] ";
+
+/// Lines worth keeping from the middle of long output
+bool looksLikeError(const std::string& line) {
+    static const std::regex pattern(
+        "error|fail|fatal|exception|panic|denied|killed|segmentation|traceback|abort|"
+        "out of memory|oom|assert|undefined reference|cannot|not found|timed? ?out",
+        std::regex::icase);
+    return std::regex_search(line, pattern);
+}
+
+/// Line with digit runs and hex after "0x" folded, so counters and addresses compare equal
+std::string shapeOf(const std::string& line) {
+    std::string shape;
+    shape.reserve(line.size());
+    for (size_t i = 0; i < line.size(); ++i) {
+        if (line.compare(i, 2, "0x") == 0) {
+            shape += "0x#";
+            i += 2;
+            while (i < line.size() && std::isxdigit(static_cast<unsigned char>(line[i]))) {
+                ++i;
+            }
+            --i;
+        } else if (std::isdigit(static_cast<unsigned char>(line[i]))) {
+            shape += '#';
+            while (i + 1 < line.size() && std::isdigit(static_cast<unsigned char>(line[i + 1]))) {
+                ++i;
+            }
+        } else {
+            shape += line[i];
+        }
+    }
+    return shape;
+}
+
+/// Byte inside a UTF-8 character, where a line must not be cut
+bool isContinuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+/// Tokens of a line including its newline
+int lineTokens(const std::string& line) {
+    return PromptBudget::estimateTokens(line) + 1;
+}
+
+std::string omitted(size_t lines) {
+    return "[... " + std::to_string(lines) + " lines omitted ...]";
+}
+
+} // namespace
+
+int PromptBudget::estimateTokens(const std::string& text) {
+    return static_cast<int>((text.size() + kBytesPerToken - 1) / kBytesPerToken);
+}
+
+int PromptBudget::budgetFor(const AIModuleConfig& config) {
+    int budget = config.context_window_tokens - config.max_tokens - kFramingTokens;
+    if (config.max_prompt_tokens > 0) {
+        budget = std::min(budget, config.max_prompt_tokens);
+    }
+    return std::max(budget, kMinTokens);
+}
+
+std::vector<std::string> PromptBudget::dedupe(const std::vector<std::string>& lines) {
+    std::vector<std::string> result;
+    size_t i = 0;
+    while (i < lines.size()) {
+        std::string shape = shapeOf(lines[i]);
+        size_t j = i + 1;
+        while (j < lines.size() && shapeOf(lines[j]) == shape) {
+            ++j;
+        }
+        result.push_back(j - i > 1 ? lines[i] + " [repeated " + std::to_string(j - i) + " times]"
+                                   : lines[i]);
+        i = j;
+    }
+    return result;
+}
+
+std::vector<std::string> PromptBudget::fitLines(const std::vector<std::string>& input, int maxTokens) {
+    std::vector<std::string> lines = dedupe(input);
+    auto total = [&lines]() {
+        int tokens = 0;
+        for (const auto& line : lines) {
+            tokens += lineTokens(line);
+        }
+        return tokens;
+    };
+    if (total() <= maxTokens) {
+        return lines;
+    }
+
+    // No single line may take more than an eighth of the budget
+    size_t maxLineBytes = static_cast<size_t>(std::max(maxTokens / 8, 16)) * kBytesPerToken;
+    for (auto& line : lines) {
+        if (line.size() > maxLineBytes) {
+            size_t keep = (maxLineBytes - std::string(kLineCut).size()) / 2;
+            size_t headEnd = keep;
+            size_t tailStart = line.size() - keep;
+            while (headEnd > 0 && isContinuation(line[headEnd])) {
+                --headEnd;
+            }
+            while (tailStart < line.size() && isContinuation(line[tailStart])) {
+                ++tailStart;
+            }
+            line = line.substr(0, headEnd) + kLineCut + line.substr(tailStart);
+        }
+    }
+    if (total() <= maxTokens) {
+        return lines;
+    }
+
+    // A quarter for the head, where the failure usually starts, half for
+    // the tail, where it ends, and the rest for error lines in between
+    int markerTokens = lineTokens(omitted(lines.size()));
+    size_t head = 0;
+    int headTokens = 0;
+    while (head < lines.size() && headTokens + lineTokens(lines[head]) <= maxTokens / 4) {
+        headTokens += lineTokens(lines[head++]);
+    }
+    size_t tail = lines.size();
+    int tailTokens = 0;
+    while (tail > head && tailTokens + lineTokens(lines[tail - 1]) <= maxTokens / 2) {
+        tailTokens += lineTokens(lines[--tail]);
+    }
+
+    int left = maxTokens - headTokens - tailTokens - markerTokens;
+    std::vector<bool> keep(lines.size(), false);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        keep[i] = i < head || i >= tail;
+    }
+    for (size_t i = head; i < tail; ++i) {
+        int cost = lineTokens(lines[i]) + markerTokens;
+        if (cost <= left && looksLikeError(lines[i])) {
+            keep[i] = true;
+            left -= cost;
+        }
+    }
+
+    std::vector<std::string> fitted;
+    size_t skipped = 0;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (!keep[i]) {
+            ++skipped;
+            continue;
+        }
+        if (skipped > 0) {
+            fitted.push_back(omitted(skipped));
+            skipped = 0;
+        }
+        fitted.push_back(lines[i]);
+    }
+    if (skipped > 0) {
+        fitted.push_back(omitted(skipped));
+    }
+    return fitted;
+}
+
+std::string PromptBudget::fit(const std::string& text, int maxTokens) {
+    if (estimateTokens(text) <= maxTokens) {
+        return text;
+    }
+
+    std::vector<std::string> lines;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        lines.push_back(line);
+    }
+
+    std::string fitted;
+    for (const auto& kept : fitLines(lines, maxTokens)) {
+        fitted += (fitted.empty() ? "" : "\n") + kept;
+    }
+    return fitted;
+}
+
+} // namespace sandbox
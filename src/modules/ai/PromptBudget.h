@@ -0,0 +1,89 @@
+/**
+ * @file PromptBudget.h
+ * @brief Size control for AI prompts.
+ *
+ * This header defines the PromptBudget class that estimates the tokens
+ * of prompt text and shrinks error output and context to a budget
+ * derived from the model's context window and the reply size.
+ */
+
+#ifndef SANDBOX_PROMPT_BUDGET_H
+#define SANDBOX_PROMPT_BUDGET_H
+
+#include "core/ConfigParser.h"
+#include <string>
+#include <vector>
+
+namespace sandbox {
+
+/**
+ * @class PromptBudget
+ * @brief Fits prompt text into a token budget.
+ *
+ * Tokens are estimated from the byte count, erring on the high side so
+ * that an estimate within the budget is within the model limit too.
+ * Text over budget is shrunk in steps:
+ *
+ * 1. Repeated lines are collapsed: a run of lines that differ only in
+ *    numbers or addresses becomes its first line with a repeat count.
+ * 2. The first lines and the last lines are kept, plus the lines in
+ *    between that look like errors, and a marker says how many lines
+ *    were left out.
+ * 3. Lines still too long are cut in the middle.
+ */
+class PromptBudget {
+public:
+    /// Bytes per token assumed by estimates; real text averages more
+    static constexpr int kBytesPerToken = 3;
+
+    /// Tokens kept free for message framing in the request
+    static constexpr int kFramingTokens = 64;
+
+    /// Smallest budget handed out, whatever the configuration says
+    static constexpr int kMinTokens = 256;
+
+    /**
+     * @brief Estimate the tokens of text.
+     * @param text The text.
+     * @return The estimated token count.
+     */
+    static int estimateTokens(const std::string& text);
+
+    /**
+     * @brief Compute the prompt budget of a configuration.
+     *
+     * The context window less the reply (max_tokens) and framing,
+     * capped by max_prompt_tokens when that is set.
+     *
+     * @param config The AI module configuration.
+     * @return Tokens the system and user messages may take together.
+     */
+    static int budgetFor(const AIModuleConfig& config);
+
+    /**
+     * @brief Collapse repeated lines.
+     * @param lines The lines.
+     * @return The lines without repeats, runs annotated with their count.
+     */
+    static std::vector<std::string> dedupe(const std::vector<std::string>& lines);
+
+    /**
+     * @brief Shrink lines to a budget.
+     * @param lines The lines, oldest first.
+     * @param maxTokens The budget.
+     * @return The lines that fit, in their original order.
+     */
+    static std::vector<std::string> fitLines(const std::vector<std::string>& lines, int maxTokens);
+
+    /**
+     * @brief Shrink text to a budget.
+     * @param text The text.
+     * @param maxTokens The budget.
+     * @return The text unchanged if it fits, otherwise its fitted lines.
+     */
+    static std::string fit(const std::string& text, int maxTokens);
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_PROMPT_BUDGET_H
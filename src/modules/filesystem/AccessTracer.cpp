@@ -0,0 +1,160 @@
+/**
+ * @file AccessTracer.cpp
+ * @brief Implementation of the AccessTracer class.
+ */
+
+#include "modules/filesystem/AccessTracer.h"
+#include "core/Logger.h"
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/fanotify.h>
+
+namespace sandbox {
+
+AccessTracer::AccessTracer()
+    : fanFd_(-1)
+    , mountFd_(-1)
+    , stopFd_(-1)
+    , overflowed_(false)
+{
+}
+
+AccessTracer::~AccessTracer() {
+    stop();
+}
+
+bool AccessTracer::start(const std::string& rootPath) {
+    char resolved[PATH_MAX];
+    if (!realpath(rootPath.c_str(), resolved)) {
+        SANDBOX_ERROR("Cannot trace " + rootPath + ": " + std::string(strerror(errno)));
+        return false;
+    }
+    rootPath_ = resolved;
+
+    fanFd_ = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_FID |
+                           FAN_UNLIMITED_QUEUE, O_RDONLY | O_LARGEFILE);
+    if (fanFd_ < 0) {
+        SANDBOX_ERROR("fanotify unavailable: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    mountFd_ = open(rootPath_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    stopFd_ = eventfd(0, EFD_CLOEXEC);
+    if (mountFd_ < 0 || stopFd_ < 0 ||
+        fanotify_mark(fanFd_, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, FAN_OPEN, AT_FDCWD,
+                      rootPath_.c_str()) < 0) {
+        SANDBOX_ERROR("Failed to watch " + rootPath_ + ": " + std::string(strerror(errno)));
+        stop();
+        return false;
+    }
+
+    reader_ = std::thread(&AccessTracer::run, this);
+    SANDBOX_DEBUG("Tracing file access in " + rootPath_);
+    return true;
+}
+
+void AccessTracer::stop() {
+    if (reader_.joinable()) {
+        uint64_t one = 1;
+        if (write(stopFd_, &one, sizeof(one)) < 0) {
+            SANDBOX_WARNING("Failed to signal the access tracer");
+        }
+        reader_.join();
+    }
+    for (int* fd : {&fanFd_, &mountFd_, &stopFd_}) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+std::set<std::string> AccessTracer::files() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return files_;
+}
+
+bool AccessTracer::complete() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !overflowed_;
+}
+
+void AccessTracer::run() {
+    struct pollfd fds[2] = {{fanFd_, POLLIN, 0}, {stopFd_, POLLIN, 0}};
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        drain();
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+    }
+}
+
+void AccessTracer::drain() {
+    alignas(struct fanotify_event_metadata) char buffer[65536];
+    for (;;) {
+        ssize_t len = read(fanFd_, buffer, sizeof(buffer));
+        if (len <= 0) {
+            return;
+        }
+
+        for (auto* event = reinterpret_cast<struct fanotify_event_metadata*>(buffer);
+             FAN_EVENT_OK(event, len); event = FAN_EVENT_NEXT(event, len)) {
+            if (event->mask & FAN_Q_OVERFLOW) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                overflowed_ = true;
+                continue;
+            }
+            if (event->event_len < event->metadata_len + sizeof(struct fanotify_event_info_fid)) {
+                continue;
+            }
+
+            auto* info = reinterpret_cast<struct fanotify_event_info_fid*>(
+                reinterpret_cast<char*>(event) + event->metadata_len);
+            if (info->hdr.info_type != FAN_EVENT_INFO_TYPE_FID) {
+                continue;
+            }
+            auto* handle = reinterpret_cast<struct file_handle*>(info->handle);
+
+            // Each file is resolved once, however often it is opened
+            std::string key(reinterpret_cast<const char*>(handle),
+                            sizeof(struct file_handle) + handle->handle_bytes);
+            if (!seenHandles_.insert(key).second) {
+                continue;
+            }
+
+            int fd = open_by_handle_at(mountFd_, handle, O_PATH | O_CLOEXEC);
+            if (fd < 0) {
+                continue;
+            }
+            char path[PATH_MAX];
+            ssize_t pathLen = readlink(("/proc/self/fd/" + std::to_string(fd)).c_str(), path, sizeof(path) - 1);
+            close(fd);
+            if (pathLen <= 0) {
+                continue;
+            }
+            path[pathLen] = '\0';
+
+            std::string file = path;
+            if (file.size() > 10 && file.compare(file.size() - 10, 10, " (deleted)") == 0) {
+                continue;
+            }
+            if (file.size() > rootPath_.size() + 1 && file.compare(0, rootPath_.size(), rootPath_) == 0 &&
+                file[rootPath_.size()] == '/') {
+                std::lock_guard<std::mutex> lock(mutex_);
+                files_.insert(file.substr(rootPath_.size() + 1));
+            }
+        }
+    }
+}
+
+} // namespace sandbox
@@ -0,0 +1,85 @@
+/**
+ * @file AccessTracer.h
+ * @brief Records the files opened within a rootfs.
+ *
+ * This header defines the AccessTracer class that watches a rootfs with
+ * fanotify and collects the paths of every file opened in it.
+ */
+
+#ifndef SANDBOX_ACCESS_TRACER_H
+#define SANDBOX_ACCESS_TRACER_H
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+namespace sandbox {
+
+/**
+ * @class AccessTracer
+ * @brief Traces file opens on the filesystem holding a rootfs.
+ *
+ * The filesystem is marked as a whole, so opens are seen through any
+ * mount of it, including the sandbox's own bind mount in its mount
+ * namespace. Events identify files by handle, which is resolved
+ * against the rootfs; files outside the rootfs are ignored.
+ *
+ * Requires CAP_SYS_ADMIN and a kernel reporting file handles
+ * (Linux 5.1 or later).
+ */
+class AccessTracer {
+public:
+    AccessTracer();
+
+    /**
+     * @brief Destructor. Stops tracing if still running.
+     */
+    ~AccessTracer();
+
+    AccessTracer(const AccessTracer&) = delete;
+    AccessTracer& operator=(const AccessTracer&) = delete;
+
+    /**
+     * @brief Start recording opens below a directory.
+     * @param rootPath The rootfs.
+     * @return true if tracing started.
+     */
+    bool start(const std::string& rootPath);
+
+    /**
+     * @brief Stop recording after consuming pending events.
+     */
+    void stop();
+
+    /**
+     * @brief Get the opened files.
+     * @return Paths relative to the rootfs.
+     */
+    std::set<std::string> files() const;
+
+    /**
+     * @brief Check whether events were lost.
+     * @return true if the trace is complete.
+     */
+    bool complete() const;
+
+private:
+    void run();
+    void drain();
+
+    std::string rootPath_;
+    int fanFd_;
+    int mountFd_;
+    int stopFd_;
+    bool overflowed_;
+    std::thread reader_;
+    mutable std::mutex mutex_;
+    std::set<std::string> files_;
+    std::unordered_set<std::string> seenHandles_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_ACCESS_TRACER_H
@@ -0,0 +1,712 @@
+/**
+ * @file DebBootstrap.cpp
+ * @brief Implementation of the DebBootstrap class.
+ */
+
+#include "modules/filesystem/DebBootstrap.h"
+#include "utils/Syscalls.h"
+#include "core/Logger.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <zlib.h>
+
+namespace sandbox {
+
+namespace {
+
+/// Fields of a Packages index that do not belong in the dpkg status
+const std::set<std::string> kIndexOnlyFields = {
+    "Filename", "Size", "MD5sum", "SHA1", "SHA256", "SHA512", "Description-md5", "Task", "Supported"
+};
+
+/**
+ * @brief Get the value of a field of a control stanza.
+ */
+std::string field(const std::string& stanza, const std::string& name) {
+    std::istringstream in(stanza);
+    std::string line;
+    std::string value;
+    bool found = false;
+    while (std::getline(in, line)) {
+        if (found) {
+            if (line.empty() || (line[0] != ' ' && line[0] != '\t')) {
+                break;
+            }
+            value += "\n" + line;
+        } else if (line.size() > name.size() && line.compare(0, name.size(), name) == 0 &&
+                   line[name.size()] == ':') {
+            found = true;
+            value = line.substr(name.size() + 1);
+            value.erase(0, value.find_first_not_of(" \t"));
+        }
+    }
+    return value;
+}
+
+std::string trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t\n");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    return s.substr(begin, s.find_last_not_of(" \t\n") - begin + 1);
+}
+
+/**
+ * @brief Parse a relation field into alternatives, dropping versions and qualifiers.
+ */
+std::vector<std::vector<std::string>> parseRelations(const std::string& value) {
+    std::vector<std::vector<std::string>> relations;
+    std::istringstream entries(value);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        std::vector<std::string> alternatives;
+        std::istringstream options(entry);
+        std::string option;
+        while (std::getline(options, option, '|')) {
+            option = trim(option);
+            option = option.substr(0, option.find_first_of(" \t\n(:["));
+            if (!option.empty()) {
+                alternatives.push_back(option);
+            }
+        }
+        if (!alternatives.empty()) {
+            relations.push_back(alternatives);
+        }
+    }
+    return relations;
+}
+
+/**
+ * @brief Run a command and optionally capture its stdout.
+ */
+bool runCommand(const std::vector<std::string>& args, std::string* output = nullptr) {
+    int out[2] = {-1, -1};
+    if (output && pipe2(out, O_CLOEXEC) < 0) {
+        return false;
+    }
+
+    std::vector<char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        if (output) {
+            close(out[0]);
+            close(out[1]);
+        }
+        return false;
+    }
+    if (pid == 0) {
+        if (output) {
+            dup2(out[1], STDOUT_FILENO);
+        }
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    if (output) {
+        close(out[1]);
+        char buffer[65536];
+        ssize_t len;
+        while ((len = read(out[0], buffer, sizeof(buffer))) != 0) {
+            if (len < 0 && errno != EINTR) {
+                break;
+            }
+            if (len > 0) {
+                output->append(buffer, static_cast<size_t>(len));
+            }
+        }
+        close(out[0]);
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * @brief Run work(i) for every i below count on a pool of threads.
+ */
+void parallelFor(size_t count, int threads, const std::function<void(size_t)>& work) {
+    size_t workers = threads > 0 ? static_cast<size_t>(threads)
+                                 : std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, count);
+
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < workers; ++i) {
+        pool.emplace_back([&]() {
+            for (size_t index = next++; index < count; index = next++) {
+                work(index);
+            }
+        });
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+/// Ordering of a character in a Debian version, as dpkg defines it
+int order(char c) {
+    if (std::isdigit(static_cast<unsigned char>(c))) {
+        return 0;
+    }
+    if (std::isalpha(static_cast<unsigned char>(c))) {
+        return c;
+    }
+    if (c == '~') {
+        return -1;
+    }
+    return c ? c + 256 : 0;
+}
+
+int compareFragment(const std::string& a, const std::string& b) {
+    size_t i = 0;
+    size_t j = 0;
+    auto at = [](const std::string& s, size_t k) { return k < s.size() ? s[k] : '\0'; };
+    auto digit = [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; };
+
+    while (i < a.size() || j < b.size()) {
+        while ((at(a, i) && !digit(at(a, i))) || (at(b, j) && !digit(at(b, j)))) {
+            int ac = order(at(a, i));
+            int bc = order(at(b, j));
+            if (ac != bc) {
+                return ac - bc;
+            }
+            ++i;
+            ++j;
+        }
+        while (at(a, i) == '0') {
+            ++i;
+        }
+        while (at(b, j) == '0') {
+            ++j;
+        }
+        int firstDiff = 0;
+        while (digit(at(a, i)) && digit(at(b, j))) {
+            if (!firstDiff) {
+                firstDiff = at(a, i) - at(b, j);
+            }
+            ++i;
+            ++j;
+        }
+        if (digit(at(a, i))) {
+            return 1;
+        }
+        if (digit(at(b, j))) {
+            return -1;
+        }
+        if (firstDiff) {
+            return firstDiff;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+DebBootstrap::DebBootstrap(const std::string& source, const std::string& arch, int threads)
+    : source_(source)
+    , arch_(arch.empty() ? hostArch() : arch)
+    , threads_(threads)
+{
+}
+
+const std::map<std::string, DebPackage>& DebBootstrap::packages() const {
+    return packages_;
+}
+
+std::string DebBootstrap::hostArch() {
+    struct utsname name;
+    if (uname(&name) < 0) {
+        return "amd64";
+    }
+
+    static const std::map<std::string, std::string> arches = {
+        {"x86_64", "amd64"}, {"aarch64", "arm64"}, {"armv7l", "armhf"}, {"i686", "i386"},
+        {"i386", "i386"}, {"ppc64le", "ppc64el"}, {"s390x", "s390x"}, {"riscv64", "riscv64"}
+    };
+    auto it = arches.find(name.machine);
+    return it != arches.end() ? it->second : name.machine;
+}
+
+int DebBootstrap::compareVersions(const std::string& a, const std::string& b) {
+    // [epoch:]upstream[-revision]
+    auto split = [](const std::string& v, long& epoch, std::string& upstream, std::string& revision) {
+        size_t colon = v.find(':');
+        epoch = colon == std::string::npos ? 0 : std::strtol(v.c_str(), nullptr, 10);
+        upstream = colon == std::string::npos ? v : v.substr(colon + 1);
+        size_t dash = upstream.rfind('-');
+        revision = dash == std::string::npos ? "" : upstream.substr(dash + 1);
+        if (dash != std::string::npos) {
+            upstream.resize(dash);
+        }
+    };
+
+    long epochA;
+    long epochB;
+    std::string upstreamA;
+    std::string upstreamB;
+    std::string revisionA;
+    std::string revisionB;
+    split(a, epochA, upstreamA, revisionA);
+    split(b, epochB, upstreamB, revisionB);
+
+    if (epochA != epochB) {
+        return epochA < epochB ? -1 : 1;
+    }
+    int result = compareFragment(upstreamA, upstreamB);
+    return result ? result : compareFragment(revisionA, revisionB);
+}
+
+bool DebBootstrap::loadIndex(const std::string& release) {
+    packages_.clear();
+    providers_.clear();
+
+    std::string dists = source_ + "/dists/" + release;
+    if (Syscall::isDirectory(dists)) {
+        std::error_code ec;
+        for (const auto& component : std::filesystem::directory_iterator(dists, ec)) {
+            std::string index = component.path().string() + "/binary-" + arch_ + "/Packages";
+            if (Syscall::exists(index)) {
+                readIndex(index, source_);
+            } else if (Syscall::exists(index + ".gz")) {
+                readIndex(index + ".gz", source_);
+            }
+        }
+    } else if (Syscall::exists(source_ + "/Packages")) {
+        readIndex(source_ + "/Packages", source_);
+    } else if (Syscall::exists(source_ + "/Packages.gz")) {
+        readIndex(source_ + "/Packages.gz", source_);
+    } else {
+        indexDebs();
+    }
+
+    for (const auto& [name, package] : packages_) {
+        for (const auto& provided : package.provides) {
+            providers_[provided].push_back(name);
+        }
+    }
+
+    if (packages_.empty()) {
+        SANDBOX_ERROR("No " + arch_ + " packages found in " + source_);
+        return false;
+    }
+    SANDBOX_INFO("Indexed " + std::to_string(packages_.size()) + " packages from " + source_);
+    return true;
+}
+
+bool DebBootstrap::readIndex(const std::string& path, const std::string& baseDir) {
+    std::string text;
+    if (path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0) {
+        gzFile file = gzopen(path.c_str(), "rb");
+        if (!file) {
+            return false;
+        }
+        char buffer[65536];
+        int len;
+        while ((len = gzread(file, buffer, sizeof(buffer))) > 0) {
+            text.append(buffer, static_cast<size_t>(len));
+        }
+        gzclose(file);
+        if (len < 0) {
+            SANDBOX_ERROR("Corrupt package index " + path);
+            return false;
+        }
+    } else {
+        auto content = Syscall::readFile(path);
+        if (!content) {
+            return false;
+        }
+        text = std::move(*content);
+    }
+
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find("\n\n", start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        addStanza(text.substr(start, end - start) + "\n", baseDir);
+        start = end + 2;
+    }
+    return true;
+}
+
+bool DebBootstrap::indexDebs() {
+    std::vector<std::string> debs;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(source_, ec)) {
+        if (entry.path().extension() == ".deb") {
+            debs.push_back(entry.path().filename().string());
+        }
+    }
+    std::sort(debs.begin(), debs.end());
+
+    // Reading control fields spawns dpkg-deb per package; do it concurrently
+    std::vector<std::string> stanzas(debs.size());
+    parallelFor(debs.size(), threads_, [&](size_t i) {
+        if (!runCommand({"dpkg-deb", "--field", source_ + "/" + debs[i]}, &stanzas[i])) {
+            SANDBOX_WARNING("Skipping unreadable package " + debs[i]);
+            stanzas[i].clear();
+        }
+    });
+
+    for (size_t i = 0; i < debs.size(); ++i) {
+        if (!stanzas[i].empty()) {
+            addStanza(stanzas[i] + "Filename: " + debs[i] + "\n", source_);
+        }
+    }
+    return !ec;
+}
+
+void DebBootstrap::addStanza(const std::string& stanza, const std::string& baseDir) {
+    DebPackage package;
+    package.name = field(stanza, "Package");
+    package.version = field(stanza, "Version");
+    package.arch = field(stanza, "Architecture");
+    std::string filename = field(stanza, "Filename");
+    if (package.name.empty() || package.version.empty() || filename.empty() ||
+        (package.arch != arch_ && package.arch != "all")) {
+        return;
+    }
+
+    auto existing = packages_.find(package.name);
+    if (existing != packages_.end() && compareVersions(existing->second.version, package.version) >= 0) {
+        return;
+    }
+
+    package.filename = filename[0] == '/' ? filename : baseDir + "/" + filename;
+    package.required = field(stanza, "Priority") == "required" || field(stanza, "Essential") == "yes";
+    package.multiArchSame = field(stanza, "Multi-Arch") == "same";
+    package.depends = parseRelations(field(stanza, "Pre-Depends"));
+    for (auto& relation : parseRelations(field(stanza, "Depends"))) {
+        package.depends.push_back(std::move(relation));
+    }
+    for (const auto& relation : parseRelations(field(stanza, "Provides"))) {
+        package.provides.push_back(relation[0]);
+    }
+
+    std::istringstream in(stanza);
+    std::string line;
+    bool keep = true;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        if (line[0] != ' ' && line[0] != '\t') {
+            keep = kIndexOnlyFields.count(line.substr(0, line.find(':'))) == 0;
+        }
+        if (keep) {
+            package.control += line + "\n";
+        }
+    }
+
+    packages_[package.name] = std::move(package);
+}
+
+bool DebBootstrap::resolve(const std::vector<std::string>& include,
+                           std::vector<const DebPackage*>& selected) const {
+    selected.clear();
+
+    // A real package of that name, else the first package providing it
+    auto candidate = [this](const std::string& name) -> const DebPackage* {
+        auto it = packages_.find(name);
+        if (it != packages_.end()) {
+            return &it->second;
+        }
+        auto provider = providers_.find(name);
+        return provider != providers_.end() ? &packages_.at(provider->second.front()) : nullptr;
+    };
+
+    std::vector<const DebPackage*> queue;
+    for (const auto& [name, package] : packages_) {
+        if (package.required) {
+            queue.push_back(&package);
+        }
+    }
+    if (packages_.count("apt")) {
+        queue.push_back(&packages_.at("apt"));
+    }
+    for (const auto& name : include) {
+        const DebPackage* package = candidate(name);
+        if (!package) {
+            SANDBOX_ERROR("Package not available: " + name);
+            return false;
+        }
+        queue.push_back(package);
+    }
+
+    std::set<std::string> chosen;
+    auto satisfied = [&](const std::string& name) {
+        if (chosen.count(name)) {
+            return true;
+        }
+        auto provider = providers_.find(name);
+        if (provider == providers_.end()) {
+            return false;
+        }
+        return std::any_of(provider->second.begin(), provider->second.end(),
+                           [&](const std::string& p) { return chosen.count(p) > 0; });
+    };
+
+    while (!queue.empty()) {
+        const DebPackage* package = queue.back();
+        queue.pop_back();
+        if (!chosen.insert(package->name).second) {
+            continue;
+        }
+
+        for (const auto& alternatives : package->depends) {
+            if (std::any_of(alternatives.begin(), alternatives.end(), satisfied)) {
+                continue;
+            }
+            const DebPackage* pick = nullptr;
+            for (const auto& name : alternatives) {
+                if ((pick = candidate(name))) {
+                    break;
+                }
+            }
+            if (!pick) {
+                std::string wanted;
+                for (const auto& name : alternatives) {
+                    wanted += (wanted.empty() ? "" : " | ") + name;
+                }
+                SANDBOX_ERROR("Unsatisfiable dependency of " + package->name + ": " + wanted);
+                return false;
+            }
+            queue.push_back(pick);
+        }
+    }
+
+    for (const auto& name : chosen) {
+        selected.push_back(&packages_.at(name));
+    }
+    return true;
+}
+
+bool DebBootstrap::install(const std::string& rootPath, const std::vector<const DebPackage*>& selected) {
+    std::string dpkgDir = rootPath + "/var/lib/dpkg";
+    for (const auto& dir : {rootPath + "/usr/bin", rootPath + "/usr/sbin", rootPath + "/usr/lib",
+                            dpkgDir + "/info", dpkgDir + "/updates", dpkgDir + "/alternatives",
+                            dpkgDir + "/triggers"}) {
+        if (!Syscall::mkdirRecursive(dir, 0755)) {
+            SANDBOX_ERROR("Failed to create " + dir);
+            return false;
+        }
+    }
+
+    // Merged /usr, as debootstrap sets it up
+    std::vector<std::string> merged = {"bin", "sbin", "lib"};
+    if (arch_ == "amd64") {
+        merged.insert(merged.end(), {"lib32", "lib64", "libx32"});
+    }
+    for (const auto& dir : merged) {
+        std::string link = rootPath + "/" + dir;
+        if (!Syscall::exists(link) && symlink(("usr/" + dir).c_str(), link.c_str()) < 0) {
+            SANDBOX_ERROR("Failed to link /" + dir + ": " + std::string(strerror(errno)));
+            return false;
+        }
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::atomic<bool> failed{false};
+    parallelFor(selected.size(), threads_, [&](size_t i) {
+        if (!failed && !unpack(*selected[i], rootPath)) {
+            SANDBOX_ERROR("Failed to unpack " + selected[i]->filename);
+            failed = true;
+        }
+    });
+    if (failed) {
+        return false;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+    SANDBOX_INFO("Unpacked " + std::to_string(selected.size()) + " packages in " +
+                 std::to_string(elapsed) + " ms");
+
+    // Register everything as unpacked so that dpkg configures it
+    std::string status;
+    for (const auto* package : selected) {
+        std::string infoName = package->multiArchSame ? package->name + ":" + package->arch : package->name;
+        std::string conffiles;
+        if (auto content = Syscall::readFile(dpkgDir + "/info/" + infoName + ".conffiles")) {
+            std::istringstream in(*content);
+            std::string line;
+            while (std::getline(in, line)) {
+                if (!line.empty() && line[0] == '/') {
+                    conffiles += " " + line + " newconffile\n";
+                }
+            }
+        }
+
+        std::string control = package->control;
+        size_t afterPackage = control.find('\n') + 1;
+        control.insert(afterPackage, "Status: install ok unpacked\n");
+        status += control + (conffiles.empty() ? "" : "Conffiles:\n" + conffiles) + "\n";
+    }
+    if (!Syscall::writeFile(dpkgDir + "/status", status) ||
+        !Syscall::writeFile(dpkgDir + "/available", "") ||
+        !Syscall::writeFile(dpkgDir + "/arch", arch_ + "\n")) {
+        SANDBOX_ERROR("Failed to write the dpkg database");
+        return false;
+    }
+
+    return configure(rootPath);
+}
+
+bool DebBootstrap::unpack(const DebPackage& package, const std::string& rootPath) {
+    int tarIn[2];
+    int names[2];
+    if (pipe2(tarIn, O_CLOEXEC) < 0) {
+        return false;
+    }
+    if (pipe2(names, O_CLOEXEC) < 0) {
+        close(tarIn[0]);
+        close(tarIn[1]);
+        return false;
+    }
+
+    // dpkg-deb --fsys-tarfile | tar -x, keeping the merged /usr links
+    pid_t deb = fork();
+    if (deb == 0) {
+        dup2(tarIn[1], STDOUT_FILENO);
+        execlp("dpkg-deb", "dpkg-deb", "--fsys-tarfile", package.filename.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+    pid_t tar = deb < 0 ? -1 : fork();
+    if (tar == 0) {
+        dup2(tarIn[0], STDIN_FILENO);
+        dup2(names[1], STDOUT_FILENO);
+        execlp("tar", "tar", "-x", "-v", "-p", "--numeric-owner", "--keep-directory-symlink",
+               "-C", rootPath.c_str(), "-f", "-", (char*)nullptr);
+        _exit(127);
+    }
+    close(tarIn[0]);
+    close(tarIn[1]);
+    close(names[1]);
+
+    std::string listing;
+    char buffer[65536];
+    ssize_t len;
+    while ((len = read(names[0], buffer, sizeof(buffer))) != 0) {
+        if (len < 0 && errno != EINTR) {
+            break;
+        }
+        if (len > 0) {
+            listing.append(buffer, static_cast<size_t>(len));
+        }
+    }
+    close(names[0]);
+
+    bool ok = deb > 0 && tar > 0;
+    for (pid_t pid : {deb, tar}) {
+        int status = 0;
+        if (pid > 0) {
+            while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+            }
+            ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+    }
+    if (!ok) {
+        return false;
+    }
+
+    // Maintainer scripts and the file list go to the dpkg database
+    std::string infoName = package.multiArchSame ? package.name + ":" + package.arch : package.name;
+    std::string infoDir = rootPath + "/var/lib/dpkg/info";
+    std::string controlDir = rootPath + "/var/lib/dpkg/tmp.ci-" + infoName;
+    Syscall::removeRecursive(controlDir);
+    if (!runCommand({"dpkg-deb", "--control", package.filename, controlDir})) {
+        return false;
+    }
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(controlDir, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name != "control") {
+            ::rename(entry.path().c_str(), (infoDir + "/" + infoName + "." + name).c_str());
+        }
+    }
+    Syscall::removeRecursive(controlDir);
+
+    std::string list;
+    std::istringstream in(listing);
+    std::string path;
+    while (std::getline(in, path)) {
+        // "./usr/bin/" -> "/usr/bin", "./" -> "/."
+        if (path.size() > 1 && path.back() == '/') {
+            path.pop_back();
+        }
+        if (path == ".") {
+            list += "/.\n";
+        } else if (path.compare(0, 2, "./") == 0) {
+            list += path.substr(1) + "\n";
+        }
+    }
+    return Syscall::writeFile(infoDir + "/" + infoName + ".list", list);
+}
+
+bool DebBootstrap::configure(const std::string& rootPath) {
+    if (!Syscall::exists(rootPath + "/usr/bin/dpkg")) {
+        SANDBOX_WARNING("No dpkg in the package set; packages are left unconfigured");
+        return true;
+    }
+
+    // Keep maintainer scripts from starting services
+    std::string policy = rootPath + "/usr/sbin/policy-rc.d";
+    Syscall::writeFile(policy, "#!/bin/sh\nexit 101\n");
+    chmod(policy.c_str(), 0755);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        return false;
+    }
+    if (pid == 0) {
+        // proc and dev are only visible to this run
+        if (unshare(CLONE_NEWNS) < 0 || mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr) < 0) {
+            _exit(126);
+        }
+        mkdir((rootPath + "/proc").c_str(), 0555);
+        mkdir((rootPath + "/dev").c_str(), 0755);
+        mount("proc", (rootPath + "/proc").c_str(), "proc", MS_NOSUID | MS_NODEV | MS_NOEXEC, nullptr);
+        mount("/dev", (rootPath + "/dev").c_str(), nullptr, MS_BIND | MS_REC, nullptr);
+        if (chroot(rootPath.c_str()) < 0 || chdir("/") < 0) {
+            _exit(126);
+        }
+        const char* env[] = {"PATH=/usr/sbin:/usr/bin:/sbin:/bin", "DEBIAN_FRONTEND=noninteractive",
+                             "LC_ALL=C", nullptr};
+        execle("/usr/bin/dpkg", "dpkg", "--configure", "-a", (char*)nullptr, env);
+        _exit(127);
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    unlink(policy.c_str());
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        SANDBOX_ERROR("dpkg --configure failed with status: " + std::to_string(WEXITSTATUS(status)));
+        return false;
+    }
+    return true;
+}
+
+} // namespace sandbox
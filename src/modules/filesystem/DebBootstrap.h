@@ -0,0 +1,119 @@
+/**
+ * @file DebBootstrap.h
+ * @brief Offline rootfs bootstrap from local Debian packages.
+ *
+ * This header defines the DebBootstrap class that builds a minimal
+ * Debian/Ubuntu root filesystem from a local directory of .deb files or
+ * a local mirror, without network access.
+ */
+
+#ifndef SANDBOX_DEB_BOOTSTRAP_H
+#define SANDBOX_DEB_BOOTSTRAP_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace sandbox {
+
+/**
+ * @struct DebPackage
+ * @brief A binary package available for installation.
+ */
+struct DebPackage {
+    std::string name;
+    std::string version;
+    std::string arch;
+    std::string filename;         ///< Absolute path of the .deb
+    bool required;                ///< Priority required or Essential
+    bool multiArchSame;           ///< Multi-Arch: same, named name:arch by dpkg
+    std::vector<std::vector<std::string>> depends;  ///< Depends and Pre-Depends, alternatives per entry
+    std::vector<std::string> provides;
+    std::string control;          ///< Control stanza as recorded in the dpkg status
+};
+
+/**
+ * @class DebBootstrap
+ * @brief Resolves and unpacks a minbase package set in parallel.
+ *
+ * The package set is resolved once from the index: every required or
+ * essential package, apt and any extra packages, closed over Depends
+ * and Pre-Depends. Unpacking needs no ordering, so the packages are
+ * extracted concurrently by dpkg-deb, one per core, and registered as
+ * unpacked in the dpkg database. The image's own dpkg then configures
+ * them all in one chrooted run.
+ *
+ * The source is either a mirror with dists/<release>/<component>/
+ * binary-<arch>/Packages indexes, a directory with a Packages index, or
+ * a plain directory of .deb files whose control fields are read
+ * directly. Version constraints are not checked; the newest version of
+ * each package is used.
+ */
+class DebBootstrap {
+public:
+    /**
+     * @brief Construct a DebBootstrap.
+     * @param source Local mirror or package directory.
+     * @param arch Target architecture, empty for the host's.
+     * @param threads Unpacking threads, 0 for one per CPU.
+     */
+    DebBootstrap(const std::string& source, const std::string& arch, int threads);
+
+    /**
+     * @brief Read the available packages.
+     * @param release Release to read from a mirror.
+     * @return true if at least one package was found.
+     */
+    bool loadIndex(const std::string& release);
+
+    /**
+     * @brief Resolve the packages to install.
+     * @param include Packages wanted in addition to the minimal set.
+     * @param selected Output packages, sorted by name.
+     * @return false if a dependency cannot be satisfied.
+     */
+    bool resolve(const std::vector<std::string>& include, std::vector<const DebPackage*>& selected) const;
+
+    /**
+     * @brief Unpack, register and configure packages into a rootfs.
+     * @param rootPath The rootfs to create.
+     * @param selected Packages returned by resolve().
+     * @return true if successful.
+     */
+    bool install(const std::string& rootPath, const std::vector<const DebPackage*>& selected);
+
+    /**
+     * @brief Get the indexed packages.
+     * @return Packages by name.
+     */
+    const std::map<std::string, DebPackage>& packages() const;
+
+    /**
+     * @brief Compare Debian version strings.
+     * @return Negative, zero or positive like strcmp.
+     */
+    static int compareVersions(const std::string& a, const std::string& b);
+
+    /**
+     * @brief Get the Debian name of the host architecture.
+     * @return The architecture, e.g. "amd64".
+     */
+    static std::string hostArch();
+
+private:
+    bool readIndex(const std::string& path, const std::string& baseDir);
+    bool indexDebs();
+    void addStanza(const std::string& stanza, const std::string& baseDir);
+    bool unpack(const DebPackage& package, const std::string& rootPath);
+    bool configure(const std::string& rootPath);
+
+    std::string source_;
+    std::string arch_;
+    int threads_;
+    std::map<std::string, DebPackage> packages_;
+    std::map<std::string, std::vector<std::string>> providers_;  ///< Virtual name to packages
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_DEB_BOOTSTRAP_H
@@ -0,0 +1,119 @@
+/**
+ * @file DevTemplate.cpp
+ * @brief Implementation of the DevTemplate class.
+ */
+
+#include "modules/filesystem/DevTemplate.h"
+#include "utils/Syscalls.h"
+#include "core/Logger.h"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+namespace sandbox {
+
+namespace {
+
+struct DeviceNode {
+    const char* name;
+    unsigned int major;
+    unsigned int minor;
+};
+
+/// Devices that expose nothing of the host
+const DeviceNode kDevices[] = {
+    {"null", 1, 3}, {"zero", 1, 5}, {"full", 1, 7}, {"random", 1, 8}, {"urandom", 1, 9}, {"tty", 5, 0}
+};
+
+struct DeviceLink {
+    const char* name;
+    const char* target;
+};
+
+const DeviceLink kLinks[] = {
+    {"fd", "/proc/self/fd"}, {"stdin", "/proc/self/fd/0"}, {"stdout", "/proc/self/fd/1"},
+    {"stderr", "/proc/self/fd/2"}, {"ptmx", "pts/ptmx"}
+};
+
+} // namespace
+
+bool DevTemplate::isPrepared(const std::string& dir) {
+    struct stat st;
+    return stat((dir + "/urandom").c_str(), &st) == 0 && S_ISCHR(st.st_mode) &&
+           Syscall::isDirectory(dir + "/pts") && Syscall::isDirectory(dir + "/shm");
+}
+
+bool DevTemplate::prepare(const std::string& dir) {
+    if (isPrepared(dir)) {
+        return true;
+    }
+    if (!Syscall::mkdirRecursive(dir, 0755)) {
+        SANDBOX_ERROR("Failed to create " + dir);
+        return false;
+    }
+
+    // Serialize supervisors preparing at the same time
+    std::string lockPath = dir + ".lock";
+    int lockFd = open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lockFd < 0 || flock(lockFd, LOCK_EX) < 0) {
+        SANDBOX_ERROR("Failed to lock " + lockPath + ": " + std::string(strerror(errno)));
+        if (lockFd >= 0) {
+            close(lockFd);
+        }
+        return false;
+    }
+    if (isPrepared(dir)) {
+        close(lockFd);
+        return true;
+    }
+
+    bool ok = Syscall::mount("tmpfs", dir, "tmpfs", MS_NOSUID | MS_NOEXEC,
+                             "mode=755,size=64k,nr_inodes=64");
+    for (const auto& device : kDevices) {
+        std::string path = dir + "/" + device.name;
+        if (ok && (mknod(path.c_str(), S_IFCHR | 0666, makedev(device.major, device.minor)) < 0 ||
+                   chmod(path.c_str(), 0666) < 0)) {
+            SANDBOX_ERROR("Failed to create " + path + ": " + std::string(strerror(errno)));
+            ok = false;
+        }
+    }
+    for (const auto& link : kLinks) {
+        std::string path = dir + "/" + link.name;
+        if (ok && symlink(link.target, path.c_str()) < 0) {
+            SANDBOX_ERROR("Failed to create " + path + ": " + std::string(strerror(errno)));
+            ok = false;
+        }
+    }
+    ok = ok && mkdir((dir + "/pts").c_str(), 0755) == 0 && mkdir((dir + "/shm").c_str(), 01777) == 0;
+
+    // Device I/O still works on a read-only filesystem
+    ok = ok && Syscall::mount("", dir, "", MS_REMOUNT | MS_RDONLY | MS_NOSUID | MS_NOEXEC, nullptr);
+    if (!ok) {
+        SANDBOX_ERROR("Failed to prepare /dev template in " + dir);
+        umount2(dir.c_str(), MNT_DETACH);
+    } else {
+        SANDBOX_INFO("Prepared /dev template in " + dir);
+    }
+
+    close(lockFd);
+    return ok;
+}
+
+bool DevTemplate::mountPrivate(const std::string& devDir) {
+    if (!Syscall::mount("devpts", devDir + "/pts", "devpts", MS_NOSUID | MS_NOEXEC,
+                        "newinstance,ptmxmode=0666,mode=0620")) {
+        SANDBOX_ERROR("Failed to mount " + devDir + "/pts");
+        return false;
+    }
+    if (!Syscall::mount("shm", devDir + "/shm", "tmpfs", MS_NOSUID | MS_NODEV | MS_NOEXEC, "mode=1777")) {
+        SANDBOX_ERROR("Failed to mount " + devDir + "/shm");
+        return false;
+    }
+    return true;
+}
+
+} // namespace sandbox
@@ -0,0 +1,57 @@
+/**
+ * @file DevTemplate.h
+ * @brief Shared, prebuilt /dev for sandboxes.
+ *
+ * This header defines the DevTemplate class that prepares a read-only
+ * /dev with the safe device nodes once on the host, for every sandbox
+ * to attach with a single bind mount.
+ */
+
+#ifndef SANDBOX_DEV_TEMPLATE_H
+#define SANDBOX_DEV_TEMPLATE_H
+
+#include <string>
+
+namespace sandbox {
+
+/**
+ * @class DevTemplate
+ * @brief Builds and attaches the /dev template.
+ *
+ * The template is a small tmpfs holding null, zero, full, random,
+ * urandom and tty, the fd and stdio links into /proc, a ptmx link and
+ * the pts and shm mount points. Once populated it is remounted
+ * read-only, so sandboxes share it without being able to change it.
+ * Each sandbox then mounts its own devpts instance and /dev/shm tmpfs
+ * on top, keeping terminals and shared memory private.
+ */
+class DevTemplate {
+public:
+    /**
+     * @brief Create the template unless it already exists.
+     *
+     * Safe to call from concurrent supervisors.
+     *
+     * @param dir Host directory to mount the template on.
+     * @return true if the template is ready.
+     */
+    static bool prepare(const std::string& dir);
+
+    /**
+     * @brief Check whether a directory holds a prepared template.
+     * @param dir The template directory.
+     * @return true if prepared.
+     */
+    static bool isPrepared(const std::string& dir);
+
+    /**
+     * @brief Mount the private parts on an attached template.
+     * @param devDir The sandbox's /dev.
+     * @return true if successful.
+     */
+    static bool mountPrivate(const std::string& devDir);
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_DEV_TEMPLATE_H
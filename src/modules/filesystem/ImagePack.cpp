@@ -0,0 +1,285 @@
+/**
+ * @file ImagePack.cpp
+ * @brief Implementation of the ImagePack class.
+ */
+
+#include "modules/filesystem/ImagePack.h"
+#include "utils/Hash.h"
+#include "utils/Syscalls.h"
+#include "core/Logger.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <zlib.h>
+
+using json = nlohmann::json;
+
+namespace sandbox {
+
+namespace {
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+} // namespace
+
+ImagePack::ImagePack()
+    : packFd_(-1)
+{
+}
+
+ImagePack::~ImagePack() {
+    if (packFd_ >= 0) {
+        close(packFd_);
+    }
+}
+
+bool ImagePack::build(const std::string& sourceDir, const std::string& outputDir) {
+    if (!Syscall::isDirectory(outputDir) && !Syscall::mkdirRecursive(outputDir, 0755)) {
+        SANDBOX_ERROR("Failed to create " + outputDir);
+        return false;
+    }
+
+    std::string packPath = outputDir + "/blobs.pack";
+    int packFd = open(packPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (packFd < 0) {
+        SANDBOX_ERROR("Failed to create " + packPath + ": " + std::string(strerror(errno)));
+        return false;
+    }
+
+    json entries = json::array();
+    json blobs = json::object();
+    unsigned long long offset = 0;
+    bool ok = true;
+
+    std::function<void(const std::string&, const std::string&)> walk =
+        [&](const std::string& hostPath, const std::string& imagePath) {
+        struct stat st;
+        if (!ok || lstat(hostPath.c_str(), &st) < 0) {
+            return;
+        }
+
+        json entry;
+        entry["path"] = imagePath;
+        entry["mode"] = st.st_mode & 07777;
+        entry["uid"] = st.st_uid;
+        entry["gid"] = st.st_gid;
+        entry["mtime"] = static_cast<long long>(st.st_mtime);
+
+        if (S_ISDIR(st.st_mode)) {
+            entry["type"] = "dir";
+            entry["size"] = 0;
+            entries.push_back(entry);
+
+            std::vector<std::string> names;
+            std::error_code ec;
+            for (const auto& child : std::filesystem::directory_iterator(hostPath, ec)) {
+                names.push_back(child.path().filename().string());
+            }
+            std::sort(names.begin(), names.end());
+            for (const auto& name : names) {
+                walk(hostPath + "/" + name, (imagePath == "/" ? "" : imagePath) + "/" + name);
+            }
+        } else if (S_ISLNK(st.st_mode)) {
+            std::string target(static_cast<size_t>(st.st_size) + 1, '\0');
+            ssize_t len = readlink(hostPath.c_str(), target.data(), target.size());
+            if (len < 0) {
+                return;
+            }
+            target.resize(static_cast<size_t>(len));
+            entry["type"] = "symlink";
+            entry["size"] = target.size();
+            entry["target"] = target;
+            entries.push_back(entry);
+        } else if (S_ISREG(st.st_mode)) {
+            auto content = Syscall::readFile(hostPath);
+            if (!content) {
+                SANDBOX_WARNING("Skipping unreadable file " + hostPath);
+                return;
+            }
+            std::string digest = Xxh64::toHex(Xxh64::hash(content->data(), content->size()));
+            entry["type"] = "file";
+            entry["size"] = content->size();
+            entry["digest"] = digest;
+            entries.push_back(entry);
+
+            if (blobs.contains(digest)) {
+                return;
+            }
+
+            // Store incompressible contents as they are
+            uLongf compressedSize = compressBound(content->size());
+            std::string compressed(compressedSize, '\0');
+            bool useCompressed = compress2(reinterpret_cast<Bytef*>(compressed.data()), &compressedSize,
+                                           reinterpret_cast<const Bytef*>(content->data()),
+                                           content->size(), Z_DEFAULT_COMPRESSION) == Z_OK &&
+                                 compressedSize < content->size();
+            const std::string& stored = useCompressed ? compressed : *content;
+            size_t length = useCompressed ? compressedSize : content->size();
+
+            if (!writeAll(packFd, stored.data(), length)) {
+                SANDBOX_ERROR("Failed to write " + packPath + ": " + std::string(strerror(errno)));
+                ok = false;
+                return;
+            }
+            blobs[digest] = {{"offset", offset}, {"length", length}, {"size", content->size()},
+                             {"compressed", useCompressed}};
+            offset += length;
+        } else {
+            SANDBOX_DEBUG("Skipping special file " + hostPath);
+        }
+    };
+
+    walk(sourceDir, "/");
+    close(packFd);
+
+    if (!ok || entries.empty() || entries[0]["type"] != "dir") {
+        SANDBOX_ERROR("Failed to pack " + sourceDir);
+        return false;
+    }
+
+    json manifest;
+    manifest["version"] = 1;
+    manifest["pack"] = "blobs.pack";
+    manifest["entries"] = entries;
+    manifest["blobs"] = blobs;
+    if (!Syscall::writeFile(outputDir + "/manifest.json", manifest.dump())) {
+        return false;
+    }
+
+    SANDBOX_INFO("Packed " + std::to_string(entries.size()) + " files into " +
+                 std::to_string(blobs.size()) + " blobs, " + std::to_string(offset) + " bytes");
+    return true;
+}
+
+bool ImagePack::load(const std::string& manifestPath) {
+    auto content = Syscall::readFile(manifestPath);
+    if (!content) {
+        SANDBOX_ERROR("Failed to read image manifest: " + manifestPath);
+        return false;
+    }
+
+    try {
+        json manifest = json::parse(*content);
+
+        entries_.clear();
+        for (const auto& e : manifest.at("entries")) {
+            ImageEntry entry;
+            entry.path = e.at("path");
+            entry.type = e.at("type");
+            entry.mode = e.value("mode", 0755);
+            entry.uid = e.value("uid", 0);
+            entry.gid = e.value("gid", 0);
+            entry.mtime = e.value("mtime", 0LL);
+            entry.size = e.value("size", 0ULL);
+            entry.digest = e.value("digest", "");
+            entry.target = e.value("target", "");
+            entries_.push_back(entry);
+        }
+
+        blobs_.clear();
+        for (const auto& [digest, b] : manifest.at("blobs").items()) {
+            blobs_[digest] = {b.at("offset"), b.at("length"), b.at("size"), b.value("compressed", false)};
+        }
+
+        std::string pack = manifest.value("pack", "blobs.pack");
+        if (pack.empty() || pack[0] != '/') {
+            pack = std::filesystem::path(manifestPath).parent_path().string() + "/" + pack;
+        }
+        if (packFd_ >= 0) {
+            close(packFd_);
+        }
+        packFd_ = open(pack.c_str(), O_RDONLY | O_CLOEXEC);
+        if (packFd_ < 0) {
+            SANDBOX_ERROR("Failed to open image pack " + pack + ": " + std::string(strerror(errno)));
+            return false;
+        }
+    } catch (const json::exception& e) {
+        SANDBOX_ERROR("Invalid image manifest " + manifestPath + ": " + e.what());
+        return false;
+    }
+
+    if (entries_.empty() || entries_[0].path != "/" || entries_[0].type != "dir") {
+        SANDBOX_ERROR("Image manifest has no root directory: " + manifestPath);
+        return false;
+    }
+
+    return true;
+}
+
+const std::vector<ImageEntry>& ImagePack::entries() const {
+    return entries_;
+}
+
+int ImagePack::fetch(const std::string& digest, const std::string& cacheDir) const {
+    std::string cached = cacheDir + "/" + digest;
+    int fd = open(cached.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        return fd;
+    }
+
+    auto it = blobs_.find(digest);
+    if (it == blobs_.end()) {
+        return -1;
+    }
+    const PackedBlob& blob = it->second;
+
+    std::string stored(blob.length, '\0');
+    if (pread(packFd_, stored.data(), blob.length, static_cast<off_t>(blob.offset)) !=
+        static_cast<ssize_t>(blob.length)) {
+        return -1;
+    }
+
+    std::string data;
+    if (blob.compressed) {
+        data.resize(blob.size);
+        uLongf size = blob.size;
+        if (uncompress(reinterpret_cast<Bytef*>(data.data()), &size,
+                       reinterpret_cast<const Bytef*>(stored.data()), stored.size()) != Z_OK ||
+            size != blob.size) {
+            return -1;
+        }
+    } else {
+        data = std::move(stored);
+    }
+
+    if (Xxh64::toHex(Xxh64::hash(data.data(), data.size())) != digest) {
+        SANDBOX_ERROR("Corrupt blob " + digest + " in image pack");
+        return -1;
+    }
+
+    // Publish atomically; concurrent fetchers write identical contents
+    std::string tmpPath = cached + ".tmp-" + std::to_string(syscall(SYS_gettid));
+    int tmpFd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0444);
+    if (tmpFd < 0) {
+        return -1;
+    }
+    bool written = writeAll(tmpFd, data.data(), data.size());
+    close(tmpFd);
+    if (!written || ::rename(tmpPath.c_str(), cached.c_str()) < 0) {
+        unlink(tmpPath.c_str());
+        return -1;
+    }
+
+    return open(cached.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+} // namespace sandbox
@@ -0,0 +1,109 @@
+/**
+ * @file ImagePack.h
+ * @brief Content-addressed rootfs images stored in a pack file.
+ *
+ * This header defines the ImagePack class that describes an image as a
+ * manifest of file metadata plus a pack of compressed content blobs, so
+ * that file contents can be materialized one at a time on demand.
+ */
+
+#ifndef SANDBOX_IMAGE_PACK_H
+#define SANDBOX_IMAGE_PACK_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace sandbox {
+
+/**
+ * @struct ImageEntry
+ * @brief Metadata of one file of an image.
+ */
+struct ImageEntry {
+    std::string path;          ///< Path inside the image, "/" for the root
+    std::string type;          ///< "dir", "file" or "symlink"
+    mode_t mode;               ///< Permission bits
+    uid_t uid;
+    gid_t gid;
+    long long mtime;           ///< Modification time (seconds since epoch)
+    unsigned long long size;   ///< File size or symlink target length
+    std::string digest;        ///< XXH64 of the contents of a file
+    std::string target;        ///< Target of a symlink
+};
+
+/**
+ * @struct PackedBlob
+ * @brief Location of one content blob in the pack file.
+ */
+struct PackedBlob {
+    unsigned long long offset;   ///< Offset in the pack file
+    unsigned long long length;   ///< Stored length
+    unsigned long long size;     ///< Uncompressed size
+    bool compressed;             ///< zlib-compressed, otherwise stored as is
+};
+
+/**
+ * @class ImagePack
+ * @brief Reads and writes packed images.
+ *
+ * A packed image is a directory holding `manifest.json` and
+ * `blobs.pack`. Identical files share one blob, addressed by the XXH64
+ * of their contents. Blobs are fetched into a cache directory shared by
+ * all images; a fetched blob is verified against its digest and never
+ * fetched again.
+ */
+class ImagePack {
+public:
+    ImagePack();
+    ~ImagePack();
+
+    ImagePack(const ImagePack&) = delete;
+    ImagePack& operator=(const ImagePack&) = delete;
+
+    /**
+     * @brief Pack a directory tree into an image.
+     *
+     * Device nodes, sockets and FIFOs are skipped.
+     *
+     * @param sourceDir The root of the tree.
+     * @param outputDir Directory receiving manifest.json and blobs.pack.
+     * @return true if successful.
+     */
+    static bool build(const std::string& sourceDir, const std::string& outputDir);
+
+    /**
+     * @brief Load the manifest of an image and open its pack.
+     * @param manifestPath Path to manifest.json.
+     * @return true if successful.
+     */
+    bool load(const std::string& manifestPath);
+
+    /**
+     * @brief Get the files of the image, parents before children.
+     * @return The entries; the first one is the root.
+     */
+    const std::vector<ImageEntry>& entries() const;
+
+    /**
+     * @brief Materialize a blob in the cache and open it.
+     *
+     * Safe to call concurrently, also from several processes sharing
+     * the cache directory.
+     *
+     * @param digest The blob digest.
+     * @param cacheDir The blob cache.
+     * @return A read-only descriptor, or -1 on error.
+     */
+    int fetch(const std::string& digest, const std::string& cacheDir) const;
+
+private:
+    std::vector<ImageEntry> entries_;
+    std::map<std::string, PackedBlob> blobs_;
+    int packFd_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_IMAGE_PACK_H
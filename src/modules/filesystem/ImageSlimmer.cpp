@@ -0,0 +1,500 @@
+/**
+ * @file ImageSlimmer.cpp
+ * @brief Implementation of the ImageSlimmer class.
+ */
+
+#include "modules/filesystem/ImageSlimmer.h"
+#include "utils/Syscalls.h"
+#include "core/Logger.h"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <sstream>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+namespace sandbox {
+
+namespace {
+
+std::vector<std::string> splitPath(const std::string& path) {
+    std::vector<std::string> parts;
+    std::istringstream in(path);
+    std::string part;
+    while (std::getline(in, part, '/')) {
+        if (!part.empty() && part != ".") {
+            parts.push_back(part);
+        }
+    }
+    return parts;
+}
+
+std::string parentOf(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? "" : path.substr(0, slash);
+}
+
+bool copyFile(const std::string& from, const std::string& to, const struct stat& st) {
+    int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return false;
+    }
+    int out = open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+
+    bool ok = true;
+    off_t remaining = st.st_size;
+    while (ok && remaining > 0) {
+        ssize_t copied = copy_file_range(in, nullptr, out, nullptr, static_cast<size_t>(remaining), 0);
+        if (copied > 0) {
+            remaining -= copied;
+            continue;
+        }
+        if (copied == 0) {
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP) {
+            ok = false;
+            break;
+        }
+
+        // Fall back to plain copies across filesystems that cannot share extents
+        char buffer[65536];
+        ssize_t len;
+        while ((len = read(in, buffer, sizeof(buffer))) > 0) {
+            if (write(out, buffer, static_cast<size_t>(len)) != len) {
+                ok = false;
+                break;
+            }
+        }
+        ok = ok && len == 0;
+        break;
+    }
+
+    // chown clears set-id bits, so the mode comes last
+    if (ok && (fchown(out, st.st_uid, st.st_gid) < 0 || fchmod(out, st.st_mode & 07777) < 0)) {
+        ok = false;
+    }
+    struct timespec times[2] = {st.st_atim, st.st_mtim};
+    futimens(out, times);
+
+    close(in);
+    close(out);
+    return ok;
+}
+
+} // namespace
+
+ImageSlimmer::ImageSlimmer(const std::string& sourceRoot)
+    : sourceRoot_(sourceRoot)
+{
+}
+
+void ImageSlimmer::addFile(const std::string& path) {
+    std::string relative = resolve(path);
+    if (!relative.empty()) {
+        files_.insert(relative);
+    }
+}
+
+void ImageSlimmer::addAllowed(const std::string& path) {
+    std::string relative = resolve(path);
+    if (relative.empty()) {
+        for (const auto& part : splitPath(path)) {
+            relative += (relative.empty() ? "" : "/") + part;
+        }
+    }
+    if (!relative.empty()) {
+        allowed_.push_back(relative);
+    }
+}
+
+std::string ImageSlimmer::resolve(const std::string& path) const {
+    // Follow symlinks as if the image were the root
+    std::deque<std::string> pending;
+    for (const auto& part : splitPath(path)) {
+        pending.push_back(part);
+    }
+    std::vector<std::string> resolved;
+    int links = 0;
+
+    while (!pending.empty()) {
+        std::string part = pending.front();
+        pending.pop_front();
+        if (part == "..") {
+            if (!resolved.empty()) {
+                resolved.pop_back();
+            }
+            continue;
+        }
+
+        std::string candidate;
+        for (const auto& component : resolved) {
+            candidate += component + "/";
+        }
+        candidate += part;
+
+        struct stat st;
+        if (lstat((sourceRoot_ + "/" + candidate).c_str(), &st) < 0) {
+            return "";
+        }
+        if (!S_ISLNK(st.st_mode)) {
+            resolved.push_back(part);
+            continue;
+        }
+
+        if (++links > 40) {
+            return "";
+        }
+        std::string target(static_cast<size_t>(st.st_size) + 1, '\0');
+        ssize_t len = readlink((sourceRoot_ + "/" + candidate).c_str(), target.data(), target.size());
+        if (len <= 0) {
+            return "";
+        }
+        target.resize(static_cast<size_t>(len));
+        if (target[0] == '/') {
+            resolved.clear();
+        }
+        auto parts = splitPath(target);
+        pending.insert(pending.begin(), parts.begin(), parts.end());
+    }
+
+    std::string result;
+    for (const auto& component : resolved) {
+        result += (result.empty() ? "" : "/") + component;
+    }
+    return result;
+}
+
+bool ImageSlimmer::readElf(const std::string& path, std::string& interp,
+                           std::vector<std::string>& needed, std::vector<std::string>& runpath) {
+    interp.clear();
+    needed.clear();
+    runpath.clear();
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    Elf64_Ehdr header;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 || header.e_ident[EI_CLASS] != ELFCLASS64 ||
+        header.e_phentsize != sizeof(Elf64_Phdr) || header.e_phnum == 0) {
+        close(fd);
+        return false;
+    }
+
+    std::vector<Elf64_Phdr> segments(header.e_phnum);
+    size_t segmentBytes = segments.size() * sizeof(Elf64_Phdr);
+    if (pread(fd, segments.data(), segmentBytes, static_cast<off_t>(header.e_phoff)) !=
+        static_cast<ssize_t>(segmentBytes)) {
+        close(fd);
+        return false;
+    }
+
+    std::vector<Elf64_Dyn> dynamic;
+    for (const auto& segment : segments) {
+        if (segment.p_type == PT_INTERP && segment.p_filesz > 1 && segment.p_filesz < 4096) {
+            interp.resize(segment.p_filesz);
+            if (pread(fd, interp.data(), interp.size(), static_cast<off_t>(segment.p_offset)) !=
+                static_cast<ssize_t>(interp.size())) {
+                interp.clear();
+            }
+            interp.resize(strnlen(interp.c_str(), interp.size()));
+        } else if (segment.p_type == PT_DYNAMIC && segment.p_filesz < (1 << 20)) {
+            dynamic.resize(segment.p_filesz / sizeof(Elf64_Dyn));
+            size_t bytes = dynamic.size() * sizeof(Elf64_Dyn);
+            if (pread(fd, dynamic.data(), bytes, static_cast<off_t>(segment.p_offset)) !=
+                static_cast<ssize_t>(bytes)) {
+                dynamic.clear();
+            }
+        }
+    }
+
+    // The string table is given by address; find it in the file through the loaded segments
+    uint64_t strtabAddr = 0;
+    uint64_t strtabSize = 0;
+    for (const auto& entry : dynamic) {
+        if (entry.d_tag == DT_STRTAB) {
+            strtabAddr = entry.d_un.d_ptr;
+        } else if (entry.d_tag == DT_STRSZ) {
+            strtabSize = entry.d_un.d_val;
+        }
+    }
+    std::string strtab;
+    for (const auto& segment : segments) {
+        if (strtabAddr && segment.p_type == PT_LOAD && strtabAddr >= segment.p_vaddr &&
+            strtabAddr + strtabSize <= segment.p_vaddr + segment.p_filesz && strtabSize < (16 << 20)) {
+            strtab.resize(strtabSize);
+            off_t offset = static_cast<off_t>(segment.p_offset + strtabAddr - segment.p_vaddr);
+            if (pread(fd, strtab.data(), strtab.size(), offset) != static_cast<ssize_t>(strtab.size())) {
+                strtab.clear();
+            }
+            break;
+        }
+    }
+    close(fd);
+
+    auto stringAt = [&strtab](uint64_t offset) {
+        return offset < strtab.size() ? std::string(strtab.c_str() + offset) : std::string();
+    };
+    for (const auto& entry : dynamic) {
+        if (entry.d_tag == DT_NEEDED) {
+            std::string name = stringAt(entry.d_un.d_val);
+            if (!name.empty()) {
+                needed.push_back(name);
+            }
+        } else if (entry.d_tag == DT_RUNPATH || entry.d_tag == DT_RPATH) {
+            std::istringstream in(stringAt(entry.d_un.d_val));
+            std::string dir;
+            while (std::getline(in, dir, ':')) {
+                if (!dir.empty()) {
+                    runpath.push_back(dir);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+std::vector<std::string> ImageSlimmer::librarySearchPath() const {
+    std::vector<std::string> dirs;
+    auto readConf = [&](const std::string& relative) {
+        auto content = Syscall::readFile(sourceRoot_ + "/" + relative);
+        if (!content) {
+            return;
+        }
+        std::istringstream in(*content);
+        std::string line;
+        while (std::getline(in, line)) {
+            line = line.substr(0, line.find('#'));
+            line.erase(0, line.find_first_not_of(" \t"));
+            line.erase(line.find_last_not_of(" \t") + 1);
+            if (!line.empty() && line[0] == '/') {
+                dirs.push_back(line);
+            }
+        }
+    };
+
+    readConf(resolve("etc/ld.so.conf"));
+    std::string confDir = resolve("etc/ld.so.conf.d");
+    if (!confDir.empty()) {
+        std::vector<std::string> confs;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(sourceRoot_ + "/" + confDir, ec)) {
+            if (entry.path().extension() == ".conf") {
+                confs.push_back(confDir + "/" + entry.path().filename().string());
+            }
+        }
+        std::sort(confs.begin(), confs.end());
+        for (const auto& conf : confs) {
+            readConf(conf);
+        }
+    }
+
+    for (const char* dir : {"/lib", "/usr/lib", "/lib64", "/usr/lib64"}) {
+        dirs.push_back(dir);
+    }
+    return dirs;
+}
+
+std::string ImageSlimmer::findLibrary(const std::string& name, const std::string& origin,
+                                      const std::vector<std::string>& runpath,
+                                      const std::vector<std::string>& searchPath) const {
+    if (name.find('/') != std::string::npos) {
+        return resolve(name);
+    }
+
+    std::vector<std::string> dirs;
+    for (std::string dir : runpath) {
+        for (const char* token : {"${ORIGIN}", "$ORIGIN"}) {
+            size_t at = dir.find(token);
+            if (at != std::string::npos) {
+                dir.replace(at, strlen(token), "/" + origin);
+            }
+        }
+        dirs.push_back(dir);
+    }
+    dirs.insert(dirs.end(), searchPath.begin(), searchPath.end());
+
+    for (const auto& dir : dirs) {
+        std::string candidate = resolve(dir + "/" + name);
+        struct stat st;
+        if (!candidate.empty() && stat((sourceRoot_ + "/" + candidate).c_str(), &st) == 0 &&
+            S_ISREG(st.st_mode)) {
+            return candidate;
+        }
+    }
+    return "";
+}
+
+size_t ImageSlimmer::addDependencies() {
+    std::vector<std::string> pending(files_.begin(), files_.end());
+    size_t added = 0;
+
+    std::vector<std::string> searchPath = librarySearchPath();
+    while (!pending.empty()) {
+        std::string file = pending.back();
+        pending.pop_back();
+
+        std::string interp;
+        std::vector<std::string> needed;
+        std::vector<std::string> runpath;
+        if (!readElf(sourceRoot_ + "/" + file, interp, needed, runpath)) {
+            continue;
+        }
+
+        std::vector<std::string> wanted;
+        if (!interp.empty()) {
+            wanted.push_back(resolve(interp));
+        }
+        for (const auto& name : needed) {
+            std::string library = findLibrary(name, parentOf(file), runpath, searchPath);
+            if (library.empty()) {
+                SANDBOX_WARNING("Library " + name + " needed by /" + file + " not found in the image");
+            }
+            wanted.push_back(library);
+        }
+
+        for (const auto& library : wanted) {
+            if (!library.empty() && files_.insert(library).second) {
+                pending.push_back(library);
+                ++added;
+            }
+        }
+    }
+    return added;
+}
+
+bool ImageSlimmer::build(const std::string& outputDir, SlimReport& report) {
+    report = {};
+    if (Syscall::exists(outputDir)) {
+        SANDBOX_ERROR("Slim image target already exists: " + outputDir);
+        return false;
+    }
+
+    report.libraries = addDependencies();
+
+    auto isAllowed = [this](const std::string& relative) {
+        for (const auto& prefix : allowed_) {
+            if (relative == prefix ||
+                (relative.size() > prefix.size() && relative.compare(0, prefix.size(), prefix) == 0 &&
+                 relative[prefix.size()] == '/')) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    struct stat rootStat;
+    if (lstat(sourceRoot_.c_str(), &rootStat) < 0 || !S_ISDIR(rootStat.st_mode)) {
+        SANDBOX_ERROR("Not an image directory: " + sourceRoot_);
+        return false;
+    }
+
+    // Pick what to keep; directories are kept when anything below them is
+    std::map<std::string, struct stat> dirs;
+    std::map<std::string, struct stat> kept;
+    std::set<std::string> keptDirs = {""};
+    auto keepParents = [&keptDirs](std::string relative) {
+        while (!(relative = parentOf(relative)).empty() && keptDirs.insert(relative).second) {
+        }
+    };
+
+    std::error_code ec;
+    std::filesystem::recursive_directory_iterator it(sourceRoot_, ec);
+    for (; !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        std::string relative = it->path().string().substr(sourceRoot_.size() + 1);
+        struct stat st;
+        if (lstat(it->path().c_str(), &st) < 0) {
+            continue;
+        }
+        if (st.st_dev != rootStat.st_dev) {
+            it.disable_recursion_pending();
+            continue;
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            dirs[relative] = st;
+            if (isAllowed(relative)) {
+                keptDirs.insert(relative);
+                keepParents(relative);
+            }
+            continue;
+        }
+        if (S_ISREG(st.st_mode)) {
+            report.sourceFiles++;
+            report.sourceBytes += static_cast<unsigned long long>(st.st_size);
+        }
+        if (S_ISLNK(st.st_mode) || (S_ISREG(st.st_mode) && files_.count(relative)) || isAllowed(relative)) {
+            kept[relative] = st;
+            keepParents(relative);
+        }
+    }
+    if (ec) {
+        SANDBOX_ERROR("Failed to walk " + sourceRoot_ + ": " + ec.message());
+        return false;
+    }
+
+    if (!Syscall::mkdirRecursive(outputDir, 0755)) {
+        SANDBOX_ERROR("Failed to create " + outputDir);
+        return false;
+    }
+    dirs[""] = rootStat;
+    for (const auto& relative : keptDirs) {
+        const struct stat& st = dirs[relative];
+        std::string path = outputDir + (relative.empty() ? "" : "/" + relative);
+        if ((!relative.empty() && mkdir(path.c_str(), 0700) < 0) ||
+            lchown(path.c_str(), st.st_uid, st.st_gid) < 0 || chmod(path.c_str(), st.st_mode & 07777) < 0) {
+            SANDBOX_ERROR("Failed to create " + path + ": " + std::string(strerror(errno)));
+            return false;
+        }
+    }
+
+    for (const auto& [relative, st] : kept) {
+        std::string from = sourceRoot_ + "/" + relative;
+        std::string to = outputDir + "/" + relative;
+        bool ok;
+        if (S_ISREG(st.st_mode)) {
+            ok = copyFile(from, to, st);
+            report.files++;
+            report.bytes += static_cast<unsigned long long>(st.st_size);
+        } else if (S_ISLNK(st.st_mode)) {
+            std::string target(static_cast<size_t>(st.st_size) + 1, '\0');
+            ssize_t len = readlink(from.c_str(), target.data(), target.size());
+            target.resize(len > 0 ? static_cast<size_t>(len) : 0);
+            ok = len > 0 && symlink(target.c_str(), to.c_str()) == 0 &&
+                 lchown(to.c_str(), st.st_uid, st.st_gid) == 0;
+        } else {
+            ok = mknod(to.c_str(), st.st_mode, st.st_rdev) == 0 &&
+                 lchown(to.c_str(), st.st_uid, st.st_gid) == 0;
+        }
+        if (!ok) {
+            SANDBOX_ERROR("Failed to copy /" + relative + ": " + std::string(strerror(errno)));
+            return false;
+        }
+    }
+
+    // Directory times last, after their contents stopped changing
+    for (auto dir = keptDirs.rbegin(); dir != keptDirs.rend(); ++dir) {
+        const struct stat& st = dirs[*dir];
+        struct timespec times[2] = {st.st_atim, st.st_mtim};
+        utimensat(AT_FDCWD, (outputDir + (dir->empty() ? "" : "/" + *dir)).c_str(), times, AT_SYMLINK_NOFOLLOW);
+    }
+
+    return true;
+}
+
+} // namespace sandbox
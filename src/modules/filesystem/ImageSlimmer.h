@@ -0,0 +1,96 @@
+/**
+ * @file ImageSlimmer.h
+ * @brief Builds a minimal rootfs from the files a workload uses.
+ *
+ * This header defines the ImageSlimmer class that copies a selected
+ * subset of a rootfs, completed with the shared libraries the selected
+ * programs link against, into a new image.
+ */
+
+#ifndef SANDBOX_IMAGE_SLIMMER_H
+#define SANDBOX_IMAGE_SLIMMER_H
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace sandbox {
+
+/**
+ * @struct SlimReport
+ * @brief Size of a slimmed image against its source.
+ */
+struct SlimReport {
+    size_t files;                      ///< Regular files kept
+    unsigned long long bytes;          ///< Bytes kept
+    size_t sourceFiles;                ///< Regular files in the source
+    unsigned long long sourceBytes;    ///< Bytes in the source
+    size_t libraries;                  ///< Files added as ELF dependencies
+};
+
+/**
+ * @class ImageSlimmer
+ * @brief Keeps the used files of an image and drops the rest.
+ *
+ * Kept are the given files, everything below the allowlisted paths,
+ * and, for every kept ELF object, its interpreter and DT_NEEDED
+ * libraries, found the way the dynamic linker would inside the image.
+ * All directories leading to kept files and all symlinks are kept too,
+ * so paths through /bin or /lib64 links keep resolving. Owners, modes
+ * and times are preserved.
+ */
+class ImageSlimmer {
+public:
+    /**
+     * @brief Construct an ImageSlimmer.
+     * @param sourceRoot The full image.
+     */
+    explicit ImageSlimmer(const std::string& sourceRoot);
+
+    /**
+     * @brief Keep a file.
+     * @param path Path relative to the image root.
+     */
+    void addFile(const std::string& path);
+
+    /**
+     * @brief Keep a file or a whole directory.
+     * @param path Path inside the image, absolute or relative.
+     */
+    void addAllowed(const std::string& path);
+
+    /**
+     * @brief Write the slimmed image.
+     * @param outputDir The new image; must not exist yet.
+     * @param report Output sizes.
+     * @return true if successful.
+     */
+    bool build(const std::string& outputDir, SlimReport& report);
+
+    /**
+     * @brief Read the dynamic linking requirements of an ELF object.
+     * @param path The object on the host.
+     * @param interp Output program interpreter, empty if none.
+     * @param needed Output DT_NEEDED entries.
+     * @param runpath Output DT_RUNPATH or DT_RPATH directories.
+     * @return false if the file is not a 64-bit ELF object.
+     */
+    static bool readElf(const std::string& path, std::string& interp,
+                        std::vector<std::string>& needed, std::vector<std::string>& runpath);
+
+private:
+    std::string resolve(const std::string& path) const;
+    std::string findLibrary(const std::string& name, const std::string& origin,
+                            const std::vector<std::string>& runpath,
+                            const std::vector<std::string>& searchPath) const;
+    std::vector<std::string> librarySearchPath() const;
+    size_t addDependencies();
+
+    std::string sourceRoot_;
+    std::set<std::string> files_;
+    std::vector<std::string> allowed_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_IMAGE_SLIMMER_H
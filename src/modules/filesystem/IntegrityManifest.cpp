@@ -0,0 +1,330 @@
+/**
+ * @file IntegrityManifest.cpp
+ * @brief Implementation of the IntegrityManifest class.
+ */
+
+#include "modules/filesystem/IntegrityManifest.h"
+#include "utils/Hash.h"
+#include "utils/Syscalls.h"
+#include "core/Logger.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using json = nlohmann::json;
+
+namespace sandbox {
+
+namespace {
+
+int64_t toNs(const struct timespec& ts) {
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+std::string normalize(const std::string& path) {
+    std::string normal = std::filesystem::path(path).lexically_normal().string();
+    while (normal.size() > 1 && normal.back() == '/') {
+        normal.pop_back();
+    }
+    return normal;
+}
+
+} // namespace
+
+IntegrityManifest::IntegrityManifest()
+    : rehashed_(0)
+{
+}
+
+bool IntegrityManifest::hashFile(const std::string& path, std::string& digest) {
+    int fd = open(path.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    thread_local std::vector<char> buffer(1024 * 1024);
+    Xxh64 hash;
+    ssize_t len;
+    while ((len = read(fd, buffer.data(), buffer.size())) != 0) {
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            return false;
+        }
+        hash.update(buffer.data(), static_cast<size_t>(len));
+    }
+    close(fd);
+
+    digest = Xxh64::toHex(hash.digest());
+    return true;
+}
+
+bool IntegrityManifest::scan(const std::string& root, int threads, const IntegrityManifest* reference) {
+    root_ = normalize(root);
+    entries_.clear();
+    rehashed_ = 0;
+
+    struct stat rootStat;
+    if (lstat(root_.c_str(), &rootStat) < 0 || !S_ISDIR(rootStat.st_mode)) {
+        SANDBOX_ERROR("Not an image directory: " + root_);
+        return false;
+    }
+
+    std::unordered_map<std::string, const IntegrityEntry*> known;
+    if (reference) {
+        for (const auto& entry : reference->entries_) {
+            known[entry.path] = &entry;
+        }
+    }
+
+    auto record = [&](const std::string& relative, const std::string& fullPath, const struct stat& st) {
+        IntegrityEntry entry;
+        entry.path = relative;
+        entry.mode = st.st_mode & 07777;
+        entry.size = static_cast<uint64_t>(st.st_size);
+        entry.ino = st.st_ino;
+        entry.mtimeNs = toNs(st.st_mtim);
+        entry.ctimeNs = toNs(st.st_ctim);
+
+        if (S_ISDIR(st.st_mode)) {
+            entry.type = "dir";
+            entry.size = 0;
+        } else if (S_ISREG(st.st_mode)) {
+            entry.type = "file";
+            auto it = known.find(relative);
+            if (it != known.end() && it->second->type == "file" && it->second->ino == entry.ino &&
+                it->second->size == entry.size && it->second->mtimeNs == entry.mtimeNs &&
+                it->second->ctimeNs == entry.ctimeNs) {
+                entry.digest = it->second->digest;
+            }
+        } else if (S_ISLNK(st.st_mode)) {
+            entry.type = "symlink";
+            std::string target(static_cast<size_t>(st.st_size) + 1, '\0');
+            ssize_t len = readlink(fullPath.c_str(), target.data(), target.size());
+            target.resize(len > 0 ? static_cast<size_t>(len) : 0);
+            entry.target = target;
+        } else {
+            entry.type = "other";
+        }
+        entries_.push_back(entry);
+    };
+
+    record("", root_, rootStat);
+
+    bool complete = true;
+    std::error_code ec;
+    std::filesystem::recursive_directory_iterator it(root_, ec);
+    for (; !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        std::string fullPath = it->path().string();
+        struct stat st;
+        if (lstat(fullPath.c_str(), &st) < 0) {
+            complete = false;
+            continue;
+        }
+        // Mounts inside the image are not part of it
+        if (st.st_dev != rootStat.st_dev) {
+            it.disable_recursion_pending();
+            continue;
+        }
+        record(fullPath.substr(root_.size() + 1), fullPath, st);
+    }
+    if (ec) {
+        SANDBOX_ERROR("Failed to walk " + root_ + ": " + ec.message());
+        complete = false;
+    }
+
+    std::sort(entries_.begin(), entries_.end(), [](const IntegrityEntry& a, const IntegrityEntry& b) {
+        return a.path < b.path;
+    });
+
+    // Hash whatever could not be reused, spread over the CPUs
+    std::vector<IntegrityEntry*> pending;
+    for (auto& entry : entries_) {
+        if (entry.type == "file" && entry.digest.empty()) {
+            pending.push_back(&entry);
+        }
+    }
+    rehashed_ = pending.size();
+
+    size_t workers = threads > 0 ? static_cast<size_t>(threads)
+                                 : std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, pending.size());
+
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < workers; ++i) {
+        pool.emplace_back([&]() {
+            for (size_t index = next++; index < pending.size(); index = next++) {
+                IntegrityEntry* entry = pending[index];
+                if (!hashFile(root_ + "/" + entry->path, entry->digest)) {
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    if (failed) {
+        SANDBOX_WARNING("Some files of " + root_ + " could not be read");
+    }
+    return complete && !failed;
+}
+
+IntegrityReport IntegrityManifest::compare(const IntegrityManifest& reference) const {
+    IntegrityReport report;
+    report.files = entries_.size();
+    report.rehashed = rehashed_;
+
+    auto current = entries_.begin();
+    auto expected = reference.entries_.begin();
+    while (current != entries_.end() || expected != reference.entries_.end()) {
+        if (expected == reference.entries_.end() ||
+            (current != entries_.end() && current->path < expected->path)) {
+            // The runtime creates missing mount points; only contents count
+            if (current->type != "dir") {
+                report.added.push_back(current->path);
+            }
+            ++current;
+        } else if (current == entries_.end() || expected->path < current->path) {
+            report.missing.push_back(expected->path);
+            ++expected;
+        } else {
+            if (current->type != expected->type || current->mode != expected->mode ||
+                current->digest != expected->digest || current->target != expected->target) {
+                report.modified.push_back(current->path);
+            }
+            ++current;
+            ++expected;
+        }
+    }
+
+    return report;
+}
+
+IntegrityReport IntegrityManifest::verify(const std::string& root, int threads, bool full) {
+    IntegrityManifest current;
+    current.scan(root, threads, full ? nullptr : this);
+    IntegrityReport report = current.compare(*this);
+
+    if (report.ok() && report.rehashed > 0) {
+        entries_ = current.entries_;
+    }
+    return report;
+}
+
+bool IntegrityManifest::load(const std::string& path) {
+    auto content = Syscall::readFile(path);
+    if (!content) {
+        return false;
+    }
+
+    try {
+        json manifest = json::parse(*content);
+        if (manifest.value("algorithm", "") != "xxh64") {
+            SANDBOX_ERROR("Unsupported integrity manifest: " + path);
+            return false;
+        }
+
+        root_ = manifest.value("root", "");
+        entries_.clear();
+        for (const auto& e : manifest.at("entries")) {
+            IntegrityEntry entry;
+            entry.path = e.at("path");
+            entry.type = e.at("type");
+            entry.mode = e.value("mode", 0);
+            entry.size = e.value("size", 0ULL);
+            entry.ino = e.value("ino", 0ULL);
+            entry.mtimeNs = e.value("mtime_ns", 0LL);
+            entry.ctimeNs = e.value("ctime_ns", 0LL);
+            entry.digest = e.value("digest", "");
+            entry.target = e.value("target", "");
+            entries_.push_back(entry);
+        }
+    } catch (const json::exception& e) {
+        SANDBOX_ERROR("Invalid integrity manifest " + path + ": " + e.what());
+        return false;
+    }
+
+    std::sort(entries_.begin(), entries_.end(), [](const IntegrityEntry& a, const IntegrityEntry& b) {
+        return a.path < b.path;
+    });
+    return true;
+}
+
+bool IntegrityManifest::save(const std::string& path) const {
+    std::string dir = std::filesystem::path(path).parent_path().string();
+    if (!dir.empty() && !Syscall::isDirectory(dir) && !Syscall::mkdirRecursive(dir, 0755)) {
+        return false;
+    }
+
+    json entries = json::array();
+    for (const auto& entry : entries_) {
+        json e = {{"path", entry.path}, {"type", entry.type}, {"mode", entry.mode},
+                  {"size", entry.size}, {"ino", entry.ino}, {"mtime_ns", entry.mtimeNs},
+                  {"ctime_ns", entry.ctimeNs}};
+        if (!entry.digest.empty()) {
+            e["digest"] = entry.digest;
+        }
+        if (!entry.target.empty()) {
+            e["target"] = entry.target;
+        }
+        entries.push_back(e);
+    }
+
+    json manifest;
+    manifest["version"] = 1;
+    manifest["algorithm"] = "xxh64";
+    manifest["root"] = root_;
+    manifest["digest"] = digest();
+    manifest["entries"] = entries;
+
+    std::string tmpPath = path + ".tmp";
+    if (!Syscall::writeFile(tmpPath, manifest.dump())) {
+        return false;
+    }
+    if (::rename(tmpPath.c_str(), path.c_str()) < 0) {
+        SANDBOX_ERROR("Failed to store integrity manifest: " + std::string(strerror(errno)));
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string IntegrityManifest::digest() const {
+    // Only what makes up the contents, never inode numbers or times
+    Xxh64 hash;
+    for (const auto& entry : entries_) {
+        std::string line = entry.path + '\0' + entry.type + '\0' + std::to_string(entry.mode) + '\0' +
+                           entry.digest + '\0' + entry.target + '\n';
+        hash.update(line.data(), line.size());
+    }
+    return Xxh64::toHex(hash.digest());
+}
+
+const std::vector<IntegrityEntry>& IntegrityManifest::entries() const {
+    return entries_;
+}
+
+size_t IntegrityManifest::rehashed() const {
+    return rehashed_;
+}
+
+std::string IntegrityManifest::pathFor(const std::string& integrityDir, const std::string& root) {
+    std::string normal = normalize(root);
+    return integrityDir + "/" + Xxh64::toHex(Xxh64::hash(normal.data(), normal.size())) + ".json";
+}
+
+} // namespace sandbox
@@ -0,0 +1,157 @@
+/**
+ * @file IntegrityManifest.h
+ * @brief Per-file content hashes of a rootfs image.
+ *
+ * This header defines the IntegrityManifest class that records a hash
+ * of every file of a directory rootfs, so that the image can be checked
+ * for modification before a sandbox uses it.
+ */
+
+#ifndef SANDBOX_INTEGRITY_MANIFEST_H
+#define SANDBOX_INTEGRITY_MANIFEST_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace sandbox {
+
+/**
+ * @struct IntegrityEntry
+ * @brief Recorded state of one file.
+ */
+struct IntegrityEntry {
+    std::string path;          ///< Path relative to the image root, "" for the root
+    std::string type;          ///< "dir", "file", "symlink" or "other"
+    mode_t mode;               ///< Permission bits
+    uint64_t size;
+    uint64_t ino;              ///< Inode when hashed
+    int64_t mtimeNs;           ///< Modification time when hashed
+    int64_t ctimeNs;           ///< Change time when hashed
+    std::string digest;        ///< XXH64 of the contents of a file
+    std::string target;        ///< Target of a symlink
+};
+
+/**
+ * @struct IntegrityReport
+ * @brief Differences between an image and its manifest.
+ */
+struct IntegrityReport {
+    size_t files;                        ///< Files checked
+    size_t rehashed;                     ///< Files whose contents were read
+    std::vector<std::string> modified;   ///< Different contents, type, mode or target
+    std::vector<std::string> missing;    ///< In the manifest, not in the image
+    std::vector<std::string> added;      ///< In the image, not in the manifest; directories are not counted
+
+    /**
+     * @brief Check whether the image matches the manifest.
+     * @return true if nothing differs.
+     */
+    bool ok() const { return modified.empty() && missing.empty() && added.empty(); }
+};
+
+/**
+ * @class IntegrityManifest
+ * @brief Hashes an image in parallel and checks it incrementally.
+ *
+ * Files are hashed with XXH64 by a pool of threads. Along with each
+ * hash the manifest keeps the inode, size, modification and change time
+ * of the file; a later scan trusts the recorded hash of a file whose
+ * stat is unchanged and rehashes only the others, so checking an
+ * untouched image costs one stat per file.
+ *
+ * The digest over all entries identifies the image contents and can
+ * key caches of results computed from the image.
+ */
+class IntegrityManifest {
+public:
+    IntegrityManifest();
+
+    /**
+     * @brief Record the current state of an image.
+     * @param root The image root.
+     * @param threads Hashing threads, 0 for one per CPU.
+     * @param reference Manifest whose hashes may be reused for unchanged
+     *        files, or nullptr to hash everything.
+     * @return true if the whole tree was read.
+     */
+    bool scan(const std::string& root, int threads, const IntegrityManifest* reference = nullptr);
+
+    /**
+     * @brief Compare this manifest with a reference.
+     * @param reference The trusted manifest.
+     * @return The differences.
+     */
+    IntegrityReport compare(const IntegrityManifest& reference) const;
+
+    /**
+     * @brief Check an image against this manifest.
+     *
+     * When the image matches but some files had to be rehashed, the
+     * manifest takes over their new stat so the next check skips them.
+     *
+     * @param root The image root.
+     * @param threads Hashing threads, 0 for one per CPU.
+     * @param full Rehash every file instead of trusting unchanged stats.
+     * @return The differences.
+     */
+    IntegrityReport verify(const std::string& root, int threads, bool full);
+
+    /**
+     * @brief Load a manifest.
+     * @param path The manifest file.
+     * @return true if successful.
+     */
+    bool load(const std::string& path);
+
+    /**
+     * @brief Save the manifest, replacing any previous file atomically.
+     * @param path The manifest file.
+     * @return true if successful.
+     */
+    bool save(const std::string& path) const;
+
+    /**
+     * @brief Get the digest over all entries.
+     * @return 16 hex digits identifying the image contents.
+     */
+    std::string digest() const;
+
+    /**
+     * @brief Get the recorded files, sorted by path.
+     * @return The entries.
+     */
+    const std::vector<IntegrityEntry>& entries() const;
+
+    /**
+     * @brief Get the number of files read by the last scan.
+     * @return The count.
+     */
+    size_t rehashed() const;
+
+    /**
+     * @brief Get where the manifest of an image is kept.
+     * @param integrityDir The manifest directory.
+     * @param root The image root.
+     * @return The manifest path.
+     */
+    static std::string pathFor(const std::string& integrityDir, const std::string& root);
+
+    /**
+     * @brief Hash the contents of a file.
+     * @param path The file.
+     * @param digest Output hex digest.
+     * @return true if successful.
+     */
+    static bool hashFile(const std::string& path, std::string& digest);
+
+private:
+    std::string root_;
+    std::vector<IntegrityEntry> entries_;
+    size_t rehashed_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_INTEGRITY_MANIFEST_H
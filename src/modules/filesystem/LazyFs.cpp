@@ -0,0 +1,419 @@
+/**
+ * @file LazyFs.cpp
+ * @brief Implementation of the LazyFs class.
+ */
+
+#include "modules/filesystem/LazyFs.h"
+#include "utils/Syscalls.h"
+#include "core/Logger.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <linux/fuse.h>
+
+namespace sandbox {
+
+namespace {
+
+// The image never changes, so entries and attributes never expire
+constexpr uint64_t kCacheTimeout = 24 * 3600;
+constexpr uint32_t kMaxWrite = 128 * 1024;
+constexpr size_t kBufferSize = kMaxWrite + 4096;
+
+uint32_t typeBits(const ImageEntry& entry) {
+    if (entry.type == "dir") {
+        return S_IFDIR;
+    }
+    if (entry.type == "symlink") {
+        return S_IFLNK;
+    }
+    return S_IFREG;
+}
+
+} // namespace
+
+LazyFs::LazyFs(const std::string& cacheDir, int threads)
+    : cacheDir_(cacheDir)
+    , threadCount_(std::max(1, threads))
+    , fuseFd_(-1)
+    , stopFd_(-1)
+{
+}
+
+LazyFs::~LazyFs() {
+    unmount();
+}
+
+bool LazyFs::mount(const std::string& manifestPath, const std::string& mountPoint) {
+    if (!pack_.load(manifestPath) || !buildTree()) {
+        return false;
+    }
+
+    if (!Syscall::isDirectory(cacheDir_) && !Syscall::mkdirRecursive(cacheDir_, 0700)) {
+        SANDBOX_ERROR("Failed to create blob cache: " + cacheDir_);
+        return false;
+    }
+
+    fuseFd_ = open("/dev/fuse", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fuseFd_ < 0) {
+        SANDBOX_ERROR("Failed to open /dev/fuse: " + std::string(strerror(errno)));
+        return false;
+    }
+    stopFd_ = eventfd(0, EFD_CLOEXEC);
+
+    std::string options = "fd=" + std::to_string(fuseFd_) +
+                          ",rootmode=40000,user_id=0,group_id=0,allow_other,default_permissions";
+    if (::mount("sandbox-lazy", mountPoint.c_str(), "fuse", MS_NOSUID | MS_NODEV | MS_RDONLY,
+                options.c_str()) < 0) {
+        SANDBOX_ERROR("Failed to mount lazy rootfs at " + mountPoint + ": " + std::string(strerror(errno)));
+        close(fuseFd_);
+        close(stopFd_);
+        fuseFd_ = -1;
+        stopFd_ = -1;
+        return false;
+    }
+    mountPoint_ = mountPoint;
+    start();
+
+    SANDBOX_INFO("Mounted lazy rootfs " + manifestPath + " at " + mountPoint + " (" +
+                 std::to_string(nodes_.size()) + " files)");
+    return true;
+}
+
+void LazyFs::pause() {
+    if (stopFd_ < 0 || workers_.empty()) {
+        return;
+    }
+
+    uint64_t one = 1;
+    if (write(stopFd_, &one, sizeof(one)) < 0) {
+        SANDBOX_WARNING("Failed to stop lazy rootfs server");
+    }
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+
+    // Reset the eventfd so that restarted threads keep serving
+    uint64_t count;
+    if (read(stopFd_, &count, sizeof(count)) < 0) {
+        SANDBOX_DEBUG("Lazy rootfs server stop event already cleared");
+    }
+}
+
+void LazyFs::start() {
+    if (fuseFd_ < 0 || !workers_.empty()) {
+        return;
+    }
+    for (int i = 0; i < threadCount_; ++i) {
+        workers_.emplace_back(&LazyFs::serve, this);
+    }
+}
+
+void LazyFs::unmount() {
+    if (!mountPoint_.empty()) {
+        if (umount2(mountPoint_.c_str(), MNT_DETACH) < 0) {
+            SANDBOX_WARNING("Failed to unmount " + mountPoint_ + ": " + std::string(strerror(errno)));
+        }
+        mountPoint_.clear();
+    }
+
+    pause();
+
+    // Closing the device aborts whatever still references the mount
+    if (fuseFd_ >= 0) {
+        close(fuseFd_);
+        fuseFd_ = -1;
+    }
+    if (stopFd_ >= 0) {
+        close(stopFd_);
+        stopFd_ = -1;
+    }
+}
+
+bool LazyFs::buildTree() {
+    const auto& entries = pack_.entries();
+    nodes_.clear();
+    nodes_.reserve(entries.size());
+
+    std::unordered_map<std::string, uint64_t> inodes;
+    for (const auto& entry : entries) {
+        uint64_t ino = nodes_.size() + 1;
+        uint64_t parent = FUSE_ROOT_ID;
+        std::string name;
+
+        if (entry.path != "/") {
+            size_t slash = entry.path.rfind('/');
+            std::string parentPath = slash == 0 ? "/" : entry.path.substr(0, slash);
+            name = entry.path.substr(slash + 1);
+            auto it = inodes.find(parentPath);
+            if (it == inodes.end() || nodes_[it->second - 1].entry->type != "dir" || name.empty()) {
+                SANDBOX_ERROR("Image manifest lists " + entry.path + " before its directory");
+                return false;
+            }
+            parent = it->second;
+            nodes_[parent - 1].children[name] = ino;
+        }
+
+        nodes_.push_back({&entry, parent, {}, {}});
+        inodes[entry.path] = ino;
+    }
+
+    for (auto& n : nodes_) {
+        n.listing.assign(n.children.begin(), n.children.end());
+    }
+    return true;
+}
+
+const LazyFs::Node* LazyFs::node(uint64_t ino) const {
+    if (ino == 0 || ino > nodes_.size()) {
+        return nullptr;
+    }
+    return &nodes_[ino - 1];
+}
+
+void LazyFs::fillAttr(uint64_t ino, void* out) const {
+    auto* attr = static_cast<struct fuse_attr*>(out);
+    const ImageEntry& entry = *nodes_[ino - 1].entry;
+
+    std::memset(attr, 0, sizeof(*attr));
+    attr->ino = ino;
+    attr->size = entry.size;
+    attr->blocks = (entry.size + 511) / 512;
+    attr->atime = attr->mtime = attr->ctime = static_cast<uint64_t>(entry.mtime);
+    attr->mode = typeBits(entry) | (entry.mode & 07777);
+    attr->nlink = entry.type == "dir" ? 2 : 1;
+    attr->uid = entry.uid;
+    attr->gid = entry.gid;
+    attr->blksize = 4096;
+}
+
+void LazyFs::serve() {
+    std::vector<char> buffer(kBufferSize);
+    struct pollfd fds[2] = {{fuseFd_, POLLIN, 0}, {stopFd_, POLLIN, 0}};
+
+    while (true) {
+        if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+
+        ssize_t len = read(fuseFd_, buffer.data(), buffer.size());
+        if (len < 0) {
+            // Another thread took the request, or it was interrupted
+            if (errno == EAGAIN || errno == EINTR || errno == ENOENT) {
+                continue;
+            }
+            // ENODEV: the filesystem was unmounted
+            return;
+        }
+        if (static_cast<size_t>(len) >= sizeof(struct fuse_in_header)) {
+            handle(buffer.data(), static_cast<size_t>(len));
+        }
+    }
+}
+
+void LazyFs::reply(uint64_t unique, int error, const void* data, size_t size) {
+    struct fuse_out_header header;
+    header.len = static_cast<uint32_t>(sizeof(header) + (error ? 0 : size));
+    header.error = -error;
+    header.unique = unique;
+
+    struct iovec iov[2] = {{&header, sizeof(header)}, {const_cast<void*>(data), error ? 0 : size}};
+    // ENOENT means the request was interrupted meanwhile
+    if (writev(fuseFd_, iov, 2) < 0 && errno != ENOENT) {
+        SANDBOX_DEBUG("Failed to answer FUSE request: " + std::string(strerror(errno)));
+    }
+}
+
+void LazyFs::handle(const char* request, size_t size) {
+    const auto* in = reinterpret_cast<const struct fuse_in_header*>(request);
+    const char* arg = request + sizeof(*in);
+    const Node* n = node(in->nodeid);
+
+    switch (in->opcode) {
+    case FUSE_INIT: {
+        const auto* init = reinterpret_cast<const struct fuse_init_in*>(arg);
+        if (init->major != FUSE_KERNEL_VERSION) {
+            reply(in->unique, EPROTO);
+            return;
+        }
+        struct fuse_init_out out;
+        std::memset(&out, 0, sizeof(out));
+        out.major = FUSE_KERNEL_VERSION;
+        out.minor = FUSE_KERNEL_MINOR_VERSION;
+        out.max_readahead = init->max_readahead;
+        out.flags = FUSE_ASYNC_READ;
+        out.max_background = 16;
+        out.congestion_threshold = 12;
+        out.max_write = kMaxWrite;
+        out.time_gran = 1000000000;
+        reply(in->unique, 0, &out, init->minor < 23 ? FUSE_COMPAT_22_INIT_OUT_SIZE : sizeof(out));
+        return;
+    }
+
+    case FUSE_LOOKUP: {
+        if (!n) {
+            reply(in->unique, ENOENT);
+            return;
+        }
+        struct fuse_entry_out out;
+        std::memset(&out, 0, sizeof(out));
+        auto it = n->children.find(std::string(arg, strnlen(arg, size - sizeof(*in))));
+        // Cache misses too: an immutable image never grows the name
+        out.entry_valid = kCacheTimeout;
+        if (it != n->children.end()) {
+            out.nodeid = it->second;
+            out.generation = 1;
+            out.attr_valid = kCacheTimeout;
+            fillAttr(it->second, &out.attr);
+        }
+        reply(in->unique, 0, &out, sizeof(out));
+        return;
+    }
+
+    case FUSE_FORGET:
+    case FUSE_BATCH_FORGET:
+    case FUSE_INTERRUPT:
+        // Inodes are static and requests are short: nothing to do, no reply
+        return;
+
+    case FUSE_GETATTR: {
+        if (!n) {
+            reply(in->unique, ENOENT);
+            return;
+        }
+        struct fuse_attr_out out;
+        std::memset(&out, 0, sizeof(out));
+        out.attr_valid = kCacheTimeout;
+        fillAttr(in->nodeid, &out.attr);
+        reply(in->unique, 0, &out, sizeof(out));
+        return;
+    }
+
+    case FUSE_READLINK:
+        if (!n || n->entry->type != "symlink") {
+            reply(in->unique, EINVAL);
+            return;
+        }
+        reply(in->unique, 0, n->entry->target.data(), n->entry->target.size());
+        return;
+
+    case FUSE_OPEN: {
+        if (!n || n->entry->type != "file") {
+            reply(in->unique, n ? EISDIR : ENOENT);
+            return;
+        }
+        // First access materializes the blob
+        int fd = pack_.fetch(n->entry->digest, cacheDir_);
+        if (fd < 0) {
+            reply(in->unique, EIO);
+            return;
+        }
+        struct fuse_open_out out;
+        std::memset(&out, 0, sizeof(out));
+        out.fh = static_cast<uint64_t>(fd);
+        out.open_flags = FOPEN_KEEP_CACHE;
+        reply(in->unique, 0, &out, sizeof(out));
+        return;
+    }
+
+    case FUSE_READ: {
+        const auto* read = reinterpret_cast<const struct fuse_read_in*>(arg);
+        std::vector<char> data(read->size);
+        ssize_t len = pread(static_cast<int>(read->fh), data.data(), data.size(),
+                            static_cast<off_t>(read->offset));
+        if (len < 0) {
+            reply(in->unique, errno);
+            return;
+        }
+        reply(in->unique, 0, data.data(), static_cast<size_t>(len));
+        return;
+    }
+
+    case FUSE_RELEASE: {
+        const auto* release = reinterpret_cast<const struct fuse_release_in*>(arg);
+        close(static_cast<int>(release->fh));
+        reply(in->unique, 0);
+        return;
+    }
+
+    case FUSE_OPENDIR: {
+        if (!n || n->entry->type != "dir") {
+            reply(in->unique, n ? ENOTDIR : ENOENT);
+            return;
+        }
+        struct fuse_open_out out;
+        std::memset(&out, 0, sizeof(out));
+        out.open_flags = FOPEN_KEEP_CACHE | FOPEN_CACHE_DIR;
+        reply(in->unique, 0, &out, sizeof(out));
+        return;
+    }
+
+    case FUSE_READDIR: {
+        const auto* read = reinterpret_cast<const struct fuse_read_in*>(arg);
+        if (!n) {
+            reply(in->unique, ENOENT);
+            return;
+        }
+
+        std::vector<char> data(read->size);
+        size_t used = 0;
+        // Offsets 0 and 1 are "." and ".."; children follow
+        for (uint64_t index = read->offset; index < n->listing.size() + 2; ++index) {
+            std::string name = index == 0 ? "." : index == 1 ? ".." : n->listing[index - 2].first;
+            uint64_t ino = index == 0 ? in->nodeid : index == 1 ? n->parent : n->listing[index - 2].second;
+
+            size_t entrySize = FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET + name.size());
+            if (used + entrySize > data.size()) {
+                break;
+            }
+            auto* dirent = reinterpret_cast<struct fuse_dirent*>(data.data() + used);
+            std::memset(dirent, 0, entrySize);
+            dirent->ino = ino;
+            dirent->off = index + 1;
+            dirent->namelen = static_cast<uint32_t>(name.size());
+            dirent->type = typeBits(*nodes_[ino - 1].entry) >> 12;
+            std::memcpy(dirent->name, name.data(), name.size());
+            used += entrySize;
+        }
+        reply(in->unique, 0, data.data(), used);
+        return;
+    }
+
+    case FUSE_RELEASEDIR:
+    case FUSE_FLUSH:
+    case FUSE_ACCESS:
+    case FUSE_DESTROY:
+        reply(in->unique, 0);
+        return;
+
+    case FUSE_STATFS: {
+        struct fuse_statfs_out out;
+        std::memset(&out, 0, sizeof(out));
+        out.st.bsize = 4096;
+        out.st.frsize = 4096;
+        out.st.files = nodes_.size();
+        out.st.namelen = 255;
+        reply(in->unique, 0, &out, sizeof(out));
+        return;
+    }
+
+    default:
+        // Includes xattrs; the kernel stops asking after ENOSYS
+        reply(in->unique, ENOSYS);
+        return;
+    }
+}
+
+} // namespace sandbox
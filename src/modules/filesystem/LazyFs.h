@@ -0,0 +1,110 @@
+/**
+ * @file LazyFs.h
+ * @brief Read-only FUSE filesystem serving a packed image on demand.
+ *
+ * This header defines the LazyFs class that presents an ImagePack as a
+ * filesystem and materializes file contents only when they are opened,
+ * so a sandbox can start before its image is fully unpacked.
+ */
+
+#ifndef SANDBOX_LAZY_FS_H
+#define SANDBOX_LAZY_FS_H
+
+#include "modules/filesystem/ImagePack.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sandbox {
+
+/**
+ * @class LazyFs
+ * @brief Serves a packed image over the FUSE kernel protocol.
+ *
+ * Directory listings and attributes come from the manifest; a file's
+ * blob is fetched into the blob cache when the file is first opened,
+ * and reads are served from the cached blob. The image is immutable,
+ * so the kernel may cache entries, attributes and pages indefinitely.
+ *
+ * The server speaks the protocol of /dev/fuse directly and needs no
+ * FUSE library. Its request threads run in the supervisor, so the
+ * filesystem lives as long as the supervisor does. They are paused
+ * while the supervisor forks the sandbox.
+ */
+class LazyFs {
+public:
+    /**
+     * @brief Construct a LazyFs.
+     * @param cacheDir The blob cache.
+     * @param threads Number of request threads.
+     */
+    LazyFs(const std::string& cacheDir, int threads);
+
+    /**
+     * @brief Destructor. Unmounts if still mounted.
+     */
+    ~LazyFs();
+
+    LazyFs(const LazyFs&) = delete;
+    LazyFs& operator=(const LazyFs&) = delete;
+
+    /**
+     * @brief Load an image and mount it.
+     * @param manifestPath Path to the image manifest.
+     * @param mountPoint Existing directory to mount on.
+     * @return true if mounted.
+     */
+    bool mount(const std::string& manifestPath, const std::string& mountPoint);
+
+    /**
+     * @brief Stop the request threads; requests queue until start().
+     *
+     * The threads log, so none may run while the sandbox is forked: a
+     * child forked while one holds the logger lock would deadlock.
+     */
+    void pause();
+
+    /**
+     * @brief Start the request threads again after pause().
+     */
+    void start();
+
+    /**
+     * @brief Detach the filesystem and stop serving it.
+     */
+    void unmount();
+
+private:
+    /**
+     * @struct Node
+     * @brief An inode of the image; the inode number is its index plus one.
+     */
+    struct Node {
+        const ImageEntry* entry;
+        uint64_t parent;
+        std::map<std::string, uint64_t> children;
+        std::vector<std::pair<std::string, uint64_t>> listing;  ///< children in readdir order
+    };
+
+    bool buildTree();
+    void serve();
+    void handle(const char* request, size_t size);
+    void reply(uint64_t unique, int error, const void* data = nullptr, size_t size = 0);
+    void fillAttr(uint64_t ino, void* attr) const;
+    const Node* node(uint64_t ino) const;
+
+    ImagePack pack_;
+    std::string cacheDir_;
+    int threadCount_;
+    int fuseFd_;
+    int stopFd_;
+    std::string mountPoint_;
+    std::vector<Node> nodes_;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_LAZY_FS_H
@@ -6,8 +6,16 @@
 #include "modules/filesystem/RootFS.h"
 #include "utils/Syscalls.h"
 #include "core/Logger.h"
+#include "core/ImageStore.h"
+#include "modules/filesystem/IntegrityManifest.h"
+#include "modules/filesystem/DebBootstrap.h"
+#include "modules/filesystem/DevTemplate.h"
+#include "modules/isolation/ResourceView.h"
+#include <sys/mount.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <cerrno>
 #include <cstdlib>
 
 namespace sandbox {
@@ -37,6 +45,25 @@ bool RootFS::initialize(const SandboxConfiguration& config) {
     rootPath_ = config.sandbox.rootfs_path;
     oldRootPath_ = "/oldroot";
 
+    devTemplate_ = config.mounts.dev_template;
+    if (!devTemplate_.empty() && !DevTemplate::prepare(devTemplate_)) {
+        SANDBOX_WARNING("No /dev template; sandboxes get an empty /dev");
+        devTemplate_.clear();
+    }
+
+    // A packed image is served on demand; there is nothing to bootstrap
+    if (!config.sandbox.rootfs_manifest.empty()) {
+        if (!mountLazyRoot(config)) {
+            SANDBOX_ERROR("Failed to mount lazy rootfs: " + config.sandbox.rootfs_manifest);
+            return false;
+        }
+        ImageStore(config.images).markUsed(config.sandbox.rootfs_manifest);
+
+        state_ = ModuleState::INITIALIZED;
+        SANDBOX_INFO("RootFS module initialized successfully");
+        return true;
+    }
+
     SANDBOX_DEBUG("Rootfs path: " + rootPath_);
 
     // Check if we need to bootstrap
@@ -56,6 +83,13 @@ bool RootFS::initialize(const SandboxConfiguration& config) {
         return false;
     }
 
+    if (config.images.verify_integrity && !verifyIntegrity(config)) {
+        return false;
+    }
+
+    // Keep the image from being collected as least recently used
+    ImageStore(config.images).markUsed(rootPath_);
+
     state_ = ModuleState::INITIALIZED;
     SANDBOX_INFO("RootFS module initialized successfully");
 
@@ -65,18 +99,40 @@ bool RootFS::initialize(const SandboxConfiguration& config) {
 bool RootFS::prepareChild(const SandboxConfiguration& config, pid_t childPid) {
     // Prepare rootfs in parent process (mounts are done in child)
     SANDBOX_DEBUG("Preparing rootfs for child process");
+    if (lazyFs_) {
+        lazyFs_->start();
+    }
     return true;
 }
 
 bool RootFS::applyChild(const SandboxConfiguration& config) {
     SANDBOX_INFO("Setting up root filesystem");
 
+    // Mounts made for the sandbox must not propagate back to the host
+    if (!Syscall::mount("", "/", "", MS_REC | MS_PRIVATE, nullptr)) {
+        SANDBOX_ERROR("Failed to make mounts private");
+        return false;
+    }
+
     // Set up mounts before pivot_root
     if (!setupMounts(config)) {
         SANDBOX_ERROR("Failed to setup mounts");
         return false;
     }
 
+    // The shared /dev template comes along with the recursive root bind
+    if (!devTemplate_.empty()) {
+        std::string devDir = rootPath_ + "/dev";
+        if (!Syscall::isDirectory(devDir) && !Syscall::mkdirRecursive(devDir)) {
+            SANDBOX_ERROR("Failed to create /dev");
+            return false;
+        }
+        if (!Syscall::mount(devTemplate_, devDir, "", MS_BIND | MS_REC, nullptr)) {
+            SANDBOX_ERROR("Failed to attach /dev template");
+            return false;
+        }
+    }
+
     // Create old root directory
     std::string oldRootDir = rootPath_ + oldRootPath_;
     if (!Syscall::mkdirRecursive(oldRootDir)) {
@@ -105,11 +161,22 @@ bool RootFS::applyChild(const SandboxConfiguration& config) {
         SANDBOX_WARNING("Failed to mount /sys");
     }
 
-    if (!Syscall::mount("tmpfs", "/dev", "tmpfs",
-                        MS_NOSUID | MS_STRICTATIME, "mode=755")) {
+    if (!devTemplate_.empty()) {
+        if (!DevTemplate::mountPrivate("/dev")) {
+            return false;
+        }
+    } else if (!Syscall::mount("tmpfs", "/dev", "tmpfs",
+                               MS_NOSUID | MS_STRICTATIME, "mode=755")) {
         SANDBOX_WARNING("Failed to mount /dev");
     }
 
+    // The emptied old root is the scratch space for the rendered files.
+    // The cgroup module pins first, so the affinity already is the quota.
+    if (config.resources.virtual_proc &&
+        !ResourceView::fromLimits(config.resources, Syscall::getAffinityCpus(), 0).mountProcFiles(oldRootPath_)) {
+        return false;
+    }
+
     state_ = ModuleState::RUNNING;
     return true;
 }
@@ -120,6 +187,7 @@ int RootFS::execute(const SandboxConfiguration& config) {
 
 bool RootFS::cleanup() {
     SANDBOX_DEBUG("Cleaning up RootFS module");
+    unmountLazyRoot();
     state_ = ModuleState::STOPPED;
     return true;
 }
@@ -148,9 +216,157 @@ bool RootFS::exists() const {
     return Syscall::exists(rootPath_);
 }
 
+std::vector<std::string> RootFS::getHostMounts() const {
+    if (lazyDir_.empty()) {
+        return {};
+    }
+    return {lazyDir_ + "/lower", lazyDir_ + "/root"};
+}
+
+std::vector<std::string> RootFS::getScratchDirs() const {
+    if (lazyDir_.empty()) {
+        return {};
+    }
+    return {lazyDir_};
+}
+
+std::string RootFS::getImageDigest() const {
+    return imageDigest_;
+}
+
+bool RootFS::verifyIntegrity(const SandboxConfiguration& config) {
+    std::string manifestPath = IntegrityManifest::pathFor(config.images.integrity_dir, rootPath_);
+    // Only a missing manifest means unsealed; one that cannot be read is refused
+    struct stat st;
+    if (stat(manifestPath.c_str(), &st) < 0 && errno == ENOENT) {
+        SANDBOX_WARNING("Rootfs " + rootPath_ + " is not sealed; run 'sandbox seal-image' to verify it");
+        return true;
+    }
+    IntegrityManifest manifest;
+    if (!manifest.load(manifestPath)) {
+        SANDBOX_ERROR("Cannot load integrity manifest " + manifestPath + " of rootfs " + rootPath_);
+        return false;
+    }
+
+    IntegrityReport report = manifest.verify(rootPath_, config.images.integrity_threads, false);
+    if (!report.ok()) {
+        for (const auto& path : report.modified) {
+            SANDBOX_ERROR("Rootfs file modified: /" + path);
+        }
+        for (const auto& path : report.missing) {
+            SANDBOX_ERROR("Rootfs file missing: /" + path);
+        }
+        for (const auto& path : report.added) {
+            SANDBOX_ERROR("Rootfs file added: /" + path);
+        }
+        SANDBOX_ERROR("Rootfs " + rootPath_ + " does not match its integrity manifest");
+        return false;
+    }
+
+    // Remember the new stat of rehashed files so the next check skips them
+    if (report.rehashed > 0 && !manifest.save(manifestPath)) {
+        SANDBOX_WARNING("Failed to update integrity manifest " + manifestPath);
+    }
+
+    imageDigest_ = manifest.digest();
+    SANDBOX_DEBUG("Rootfs verified: " + std::to_string(report.files) + " files, " +
+                  std::to_string(report.rehashed) + " rehashed, digest " + imageDigest_);
+    return true;
+}
+
+bool RootFS::mountLazyRoot(const SandboxConfiguration& config) {
+    lazyDir_ = config.images.lazy_run_dir + "/" + config.sandbox.name + "-" + std::to_string(getpid());
+    std::string lower = lazyDir_ + "/lower";
+    std::string upper = lazyDir_ + "/upper";
+    std::string work = lazyDir_ + "/work";
+    std::string root = lazyDir_ + "/root";
+
+    for (const auto& dir : {lower, upper, work, root}) {
+        if (!Syscall::mkdirRecursive(dir, 0755)) {
+            unmountLazyRoot();
+            return false;
+        }
+    }
+
+    lazyFs_ = std::make_unique<LazyFs>(config.images.blob_cache_dir, config.images.lazy_threads);
+    if (!lazyFs_->mount(config.sandbox.rootfs_manifest, lower)) {
+        unmountLazyRoot();
+        return false;
+    }
+
+    // The image is read-only; writes of the sandbox go to a private upper layer
+    std::string options = "lowerdir=" + lower + ",upperdir=" + upper + ",workdir=" + work;
+    if (!Syscall::mount("overlay", root, "overlay", 0, options.c_str())) {
+        unmountLazyRoot();
+        return false;
+    }
+
+    // The overlay mount needed the server; it resumes once the sandbox is forked
+    lazyFs_->pause();
+    rootPath_ = root;
+    return true;
+}
+
+void RootFS::unmountLazyRoot() {
+    if (lazyDir_.empty()) {
+        return;
+    }
+
+    umount2((lazyDir_ + "/root").c_str(), MNT_DETACH);
+    lazyFs_.reset();
+    Syscall::removeRecursive(lazyDir_);
+    lazyDir_.clear();
+}
+
 bool RootFS::bootstrap(const SandboxConfiguration& config) {
     SANDBOX_INFO("Bootstrapping rootfs: " + config.sandbox.distro + " " + config.sandbox.release);
 
+    if (config.sandbox.bootstrap_packages.empty()) {
+        return runDebootstrap(config);
+    }
+
+    // Offline from local packages
+    DebBootstrap debs(config.sandbox.bootstrap_packages, config.sandbox.bootstrap_arch,
+                      config.sandbox.bootstrap_threads);
+    std::vector<const DebPackage*> selected;
+    if (!debs.loadIndex(config.sandbox.release) ||
+        !debs.resolve(config.sandbox.bootstrap_include, selected)) {
+        SANDBOX_ERROR("Cannot bootstrap from " + config.sandbox.bootstrap_packages);
+        return false;
+    }
+    SANDBOX_INFO("Installing " + std::to_string(selected.size()) + " packages");
+
+    if (!debs.install(config.sandbox.rootfs_path, selected)) {
+        SANDBOX_ERROR("Bootstrap failed; removing partial rootfs");
+        Syscall::removeRecursive(config.sandbox.rootfs_path);
+        return false;
+    }
+
+    SANDBOX_INFO("Bootstrap completed successfully");
+    return true;
+}
+
+bool RootFS::runDebootstrap(const SandboxConfiguration& config) {
+    std::string arch = config.sandbox.bootstrap_arch.empty() ? DebBootstrap::hostArch()
+                                                             : config.sandbox.bootstrap_arch;
+    std::vector<std::string> args = {"debootstrap", "--arch=" + arch, "--variant=minbase"};
+    if (!config.sandbox.bootstrap_include.empty()) {
+        std::string include;
+        for (const auto& package : config.sandbox.bootstrap_include) {
+            include += (include.empty() ? "" : ",") + package;
+        }
+        args.push_back("--include=" + include);
+    }
+    args.push_back(config.sandbox.release);
+    args.push_back(config.sandbox.rootfs_path);
+    args.push_back(config.sandbox.bootstrap_mirror);
+
+    std::vector<char*> argv;
+    for (auto& arg : args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+
     // Fork to run debootstrap
     pid_t pid = fork();
     if (pid < 0) {
@@ -160,19 +376,7 @@ bool RootFS::bootstrap(const SandboxConfiguration& config) {
 
     if (pid == 0) {
         // Child process
-        const char* distro = config.sandbox.distro.c_str();
-        const char* release = config.sandbox.release.c_str();
-        const char* path = config.sandbox.rootfs_path.c_str();
-        const char* mirror = "http://archive.ubuntu.com/ubuntu/";
-
-        // Execute debootstrap
-        execlp("debootstrap", "debootstrap",
-               "--arch=amd64",
-               "--variant=minbase",
-               release,
-               path,
-               mirror,
-               (char*)nullptr);
+        execvp("debootstrap", argv.data());
 
         // If we get here, debootstrap failed
         _exit(1);
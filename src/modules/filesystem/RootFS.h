@@ -11,6 +11,8 @@
 
 #include "modules/interface/IModule.h"
 #include "core/ConfigParser.h"
+#include "modules/filesystem/LazyFs.h"
+#include <memory>
 #include <string>
 
 namespace sandbox {
@@ -63,13 +65,53 @@ public:
     bool exists() const;
 
     /**
-     * @brief Bootstrap a new rootfs using debootstrap.
+     * @brief Bootstrap a new rootfs, offline from local packages if configured.
      * @param config The sandbox configuration.
      * @return true if successful.
      */
     bool bootstrap(const SandboxConfiguration& config);
 
+    /**
+     * @brief Get the host-side mounts made for the sandbox, outermost first.
+     * @return The mount points.
+     */
+    std::vector<std::string> getHostMounts() const;
+
+    /**
+     * @brief Get the scratch directories made for the sandbox.
+     * @return The directories.
+     */
+    std::vector<std::string> getScratchDirs() const;
+
+    /**
+     * @brief Get the digest of the verified image contents.
+     * @return The manifest digest, empty unless integrity was verified.
+     */
+    std::string getImageDigest() const;
+
 private:
+    /**
+     * @brief Serve a packed image lazily and overlay a writable layer.
+     *
+     * The merged tree becomes the root path of the sandbox.
+     *
+     * @param config The sandbox configuration.
+     * @return true if successful.
+     */
+    bool mountLazyRoot(const SandboxConfiguration& config);
+
+    /**
+     * @brief Tear down a lazily served root filesystem.
+     */
+    void unmountLazyRoot();
+
+    /**
+     * @brief Check a directory rootfs against its integrity manifest.
+     * @param config The sandbox configuration.
+     * @return false if the image was modified.
+     */
+    bool verifyIntegrity(const SandboxConfiguration& config);
+
     /**
      * @brief Check if the rootfs needs to be created.
      * @return true if needs creation.
@@ -103,6 +145,10 @@ private:
     std::string rootPath_;
     std::string oldRootPath_;
     bool bootstrapRequired_;
+    std::unique_ptr<LazyFs> lazyFs_;  ///< Server of a lazy rootfs, if any
+    std::string lazyDir_;             ///< Scratch directory of a lazy rootfs
+    std::string imageDigest_;         ///< Digest of the verified image
+    std::string devTemplate_;         ///< Prepared /dev template, empty for a bare tmpfs
 };
 
 } // namespace sandbox
@@ -0,0 +1,283 @@
+/**
+ * @file Channels.cpp
+ * @brief Implementation of the Channels class.
+ */
+
+#include "modules/ipc/Channels.h"
+#include "utils/Syscalls.h"
+#include "core/Logger.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#ifndef OPEN_TREE_CLONE
+#define OPEN_TREE_CLONE 1
+#endif
+#ifndef OPEN_TREE_CLOEXEC
+#define OPEN_TREE_CLOEXEC O_CLOEXEC
+#endif
+#ifndef MOVE_MOUNT_F_EMPTY_PATH
+#define MOVE_MOUNT_F_EMPTY_PATH 0x00000004
+#endif
+
+namespace sandbox {
+
+Channels::Channels()
+    : state_(ModuleState::UNINITIALIZED)
+{
+}
+
+Channels::~Channels() {
+    closeChannels();
+}
+
+std::string Channels::getName() const {
+    return "channels";
+}
+
+std::string Channels::getVersion() const {
+    return "1.0.0";
+}
+
+ModuleState Channels::getState() const {
+    return state_;
+}
+
+std::string Channels::envName(const std::string& name) {
+    std::string env = "SANDBOX_CHANNEL_";
+    for (char c : name) {
+        env += std::isalnum(static_cast<unsigned char>(c))
+             ? static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : '_';
+    }
+    return env;
+}
+
+bool Channels::initialize(const SandboxConfiguration& config) {
+    SANDBOX_INFO("Initializing Channels module");
+    config_ = config;
+
+    if (config.ipc.channels.empty()) {
+        state_ = ModuleState::INITIALIZED;
+        return true;
+    }
+
+    if (!Syscall::isDirectory(config.ipc.channel_dir) &&
+        !Syscall::mkdirRecursive(config.ipc.channel_dir, 0755)) {
+        SANDBOX_ERROR("Failed to create channel directory: " + config.ipc.channel_dir);
+        return false;
+    }
+
+    for (const auto& channelConfig : config.ipc.channels) {
+        OpenChannel channel;
+        channel.config = channelConfig;
+        channel.lockPath = config.ipc.channel_dir + "/." + channelConfig.name + ".lock";
+        channel.lockFd = -1;
+        channel.fd = -1;
+        channel.detachedMount = false;
+
+        bool opened = lockChannel(channel) &&
+                      (channelConfig.type == "shm" ? openShmChannel(channel)
+                                                   : openSocketChannel(channel));
+        channels_.push_back(channel);
+        if (!opened) {
+            SANDBOX_ERROR("Failed to open channel: " + channelConfig.name);
+            return false;
+        }
+
+        SANDBOX_DEBUG("Opened " + channelConfig.type + " channel " + channelConfig.name +
+                      " at " + channel.hostPath);
+    }
+
+    state_ = ModuleState::INITIALIZED;
+    SANDBOX_INFO("Channels module initialized successfully");
+
+    return true;
+}
+
+bool Channels::prepareChild(const SandboxConfiguration& config, pid_t childPid) {
+    // Channels are opened before the fork and attached in the child
+    return true;
+}
+
+bool Channels::applyChild(const SandboxConfiguration& config) {
+    for (const auto& channel : channels_) {
+        std::string value;
+
+        if (channel.config.type == "shm") {
+            // Let the descriptor survive exec
+            if (fcntl(channel.fd, F_SETFD, 0) < 0) {
+                SANDBOX_ERROR("Failed to pass channel " + channel.config.name);
+                return false;
+            }
+            value = std::to_string(channel.fd);
+        } else {
+            if (!attachSocketChannel(channel)) {
+                SANDBOX_ERROR("Failed to mount channel " + channel.config.name +
+                              " at " + channel.config.target);
+                return false;
+            }
+            value = channel.config.target;
+        }
+
+        setenv(envName(channel.config.name).c_str(), value.c_str(), 1);
+    }
+
+    state_ = ModuleState::RUNNING;
+    return true;
+}
+
+int Channels::execute(const SandboxConfiguration& config) {
+    return 0;
+}
+
+bool Channels::cleanup() {
+    SANDBOX_DEBUG("Cleaning up Channels module");
+
+    closeChannels();
+    state_ = ModuleState::STOPPED;
+    return true;
+}
+
+std::vector<std::string> Channels::getDependencies() const {
+    // Socket channels are mounted inside the new root
+    return {"rootfs"};
+}
+
+bool Channels::isEnabled() const {
+    return !config_.ipc.channels.empty();
+}
+
+std::string Channels::getDescription() const {
+    return "Shares UNIX socket directories and shared memory between sandboxes.";
+}
+
+std::string Channels::getType() const {
+    return "ipc";
+}
+
+bool Channels::lockChannel(OpenChannel& channel) {
+    // The last user removes the lock file; retry if we locked a removed one
+    for (int attempt = 0; attempt < 5; ++attempt) {
+        int fd = open(channel.lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            SANDBOX_ERROR("Failed to open " + channel.lockPath + ": " + std::string(strerror(errno)));
+            return false;
+        }
+        if (flock(fd, LOCK_SH) < 0) {
+            close(fd);
+            return false;
+        }
+
+        struct stat locked;
+        struct stat current;
+        if (fstat(fd, &locked) == 0 && stat(channel.lockPath.c_str(), &current) == 0 &&
+            locked.st_dev == current.st_dev && locked.st_ino == current.st_ino) {
+            channel.lockFd = fd;
+            return true;
+        }
+        close(fd);
+    }
+
+    SANDBOX_ERROR("Failed to lock channel " + channel.config.name);
+    return false;
+}
+
+bool Channels::openSocketChannel(OpenChannel& channel) {
+    channel.hostPath = config_.ipc.channel_dir + "/" + channel.config.name;
+    if (mkdir(channel.hostPath.c_str(), 0770) < 0 && errno != EEXIST) {
+        SANDBOX_ERROR("Failed to create " + channel.hostPath + ": " + std::string(strerror(errno)));
+        return false;
+    }
+
+    // Let the sandbox root of a user namespace create sockets in it
+    bool userNs = std::find(config_.isolation.namespaces.begin(), config_.isolation.namespaces.end(),
+                            "user") != config_.isolation.namespaces.end();
+    if (userNs && geteuid() == 0 &&
+        chown(channel.hostPath.c_str(), config_.isolation.uid_map.host_uid,
+              config_.isolation.gid_map.host_gid) < 0) {
+        SANDBOX_WARNING("Failed to chown " + channel.hostPath);
+    }
+
+    channel.fd = static_cast<int>(syscall(SYS_open_tree, AT_FDCWD, channel.hostPath.c_str(),
+                                          OPEN_TREE_CLONE | OPEN_TREE_CLOEXEC));
+    if (channel.fd >= 0) {
+        channel.detachedMount = true;
+        return true;
+    }
+
+    // Older kernels: bind through /proc/self/fd in the child instead
+    SANDBOX_DEBUG("open_tree unavailable, falling back to an O_PATH descriptor");
+    channel.fd = open(channel.hostPath.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    return channel.fd >= 0;
+}
+
+bool Channels::openShmChannel(OpenChannel& channel) {
+    channel.hostPath = "/dev/shm/sandbox-channel-" + channel.config.name;
+    channel.fd = open(channel.hostPath.c_str(), O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0660);
+    if (channel.fd < 0) {
+        SANDBOX_ERROR("Failed to open " + channel.hostPath + ": " + std::string(strerror(errno)));
+        return false;
+    }
+
+    // The first user sizes the segment
+    off_t size = static_cast<off_t>(channel.config.size_mb) * 1024 * 1024;
+    struct stat st;
+    if (fstat(channel.fd, &st) == 0 && st.st_size < size && ftruncate(channel.fd, size) < 0) {
+        SANDBOX_ERROR("Failed to size " + channel.hostPath + ": " + std::string(strerror(errno)));
+        return false;
+    }
+
+    return true;
+}
+
+bool Channels::attachSocketChannel(const OpenChannel& channel) {
+    const std::string& target = channel.config.target;
+    if (!Syscall::mkdirRecursive(target)) {
+        return false;
+    }
+
+    if (channel.detachedMount) {
+        if (syscall(SYS_move_mount, channel.fd, "", AT_FDCWD, target.c_str(),
+                    MOVE_MOUNT_F_EMPTY_PATH) < 0) {
+            SANDBOX_ERROR("move_mount failed: " + std::string(strerror(errno)));
+            return false;
+        }
+        return true;
+    }
+
+    return Syscall::mount("/proc/self/fd/" + std::to_string(channel.fd), target, "bind",
+                          MS_BIND, nullptr);
+}
+
+void Channels::closeChannels() {
+    for (auto& channel : channels_) {
+        if (channel.fd >= 0) {
+            close(channel.fd);
+        }
+        if (channel.lockFd < 0) {
+            continue;
+        }
+
+        // No other sandbox holds the channel: remove it
+        if (flock(channel.lockFd, LOCK_EX | LOCK_NB) == 0) {
+            if (channel.config.type == "shm") {
+                unlink(channel.hostPath.c_str());
+            } else if (!channel.hostPath.empty()) {
+                Syscall::removeRecursive(channel.hostPath);
+            }
+            unlink(channel.lockPath.c_str());
+            SANDBOX_DEBUG("Removed channel " + channel.config.name);
+        }
+        close(channel.lockFd);
+    }
+    channels_.clear();
+}
+
+} // namespace sandbox
@@ -0,0 +1,128 @@
+/**
+ * @file Channels.h
+ * @brief Inter-sandbox IPC channels module.
+ *
+ * This header defines the Channels class that gives cooperating
+ * sandboxes a direct IPC path, without network setup and without
+ * relaxing their other isolation.
+ */
+
+#ifndef SANDBOX_CHANNELS_H
+#define SANDBOX_CHANNELS_H
+
+#include "modules/interface/IModule.h"
+#include "core/ConfigParser.h"
+#include <vector>
+#include <string>
+
+namespace sandbox {
+
+/**
+ * @class Channels
+ * @brief Shares named IPC channels between sandboxes.
+ *
+ * A socket channel is a host directory, `<channel_dir>/<name>`, mounted
+ * at the channel target inside every sandbox that declares it; the
+ * sandboxes exchange AF_UNIX sockets through it. A shm channel is a
+ * shared memory file in /dev/shm whose descriptor is inherited by the
+ * sandboxed command.
+ *
+ * The supervisor opens every channel before the fork, so the sandbox
+ * never needs to reach host paths after pivot_root. A socket channel is
+ * opened as a detached mount with open_tree(2) and attached inside the
+ * sandbox with move_mount(2), which also works across mount
+ * namespaces. Each supervisor holds a shared lock on the channel; the
+ * last one to leave removes it.
+ *
+ * The command finds its channels through environment variables:
+ * `SANDBOX_CHANNEL_<NAME>` holds the mount point of a socket channel or
+ * the descriptor number of a shm channel.
+ */
+class Channels : public IModule {
+public:
+    /**
+     * @brief Construct a Channels module.
+     */
+    Channels();
+
+    /**
+     * @brief Destructor.
+     */
+    ~Channels() override;
+
+    // IModule interface
+    std::string getName() const override;
+    std::string getVersion() const override;
+    ModuleState getState() const override;
+    bool initialize(const SandboxConfiguration& config) override;
+    bool prepareChild(const SandboxConfiguration& config, pid_t childPid) override;
+    bool applyChild(const SandboxConfiguration& config) override;
+    int execute(const SandboxConfiguration& config) override;
+    bool cleanup() override;
+    std::vector<std::string> getDependencies() const override;
+    bool isEnabled() const override;
+    std::string getDescription() const override;
+    std::string getType() const override;
+
+    /**
+     * @brief Build the environment variable name of a channel.
+     * @param name The channel name.
+     * @return SANDBOX_CHANNEL_ followed by the upper-cased name.
+     */
+    static std::string envName(const std::string& name);
+
+private:
+    /**
+     * @struct OpenChannel
+     * @brief Descriptors held for one channel.
+     */
+    struct OpenChannel {
+        ChannelConfig config;
+        std::string hostPath;      ///< Directory or shm file on the host
+        std::string lockPath;      ///< Lock file shared by all users
+        int lockFd;                ///< Shared lock on the channel
+        int fd;                    ///< Detached mount, O_PATH directory or shm file
+        bool detachedMount;        ///< Whether fd comes from open_tree()
+    };
+
+    /**
+     * @brief Take a shared lock on a channel.
+     * @param channel The channel.
+     * @return true if successful.
+     */
+    bool lockChannel(OpenChannel& channel);
+
+    /**
+     * @brief Open the host side of a socket channel.
+     * @param channel The channel.
+     * @return true if successful.
+     */
+    bool openSocketChannel(OpenChannel& channel);
+
+    /**
+     * @brief Open or create a shm channel.
+     * @param channel The channel.
+     * @return true if successful.
+     */
+    bool openShmChannel(OpenChannel& channel);
+
+    /**
+     * @brief Mount a socket channel inside the sandbox.
+     * @param channel The channel.
+     * @return true if successful.
+     */
+    bool attachSocketChannel(const OpenChannel& channel);
+
+    /**
+     * @brief Close all channels, removing those no one else uses.
+     */
+    void closeChannels();
+
+    ModuleState state_;
+    SandboxConfiguration config_;
+    std::vector<OpenChannel> channels_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_CHANNELS_H
@@ -0,0 +1,422 @@
+/**
+ * @file Datasets.cpp
+ * @brief Implementation of the Datasets class.
+ */
+
+#include "modules/ipc/Datasets.h"
+#include "utils/Syscalls.h"
+#include "core/Logger.h"
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+namespace sandbox {
+
+namespace {
+
+/// One supervisor holding a dataset, as listed in the registry
+struct Holder {
+    pid_t pid;
+    int fd;
+    ino_t ino;
+    off_t size;
+    std::string signature;     ///< Identity of the source file the copy was made from
+};
+
+/// Identify a source file, so a changed file is loaded again
+std::string sourceSignature(const struct stat& st, bool hugePages) {
+    return std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino) + ":" +
+           std::to_string(st.st_size) + ":" + std::to_string(st.st_mtim.tv_sec) + "." +
+           std::to_string(st.st_mtim.tv_nsec) + (hugePages ? ":huge" : "");
+}
+
+std::vector<Holder> readHolders(const std::string& path) {
+    std::vector<Holder> holders;
+    auto content = Syscall::readFile(path);
+    if (!content) {
+        return holders;
+    }
+    std::istringstream in(*content);
+    Holder holder;
+    while (in >> holder.pid >> holder.fd >> holder.ino >> holder.size >> holder.signature) {
+        holders.push_back(holder);
+    }
+    return holders;
+}
+
+bool writeHolders(const std::string& path, const std::vector<Holder>& holders) {
+    if (holders.empty()) {
+        return unlink(path.c_str()) == 0 || errno == ENOENT;
+    }
+    std::string content;
+    for (const auto& holder : holders) {
+        content += std::to_string(holder.pid) + " " + std::to_string(holder.fd) + " " +
+                   std::to_string(holder.ino) + " " + std::to_string(holder.size) + " " +
+                   holder.signature + "\n";
+    }
+    std::string tmp = path + ".tmp";
+    return Syscall::writeFile(tmp, content) && rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+/// Duplicate another process's descriptor, -1 if it is gone
+int takeDescriptor(pid_t pid, int fd) {
+    int pidFd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (pidFd < 0) {
+        return -1;
+    }
+    int copy = static_cast<int>(syscall(SYS_pidfd_getfd, pidFd, fd, 0));
+    close(pidFd);
+    return copy;
+}
+
+} // namespace
+
+Datasets::Datasets(const std::string& cgroupPath)
+    : state_(ModuleState::UNINITIALIZED)
+    , cgroupPath_(cgroupPath)
+{
+}
+
+Datasets::~Datasets() {
+    for (auto& dataset : datasets_) {
+        release(dataset);
+    }
+}
+
+std::string Datasets::getName() const {
+    return "datasets";
+}
+
+std::string Datasets::getVersion() const {
+    return "1.0.0";
+}
+
+ModuleState Datasets::getState() const {
+    return state_;
+}
+
+std::string Datasets::envName(const std::string& name) {
+    std::string env = "SANDBOX_DATASET_";
+    for (char c : name) {
+        env += std::isalnum(static_cast<unsigned char>(c))
+             ? static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : '_';
+    }
+    return env;
+}
+
+bool Datasets::initialize(const SandboxConfiguration& config) {
+    SANDBOX_INFO("Initializing Datasets module");
+    config_ = config;
+
+    if (config.ipc.datasets.empty()) {
+        state_ = ModuleState::INITIALIZED;
+        return true;
+    }
+
+    if (!Syscall::isDirectory(config.ipc.dataset_dir) &&
+        !Syscall::mkdirRecursive(config.ipc.dataset_dir, 0700)) {
+        SANDBOX_ERROR("Failed to create dataset directory: " + config.ipc.dataset_dir);
+        return false;
+    }
+
+    for (const auto& datasetConfig : config.ipc.datasets) {
+        OpenDataset dataset;
+        dataset.config = datasetConfig;
+        dataset.registryPath = config.ipc.dataset_dir + "/" + datasetConfig.name + ".holders";
+        dataset.lockPath = config.ipc.dataset_dir + "/." + datasetConfig.name + ".lock";
+        dataset.fd = -1;
+        dataset.size = 0;
+
+        bool acquired = acquire(dataset);
+        datasets_.push_back(dataset);
+        if (!acquired) {
+            SANDBOX_ERROR("Failed to provide dataset: " + datasetConfig.name);
+            return false;
+        }
+    }
+
+    state_ = ModuleState::INITIALIZED;
+    SANDBOX_INFO("Datasets module initialized successfully");
+
+    return true;
+}
+
+bool Datasets::prepareChild(const SandboxConfiguration& config, pid_t childPid) {
+    // Datasets are loaded before the fork and inherited by the child
+    return true;
+}
+
+bool Datasets::applyChild(const SandboxConfiguration& config) {
+    for (const auto& dataset : datasets_) {
+        // The seals make the inherited descriptor read-only
+        if (fcntl(dataset.fd, F_SETFD, 0) < 0) {
+            SANDBOX_ERROR("Failed to pass dataset " + dataset.config.name);
+            return false;
+        }
+        std::string env = envName(dataset.config.name);
+        setenv(env.c_str(), std::to_string(dataset.fd).c_str(), 1);
+        setenv((env + "_SIZE").c_str(), std::to_string(dataset.size).c_str(), 1);
+    }
+
+    if (!datasets_.empty() && !config.ipc.dataset_mount_dir.empty() && !linkDatasets()) {
+        SANDBOX_ERROR("Failed to link datasets into " + config.ipc.dataset_mount_dir);
+        return false;
+    }
+
+    state_ = ModuleState::RUNNING;
+    return true;
+}
+
+int Datasets::execute(const SandboxConfiguration& config) {
+    return 0;
+}
+
+bool Datasets::cleanup() {
+    for (auto& dataset : datasets_) {
+        release(dataset);
+    }
+    datasets_.clear();
+    state_ = ModuleState::STOPPED;
+    return true;
+}
+
+std::vector<std::string> Datasets::getDependencies() const {
+    // Dataset links are created inside the new root
+    return {"rootfs"};
+}
+
+bool Datasets::isEnabled() const {
+    return !config_.ipc.datasets.empty();
+}
+
+std::string Datasets::getDescription() const {
+    return "Shares read-only datasets between sandboxes as sealed memfds.";
+}
+
+std::string Datasets::getType() const {
+    return "ipc";
+}
+
+int Datasets::load(const std::string& source, const std::string& name, bool hugePages,
+                   const std::string& chargeCgroup, off_t& size) {
+    int sourceFd = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (sourceFd < 0 || fstat(sourceFd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        SANDBOX_ERROR("Cannot read dataset source " + source);
+        if (sourceFd >= 0) {
+            close(sourceFd);
+        }
+        return -1;
+    }
+    size = st.st_size;
+
+    std::string memfdName = "sandbox-dataset-" + name;
+    int fd = -1;
+    if (hugePages) {
+        fd = memfd_create(memfdName.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING | MFD_HUGETLB);
+        if (fd < 0) {
+            hugePages = false;
+            SANDBOX_WARNING("No huge pages for dataset " + name + ", using normal pages: " +
+                            std::string(strerror(errno)));
+        }
+    }
+    if (fd < 0) {
+        fd = memfd_create(memfdName.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    }
+
+    // hugetlbfs only takes whole pages, and its block size is the page size
+    struct stat memfdSt;
+    off_t length = size;
+    if (hugePages && fstat(fd, &memfdSt) == 0 && memfdSt.st_blksize > 0) {
+        length = (size + memfdSt.st_blksize - 1) / memfdSt.st_blksize * memfdSt.st_blksize;
+    }
+    if (fd < 0 || ftruncate(fd, length) < 0) {
+        SANDBOX_ERROR("Failed to create memfd for dataset " + name + ": " + std::string(strerror(errno)));
+        close(sourceFd);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    // Copy from a helper in the dataset cgroup, which is charged for the
+    // memfd pages from then on. Everything is prepared before the fork;
+    // the helper only makes system calls.
+    std::string procs = chargeCgroup.empty() ? "" : chargeCgroup + "/cgroup.procs";
+    pid_t helper = fork();
+    if (helper < 0) {
+        SANDBOX_ERROR("Failed to fork dataset loader: " + std::string(strerror(errno)));
+        close(sourceFd);
+        close(fd);
+        return -1;
+    }
+    if (helper == 0) {
+        if (!procs.empty()) {
+            int procsFd = open(procs.c_str(), O_WRONLY | O_CLOEXEC);
+            if (procsFd < 0 || write(procsFd, "0", 1) != 1) {
+                _exit(2);
+            }
+            close(procsFd);
+        }
+        if (size > 0) {
+            void* map = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED) {
+                _exit(1);
+            }
+            char* out = static_cast<char*>(map);
+            for (off_t done = 0; done < size;) {
+                ssize_t n = read(sourceFd, out + done, size - done);
+                if (n <= 0) {
+                    if (n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    _exit(1);
+                }
+                done += n;
+            }
+            munmap(map, length);
+        }
+        // The page cache of the source is not needed anymore
+        posix_fadvise(sourceFd, 0, 0, POSIX_FADV_DONTNEED);
+        _exit(0);
+    }
+
+    int status = 0;
+    while (waitpid(helper, &status, 0) < 0 && errno == EINTR) {
+    }
+    close(sourceFd);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        SANDBOX_ERROR(std::string(WIFEXITED(status) && WEXITSTATUS(status) == 2
+                                  ? "Failed to join dataset cgroup " + chargeCgroup
+                                  : "Failed to copy dataset " + source));
+        close(fd);
+        return -1;
+    }
+
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        SANDBOX_ERROR("Failed to seal dataset " + name + ": " + std::string(strerror(errno)));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool Datasets::acquire(OpenDataset& dataset) {
+    struct stat st;
+    if (stat(dataset.config.source.c_str(), &st) < 0) {
+        SANDBOX_ERROR("Cannot stat dataset source " + dataset.config.source);
+        return false;
+    }
+    std::string signature = sourceSignature(st, dataset.config.huge_pages);
+
+    int lockFd = open(dataset.lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lockFd < 0 || flock(lockFd, LOCK_EX) < 0) {
+        SANDBOX_ERROR("Failed to lock " + dataset.lockPath + ": " + std::string(strerror(errno)));
+        if (lockFd >= 0) {
+            close(lockFd);
+        }
+        return false;
+    }
+
+    // Take a copy from a live holder; holders that are gone are dropped
+    std::vector<Holder> holders;
+    for (const auto& holder : readHolders(dataset.registryPath)) {
+        int copy = takeDescriptor(holder.pid, holder.fd);
+        struct stat copySt;
+        if (copy < 0 || fstat(copy, &copySt) < 0 || copySt.st_ino != holder.ino) {
+            if (copy >= 0) {
+                close(copy);
+            }
+            continue;
+        }
+        holders.push_back(holder);
+        if (dataset.fd < 0 && holder.signature == signature) {
+            dataset.fd = copy;
+            dataset.size = holder.size;
+            SANDBOX_DEBUG("Sharing dataset " + dataset.config.name + " with PID " + std::to_string(holder.pid));
+        } else {
+            close(copy);
+        }
+    }
+
+    if (dataset.fd < 0) {
+        std::string chargeCgroup;
+        if (!config_.ipc.dataset_cgroup.empty()) {
+            chargeCgroup = cgroupPath_ + "/" + config_.ipc.dataset_cgroup;
+            if (!Syscall::isDirectory(chargeCgroup) &&
+                !Syscall::createCgroup(cgroupPath_, config_.ipc.dataset_cgroup)) {
+                SANDBOX_WARNING("Failed to create " + chargeCgroup + ", charging the supervisor");
+                chargeCgroup.clear();
+            }
+        }
+        dataset.fd = load(dataset.config.source, dataset.config.name, dataset.config.huge_pages,
+                          chargeCgroup, dataset.size);
+        if (dataset.fd >= 0) {
+            SANDBOX_INFO("Loaded dataset " + dataset.config.name + " (" + std::to_string(dataset.size) +
+                         " bytes) from " + dataset.config.source);
+        }
+    }
+
+    bool ok = dataset.fd >= 0;
+    if (ok) {
+        struct stat memfdSt;
+        fstat(dataset.fd, &memfdSt);
+        holders.push_back({getpid(), dataset.fd, memfdSt.st_ino, dataset.size, signature});
+    }
+    if (!writeHolders(dataset.registryPath, holders)) {
+        SANDBOX_WARNING("Failed to update " + dataset.registryPath);
+    }
+
+    close(lockFd);
+    return ok;
+}
+
+void Datasets::release(OpenDataset& dataset) {
+    if (dataset.fd < 0) {
+        return;
+    }
+
+    int lockFd = open(dataset.lockPath.c_str(), O_RDWR | O_CLOEXEC);
+    if (lockFd >= 0 && flock(lockFd, LOCK_EX) == 0) {
+        std::vector<Holder> holders = readHolders(dataset.registryPath);
+        std::vector<Holder> remaining;
+        for (const auto& holder : holders) {
+            if (holder.pid != getpid() || holder.fd != dataset.fd) {
+                remaining.push_back(holder);
+            }
+        }
+        writeHolders(dataset.registryPath, remaining);
+    }
+    if (lockFd >= 0) {
+        close(lockFd);
+    }
+
+    close(dataset.fd);
+    dataset.fd = -1;
+}
+
+bool Datasets::linkDatasets() {
+    const std::string& dir = config_.ipc.dataset_mount_dir;
+    if (!Syscall::mkdirRecursive(dir) ||
+        !Syscall::mount("tmpfs", dir, "tmpfs", MS_NOSUID | MS_NODEV | MS_NOEXEC, "mode=755,size=16k")) {
+        return false;
+    }
+    for (const auto& dataset : datasets_) {
+        std::string link = dir + "/" + dataset.config.name;
+        if (symlink(("/proc/self/fd/" + std::to_string(dataset.fd)).c_str(), link.c_str()) < 0) {
+            SANDBOX_ERROR("Failed to create " + link + ": " + std::string(strerror(errno)));
+            return false;
+        }
+    }
+    return Syscall::mount("", dir, "", MS_REMOUNT | MS_RDONLY | MS_NOSUID | MS_NODEV | MS_NOEXEC, nullptr);
+}
+
+} // namespace sandbox
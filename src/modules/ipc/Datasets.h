@@ -0,0 +1,131 @@
+/**
+ * @file Datasets.h
+ * @brief Shared read-only datasets module.
+ *
+ * This header defines the Datasets class that loads large read-only
+ * inputs into sealed memfds once and passes them to every sandbox that
+ * uses them.
+ */
+
+#ifndef SANDBOX_DATASETS_H
+#define SANDBOX_DATASETS_H
+
+#include "modules/interface/IModule.h"
+#include "core/ConfigParser.h"
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+namespace sandbox {
+
+/**
+ * @class Datasets
+ * @brief Shares sealed in-memory copies of files between sandboxes.
+ *
+ * Bind-mounted inputs are read from disk by every cold sandbox, and the
+ * page cache is charged to whichever sandbox reads it first. A dataset
+ * is instead copied once into a memfd, which is then sealed against
+ * writes, growing and shrinking. The copy runs in a helper process
+ * inside the dataset cgroup, so the memory is charged there once.
+ *
+ * Supervisors find each other's copies through a registry in
+ * `<dataset_dir>/<name>.holders` that lists the holders' PIDs and
+ * descriptors. A new supervisor takes a duplicate of a live holder's
+ * memfd with pidfd_getfd(2). Only when no holder is left, or the source
+ * file has changed, is the dataset loaded again. The memory is released
+ * when the last sandbox using it is gone.
+ *
+ * The sandboxed command inherits the descriptor, named in
+ * `SANDBOX_DATASET_<NAME>`, with the size in `SANDBOX_DATASET_<NAME>_SIZE`.
+ * Programs that want a path find `<dataset_mount_dir>/<name>`, a link to
+ * the descriptor in /proc/self/fd.
+ */
+class Datasets : public IModule {
+public:
+    /**
+     * @brief Construct a Datasets module.
+     * @param cgroupPath Path to the cgroup hierarchy (default: /sys/fs/cgroup).
+     */
+    explicit Datasets(const std::string& cgroupPath = "/sys/fs/cgroup");
+
+    /**
+     * @brief Destructor.
+     */
+    ~Datasets() override;
+
+    // IModule interface
+    std::string getName() const override;
+    std::string getVersion() const override;
+    ModuleState getState() const override;
+    bool initialize(const SandboxConfiguration& config) override;
+    bool prepareChild(const SandboxConfiguration& config, pid_t childPid) override;
+    bool applyChild(const SandboxConfiguration& config) override;
+    int execute(const SandboxConfiguration& config) override;
+    bool cleanup() override;
+    std::vector<std::string> getDependencies() const override;
+    bool isEnabled() const override;
+    std::string getDescription() const override;
+    std::string getType() const override;
+
+    /**
+     * @brief Build the environment variable name of a dataset.
+     * @param name The dataset name.
+     * @return SANDBOX_DATASET_ followed by the upper-cased name.
+     */
+    static std::string envName(const std::string& name);
+
+    /**
+     * @brief Copy a file into a new sealed memfd.
+     * @param source The file to copy.
+     * @param name Name of the memfd.
+     * @param hugePages Whether to back the memfd with hugetlb pages; falls
+     *                  back to normal pages when none are available.
+     * @param chargeCgroup Cgroup directory to copy from, empty for the caller's.
+     * @param size Output size of the file; a hugetlb memfd is larger,
+     *             rounded up to whole pages.
+     * @return The memfd, or -1 on failure.
+     */
+    static int load(const std::string& source, const std::string& name, bool hugePages,
+                    const std::string& chargeCgroup, off_t& size);
+
+private:
+    /**
+     * @struct OpenDataset
+     * @brief A dataset held by this supervisor.
+     */
+    struct OpenDataset {
+        DatasetConfig config;
+        std::string registryPath;  ///< Holders of the dataset
+        std::string lockPath;      ///< Serializes access to the registry
+        int fd;                    ///< The sealed memfd
+        off_t size;                ///< Size of the source file
+    };
+
+    /**
+     * @brief Take a copy from another holder or load the dataset.
+     * @param dataset The dataset.
+     * @return true if successful.
+     */
+    bool acquire(OpenDataset& dataset);
+
+    /**
+     * @brief Remove this supervisor from a dataset's registry.
+     * @param dataset The dataset.
+     */
+    void release(OpenDataset& dataset);
+
+    /**
+     * @brief Link the datasets into the sandbox's dataset directory.
+     * @return true if successful.
+     */
+    bool linkDatasets();
+
+    ModuleState state_;
+    SandboxConfiguration config_;
+    std::string cgroupPath_;
+    std::vector<OpenDataset> datasets_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_DATASETS_H
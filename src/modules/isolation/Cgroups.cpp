@@ -6,17 +6,75 @@
 #include "modules/isolation/Cgroups.h"
 #include "utils/Syscalls.h"
 #include "core/Logger.h"
+#include "core/Housekeeping.h"
+#include <algorithm>
 #include <sstream>
+#include <climits>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <regex>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+
+#ifndef PR_SET_MEMORY_MERGE
+#define PR_SET_MEMORY_MERGE 67
+#endif
 
 namespace sandbox {
 
+namespace {
+
+/// Write a cgroup file unbuffered, so that a rejected value is reported
+bool writeLimit(const std::string& path, const std::string& value, std::string& error) {
+    ScopedFd fd(open(path.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC));
+    if (!fd.isValid() || write(fd.get(), value.data(), value.size()) != static_cast<ssize_t>(value.size())) {
+        error = "Failed to write " + value + " to " + path + ": " + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+/// Current value of a counter or limit, -1 if unreadable
+long long readCounter(const std::string& path) {
+    auto content = Syscall::readFile(path);
+    if (!content) {
+        return -1;
+    }
+    return content->compare(0, 3, "max") == 0 ? LLONG_MAX : std::atoll(content->c_str());
+}
+
+/// Value to restore io.max of a device to; devices without a line are unlimited
+std::string ioMaxOf(const std::string& cgroupDir, const std::string& device) {
+    std::istringstream lines(Syscall::readFile(cgroupDir + "/io.max").value_or(""));
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.compare(0, device.size() + 1, device + " ") == 0) {
+            return line;
+        }
+    }
+    return device + " rbps=max wbps=max riops=max wiops=max";
+}
+
+} // namespace
+
 Cgroups::Cgroups(const std::string& cgroupPath)
     : state_(ModuleState::UNINITIALIZED)
     , cgroupPath_(cgroupPath)
+    , memoryPeakFd_(-1)
+    , ksmMergingPages_(0)
+    , ksmProfitBytes_(0)
 {
 }
 
+Cgroups::~Cgroups() {
+    closeProcessCgroupFds();
+    if (memoryPeakFd_ >= 0) {
+        close(memoryPeakFd_);
+    }
+}
+
 std::string Cgroups::getName() const {
     return "cgroups";
 }
@@ -39,15 +97,37 @@ bool Cgroups::initialize(const SandboxConfiguration& config) {
 
     // Full path to the cgroup
     cgroupFullPath_ = cgroupPath_ + "/" + cgroupName_;
+    ksmMergingPages_ = 0;
+    ksmProfitBytes_ = 0;
 
     SANDBOX_DEBUG("Cgroup path: " + cgroupFullPath_);
 
+    // Widening to every workload CPU would ignore cpuset_cpus altogether
+    if (!config.resources.cpuset_cpus.empty() && Housekeeping::sandboxCpus(config).empty()) {
+        SANDBOX_ERROR("cpuset_cpus " + config.resources.cpuset_cpus + " has no CPU outside the housekeeping CPUs");
+        return false;
+    }
+
     // Create the cgroup in parent process
     if (!createCgroup(config)) {
         SANDBOX_ERROR("Failed to create cgroup");
         return false;
     }
 
+    // Sized here so that each supervisor starts its sandbox on other CPUs
+    std::vector<int> allowed = Syscall::getAffinityCpus();
+    if (!Housekeeping::sandboxCpus(config).empty()) {
+        allowed = Syscall::parseCpuList(Housekeeping::sandboxCpus(config)).value_or(allowed);
+    }
+    resourceView_ = ResourceView::fromLimits(config.resources, allowed, static_cast<unsigned int>(getpid()));
+
+    if (config.resources.memory_merge) {
+        auto run = Syscall::readFile("/sys/kernel/mm/ksm/run");
+        if (!run || run->find('1') == std::string::npos) {
+            SANDBOX_WARNING("memory_merge is set but ksmd is not running (/sys/kernel/mm/ksm/run)");
+        }
+    }
+
     state_ = ModuleState::INITIALIZED;
     SANDBOX_INFO("Cgroups module initialized successfully");
 
@@ -57,17 +137,47 @@ bool Cgroups::initialize(const SandboxConfiguration& config) {
 bool Cgroups::prepareChild(const SandboxConfiguration& config, pid_t childPid) {
     SANDBOX_DEBUG("Adding child process " + std::to_string(childPid) + " to cgroup");
 
-    // Move the child process to our cgroup
-    if (!Syscall::addToCgroup(cgroupPath_, cgroupName_, childPid)) {
+    // Move the child process to our cgroup. A process group keeps its
+    // init in a leaf, since cgroup v2 forbids processes in inner nodes.
+    bool hasLeaves = !config.sandbox.processes.empty() || !config.fanout.inputs.empty();
+    std::string target = hasLeaves ? cgroupName_ + "/init" : cgroupName_;
+    if (!Syscall::addToCgroup(cgroupPath_, target, childPid)) {
         SANDBOX_ERROR("Failed to add child to cgroup");
         return false;
     }
 
+    if (config.resources.cpu_burst_percent > config.resources.cpu_quota_percent) {
+        elasticQuota_ = std::make_unique<ElasticQuota>(config.resources.cpu_quota_percent,
+                                                       config.resources.cpu_burst_percent);
+        elasticQuota_->start(cgroupFullPath_, config.resources.cpu_burst_interval_ms);
+    }
+
     return true;
 }
 
 bool Cgroups::applyChild(const SandboxConfiguration& config) {
-    // Cgroup configuration happens in the parent
+    // Cgroup configuration happens in the parent. KSM is opted into per
+    // process; the setting is inherited across fork and exec, so setting
+    // it here covers every process of the sandbox.
+    if (config.resources.memory_merge && prctl(PR_SET_MEMORY_MERGE, 1, 0, 0, 0) < 0) {
+        SANDBOX_WARNING("Failed to enable memory merging: " + std::string(strerror(errno)));
+    }
+
+    // Affinity and environment are inherited the same way, so runtimes
+    // in the sandbox size their thread pools to the quota, not the host
+    if (config.resources.quota_affinity && !resourceView_.pinAffinity()) {
+        return false;
+    }
+
+    // The child inherited the supervisor's housekeeping CPUs; moving it
+    // by affinity works whether or not the cpuset controller is enabled
+    if (!config.resources.quota_affinity && !config.supervisor.workload_cpus.empty() &&
+        !Syscall::setAffinityCpus(Syscall::parseCpuList(Housekeeping::sandboxCpus(config)).value_or(std::vector<int>()))) {
+        return false;
+    }
+    if (config.resources.runtime_hints) {
+        resourceView_.exportHints();
+    }
     return true;
 }
 
@@ -79,6 +189,26 @@ int Cgroups::execute(const SandboxConfiguration& config) {
 bool Cgroups::cleanup() {
     SANDBOX_DEBUG("Cleaning up Cgroups module");
 
+    if (elasticQuota_) {
+        elasticQuota_->stop();
+    }
+    closeProcessCgroupFds();
+    perfCounters_.close();
+    if (memoryPeakFd_ >= 0) {
+        close(memoryPeakFd_);
+        memoryPeakFd_ = -1;
+    }
+
+    // Drop the page cache charged to the sandbox, so the next sandbox
+    // starts cold instead of reusing it from the parent cgroup
+    if (!cgroupFullPath_.empty() && config_.resources.drop_page_cache) {
+        auto current = Syscall::readFile(cgroupFullPath_ + "/memory.current");
+        if (current && std::atoll(current->c_str()) > 0 &&
+            !Syscall::setCgroupValue(cgroupPath_, cgroupName_, "memory.reclaim", *current)) {
+            SANDBOX_DEBUG("Page cache of the sandbox was not fully reclaimed");
+        }
+    }
+
     // Remove the cgroup
     if (!cgroupFullPath_.empty()) {
         Syscall::removeCgroup(cgroupPath_, cgroupName_);
@@ -112,6 +242,239 @@ std::string Cgroups::getCgroupName() const {
     return cgroupName_;
 }
 
+int Cgroups::getProcessCgroupFd(const std::string& processName) const {
+    auto it = processCgroupFds_.find(processName);
+    return it != processCgroupFds_.end() ? it->second : -1;
+}
+
+const std::vector<FanOutSlot>& Cgroups::getFanOutSlots() const {
+    return fanOutSlots_;
+}
+
+int Cgroups::getMemoryPeakFd() const {
+    return memoryPeakFd_;
+}
+
+void Cgroups::sampleMemoryMerge() {
+    long long mergingPages = 0;
+    long long profitBytes = 0;
+
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(cgroupFullPath_, ec);
+         it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (ec) {
+            break;
+        }
+        if (it->path().filename() != "cgroup.procs") {
+            continue;
+        }
+
+        auto procs = Syscall::readFile(it->path().string());
+        std::istringstream pids(procs.value_or(""));
+        std::string pid;
+        while (pids >> pid) {
+            // ksm_stat: "ksm_rmap_items N", "ksm_merging_pages N", "ksm_process_profit N", ...
+            auto stat = Syscall::readFile("/proc/" + pid + "/ksm_stat");
+            std::istringstream fields(stat.value_or(""));
+            std::string key;
+            long long value;
+            while (fields >> key >> value) {
+                if (key == "ksm_merging_pages") {
+                    mergingPages += value;
+                } else if (key == "ksm_process_profit") {
+                    profitBytes += value;
+                }
+            }
+        }
+    }
+
+    if (mergingPages > ksmMergingPages_) {
+        ksmMergingPages_ = mergingPages;
+    }
+    if (profitBytes > ksmProfitBytes_) {
+        ksmProfitBytes_ = profitBytes;
+    }
+}
+
+ResourceUsage Cgroups::collectUsage() const {
+    ResourceUsage usage{};
+
+    // Read through the shared descriptor so warm-restart resets apply
+    if (memoryPeakFd_ >= 0) {
+        char buffer[32] = {};
+        ssize_t n = pread(memoryPeakFd_, buffer, sizeof(buffer) - 1, 0);
+        if (n > 0) {
+            usage.memoryPeakBytes = std::atoll(buffer);
+        }
+    }
+
+    if (auto cpuStat = Syscall::readFile(cgroupFullPath_ + "/cpu.stat")) {
+        std::istringstream stat(*cpuStat);
+        std::string key;
+        long long value;
+        while (stat >> key >> value) {
+            if (key == "user_usec") {
+                usage.cpuUserUs = value;
+            } else if (key == "system_usec") {
+                usage.cpuSystemUs = value;
+            } else if (key == "throttled_usec") {
+                usage.cpuThrottledUs = value;
+            }
+        }
+    }
+
+    usage.perfCounters = perfCounters_.read();
+    usage.ksmMergingPages = ksmMergingPages_;
+    usage.ksmProfitBytes = ksmProfitBytes_;
+    usage.cpuQuotaPeakPercent = elasticQuota_ ? elasticQuota_->getPeakQuota() : config_.resources.cpu_quota_percent;
+
+    return usage;
+}
+
+bool Cgroups::updateResources(const ResourceUpdate& update, std::string& error) {
+    if (cgroupFullPath_.empty()) {
+        error = "The sandbox has no cgroup";
+        return false;
+    }
+
+    // The controller restores its floor when stopped, so stop it first
+    int burst = config_.resources.cpu_burst_percent;
+    bool restartLending = elasticQuota_ && update.cpuQuotaPercent;
+    if (restartLending) {
+        elasticQuota_->stop();
+    }
+    bool ok = updateLimits(cgroupFullPath_, update, error);
+    if (ok && update.memoryMb) {
+        config_.resources.memory_mb = *update.memoryMb;
+    }
+    if (ok && update.cpuQuotaPercent) {
+        config_.resources.cpu_quota_percent = *update.cpuQuotaPercent;
+    }
+    if (ok && update.maxPids) {
+        config_.resources.max_pids = *update.maxPids;
+    }
+    if (restartLending) {
+        elasticQuota_ = std::make_unique<ElasticQuota>(config_.resources.cpu_quota_percent, burst);
+        elasticQuota_->start(cgroupFullPath_, config_.resources.cpu_burst_interval_ms);
+    }
+    return ok;
+}
+
+bool Cgroups::updateLimits(const std::string& cgroupDir, const ResourceUpdate& update, std::string& error) {
+    // (file, value) in the order they are written
+    std::vector<std::pair<std::string, std::string>> writes;
+
+    if (update.memoryMb) {
+        if (*update.memoryMb < 1) {
+            error = "Memory limit must be at least 1 MB";
+            return false;
+        }
+        long long memoryBytes = static_cast<long long>(*update.memoryMb) * 1024 * 1024;
+        long long current = readCounter(cgroupDir + "/memory.current");
+        if (current > memoryBytes) {
+            error = "The sandbox already uses " + std::to_string(current / (1024 * 1024)) +
+                    " MB, more than " + std::to_string(*update.memoryMb) + " MB";
+            return false;
+        }
+
+        // Keep memory.high below memory.max at every step
+        std::pair<std::string, std::string> max{"memory.max", std::to_string(memoryBytes)};
+        std::pair<std::string, std::string> high{"memory.high", std::to_string(memoryBytes * 8 / 10)};
+        if (memoryBytes >= readCounter(cgroupDir + "/memory.max")) {
+            writes.push_back(max);
+            writes.push_back(high);
+        } else {
+            writes.push_back(high);
+            writes.push_back(max);
+        }
+    }
+
+    if (update.cpuQuotaPercent) {
+        if (*update.cpuQuotaPercent < 1) {
+            error = "CPU quota must be at least 1%";
+            return false;
+        }
+        long long quota = static_cast<long long>(*update.cpuQuotaPercent) * 1000;
+        writes.emplace_back("cpu.max", std::to_string(quota) + " 100000");
+    }
+
+    if (update.maxPids) {
+        if (*update.maxPids < 1) {
+            error = "PID limit must be at least 1";
+            return false;
+        }
+        long long current = readCounter(cgroupDir + "/pids.current");
+        if (current > *update.maxPids) {
+            error = "The sandbox already runs " + std::to_string(current) + " tasks, more than " +
+                    std::to_string(*update.maxPids);
+            return false;
+        }
+        writes.emplace_back("pids.max", std::to_string(*update.maxPids));
+    }
+
+    if (update.ioMax) {
+        static const std::regex ioLine(R"(\d+:\d+( (rbps|wbps|riops|wiops)=(\d+|max))+)");
+        if (!std::regex_match(*update.ioMax, ioLine)) {
+            error = "Invalid io.max line: " + *update.ioMax;
+            return false;
+        }
+        writes.emplace_back("io.max", *update.ioMax);
+    }
+
+    // Remember what to roll back to before touching anything
+    std::vector<std::pair<std::string, std::string>> previous;
+    for (const auto& [file, value] : writes) {
+        std::string old = file == "io.max" ? ioMaxOf(cgroupDir, value.substr(0, value.find(' ')))
+                                           : Syscall::readFile(cgroupDir + "/" + file).value_or("");
+        if (!old.empty() && old.back() == '\n') {
+            old.pop_back();
+        }
+        if (old.empty()) {
+            error = "Cannot read " + cgroupDir + "/" + file;
+            return false;
+        }
+        previous.emplace_back(file, old);
+    }
+
+    for (size_t i = 0; i < writes.size(); ++i) {
+        if (writeLimit(cgroupDir + "/" + writes[i].first, writes[i].second, error)) {
+            continue;
+        }
+        for (size_t j = i; j-- > 0;) {
+            std::string ignored;
+            if (!writeLimit(cgroupDir + "/" + previous[j].first, previous[j].second, ignored)) {
+                SANDBOX_WARNING("Failed to restore " + previous[j].first + ": " + ignored);
+            }
+        }
+        return false;
+    }
+
+    SANDBOX_INFO("Updated " + cgroupDir + ": " + describeUpdate(update));
+    return true;
+}
+
+std::string Cgroups::describeUpdate(const ResourceUpdate& update) {
+    std::vector<std::string> parts;
+    if (update.memoryMb) {
+        parts.push_back("memory=" + std::to_string(*update.memoryMb) + "M");
+    }
+    if (update.cpuQuotaPercent) {
+        parts.push_back("cpu=" + std::to_string(*update.cpuQuotaPercent) + "%");
+    }
+    if (update.maxPids) {
+        parts.push_back("pids=" + std::to_string(*update.maxPids));
+    }
+    if (update.ioMax) {
+        parts.push_back("io=" + *update.ioMax);
+    }
+
+    std::string description;
+    for (const auto& part : parts) {
+        description += (description.empty() ? "" : " ") + part;
+    }
+    return description;
+}
+
 bool Cgroups::createCgroup(const SandboxConfiguration& config) {
     SANDBOX_INFO("Creating cgroup: " + cgroupFullPath_);
 
@@ -139,6 +502,38 @@ bool Cgroups::createCgroup(const SandboxConfiguration& config) {
         return false;
     }
 
+    // Pin to CPUs and memory nodes
+    if (!setCpusetLimits(config)) {
+        SANDBOX_ERROR("Failed to set cpuset limits");
+        return false;
+    }
+
+    if (config.resources.perf_counters) {
+        openPerfCounters(config);
+    }
+
+    // Create sub-cgroups for a process group
+    if (!config.sandbox.processes.empty() && !createProcessCgroups(config)) {
+        SANDBOX_ERROR("Failed to create process cgroups");
+        return false;
+    }
+
+    // Create slot sub-cgroups for fan-out runs
+    if (!config.fanout.inputs.empty() && !createFanOutCgroups(config)) {
+        SANDBOX_ERROR("Failed to create fan-out cgroups");
+        return false;
+    }
+
+    // Keep memory.peak open for warm-restart resets and usage reporting
+    std::string peakPath = cgroupFullPath_ + "/memory.peak";
+    memoryPeakFd_ = open(peakPath.c_str(), O_RDWR | O_CLOEXEC);
+    if (memoryPeakFd_ < 0) {
+        memoryPeakFd_ = open(peakPath.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (memoryPeakFd_ < 0) {
+        SANDBOX_DEBUG("memory.peak is not available");
+    }
+
     return true;
 }
 
@@ -188,6 +583,46 @@ bool Cgroups::setCpuLimits(const SandboxConfiguration& config) {
     return true;
 }
 
+bool Cgroups::setCpusetLimits(const SandboxConfiguration& config) {
+    // Only a configured cpuset needs the controller; housekeeping CPUs
+    // alone are kept free by affinity in applyChild()
+    if (!config.resources.cpuset_cpus.empty()) {
+        std::string cpus = Housekeeping::sandboxCpus(config);
+        if (!Syscall::setCgroupValue(cgroupPath_, cgroupName_, "cpuset.cpus", cpus)) {
+            SANDBOX_ERROR("Failed to set cpuset.cpus (is the cpuset controller enabled?)");
+            return false;
+        }
+        SANDBOX_DEBUG("Pinned to CPUs " + cpus);
+    }
+
+    if (!config.resources.cpuset_mems.empty()) {
+        if (!Syscall::setCgroupValue(cgroupPath_, cgroupName_, "cpuset.mems",
+                                     config.resources.cpuset_mems)) {
+            SANDBOX_ERROR("Failed to set cpuset.mems");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Cgroups::openPerfCounters(const SandboxConfiguration& config) {
+    std::vector<int> cpus = Syscall::getAffinityCpus();
+    if (!Housekeeping::sandboxCpus(config).empty()) {
+        cpus = Syscall::parseCpuList(Housekeeping::sandboxCpus(config)).value_or(cpus);
+    }
+
+    int cgroupFd = open(cgroupFullPath_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cgroupFd < 0) {
+        SANDBOX_WARNING("Failed to open cgroup for perf counters");
+        return;
+    }
+    if (!perfCounters_.open(cgroupFd, cpus)) {
+        SANDBOX_WARNING("No perf counters available; check kernel.perf_event_paranoid");
+    }
+    close(cgroupFd);
+}
+
 bool Cgroups::setPidLimits(const SandboxConfiguration& config) {
     if (config.resources.max_pids > 0) {
         if (!Syscall::setCgroupValue(cgroupPath_, cgroupName_, "pids.max",
@@ -202,4 +637,125 @@ bool Cgroups::setPidLimits(const SandboxConfiguration& config) {
     return true;
 }
 
+bool Cgroups::createSubCgroup(const std::string& leaf, int memoryMb,
+                              int cpuQuotaPercent, int maxPids) {
+    std::string name = cgroupName_ + "/" + leaf;
+    if (!Syscall::createCgroup(cgroupPath_, name)) {
+        SANDBOX_ERROR("Failed to create sub-cgroup: " + name);
+        return false;
+    }
+
+    if (memoryMb > 0) {
+        long long memoryBytes = static_cast<long long>(memoryMb) * 1024 * 1024;
+        if (!Syscall::setCgroupValue(cgroupPath_, name, "memory.max", std::to_string(memoryBytes))) {
+            return false;
+        }
+    }
+
+    if (cpuQuotaPercent > 0) {
+        long long quota = cpuQuotaPercent * 1000;
+        if (!Syscall::setCgroupValue(cgroupPath_, name, "cpu.max", std::to_string(quota) + " 100000")) {
+            return false;
+        }
+    }
+
+    if (maxPids > 0) {
+        if (!Syscall::setCgroupValue(cgroupPath_, name, "pids.max", std::to_string(maxPids))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Cgroups::createProcessCgroups(const SandboxConfiguration& config) {
+    // Delegate controllers to the leaves
+    if (!Syscall::setCgroupValue(cgroupPath_, cgroupName_, "cgroup.subtree_control",
+                                 "+cpu +memory +pids")) {
+        SANDBOX_ERROR("Failed to enable controllers for process cgroups");
+        return false;
+    }
+
+    if (!createSubCgroup("init", 0, 0, 0)) {
+        return false;
+    }
+
+    for (const auto& process : config.sandbox.processes) {
+        std::string leaf = "proc-" + process.name;
+        if (!createSubCgroup(leaf, process.memory_mb, process.cpu_quota_percent, process.max_pids)) {
+            return false;
+        }
+
+        std::string procsPath = cgroupFullPath_ + "/" + leaf + "/cgroup.procs";
+        int fd = open(procsPath.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd < 0) {
+            SANDBOX_ERROR("Failed to open " + procsPath);
+            return false;
+        }
+        processCgroupFds_[process.name] = fd;
+
+        SANDBOX_DEBUG("Created process cgroup: " + leaf);
+    }
+
+    return true;
+}
+
+bool Cgroups::createFanOutCgroups(const SandboxConfiguration& config) {
+    // Delegate controllers to the leaves
+    if (!Syscall::setCgroupValue(cgroupPath_, cgroupName_, "cgroup.subtree_control",
+                                 "+cpu +memory +pids")) {
+        SANDBOX_ERROR("Failed to enable controllers for fan-out cgroups");
+        return false;
+    }
+
+    if (!createSubCgroup("init", 0, 0, 0)) {
+        return false;
+    }
+
+    int slots = FanOutRunner::slotCount(config);
+    for (int i = 0; i < slots; ++i) {
+        std::string leaf = "slot-" + std::to_string(i);
+        if (!createSubCgroup(leaf, config.fanout.memory_mb, config.fanout.cpu_quota_percent,
+                             config.fanout.max_pids)) {
+            return false;
+        }
+
+        std::string leafPath = cgroupFullPath_ + "/" + leaf;
+        FanOutSlot slot;
+        slot.procsFd = open((leafPath + "/cgroup.procs").c_str(), O_WRONLY | O_CLOEXEC);
+        slot.peakFd = open((leafPath + "/memory.peak").c_str(), O_RDWR | O_CLOEXEC);
+        slot.killFd = open((leafPath + "/cgroup.kill").c_str(), O_WRONLY | O_CLOEXEC);
+        if (slot.procsFd < 0) {
+            SANDBOX_ERROR("Failed to open " + leafPath + "/cgroup.procs");
+            for (int fd : {slot.peakFd, slot.killFd}) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+            return false;
+        }
+        fanOutSlots_.push_back(slot);
+    }
+
+    SANDBOX_DEBUG("Created " + std::to_string(slots) + " fan-out slot cgroups");
+    return true;
+}
+
+void Cgroups::closeProcessCgroupFds() {
+    for (auto& [name, fd] : processCgroupFds_) {
+        close(fd);
+    }
+    processCgroupFds_.clear();
+
+    for (auto& slot : fanOutSlots_) {
+        close(slot.procsFd);
+        for (int fd : {slot.peakFd, slot.killFd}) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+    fanOutSlots_.clear();
+}
+
 } // namespace sandbox
@@ -11,9 +11,43 @@
 
 #include "modules/interface/IModule.h"
 #include "core/ConfigParser.h"
+#include "core/FanOut.h"
+#include "utils/PerfCounters.h"
+#include "modules/isolation/ResourceView.h"
+#include "modules/isolation/ElasticQuota.h"
+#include <map>
+#include <memory>
+#include <optional>
+#include <atomic>
 
 namespace sandbox {
 
+/**
+ * @struct ResourceUsage
+ * @brief Resource usage of a sandbox as accounted by its cgroup.
+ */
+struct ResourceUsage {
+    long long memoryPeakBytes;   ///< Peak memory since start or last warm restart
+    long long cpuUserUs;         ///< User CPU time from cpu.stat
+    long long cpuSystemUs;       ///< System CPU time from cpu.stat
+    std::map<std::string, long long> perfCounters;  ///< Perf event counts, if enabled
+    long long ksmMergingPages;   ///< Peak pages merged by KSM, summed over processes
+    long long ksmProfitBytes;    ///< Peak memory saved by KSM, summed over processes
+    long long cpuThrottledUs;    ///< Time spent throttled by cpu.max
+    int cpuQuotaPeakPercent;     ///< Highest CPU quota in effect, including lent CPU
+};
+
+/**
+ * @struct ResourceUpdate
+ * @brief New limits for a running sandbox; unset limits are left alone.
+ */
+struct ResourceUpdate {
+    std::optional<int> memoryMb;           ///< memory.max; memory.high follows at 80%
+    std::optional<int> cpuQuotaPercent;    ///< cpu.max, 100 per CPU
+    std::optional<int> maxPids;            ///< pids.max
+    std::optional<std::string> ioMax;      ///< One io.max line, "MAJ:MIN rbps=N wbps=N ..."
+};
+
 /**
  * @class Cgroups
  * @brief Implements cgroup-based resource limiting.
@@ -33,7 +67,7 @@ public:
     /**
      * @brief Destructor.
      */
-    ~Cgroups() override = default;
+    ~Cgroups() override;
 
     // IModule interface
     std::string getName() const override;
@@ -61,6 +95,84 @@ public:
      */
     std::string getCgroupName() const;
 
+    /**
+     * @brief Get the cgroup.procs descriptor of a process sub-cgroup.
+     *
+     * The descriptor is opened before the fork so that processes of a
+     * group can join their sub-cgroup from inside the new root by
+     * writing "0" to it.
+     *
+     * @param processName Name of the process in the group.
+     * @return The descriptor, or -1 if there is no such sub-cgroup.
+     */
+    int getProcessCgroupFd(const std::string& processName) const;
+
+    /**
+     * @brief Get the fan-out slot sub-cgroups.
+     * @return One entry per slot, empty when fan-out is not configured.
+     */
+    const std::vector<FanOutSlot>& getFanOutSlots() const;
+
+    /**
+     * @brief Get the read-write memory.peak descriptor of the sandbox.
+     *
+     * Writing to it resets the peak seen through the same open file,
+     * which is how a warm restart starts a fresh measurement.
+     *
+     * @return The descriptor, or -1 if memory.peak is unavailable.
+     */
+    int getMemoryPeakFd() const;
+
+    /**
+     * @brief Sample KSM statistics of the sandbox processes.
+     *
+     * The per-process counters in /proc disappear with the processes,
+     * so they are sampled while the sandbox runs and the peak is kept.
+     * Safe to call from a thread other than the one collecting usage.
+     */
+    void sampleMemoryMerge();
+
+    /**
+     * @brief Collect resource usage from the sandbox cgroup.
+     * @return The current resource usage.
+     */
+    ResourceUsage collectUsage() const;
+
+    /**
+     * @brief Change the limits of this sandbox while it runs.
+     *
+     * A CPU quota change also moves the floor the elastic quota lends
+     * from.
+     *
+     * @param update The limits to change.
+     * @param error Set to the reason on failure.
+     * @return true if every limit was changed.
+     */
+    bool updateResources(const ResourceUpdate& update, std::string& error);
+
+    /**
+     * @brief Change the limits of a running sandbox cgroup.
+     *
+     * Every new limit is checked against the current usage before
+     * anything is written: memory and PID limits may not drop below
+     * what the sandbox already uses. If a write fails, the files
+     * written before it get their old values back, so the limits
+     * change together or not at all.
+     *
+     * @param cgroupDir The sandbox cgroup directory.
+     * @param update The limits to change.
+     * @param error Set to the reason on failure.
+     * @return true if every limit was changed.
+     */
+    static bool updateLimits(const std::string& cgroupDir, const ResourceUpdate& update, std::string& error);
+
+    /**
+     * @brief Describe an update for logs and sandbox records.
+     * @param update The update.
+     * @return For example "memory=2048M cpu=150% pids=500".
+     */
+    static std::string describeUpdate(const ResourceUpdate& update);
+
 private:
     /**
      * @brief Create the cgroup.
@@ -83,6 +195,19 @@ private:
      */
     bool setCpuLimits(const SandboxConfiguration& config);
 
+    /**
+     * @brief Pin the sandbox to CPUs and memory nodes.
+     * @param config The sandbox configuration.
+     * @return true if successful.
+     */
+    bool setCpusetLimits(const SandboxConfiguration& config);
+
+    /**
+     * @brief Start counting perf events of the sandbox cgroup.
+     * @param config The sandbox configuration.
+     */
+    void openPerfCounters(const SandboxConfiguration& config);
+
     /**
      * @brief Set PID limits.
      * @param config The sandbox configuration.
@@ -90,11 +215,49 @@ private:
      */
     bool setPidLimits(const SandboxConfiguration& config);
 
+    /**
+     * @brief Create a leaf cgroup below the sandbox cgroup.
+     * @param leaf Name of the leaf, relative to the sandbox cgroup.
+     * @param memoryMb Memory limit, 0 for none.
+     * @param cpuQuotaPercent CPU quota, 0 for none.
+     * @param maxPids PID limit, 0 for none.
+     * @return true if successful.
+     */
+    bool createSubCgroup(const std::string& leaf, int memoryMb,
+                         int cpuQuotaPercent, int maxPids);
+
+    /**
+     * @brief Create the init and per-process sub-cgroups of a group.
+     * @param config The sandbox configuration.
+     * @return true if successful.
+     */
+    bool createProcessCgroups(const SandboxConfiguration& config);
+
+    /**
+     * @brief Create the init and per-slot sub-cgroups for fan-out runs.
+     * @param config The sandbox configuration.
+     * @return true if successful.
+     */
+    bool createFanOutCgroups(const SandboxConfiguration& config);
+
+    /**
+     * @brief Close descriptors opened for process and slot sub-cgroups.
+     */
+    void closeProcessCgroupFds();
+
     ModuleState state_;
     SandboxConfiguration config_;
     std::string cgroupPath_;
     std::string cgroupName_;
     std::string cgroupFullPath_;
+    std::map<std::string, int> processCgroupFds_;  ///< Process name -> cgroup.procs fd
+    std::vector<FanOutSlot> fanOutSlots_;          ///< Fan-out slot descriptors
+    int memoryPeakFd_;                             ///< memory.peak, shared with the child
+    PerfCounters perfCounters_;                    ///< Perf events, if enabled
+    std::atomic<long long> ksmMergingPages_;       ///< Peak sampled KSM merging pages
+    std::atomic<long long> ksmProfitBytes_;        ///< Peak sampled KSM profit
+    ResourceView resourceView_;                    ///< CPUs and memory the sandbox is sized to
+    std::unique_ptr<ElasticQuota> elasticQuota_;   ///< Lends idle CPU, if a burst is configured
 };
 
 } // namespace sandbox
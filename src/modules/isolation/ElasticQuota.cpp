@@ -0,0 +1,192 @@
+/**
+ * @file ElasticQuota.cpp
+ * @brief Implementation of the ElasticQuota class.
+ */
+
+#include "modules/isolation/ElasticQuota.h"
+#include "utils/Syscalls.h"
+#include "core/Logger.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+namespace sandbox {
+
+namespace {
+
+/// cpu.max period; the quota is expressed per 100 ms
+const long long kPeriodUs = 100000;
+
+struct HostTimes {
+    unsigned long long busy = 0;
+    unsigned long long total = 0;
+    int cpus = 0;
+};
+
+/// Read the jiffies of all CPUs from /proc/stat
+bool readHostTimes(HostTimes& times) {
+    auto stat = Syscall::readFile("/proc/stat");
+    if (!stat) {
+        return false;
+    }
+    std::istringstream in(*stat);
+    std::string line;
+    times = HostTimes();
+    while (std::getline(in, line)) {
+        if (line.compare(0, 4, "cpu ") == 0) {
+            // user nice system idle iowait irq softirq steal
+            std::istringstream fields(line.substr(4));
+            unsigned long long value;
+            for (int i = 0; i < 8 && fields >> value; ++i) {
+                times.total += value;
+                if (i != 3 && i != 4) {
+                    times.busy += value;
+                }
+            }
+        } else if (line.compare(0, 3, "cpu") == 0) {
+            ++times.cpus;
+        }
+    }
+    return times.total > 0 && times.cpus > 0;
+}
+
+/// Read usage_usec and nr_throttled from cpu.stat
+bool readCgroupTimes(const std::string& cgroupDir, long long& usageUs, long long& throttled) {
+    auto stat = Syscall::readFile(cgroupDir + "/cpu.stat");
+    if (!stat) {
+        return false;
+    }
+    std::istringstream in(*stat);
+    std::string key;
+    long long value;
+    while (in >> key >> value) {
+        if (key == "usage_usec") {
+            usageUs = value;
+        } else if (key == "nr_throttled") {
+            throttled = value;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+ElasticQuota::ElasticQuota(int floorPercent, int ceilingPercent)
+    : floor_(floorPercent)
+    , ceiling_(std::max(floorPercent, ceilingPercent))
+    , quota_(floorPercent)
+    , peak_(floorPercent)
+    , cooldown_(0)
+    , stopping_(false)
+{
+}
+
+ElasticQuota::~ElasticQuota() {
+    stop();
+}
+
+int ElasticQuota::update(double spareCpus, bool throttled) {
+    // Room the rest of the host leaves us, never below the guarantee
+    int room = std::max(floor_, static_cast<int>((spareCpus - kReserveCpus) * 100));
+    int quota = quota_;
+
+    if (quota > room) {
+        // The host wants its CPUs back
+        quota = floor_;
+        cooldown_ = kCooldownIntervals;
+    } else if (cooldown_ > 0) {
+        --cooldown_;
+    } else if (throttled && quota < ceiling_) {
+        int step = std::min(quota, (room - quota) / 2);
+        quota = std::min(ceiling_, quota + step);
+    }
+
+    quota_ = quota;
+    peak_ = std::max(peak_.load(), quota);
+    return quota;
+}
+
+void ElasticQuota::start(const std::string& cgroupDir, int intervalMs) {
+    stop();
+    stopping_ = false;
+    worker_ = std::thread(&ElasticQuota::run, this, cgroupDir, intervalMs);
+}
+
+void ElasticQuota::stop() {
+    if (!worker_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    worker_.join();
+}
+
+int ElasticQuota::getQuota() const {
+    return quota_;
+}
+
+int ElasticQuota::getPeakQuota() const {
+    return peak_;
+}
+
+void ElasticQuota::run(const std::string& cgroupDir, int intervalMs) {
+    HostTimes lastHost;
+    long long lastUsage = 0;
+    long long lastThrottled = 0;
+    auto lastTime = std::chrono::steady_clock::now();
+    if (!readHostTimes(lastHost) || !readCgroupTimes(cgroupDir, lastUsage, lastThrottled)) {
+        SANDBOX_WARNING("Cannot read CPU statistics, elastic CPU quota disabled");
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!wake_.wait_for(lock, std::chrono::milliseconds(intervalMs), [this]() { return stopping_; })) {
+        HostTimes host;
+        long long usage = lastUsage;
+        long long throttled = lastThrottled;
+        auto now = std::chrono::steady_clock::now();
+        if (!readHostTimes(host) || !readCgroupTimes(cgroupDir, usage, throttled) ||
+            host.total <= lastHost.total) {
+            continue;
+        }
+
+        // Host time is in jiffies and sandbox time in microseconds, so
+        // both are turned into CPUs busy over the interval
+        double hostBusy = static_cast<double>(host.busy - lastHost.busy) /
+                          static_cast<double>(host.total - lastHost.total) * host.cpus;
+        double elapsedUs = std::chrono::duration<double, std::micro>(now - lastTime).count();
+        double ownBusy = elapsedUs > 0 ? (usage - lastUsage) / elapsedUs : 0;
+        double spare = host.cpus - std::max(0.0, hostBusy - ownBusy);
+
+        int before = quota_;
+        int after = update(spare, throttled > lastThrottled);
+        if (after != before && writeQuota(cgroupDir, after)) {
+            SANDBOX_DEBUG("CPU quota " + std::to_string(before) + "% -> " + std::to_string(after) +
+                          "% (" + std::to_string(spare) + " CPUs spare)");
+        }
+
+        lastHost = host;
+        lastUsage = usage;
+        lastThrottled = throttled;
+        lastTime = now;
+    }
+
+    if (quota_ != floor_) {
+        quota_ = floor_;
+        writeQuota(cgroupDir, floor_);
+    }
+}
+
+bool ElasticQuota::writeQuota(const std::string& cgroupDir, int percent) {
+    long long quotaUs = static_cast<long long>(percent) * kPeriodUs / 100;
+    if (!Syscall::writeFile(cgroupDir + "/cpu.max", std::to_string(quotaUs) + " " + std::to_string(kPeriodUs))) {
+        SANDBOX_WARNING("Failed to set cpu.max of " + cgroupDir);
+        return false;
+    }
+    return true;
+}
+
+} // namespace sandbox
@@ -0,0 +1,112 @@
+/**
+ * @file ElasticQuota.h
+ * @brief Lends idle host CPU to a throttled sandbox.
+ *
+ * This header defines the ElasticQuota class that raises the cpu.max of
+ * a sandbox cgroup above its guarantee while the host has idle CPU, and
+ * drops it back as soon as the host gets busy.
+ */
+
+#ifndef SANDBOX_ELASTIC_QUOTA_H
+#define SANDBOX_ELASTIC_QUOTA_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace sandbox {
+
+/**
+ * @class ElasticQuota
+ * @brief Adjusts a cgroup's CPU quota between a floor and a ceiling.
+ *
+ * Every interval the controller measures busy host CPUs from /proc/stat
+ * and the usage and throttling of the cgroup from cpu.stat. The CPUs
+ * the rest of the host does not use, less kReserveCpus, bound what the
+ * sandbox may take; its own usage does not count against it, so a loan
+ * is not mistaken for contention. A throttled sandbox grows its quota
+ * by half the remaining room, at most doubling it per step, so that
+ * supervisors lending at the same time do not overcommit the host
+ * together. Once the rest of the host needs the CPUs back, the quota
+ * drops straight to the floor and stays there for a few intervals.
+ *
+ * Each supervisor runs the controller for its own sandbox; they
+ * coordinate only through the host CPU time they all observe.
+ */
+class ElasticQuota {
+public:
+    /// CPUs kept free for the rest of the host to grow into
+    static constexpr double kReserveCpus = 0.5;
+
+    /// Intervals without lending after the quota was taken back
+    static constexpr int kCooldownIntervals = 4;
+
+    /**
+     * @brief Construct a controller.
+     * @param floorPercent The guaranteed quota, 100 per CPU.
+     * @param ceilingPercent The largest quota to lend up to.
+     */
+    ElasticQuota(int floorPercent, int ceilingPercent);
+
+    /**
+     * @brief Destructor. Stops the controller.
+     */
+    ~ElasticQuota();
+
+    ElasticQuota(const ElasticQuota&) = delete;
+    ElasticQuota& operator=(const ElasticQuota&) = delete;
+
+    /**
+     * @brief Compute the quota for the next interval.
+     * @param spareCpus CPUs the rest of the host left unused during
+     *                  the last interval.
+     * @param throttled Whether the cgroup was throttled in it.
+     * @return The new quota in percent.
+     */
+    int update(double spareCpus, bool throttled);
+
+    /**
+     * @brief Start adjusting a cgroup's cpu.max.
+     * @param cgroupDir The cgroup directory.
+     * @param intervalMs Time between adjustments.
+     */
+    void start(const std::string& cgroupDir, int intervalMs);
+
+    /**
+     * @brief Stop adjusting and restore the floor.
+     */
+    void stop();
+
+    /**
+     * @brief Get the current quota.
+     * @return The quota in percent.
+     */
+    int getQuota() const;
+
+    /**
+     * @brief Get the highest quota lent so far.
+     * @return The quota in percent.
+     */
+    int getPeakQuota() const;
+
+private:
+    void run(const std::string& cgroupDir, int intervalMs);
+    bool writeQuota(const std::string& cgroupDir, int percent);
+
+    int floor_;
+    int ceiling_;
+    std::atomic<int> quota_;
+    std::atomic<int> peak_;
+    int cooldown_;
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_ELASTIC_QUOTA_H
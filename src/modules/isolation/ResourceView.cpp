@@ -0,0 +1,306 @@
+/**
+ * @file ResourceView.cpp
+ * @brief Implementation of the ResourceView class.
+ */
+
+#include "modules/isolation/ResourceView.h"
+#include "utils/Syscalls.h"
+#include "core/Logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sched.h>
+#include <sstream>
+#include <sys/mount.h>
+#include <sys/stat.h>
+
+namespace sandbox {
+
+namespace {
+
+/// Thread pool size variables of common runtimes
+const char* const kThreadVariables[] = {
+    "GOMAXPROCS", "OMP_NUM_THREADS", "MKL_NUM_THREADS", "OPENBLAS_NUM_THREADS",
+    "RAYON_NUM_THREADS", "DOTNET_PROCESSOR_COUNT"
+};
+
+/// meminfo fields that describe the whole limit or are meaningless inside it
+const char* const kZeroedMemFields[] = {
+    "Buffers", "Cached", "SwapCached", "SwapTotal", "SwapFree"
+};
+
+bool startsWith(const std::string& s, const std::string& prefix) {
+    return s.compare(0, prefix.size(), prefix) == 0;
+}
+
+/// Parse "cpuN" at the start of a /proc/stat line, -1 for anything else
+int statCpu(const std::string& line) {
+    if (!startsWith(line, "cpu") || line.size() < 4 || !isdigit(static_cast<unsigned char>(line[3]))) {
+        return -1;
+    }
+    return std::atoi(line.c_str() + 3);
+}
+
+} // namespace
+
+ResourceView::ResourceView()
+    : memoryBytes_(0)
+{
+}
+
+ResourceView ResourceView::fromLimits(const ResourcesConfig& resources,
+                                      const std::vector<int>& allowed, unsigned int rotation) {
+    ResourceView view;
+    view.memoryBytes_ = resources.memory_mb > 0 ? static_cast<long long>(resources.memory_mb) * 1024 * 1024 : 0;
+    if (allowed.empty()) {
+        return view;
+    }
+
+    // A partial CPU still runs a thread, so the quota is rounded up
+    // Sized for the burst, or lent CPU could not be used
+    int quota = std::max(resources.cpu_quota_percent, resources.cpu_burst_percent);
+    size_t wanted = allowed.size();
+    if (quota > 0) {
+        wanted = std::min(wanted, static_cast<size_t>((quota + 99) / 100));
+    }
+    size_t start = wanted < allowed.size() ? rotation % allowed.size() : 0;
+    for (size_t i = 0; i < wanted; ++i) {
+        view.cpus_.push_back(allowed[(start + i) % allowed.size()]);
+    }
+    std::sort(view.cpus_.begin(), view.cpus_.end());
+    return view;
+}
+
+const std::vector<int>& ResourceView::getCpus() const {
+    return cpus_;
+}
+
+long long ResourceView::getMemoryBytes() const {
+    return memoryBytes_;
+}
+
+std::vector<std::pair<std::string, std::string>> ResourceView::runtimeHints() const {
+    std::vector<std::pair<std::string, std::string>> hints;
+    if (cpus_.empty()) {
+        return hints;
+    }
+    std::string count = std::to_string(cpus_.size());
+    for (const char* name : kThreadVariables) {
+        hints.emplace_back(name, count);
+    }
+    hints.emplace_back("JAVA_TOOL_OPTIONS", "-XX:ActiveProcessorCount=" + count);
+    return hints;
+}
+
+void ResourceView::exportHints() const {
+    for (const auto& [name, value] : runtimeHints()) {
+        const char* current = getenv(name.c_str());
+        if (name == "JAVA_TOOL_OPTIONS" && current) {
+            // JVM options are combined rather than replaced
+            if (!strstr(current, "ActiveProcessorCount")) {
+                setenv(name.c_str(), (std::string(current) + " " + value).c_str(), 1);
+            }
+        } else if (!current) {
+            setenv(name.c_str(), value.c_str(), 0);
+        }
+    }
+}
+
+bool ResourceView::pinAffinity() const {
+    if (cpus_.empty()) {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus_) {
+        CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+        SANDBOX_ERROR("Failed to pin to CPUs " + Syscall::formatCpuList(cpus_) + ": " +
+                      std::string(strerror(errno)));
+        return false;
+    }
+    SANDBOX_DEBUG("Pinned to CPUs " + Syscall::formatCpuList(cpus_));
+    return true;
+}
+
+std::string ResourceView::renderCpuinfo(const std::string& host) const {
+    // Entries are separated by blank lines and start with "processor : N"
+    std::vector<std::pair<int, std::string>> entries;
+    std::stringstream in(host);
+    std::string line;
+    std::string entry;
+    int processor = -1;
+    auto flush = [&]() {
+        if (!entry.empty()) {
+            entries.emplace_back(processor, entry);
+        }
+        entry.clear();
+        processor = -1;
+    };
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            flush();
+            continue;
+        }
+        if (startsWith(line, "processor")) {
+            size_t colon = line.find(':');
+            processor = colon == std::string::npos ? -1 : std::atoi(line.c_str() + colon + 1);
+        }
+        entry += line + "\n";
+    }
+    flush();
+
+    std::string out;
+    for (size_t i = 0; i < cpus_.size(); ++i) {
+        auto it = std::find_if(entries.begin(), entries.end(),
+                               [&](const auto& e) { return e.first == cpus_[i]; });
+        if (it == entries.end()) {
+            continue;
+        }
+        std::stringstream lines(it->second);
+        while (std::getline(lines, line)) {
+            if (startsWith(line, "processor")) {
+                line = line.substr(0, line.find(':') + 1) + " " + std::to_string(i);
+            }
+            out += line + "\n";
+        }
+        out += "\n";
+    }
+    return out;
+}
+
+std::string ResourceView::renderStat(const std::string& host) const {
+    std::vector<std::string> cpuLines(cpus_.size());
+    std::vector<unsigned long long> total;
+    std::string rest;
+
+    std::stringstream in(host);
+    std::string line;
+    while (std::getline(in, line)) {
+        int cpu = statCpu(line);
+        if (startsWith(line, "cpu ")) {
+            continue;
+        }
+        if (cpu < 0) {
+            rest += line + "\n";
+            continue;
+        }
+        auto it = std::find(cpus_.begin(), cpus_.end(), cpu);
+        if (it == cpus_.end()) {
+            continue;
+        }
+
+        // Renumber the CPU and add its times to the summary line
+        size_t index = static_cast<size_t>(it - cpus_.begin());
+        std::stringstream fields(line.substr(line.find(' ')));
+        unsigned long long value;
+        std::string times;
+        for (size_t f = 0; fields >> value; ++f) {
+            if (total.size() <= f) {
+                total.push_back(0);
+            }
+            total[f] += value;
+            times += " " + std::to_string(value);
+        }
+        cpuLines[index] = "cpu" + std::to_string(index) + times + "\n";
+    }
+
+    std::string out = "cpu ";
+    for (unsigned long long value : total) {
+        out += " " + std::to_string(value);
+    }
+    out += "\n";
+    for (const auto& cpuLine : cpuLines) {
+        out += cpuLine;
+    }
+    return out + rest;
+}
+
+std::string ResourceView::renderMeminfo(const std::string& host) const {
+    if (memoryBytes_ <= 0) {
+        return host;
+    }
+    long long limitKb = memoryBytes_ / 1024;
+
+    std::string out;
+    std::stringstream in(host);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            out += line + "\n";
+            continue;
+        }
+        std::string key = line.substr(0, colon);
+        long long value = std::atoll(line.c_str() + colon + 1);
+        bool inKb = line.find("kB") != std::string::npos;
+
+        // The sandbox starts with its whole limit free
+        if (key == "MemTotal" || key == "MemFree" || key == "MemAvailable") {
+            value = limitKb;
+        } else if (std::any_of(std::begin(kZeroedMemFields), std::end(kZeroedMemFields),
+                               [&](const char* f) { return key == f; })) {
+            value = 0;
+        } else if (inKb) {
+            value = std::min(value, limitKb);
+        }
+
+        // Keep the number right-aligned where the kernel put it
+        size_t end = line.find_first_not_of(" 0123456789", colon + 1);
+        end = end == std::string::npos ? line.size() : end;
+        while (end > colon + 1 && line[end - 1] == ' ') {
+            --end;
+        }
+        std::string number = std::to_string(value);
+        size_t pad = end > colon + 1 + number.size() ? end - colon - 1 - number.size() : 1;
+        out += key + ":" + std::string(pad, ' ') + number + line.substr(end) + "\n";
+    }
+    return out;
+}
+
+bool ResourceView::mountProcFiles(const std::string& scratchDir) const {
+    if (!Syscall::mount("tmpfs", scratchDir, "tmpfs", MS_NOSUID | MS_NODEV | MS_NOEXEC, "mode=755,size=1m")) {
+        SANDBOX_ERROR("Failed to mount scratch tmpfs on " + scratchDir);
+        return false;
+    }
+
+    struct ProcFile {
+        std::string target;
+        std::string content;
+    };
+    std::vector<ProcFile> files;
+    if (auto cpuinfo = Syscall::readFile("/proc/cpuinfo")) {
+        files.push_back({"/proc/cpuinfo", renderCpuinfo(*cpuinfo)});
+    }
+    if (auto stat = Syscall::readFile("/proc/stat")) {
+        files.push_back({"/proc/stat", renderStat(*stat)});
+    }
+    if (auto meminfo = Syscall::readFile("/proc/meminfo")) {
+        files.push_back({"/proc/meminfo", renderMeminfo(*meminfo)});
+    }
+    // glibc sizes sysconf(_SC_NPROCESSORS_ONLN) from this file
+    if (!cpus_.empty() && Syscall::exists("/sys/devices/system/cpu/online")) {
+        std::string online = cpus_.size() == 1 ? "0" : "0-" + std::to_string(cpus_.size() - 1);
+        files.push_back({"/sys/devices/system/cpu/online", online + "\n"});
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < files.size() && ok; ++i) {
+        std::string source = scratchDir + "/" + std::to_string(i);
+        ok = Syscall::writeFile(source, files[i].content) && chmod(source.c_str(), 0444) == 0 &&
+             Syscall::mount(source, files[i].target, "", MS_BIND, nullptr) &&
+             Syscall::mount("", files[i].target, "", MS_BIND | MS_REMOUNT | MS_RDONLY, nullptr);
+        if (!ok) {
+            SANDBOX_ERROR("Failed to virtualize " + files[i].target);
+        }
+    }
+
+    // The bind mounts keep the tmpfs alive after it is detached
+    if (!Syscall::unmount(scratchDir, MNT_DETACH)) {
+        SANDBOX_WARNING("Failed to detach scratch tmpfs from " + scratchDir);
+    }
+    return ok;
+}
+
+} // namespace sandbox
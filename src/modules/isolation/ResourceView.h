@@ -0,0 +1,121 @@
+/**
+ * @file ResourceView.h
+ * @brief What a sandbox's processes are told about their resources.
+ *
+ * This header defines the ResourceView class that turns the cgroup
+ * limits of a sandbox into the CPU count, affinity, environment hints
+ * and /proc files that runtimes inside it size themselves by.
+ */
+
+#ifndef SANDBOX_RESOURCE_VIEW_H
+#define SANDBOX_RESOURCE_VIEW_H
+
+#include "core/ConfigParser.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sandbox {
+
+/**
+ * @class ResourceView
+ * @brief The share of the host a sandbox may use.
+ *
+ * A CPU quota of 150% entitles the sandbox to two CPUs worth of
+ * threads, yet sysconf, sched_getaffinity and /proc/cpuinfo still
+ * report every host CPU, so thread pools get sized to the host and
+ * thrash against the quota. The view holds the CPUs the sandbox is
+ * sized to, the quota rounded up and taken from the allowed CPUs, and
+ * its memory limit, and presents them to the sandboxed processes.
+ */
+class ResourceView {
+public:
+    ResourceView();
+
+    /**
+     * @brief Size a view from the configured limits.
+     *
+     * Sandboxes started by different supervisors get different CPUs,
+     * so pinned sandboxes spread over the host instead of piling up on
+     * the first CPUs.
+     *
+     * @param resources The resource limits.
+     * @param allowed The CPUs the sandbox may run on.
+     * @param rotation Selects where in the allowed CPUs to start.
+     * @return The view.
+     */
+    static ResourceView fromLimits(const ResourcesConfig& resources,
+                                   const std::vector<int>& allowed, unsigned int rotation);
+
+    /**
+     * @brief Get the host CPUs of the view.
+     * @return The CPUs in ascending order.
+     */
+    const std::vector<int>& getCpus() const;
+
+    /**
+     * @brief Get the memory limit.
+     * @return The limit in bytes, 0 for none.
+     */
+    long long getMemoryBytes() const;
+
+    /**
+     * @brief Get the thread pool hints for common runtimes.
+     * @return Environment variable names and values.
+     */
+    std::vector<std::pair<std::string, std::string>> runtimeHints() const;
+
+    /**
+     * @brief Export the runtime hints to the environment.
+     *
+     * Variables the user has set already are left alone.
+     */
+    void exportHints() const;
+
+    /**
+     * @brief Restrict the calling process to the CPUs of the view.
+     * @return true if successful.
+     */
+    bool pinAffinity() const;
+
+    /**
+     * @brief Render /proc/cpuinfo for the view.
+     * @param host The host's /proc/cpuinfo.
+     * @return The entries of the view's CPUs, renumbered from 0.
+     */
+    std::string renderCpuinfo(const std::string& host) const;
+
+    /**
+     * @brief Render /proc/stat for the view.
+     * @param host The host's /proc/stat.
+     * @return The host statistics with only the view's CPUs.
+     */
+    std::string renderStat(const std::string& host) const;
+
+    /**
+     * @brief Render /proc/meminfo for the view.
+     * @param host The host's /proc/meminfo.
+     * @return The host statistics capped at the memory limit.
+     */
+    std::string renderMeminfo(const std::string& host) const;
+
+    /**
+     * @brief Mount the rendered files over /proc and /sys.
+     *
+     * Must run after /proc is mounted in the new root. The files are
+     * written to a tmpfs on an empty scratch directory that is detached
+     * again once they are bound, so nothing is left in the image.
+     *
+     * @param scratchDir An empty directory to mount the tmpfs on.
+     * @return true if successful.
+     */
+    bool mountProcFiles(const std::string& scratchDir) const;
+
+private:
+    std::vector<int> cpus_;
+    long long memoryBytes_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_RESOURCE_VIEW_H
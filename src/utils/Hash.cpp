@@ -0,0 +1,148 @@
+/**
+ * @file Hash.cpp
+ * @brief Implementation of the Xxh64 class.
+ */
+
+#include "utils/Hash.h"
+#include <cstring>
+
+namespace sandbox {
+
+namespace {
+
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// XXH64 is defined on little-endian words
+inline uint64_t read64(const unsigned char* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+inline uint32_t read32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    acc = rotl(acc, 31);
+    return acc * kPrime1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t value) {
+    acc ^= round(0, value);
+    return acc * kPrime1 + kPrime4;
+}
+
+} // namespace
+
+Xxh64::Xxh64(uint64_t seed)
+    : seed_(seed)
+    , total_(0)
+    , acc_{seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1}
+    , buffered_(0)
+{
+}
+
+void Xxh64::update(const void* data, size_t size) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    total_ += size;
+
+    if (buffered_ + size < sizeof(buffer_)) {
+        std::memcpy(buffer_ + buffered_, p, size);
+        buffered_ += size;
+        return;
+    }
+
+    if (buffered_ > 0) {
+        size_t fill = sizeof(buffer_) - buffered_;
+        std::memcpy(buffer_ + buffered_, p, fill);
+        for (int i = 0; i < 4; ++i) {
+            acc_[i] = round(acc_[i], read64(buffer_ + 8 * i));
+        }
+        p += fill;
+        size -= fill;
+        buffered_ = 0;
+    }
+
+    while (size >= 32) {
+        for (int i = 0; i < 4; ++i) {
+            acc_[i] = round(acc_[i], read64(p + 8 * i));
+        }
+        p += 32;
+        size -= 32;
+    }
+
+    std::memcpy(buffer_, p, size);
+    buffered_ = size;
+}
+
+uint64_t Xxh64::digest() const {
+    uint64_t h;
+    if (total_ >= 32) {
+        h = rotl(acc_[0], 1) + rotl(acc_[1], 7) + rotl(acc_[2], 12) + rotl(acc_[3], 18);
+        for (int i = 0; i < 4; ++i) {
+            h = mergeRound(h, acc_[i]);
+        }
+    } else {
+        h = seed_ + kPrime5;
+    }
+    h += total_;
+
+    const unsigned char* p = buffer_;
+    size_t left = buffered_;
+    while (left >= 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * kPrime1 + kPrime4;
+        p += 8;
+        left -= 8;
+    }
+    if (left >= 4) {
+        h ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+        h = rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+        left -= 4;
+    }
+    while (left > 0) {
+        h ^= (*p) * kPrime5;
+        h = rotl(h, 11) * kPrime1;
+        ++p;
+        --left;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t Xxh64::hash(const void* data, size_t size, uint64_t seed) {
+    Xxh64 state(seed);
+    state.update(data, size);
+    return state.digest();
+}
+
+std::string Xxh64::toHex(uint64_t value) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        hex[i] = digits[value & 0xf];
+        value >>= 4;
+    }
+    return hex;
+}
+
+} // namespace sandbox
@@ -0,0 +1,72 @@
+/**
+ * @file Hash.h
+ * @brief Fast non-cryptographic content hashing.
+ *
+ * This header defines the Xxh64 class, an implementation of the XXH64
+ * hash used to address image contents.
+ */
+
+#ifndef SANDBOX_HASH_H
+#define SANDBOX_HASH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace sandbox {
+
+/**
+ * @class Xxh64
+ * @brief Incremental XXH64 hash.
+ *
+ * Feeding the same bytes in any number of update() calls gives the same
+ * digest as hashing them in one go.
+ */
+class Xxh64 {
+public:
+    /**
+     * @brief Start a hash.
+     * @param seed The seed.
+     */
+    explicit Xxh64(uint64_t seed = 0);
+
+    /**
+     * @brief Add bytes to the hash.
+     * @param data The bytes.
+     * @param size Number of bytes.
+     */
+    void update(const void* data, size_t size);
+
+    /**
+     * @brief Get the hash of the bytes added so far.
+     * @return The hash.
+     */
+    uint64_t digest() const;
+
+    /**
+     * @brief Hash a buffer in one go.
+     * @param data The bytes.
+     * @param size Number of bytes.
+     * @param seed The seed.
+     * @return The hash.
+     */
+    static uint64_t hash(const void* data, size_t size, uint64_t seed = 0);
+
+    /**
+     * @brief Format a hash as 16 lowercase hex digits.
+     * @param value The hash.
+     * @return The hex string.
+     */
+    static std::string toHex(uint64_t value);
+
+private:
+    uint64_t seed_;
+    uint64_t total_;
+    uint64_t acc_[4];
+    unsigned char buffer_[32];
+    size_t buffered_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_HASH_H
@@ -0,0 +1,159 @@
+/**
+ * @file NetworkStats.cpp
+ * @brief Implementation of the NetworkStats class.
+ */
+
+#include "utils/NetworkStats.h"
+#include "core/Logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <thread>
+#include <string>
+#include <cstring>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+
+namespace sandbox {
+
+NetworkStats::NetworkStats()
+    : socketFd_(-1)
+    , sequence_(0)
+{
+}
+
+NetworkStats::~NetworkStats() {
+    close();
+}
+
+bool NetworkStats::open(pid_t pid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (socketFd_ >= 0) {
+        return true;
+    }
+
+    std::string nsPath = "/proc/" + std::to_string(pid) + "/ns/net";
+    int nsFd = ::open(nsPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (nsFd < 0) {
+        return false;
+    }
+
+    // Never account the supervisor's own namespace
+    struct stat target;
+    struct stat self;
+    if (fstat(nsFd, &target) < 0 || stat("/proc/self/ns/net", &self) < 0 ||
+        (target.st_dev == self.st_dev && target.st_ino == self.st_ino)) {
+        ::close(nsFd);
+        return false;
+    }
+
+    // setns() only moves the calling thread, so do it in a helper thread
+    int fd = -1;
+    std::thread helper([nsFd, &fd]() {
+        if (setns(nsFd, CLONE_NEWNET) == 0) {
+            fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+        }
+    });
+    helper.join();
+    ::close(nsFd);
+
+    if (fd < 0) {
+        SANDBOX_DEBUG("Failed to open netlink socket in " + nsPath + ": " + std::string(strerror(errno)));
+        return false;
+    }
+
+    socketFd_ = fd;
+    return true;
+}
+
+bool NetworkStats::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return socketFd_ >= 0;
+}
+
+bool NetworkStats::sample(NetworkUsage& usage) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    usage = {};
+    if (socketFd_ < 0) {
+        return false;
+    }
+
+    struct {
+        struct nlmsghdr header;
+        struct ifinfomsg info;
+    } request;
+    std::memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    request.header.nlmsg_type = RTM_GETLINK;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = ++sequence_;
+    request.info.ifi_family = AF_UNSPEC;
+
+    if (send(socketFd_, &request, request.header.nlmsg_len, 0) < 0) {
+        return false;
+    }
+
+    alignas(struct nlmsghdr) char buffer[32768];
+    while (true) {
+        ssize_t len = recv(socketFd_, buffer, sizeof(buffer), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        for (auto* msg = reinterpret_cast<struct nlmsghdr*>(buffer); NLMSG_OK(msg, len);
+             msg = NLMSG_NEXT(msg, len)) {
+            if (msg->nlmsg_seq != sequence_) {
+                continue;
+            }
+            if (msg->nlmsg_type == NLMSG_DONE) {
+                return true;
+            }
+            if (msg->nlmsg_type == NLMSG_ERROR) {
+                return false;
+            }
+            if (msg->nlmsg_type != RTM_NEWLINK) {
+                continue;
+            }
+
+            auto* info = static_cast<struct ifinfomsg*>(NLMSG_DATA(msg));
+            if (info->ifi_flags & IFF_LOOPBACK) {
+                continue;
+            }
+
+            int attrLen = IFLA_PAYLOAD(msg);
+            for (auto* attr = IFLA_RTA(info); RTA_OK(attr, attrLen); attr = RTA_NEXT(attr, attrLen)) {
+                if (attr->rta_type != IFLA_STATS64) {
+                    continue;
+                }
+                struct rtnl_link_stats64 stats;
+                std::memset(&stats, 0, sizeof(stats));
+                std::memcpy(&stats, RTA_DATA(attr), std::min<size_t>(RTA_PAYLOAD(attr), sizeof(stats)));
+                usage.rxBytes += stats.rx_bytes;
+                usage.txBytes += stats.tx_bytes;
+                usage.rxPackets += stats.rx_packets;
+                usage.txPackets += stats.tx_packets;
+                usage.rxDropped += stats.rx_dropped;
+                usage.txDropped += stats.tx_dropped;
+            }
+        }
+    }
+}
+
+void NetworkStats::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (socketFd_ >= 0) {
+        ::close(socketFd_);
+        socketFd_ = -1;
+    }
+}
+
+} // namespace sandbox
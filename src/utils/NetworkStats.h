@@ -0,0 +1,87 @@
+/**
+ * @file NetworkStats.h
+ * @brief Traffic counters of a network namespace.
+ *
+ * This header defines the NetworkStats class that reads the interface
+ * counters of a sandbox's network namespace over rtnetlink, without
+ * executing any tools.
+ */
+
+#ifndef SANDBOX_NETWORK_STATS_H
+#define SANDBOX_NETWORK_STATS_H
+
+#include <mutex>
+#include <sys/types.h>
+
+namespace sandbox {
+
+/**
+ * @struct NetworkUsage
+ * @brief Traffic of a network namespace, summed over its interfaces.
+ *
+ * Loopback traffic is excluded.
+ */
+struct NetworkUsage {
+    unsigned long long rxBytes;
+    unsigned long long txBytes;
+    unsigned long long rxPackets;
+    unsigned long long txPackets;
+    unsigned long long rxDropped;
+    unsigned long long txDropped;
+};
+
+/**
+ * @class NetworkStats
+ * @brief Samples the interface counters of a process's network namespace.
+ *
+ * A NETLINK_ROUTE socket is created inside the namespace by a helper
+ * thread that joins it with setns(2); the socket stays bound to the
+ * namespace afterwards and keeps it alive, so the counters can still be
+ * read after the sandbox has exited.
+ */
+class NetworkStats {
+public:
+    NetworkStats();
+    ~NetworkStats();
+
+    NetworkStats(const NetworkStats&) = delete;
+    NetworkStats& operator=(const NetworkStats&) = delete;
+
+    /**
+     * @brief Attach to the network namespace of a process.
+     *
+     * Fails without side effects while the process still shares the
+     * supervisor's namespace, so that host traffic is never counted.
+     *
+     * @param pid The process.
+     * @return true if attached.
+     */
+    bool open(pid_t pid);
+
+    /**
+     * @brief Check whether a namespace is attached.
+     * @return true if attached.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief Read the current counters. Safe to call from any thread.
+     * @param usage Output counters.
+     * @return true if successful.
+     */
+    bool sample(NetworkUsage& usage);
+
+    /**
+     * @brief Detach from the namespace.
+     */
+    void close();
+
+private:
+    mutable std::mutex mutex_;
+    int socketFd_;
+    unsigned int sequence_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_NETWORK_STATS_H
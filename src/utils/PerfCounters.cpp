@@ -0,0 +1,105 @@
+/**
+ * @file PerfCounters.cpp
+ * @brief Implementation of the PerfCounters class.
+ */
+
+#include "utils/PerfCounters.h"
+#include "core/Logger.h"
+#include <cstring>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+namespace sandbox {
+
+namespace {
+
+struct EventSpec {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+};
+
+const EventSpec kEvents[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {"cpu_migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+    {"page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+} // namespace
+
+PerfCounters::~PerfCounters() {
+    close();
+}
+
+bool PerfCounters::open(int cgroupFd, const std::vector<int>& cpus) {
+    close();
+
+    for (const auto& spec : kEvents) {
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = spec.type;
+        attr.config = spec.config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_hv = 1;
+
+        Event event;
+        event.name = spec.name;
+        for (int cpu : cpus) {
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, cgroupFd, cpu, -1,
+                                              PERF_FLAG_PID_CGROUP | PERF_FLAG_FD_CLOEXEC));
+            if (fd < 0) {
+                SANDBOX_DEBUG("Perf event " + event.name + " unavailable on CPU " +
+                              std::to_string(cpu) + ": " + std::string(strerror(errno)));
+                for (int opened : event.fds) {
+                    ::close(opened);
+                }
+                event.fds.clear();
+                break;
+            }
+            event.fds.push_back(fd);
+        }
+
+        if (!event.fds.empty()) {
+            events_.push_back(std::move(event));
+        }
+    }
+
+    return !events_.empty();
+}
+
+std::map<std::string, long long> PerfCounters::read() const {
+    std::map<std::string, long long> values;
+
+    for (const auto& event : events_) {
+        long double total = 0;
+        for (int fd : event.fds) {
+            uint64_t data[3] = {};  // value, time enabled, time running
+            if (::read(fd, data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+                continue;
+            }
+            // Scale up when the counter was multiplexed
+            total += static_cast<long double>(data[0]) * data[1] / data[2];
+        }
+        values[event.name] = static_cast<long long>(total);
+    }
+
+    return values;
+}
+
+void PerfCounters::close() {
+    for (auto& event : events_) {
+        for (int fd : event.fds) {
+            ::close(fd);
+        }
+    }
+    events_.clear();
+}
+
+} // namespace sandbox
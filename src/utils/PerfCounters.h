@@ -0,0 +1,77 @@
+/**
+ * @file PerfCounters.h
+ * @brief Hardware and software performance counters for a cgroup.
+ *
+ * This header defines the PerfCounters class that counts events of all
+ * processes in a cgroup through perf_event_open(2) in cgroup mode.
+ */
+
+#ifndef SANDBOX_PERF_COUNTERS_H
+#define SANDBOX_PERF_COUNTERS_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace sandbox {
+
+/**
+ * @class PerfCounters
+ * @brief Counts perf events of a cgroup.
+ *
+ * Cgroup events are per CPU, so one descriptor is opened for every
+ * event on every CPU the cgroup may run on and the values are summed.
+ * Values are scaled when the kernel had to multiplex the counters.
+ * Events the machine does not support (for example hardware events in
+ * a virtual machine) are skipped.
+ */
+class PerfCounters {
+public:
+    /**
+     * @brief Construct an empty counter set.
+     */
+    PerfCounters() = default;
+
+    /**
+     * @brief Destructor. Closes all counters.
+     */
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * @brief Start counting for a cgroup.
+     * @param cgroupFd Directory descriptor of the cgroup.
+     * @param cpus CPUs to count on.
+     * @return true if at least one event could be opened.
+     */
+    bool open(int cgroupFd, const std::vector<int>& cpus);
+
+    /**
+     * @brief Read the current counter values.
+     * @return Event name -> count.
+     */
+    std::map<std::string, long long> read() const;
+
+    /**
+     * @brief Close all counters.
+     */
+    void close();
+
+private:
+    /**
+     * @struct Event
+     * @brief One event, opened on every CPU.
+     */
+    struct Event {
+        std::string name;
+        std::vector<int> fds;
+    };
+
+    std::vector<Event> events_;
+};
+
+} // namespace sandbox
+
+#endif // SANDBOX_PERF_COUNTERS_H
@@ -9,6 +9,8 @@
 #include <fstream>
 #include <algorithm>
 #include <cstring>
+#include <sched.h>
+#include <sys/resource.h>
 #include <linux/seccomp.h>
 #include <sys/capability.h>
 
@@ -105,7 +107,20 @@ bool Syscall::createCgroup(const std::string& hierarchy, const std::string& name
 
 bool Syscall::removeCgroup(const std::string& hierarchy, const std::string& name) {
     std::string path = hierarchy + "/" + name;
-    return removeRecursive(path);
+
+    // cgroupfs only allows rmdir, so remove nested cgroups depth-first
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(path, ec)) {
+        if (entry.is_directory(ec)) {
+            removeCgroup(path, entry.path().filename().string());
+        }
+    }
+
+    if (::rmdir(path.c_str()) < 0 && errno != ENOENT) {
+        SANDBOX_ERROR("Failed to remove cgroup " + path + ": " + std::string(strerror(errno)));
+        return false;
+    }
+    return true;
 }
 
 bool Syscall::setCgroupValue(const std::string& hierarchy, const std::string& name,
@@ -279,4 +294,149 @@ int Syscall::execve(const std::string& path, char* const argv[], char* const env
     return ::execve(path.c_str(), argv, envp);
 }
 
+int Syscall::execCommand(const std::vector<std::string>& command) {
+    if (command.empty()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    std::vector<char*> argv;
+    argv.reserve(command.size() + 1);
+    for (const auto& arg : command) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    ::execvp(argv[0], argv.data());
+    SANDBOX_ERROR("Failed to execute " + command[0] + ": " + std::string(strerror(errno)));
+    return -1;
+}
+
+std::optional<std::vector<int>> Syscall::parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string item;
+
+    while (std::getline(ss, item, ',')) {
+        item.erase(std::remove_if(item.begin(), item.end(), ::isspace), item.end());
+        if (item.empty()) {
+            continue;
+        }
+
+        size_t dash = item.find('-');
+        try {
+            size_t used = 0;
+            std::string head = item.substr(0, dash);
+            std::string tail = dash != std::string::npos ? item.substr(dash + 1) : head;
+            int first = std::stoi(head, &used);
+            if (used != head.size()) {
+                return std::nullopt;
+            }
+            int last = std::stoi(tail, &used);
+            if (used != tail.size()) {
+                return std::nullopt;
+            }
+            if (first < 0 || last < first) {
+                return std::nullopt;
+            }
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+    }
+
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::string Syscall::formatCpuList(std::vector<int> cpus) {
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+
+    std::string list;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            ++j;
+        }
+        if (!list.empty()) {
+            list += ",";
+        }
+        list += std::to_string(cpus[i]);
+        if (j > i) {
+            list += "-" + std::to_string(cpus[j]);
+        }
+        i = j + 1;
+    }
+    return list;
+}
+
+std::vector<int> Syscall::getAffinityCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+bool Syscall::setAffinityCpus(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+        SANDBOX_ERROR("Failed to set affinity to CPUs " + formatCpuList(cpus) + ": " +
+                      std::string(strerror(errno)));
+        return false;
+    }
+    return true;
+}
+
+bool Syscall::setIdleIoPriority() {
+    // IOPRIO_WHO_PROCESS with who 0 targets the calling thread
+    constexpr int ioprioWhoProcess = 1;
+    constexpr int ioprioClassIdle = 3;
+    constexpr int ioprioClassShift = 13;
+    if (syscall(SYS_ioprio_set, ioprioWhoProcess, 0, ioprioClassIdle << ioprioClassShift) < 0) {
+        SANDBOX_WARNING("Failed to set idle I/O priority: " + std::string(strerror(errno)));
+        return false;
+    }
+    return true;
+}
+
+int Syscall::rlimitResource(const std::string& name) {
+    static const std::pair<const char*, int> kResources[] = {
+        {"nofile", RLIMIT_NOFILE}, {"nproc", RLIMIT_NPROC}, {"stack", RLIMIT_STACK},
+        {"as", RLIMIT_AS}, {"core", RLIMIT_CORE}, {"memlock", RLIMIT_MEMLOCK}
+    };
+    for (const auto& [resourceName, resource] : kResources) {
+        if (name == resourceName) {
+            return resource;
+        }
+    }
+    return -1;
+}
+
+bool Syscall::setResourceLimit(pid_t pid, int resource, unsigned long long soft, unsigned long long hard) {
+    struct rlimit limit;
+    limit.rlim_cur = static_cast<rlim_t>(soft);
+    limit.rlim_max = static_cast<rlim_t>(hard);
+    if (prlimit(pid, static_cast<__rlimit_resource>(resource), &limit, nullptr) < 0) {
+        SANDBOX_ERROR("Failed to set resource limit " + std::to_string(resource) + ": " +
+                      std::string(strerror(errno)));
+        return false;
+    }
+    return true;
+}
+
 } // namespace sandbox
@@ -142,7 +142,7 @@ bool isDirectory(const std::string& path);
 bool createCgroup(const std::string& hierarchy, const std::string& name);
 
 /**
- * @brief Remove a cgroup.
+ * @brief Remove a cgroup and any nested sub-cgroups.
  * @param hierarchy Path to cgroup hierarchy.
  * @param name Name of the cgroup.
  * @return true if successful.
@@ -309,6 +309,66 @@ bool hasCapability(const std::string& cap);
  */
 int execve(const std::string& path, char* const argv[], char* const envp[]);
 
+/**
+ * @brief Execute a command, searching PATH for the program.
+ * @param command Program followed by its arguments.
+ * @return -1 on failure; does not return on success.
+ */
+int execCommand(const std::vector<std::string>& command);
+
+/**
+ * @brief Parse a kernel CPU list such as "0-3,8,10-11".
+ * @param list The CPU list.
+ * @return The CPUs in ascending order, nullopt if malformed.
+ */
+std::optional<std::vector<int>> parseCpuList(const std::string& list);
+
+/**
+ * @brief Format CPUs as a kernel CPU list.
+ * @param cpus The CPUs.
+ * @return The list with consecutive CPUs collapsed into ranges.
+ */
+std::string formatCpuList(std::vector<int> cpus);
+
+/**
+ * @brief Get the CPUs the calling process may run on.
+ * @return The CPUs in ascending order.
+ */
+std::vector<int> getAffinityCpus();
+
+/**
+ * @brief Restrict the calling thread to a set of CPUs.
+ * @param cpus The CPUs.
+ * @return true if successful.
+ */
+bool setAffinityCpus(const std::vector<int>& cpus);
+
+/**
+ * @brief Move the calling thread to the idle I/O scheduling class.
+ *
+ * The thread then only gets disk time when no one else needs it.
+ *
+ * @return true if successful.
+ */
+bool setIdleIoPriority();
+
+/**
+ * @brief Look up a resource limit by name.
+ * @param name Lower-case name without the RLIMIT_ prefix, e.g. "nofile".
+ * @return The RLIMIT_* constant, or -1 for limits the sandbox does not set.
+ */
+int rlimitResource(const std::string& name);
+
+/**
+ * @brief Set a resource limit of a process with prlimit(2).
+ * @param pid The process, 0 for the caller.
+ * @param resource An RLIMIT_* constant.
+ * @param soft The soft limit, RLIM_INFINITY for none.
+ * @param hard The hard limit, RLIM_INFINITY for none.
+ * @return true if successful.
+ */
+bool setResourceLimit(pid_t pid, int resource, unsigned long long soft, unsigned long long hard);
+
 } // namespace Syscall
 
 } // namespace sandbox
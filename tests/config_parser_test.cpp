@@ -5,6 +5,7 @@
 
 #include <gtest/gtest.h>
 #include "core/ConfigParser.h"
+#include <sys/resource.h>
 
 using namespace sandbox;
 
@@ -74,3 +75,353 @@ TEST(ConfigParserTest, MissingRequiredSection) {
     ConfigParser parser(json);
     EXPECT_THROW(parser.parse(), std::runtime_error);
 }
+
+TEST(ConfigParserTest, ProcessGroupParsing) {
+    std::string json = R"({
+        "sandbox": {
+            "name": "group",
+            "processes": [
+                {"name": "service", "command": ["/usr/bin/service"], "restart": "on-failure"},
+                {"name": "shipper", "command": ["/usr/bin/shipper", "-v"],
+                 "stdout": "/var/log/shipper.log", "memory_mb": 64}
+            ]
+        },
+        "resources": {
+            "memory_mb": 512
+        }
+    })";
+
+    ConfigParser parser(json);
+    auto config = parser.parse();
+
+    ASSERT_EQ(config.sandbox.processes.size(), 2);
+    EXPECT_EQ(config.sandbox.processes[0].name, "service");
+    EXPECT_EQ(config.sandbox.processes[0].restart_policy, "on-failure");
+    EXPECT_EQ(config.sandbox.processes[1].command.size(), 2);
+    EXPECT_EQ(config.sandbox.processes[1].restart_policy, "never");
+    EXPECT_EQ(config.sandbox.processes[1].stdout_path, "/var/log/shipper.log");
+    EXPECT_EQ(config.sandbox.processes[1].memory_mb, 64);
+    EXPECT_EQ(config.sandbox.processes[1].max_pids, 0);
+}
+
+TEST(ConfigParserTest, ProcessGroupRejectsDuplicateNames) {
+    std::string json = R"({
+        "sandbox": {
+            "processes": [
+                {"name": "a", "command": ["/bin/true"]},
+                {"name": "a", "command": ["/bin/false"]}
+            ]
+        },
+        "resources": {
+            "memory_mb": 512
+        }
+    })";
+
+    ConfigParser parser(json);
+    EXPECT_THROW(parser.parse(), std::runtime_error);
+}
+
+TEST(ConfigParserTest, ProcessGroupRejectsFanOut) {
+    std::string json = R"({
+        "sandbox": {
+            "processes": [
+                {"name": "a", "command": ["/bin/true"]}
+            ]
+        },
+        "resources": {
+            "memory_mb": 512
+        },
+        "fanout": {
+            "inputs": ["/in/1"]
+        }
+    })";
+
+    ConfigParser parser(json);
+    EXPECT_THROW(parser.parse(), std::runtime_error);
+}
+
+TEST(ConfigParserTest, RestartParsing) {
+    std::string json = R"({
+        "sandbox": {
+            "command": ["/usr/bin/service"]
+        },
+        "resources": {
+            "memory_mb": 512
+        },
+        "restart": {
+            "policy": "always",
+            "backoff_initial_ms": 250,
+            "crash_loop_max_restarts": 10
+        }
+    })";
+
+    ConfigParser parser(json);
+    auto config = parser.parse();
+
+    EXPECT_EQ(config.restart.policy, "always");
+    EXPECT_EQ(config.restart.backoff_initial_ms, 250);
+    EXPECT_EQ(config.restart.backoff_max_ms, 30000);
+    EXPECT_EQ(config.restart.crash_loop_max_restarts, 10);
+}
+
+TEST(ConfigParserTest, SupervisorParsing) {
+    std::string json = R"({
+        "sandbox": {
+            "command": ["/bin/true"]
+        },
+        "resources": {
+            "memory_mb": 512
+        },
+        "supervisor": {
+            "state_dir": "/run/sandbox/state",
+            "hold_output": false
+        }
+    })";
+
+    ConfigParser parser(json);
+    auto config = parser.parse();
+
+    EXPECT_EQ(config.supervisor.state_dir, "/run/sandbox/state");
+    EXPECT_FALSE(config.supervisor.hold_output);
+    EXPECT_EQ(config.supervisor.reap_parallelism, 8);
+}
+
+TEST(ConfigParserTest, FanOutParsing) {
+    std::string json = R"({
+        "sandbox": {
+            "command": ["/usr/bin/solution", "{}"]
+        },
+        "resources": {
+            "memory_mb": 512,
+            "cpu_quota_percent": 250
+        },
+        "fanout": {
+            "inputs": ["/tests/1.in", "/tests/2.in", "/tests/3.in"],
+            "memory_mb": 64,
+            "timeout_ms": 2000
+        }
+    })";
+
+    ConfigParser parser(json);
+    auto config = parser.parse();
+
+    ASSERT_EQ(config.fanout.inputs.size(), 3);
+    EXPECT_EQ(config.fanout.inputs[1], "/tests/2.in");
+    EXPECT_EQ(config.fanout.memory_mb, 64);
+    EXPECT_EQ(config.fanout.timeout_ms, 2000);
+    EXPECT_EQ(config.fanout.max_parallel, 0);
+    EXPECT_EQ(config.fanout.max_output_bytes, 1024 * 1024);
+    EXPECT_EQ(config.fanout.order, "submission");
+
+    std::string unordered = R"({
+        "sandbox": {"command": ["/usr/bin/solution", "{}"]},
+        "resources": {"memory_mb": 512},
+        "fanout": {"inputs": ["/tests/1.in"], "order": "random"}
+    })";
+    ConfigParser invalid(unordered);
+    EXPECT_THROW(invalid.parse(), std::runtime_error);
+}
+
+TEST(ConfigParserTest, ResourceTuningParsing) {
+    std::string json = R"({
+        "sandbox": {
+            "command": ["/usr/bin/python3"]
+        },
+        "resources": {
+            "memory_mb": 512,
+            "cpuset_cpus": "2-3",
+            "memory_merge": true
+        }
+    })";
+
+    ConfigParser parser(json);
+    auto config = parser.parse();
+
+    EXPECT_EQ(config.resources.cpuset_cpus, "2-3");
+    EXPECT_TRUE(config.resources.memory_merge);
+    EXPECT_FALSE(config.resources.perf_counters);
+    EXPECT_FALSE(config.resources.drop_page_cache);
+}
+
+TEST(ConfigParserTest, InvalidCpusetRejected) {
+    std::string json = R"({
+        "sandbox": {
+            "command": ["/bin/true"]
+        },
+        "resources": {
+            "memory_mb": 512,
+            "cpuset_cpus": "3-1"
+        }
+    })";
+
+    ConfigParser parser(json);
+    EXPECT_THROW(parser.parse(), std::runtime_error);
+}
+
+TEST(ConfigParserTest, CpuBurstBelowQuotaRejected) {
+    std::string json = R"({
+        "sandbox": {
+            "command": ["/bin/true"]
+        },
+        "resources": {
+            "memory_mb": 512,
+            "cpu_quota_percent": 200,
+            "cpu_burst_percent": 100
+        }
+    })";
+
+    ConfigParser parser(json);
+    EXPECT_THROW(parser.parse(), std::runtime_error);
+}
+
+TEST(ConfigParserTest, ChannelParsing) {
+    std::string json = R"({
+        "sandbox": {
+            "command": ["/usr/bin/worker"]
+        },
+        "resources": {
+            "memory_mb": 512
+        },
+        "ipc": {
+            "channels": [
+                {"name": "control"},
+                {"name": "frames", "type": "shm", "size_mb": 64}
+            ]
+        }
+    })";
+
+    ConfigParser parser(json);
+    auto config = parser.parse();
+
+    ASSERT_EQ(config.ipc.channels.size(), 2);
+    EXPECT_EQ(config.ipc.channels[0].type, "socket");
+    EXPECT_EQ(config.ipc.channels[0].target, "/run/channels/control");
+    EXPECT_EQ(config.ipc.channels[1].type, "shm");
+    EXPECT_EQ(config.ipc.channels[1].size_mb, 64);
+    EXPECT_EQ(config.ipc.channel_dir, "/run/sandbox/channels");
+}
+
+TEST(ConfigParserTest, InvalidChannelRejected) {
+    std::string json = R"({
+        "sandbox": {
+            "command": ["/bin/true"]
+        },
+        "resources": {
+            "memory_mb": 512
+        },
+        "ipc": {
+            "channels": [{"name": "../etc"}]
+        }
+    })";
+
+    ConfigParser parser(json);
+    EXPECT_THROW(parser.parse(), std::runtime_error);
+}
+
+TEST(ConfigParserTest, ImagesParsing) {
+    std::string json = R"({
+        "sandbox": {
+            "command": ["/bin/true"]
+        },
+        "resources": {
+            "memory_mb": 512
+        },
+        "images": {
+            "store_dirs": ["/srv/images"],
+            "disk_budget_mb": 20480
+        }
+    })";
+
+    ConfigParser parser(json);
+    auto config = parser.parse();
+
+    EXPECT_EQ(config.images.store_dirs, std::vector<std::string>{"/srv/images"});
+    EXPECT_EQ(config.images.disk_budget_mb, 20480);
+    EXPECT_EQ(config.images.min_idle_s, 3600);
+    EXPECT_FALSE(config.images.verify_integrity);
+    EXPECT_EQ(config.images.integrity_threads, 0);
+
+    std::string negative = R"({
+        "sandbox": {"command": ["/bin/true"]},
+        "resources": {"memory_mb": 512},
+        "images": {"disk_budget_mb": -1}
+    })";
+    ConfigParser invalid(negative);
+    EXPECT_THROW(invalid.parse(), std::runtime_error);
+}
+
+TEST(ConfigParserTest, RlimitsParsing) {
+    std::string json = R"({
+        "sandbox": {"command": ["/bin/true"]},
+        "resources": {"memory_mb": 512},
+        "rlimits": {
+            "nofile": 4096,
+            "stack": {"soft": 8388608, "hard": "unlimited"}
+        },
+        "cores": {"enabled": true, "max_mb": 64}
+    })";
+
+    ConfigParser parser(json);
+    auto config = parser.parse();
+
+    ASSERT_EQ(config.rlimits.size(), 2u);
+    EXPECT_EQ(config.rlimits[0].resource, "nofile");
+    EXPECT_EQ(config.rlimits[0].soft, 4096u);
+    EXPECT_EQ(config.rlimits[0].hard, 4096u);
+    EXPECT_EQ(config.rlimits[1].resource, "stack");
+    EXPECT_EQ(config.rlimits[1].soft, 8388608u);
+    EXPECT_EQ(config.rlimits[1].hard, static_cast<unsigned long long>(RLIM_INFINITY));
+    EXPECT_TRUE(config.cores.enabled);
+    EXPECT_EQ(config.cores.max_mb, 64);
+    EXPECT_EQ(config.cores.registry_dir, "/run/sandbox/cores");
+
+    for (const char* rlimits : {R"({"rss": 1})", R"({"nofile": {"soft": 2048, "hard": 1024}})",
+                                R"({"core": "none"})"}) {
+        std::string invalid = R"({"sandbox": {"command": ["/bin/true"]},
+                                  "resources": {"memory_mb": 512}, "rlimits": )" +
+                              std::string(rlimits) + "}";
+        ConfigParser rejected(invalid);
+        EXPECT_THROW(rejected.parse(), std::runtime_error) << rlimits;
+    }
+}
+
+TEST(ConfigParserTest, HousekeepingCpusParsing) {
+    std::string json = R"({
+        "sandbox": {"command": ["/bin/true"]},
+        "resources": {"memory_mb": 512, "cpuset_cpus": "1-3"},
+        "supervisor": {"housekeeping_cpus": "0"}
+    })";
+
+    ConfigParser parser(json);
+    auto config = parser.parse();
+    EXPECT_EQ(config.supervisor.housekeeping_cpus, "0");
+
+    std::string overlapping = R"({
+        "sandbox": {"command": ["/bin/true"]},
+        "resources": {"memory_mb": 512, "cpuset_cpus": "0-1"},
+        "supervisor": {"housekeeping_cpus": "0-3"}
+    })";
+    ConfigParser invalid(overlapping);
+    EXPECT_THROW(invalid.parse(), std::runtime_error);
+}
+
+TEST(ConfigParserTest, FanOutSpeculationRequiresIdempotent) {
+    std::string json = R"({
+        "sandbox": {"command": ["/bin/judge", "{}"]},
+        "resources": {"memory_mb": 512},
+        "fanout": {"inputs": ["/in/1"], "speculate": true}
+    })";
+    ConfigParser parser(json);
+    EXPECT_THROW(parser.parse(), std::runtime_error);
+
+    std::string idempotent = R"({
+        "sandbox": {"command": ["/bin/judge", "{}"]},
+        "resources": {"memory_mb": 512},
+        "fanout": {"inputs": ["/in/1"], "speculate": true, "idempotent": true, "speculate_percentile": 90}
+    })";
+    ConfigParser accepted(idempotent);
+    auto config = accepted.parse();
+    EXPECT_TRUE(config.fanout.speculate);
+    EXPECT_EQ(config.fanout.speculate_percentile, 90);
+    EXPECT_EQ(config.fanout.speculate_slots, 1);
+}
@@ -7,8 +7,45 @@
 #include "modules/interface/IModule.h"
 #include "modules/isolation/Namespaces.h"
 #include "modules/isolation/Cgroups.h"
+#include "modules/isolation/ResourceView.h"
+#include "modules/isolation/ElasticQuota.h"
 #include "modules/security/Caps.h"
+#include "modules/ipc/Channels.h"
+#include "modules/ipc/Datasets.h"
 #include "core/ConfigParser.h"
+#include "core/RestartPolicy.h"
+#include "core/StateStore.h"
+#include "core/FanOut.h"
+#include "core/Benchmark.h"
+#include "core/ImageStore.h"
+#include "core/CoreCollector.h"
+#include "core/Housekeeping.h"
+#include "core/RuntimeHistory.h"
+#include "utils/Syscalls.h"
+#include "utils/NetworkStats.h"
+#include "utils/Hash.h"
+#include "modules/filesystem/ImagePack.h"
+#include "modules/filesystem/LazyFs.h"
+#include "modules/filesystem/IntegrityManifest.h"
+#include "modules/filesystem/RootFS.h"
+#include "modules/filesystem/DebBootstrap.h"
+#include "modules/filesystem/ImageSlimmer.h"
+#include "modules/filesystem/DevTemplate.h"
+#include "modules/ai/FailureIndex.h"
+#include "modules/ai/PromptBudget.h"
+#include "modules/ai/AIAgent.h"
+#include <sched.h>
+#include <zlib.h>
+#include <sstream>
+#include <sys/mount.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace sandbox;
 
@@ -29,6 +66,14 @@ TEST(ModuleTest, CgroupsGetInfo) {
     EXPECT_FALSE(cg.isEnabled() == false);
 }
 
+TEST(ModuleTest, ChannelsGetInfo) {
+    Channels channels;
+    EXPECT_EQ(channels.getName(), "channels");
+    EXPECT_EQ(channels.getType(), "ipc");
+    EXPECT_EQ(channels.getDependencies(), std::vector<std::string>{"rootfs"});
+    EXPECT_EQ(Channels::envName("video-frames.1"), "SANDBOX_CHANNEL_VIDEO_FRAMES_1");
+}
+
 TEST(ModuleTest, ModuleStateTransitions) {
     Namespaces ns;
     ConfigParser parser(ConfigParser::createDefaultConfig());
@@ -48,6 +93,1112 @@ TEST(ModuleTest, ModuleStateTransitions) {
     EXPECT_EQ(ns.getState(), ModuleState::STOPPED);
 }
 
+TEST(ModuleTest, RestartPolicyDecisions) {
+    int success = 0;       // exited with status 0
+    int failure = 1 << 8;  // exited with status 1
+    int killed = SIGKILL;  // terminated by signal
+
+    EXPECT_FALSE(RestartTracker::policyAllows("never", failure));
+    EXPECT_FALSE(RestartTracker::policyAllows("on-failure", success));
+    EXPECT_TRUE(RestartTracker::policyAllows("on-failure", failure));
+    EXPECT_TRUE(RestartTracker::policyAllows("on-failure", killed));
+    EXPECT_TRUE(RestartTracker::policyAllows("always", success));
+}
+
+TEST(ModuleTest, RestartBackoffAndCrashLoop) {
+    auto config = ConfigParser::createDefaultConfig().restart;
+    config.backoff_initial_ms = 100;
+    config.backoff_max_ms = 300;
+    config.crash_loop_window_s = 60;
+    config.crash_loop_max_restarts = 3;
+
+    RestartTracker tracker("on-failure", config);
+    auto now = RestartTracker::Clock::now();
+    int failure = 1 << 8;
+
+    tracker.onStart(now);
+    EXPECT_EQ(tracker.onExit(failure, now), RestartDecision::RESTART);
+    EXPECT_EQ(tracker.getBackoffMs(), 100);
+    EXPECT_EQ(tracker.onExit(failure, now), RestartDecision::RESTART);
+    EXPECT_EQ(tracker.getBackoffMs(), 200);
+    EXPECT_EQ(tracker.onExit(failure, now), RestartDecision::RESTART);
+    EXPECT_EQ(tracker.getBackoffMs(), 300);
+    EXPECT_EQ(tracker.onExit(failure, now), RestartDecision::CRASH_LOOP);
+    EXPECT_EQ(tracker.getRestartCount(), 3);
+
+    // Staying up for a whole window resets the backoff
+    RestartTracker stable("always", config);
+    stable.onStart(now);
+    stable.onExit(failure, now);
+    stable.onExit(failure, now);
+    stable.onStart(now);
+    EXPECT_EQ(stable.onExit(0, now + std::chrono::seconds(61)), RestartDecision::RESTART);
+    EXPECT_EQ(stable.getBackoffMs(), 100);
+}
+
+TEST(ModuleTest, StateStoreRoundTrip) {
+    char dir[] = "/tmp/sandbox-state-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    StateStore store(dir);
+
+    SandboxRecord record{};
+    record.id = "sandbox-test-1";
+    record.name = "test";
+    record.pid = getpid();
+    record.startTime = StateStore::readStartTime(getpid());
+    record.holderPid = -1;
+    record.mounts = {"/tmp/a", "/tmp/b"};
+    ASSERT_TRUE(store.save(record));
+
+    auto loaded = store.load("sandbox-test-1");
+    ASSERT_TRUE(loaded.has_value());
+    EXPECT_EQ(loaded->pid, getpid());
+    EXPECT_EQ(loaded->mounts.size(), 2);
+    EXPECT_TRUE(StateStore::isAlive(loaded->pid, loaded->startTime));
+    EXPECT_FALSE(StateStore::isAlive(loaded->pid, loaded->startTime + 1));
+    EXPECT_EQ(store.list().size(), 1);
+
+    EXPECT_TRUE(store.remove("sandbox-test-1"));
+    EXPECT_TRUE(store.list().empty());
+    rmdir(dir);
+}
+
+TEST(ModuleTest, FanOutSlotsAndResults) {
+    SandboxConfiguration config = ConfigParser::createDefaultConfig();
+    config.resources.cpu_quota_percent = 250;
+    config.fanout.inputs = {"a", "b", "c", "d", "e"};
+    EXPECT_EQ(FanOutRunner::slotCount(config), 3);
+
+    config.fanout.max_parallel = 8;
+    EXPECT_EQ(FanOutRunner::slotCount(config), 5);
+
+    auto args = FanOutRunner::substitute({"/bin/judge", "{}", "--strict"}, "/in/1");
+    EXPECT_EQ(args[1], "/in/1");
+    EXPECT_EQ(args[2], "--strict");
+
+    InputResult result{"/in/1", 3, true, 12, 4096, "out\n", "err", false};
+    auto parsed = FanOutRunner::parseResults(FanOutRunner::toJsonLine(result) + "garbage\n");
+    ASSERT_EQ(parsed.size(), 1);
+    EXPECT_EQ(parsed[0].input, "/in/1");
+    EXPECT_EQ(parsed[0].exitCode, 3);
+    EXPECT_TRUE(parsed[0].timedOut);
+    EXPECT_EQ(parsed[0].memoryPeakBytes, 4096);
+    EXPECT_EQ(parsed[0].stdout, "out\n");
+}
+
+TEST(ModuleTest, FanOutSpeculatesStragglers) {
+    char dir[] = "/tmp/sandbox-speculate-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string base = dir;
+    ASSERT_TRUE(Syscall::writeFile(base + "/input", "done\n"));
+
+    // The first run of the input hangs; its duplicate finds the lock taken
+    SandboxConfiguration config = ConfigParser::createDefaultConfig();
+    config.fanout.inputs = {base + "/input"};
+    config.fanout.idempotent = true;
+    config.fanout.speculate = true;
+    EXPECT_EQ(FanOutRunner::slotCount(config), 2);
+
+    FanOutRunner runner({"/bin/sh", "-c", "mkdir " + base + "/lock 2>/dev/null && exec sleep 10; cat"},
+                        config.fanout);
+    runner.setSlots(std::vector<FanOutSlot>(2, FanOutSlot{-1, -1, -1}));
+    runner.setSpeculationThreshold(100);
+    int results = open((base + "/results").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    ASSERT_GE(results, 0);
+    EXPECT_EQ(runner.run(results), 0);
+    close(results);
+
+    auto parsed = FanOutRunner::parseResults(*Syscall::readFile(base + "/results"));
+    ASSERT_EQ(parsed.size(), 1u);
+    EXPECT_TRUE(parsed[0].speculated);
+    EXPECT_EQ(parsed[0].stdout, "done\n");
+    EXPECT_LT(parsed[0].executionTimeMs, 5000);
+
+    // A first run that fails leaves the input to its still running duplicate
+    Syscall::removeRecursive(base + "/lock");
+    FanOutRunner failing({"/bin/sh", "-c", "mkdir " + base + "/lock 2>/dev/null && { sleep 0.3; exit 1; }; "
+                          "sleep 1; cat"}, config.fanout);
+    failing.setSlots(std::vector<FanOutSlot>(2, FanOutSlot{-1, -1, -1}));
+    failing.setSpeculationThreshold(100);
+    results = open((base + "/results").c_str(), O_RDWR | O_TRUNC | O_CLOEXEC);
+    ASSERT_GE(results, 0);
+    EXPECT_EQ(failing.run(results), 0);
+    close(results);
+    parsed = FanOutRunner::parseResults(*Syscall::readFile(base + "/results"));
+    ASSERT_EQ(parsed.size(), 1u);
+    EXPECT_EQ(parsed[0].exitCode, 0);
+    EXPECT_EQ(parsed[0].stdout, "done\n");
+    EXPECT_GE(parsed[0].executionTimeMs, 1000);
+
+    // Nor does it win when both exit before the runner looks; the
+    // background sleeps keep the pipes open so neither exit wakes it
+    Syscall::removeRecursive(base + "/lock");
+    FanOutRunner together({"/bin/sh", "-c", "sleep 1 & mkdir " + base + "/lock 2>/dev/null && "
+                           "{ while [ ! -e " + base + "/go ]; do sleep 0.01; done; exit 1; }; "
+                           "cat; touch " + base + "/go"}, config.fanout);
+    together.setSlots(std::vector<FanOutSlot>(2, FanOutSlot{-1, -1, -1}));
+    together.setSpeculationThreshold(100);
+    results = open((base + "/results").c_str(), O_RDWR | O_TRUNC | O_CLOEXEC);
+    ASSERT_GE(results, 0);
+    EXPECT_EQ(together.run(results), 0);
+    close(results);
+    parsed = FanOutRunner::parseResults(*Syscall::readFile(base + "/results"));
+    ASSERT_EQ(parsed.size(), 1u);
+    EXPECT_EQ(parsed[0].exitCode, 0);
+    EXPECT_EQ(parsed[0].stdout, "done\n");
+
+    // Percentiles need enough history, which stays bounded
+    RuntimeHistory history(base + "/history", RuntimeHistory::keyFor(config));
+    ASSERT_TRUE(history.load());
+    EXPECT_EQ(history.percentile(90), -1);
+    std::vector<RunSample> samples;
+    for (long ms = 1; ms <= 30; ++ms) {
+        samples.push_back({ms, -1, "/in/" + std::to_string(ms)});
+    }
+    ASSERT_TRUE(history.record(samples));
+    RuntimeHistory reloaded(base + "/history", RuntimeHistory::keyFor(config));
+    ASSERT_TRUE(reloaded.load());
+    EXPECT_EQ(reloaded.percentile(90), 27);
+    EXPECT_EQ(reloaded.percentile(100), 30);
+    ASSERT_TRUE(reloaded.record(std::vector<RunSample>(RuntimeHistory::kMaxSamples, RunSample{5, -1, ""})));
+    EXPECT_EQ(reloaded.getSamples().size(), RuntimeHistory::kMaxSamples);
+
+    std::string key = RuntimeHistory::keyFor(config);
+    config.sandbox.command = {"/bin/other"};
+    EXPECT_NE(RuntimeHistory::keyFor(config), key);
+    Syscall::removeRecursive(base);
+}
+
+TEST(ModuleTest, FanOutOrdersByHistory) {
+    char dir[] = "/tmp/sandbox-order-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string base = dir;
+
+    // Estimates average the latest runs of each input
+    RuntimeHistory history(base, "key");
+    ASSERT_TRUE(history.record({{100, 300, "/in/slow"}, {300, 500, "/in/slow"},
+                                {10, 100, "/in/fast"}, {50, 400, "/in/mid file"}}));
+    RuntimeHistory reloaded(base, "key");
+    ASSERT_TRUE(reloaded.load());
+    auto slow = reloaded.estimate("/in/slow");
+    ASSERT_TRUE(slow.has_value());
+    EXPECT_EQ(slow->timeMs, 200);
+    EXPECT_EQ(slow->peakBytes, 400);
+    ASSERT_TRUE(reloaded.estimate("/in/mid file").has_value());
+    EXPECT_FALSE(reloaded.estimate("/in/new").has_value());
+
+    // Unknown inputs are placed as the median
+    std::map<std::string, RunEstimate> estimates = {
+        {"/in/slow", {200, 400}}, {"/in/fast", {10, 100}}, {"/in/mid", {50, 300}}};
+    std::vector<std::string> inputs = {"/in/slow", "/in/new", "/in/fast", "/in/mid"};
+    EXPECT_EQ(FanOutRunner::orderInputs(inputs, estimates, "submission"), inputs);
+    EXPECT_EQ(FanOutRunner::orderInputs(inputs, estimates, "sjf"),
+              (std::vector<std::string>{"/in/fast", "/in/new", "/in/mid", "/in/slow"}));
+    EXPECT_EQ(FanOutRunner::orderInputs(inputs, estimates, "lpt"),
+              (std::vector<std::string>{"/in/slow", "/in/new", "/in/mid", "/in/fast"}));
+    EXPECT_EQ(FanOutRunner::orderInputs(inputs, estimates, "memory"),
+              (std::vector<std::string>{"/in/slow", "/in/new", "/in/mid", "/in/fast"}));
+
+    // Inputs that do not fit next to each other run one after another
+    ASSERT_TRUE(Syscall::writeFile(base + "/a", ""));
+    ASSERT_TRUE(Syscall::writeFile(base + "/b", ""));
+    FanOutConfig fanout = ConfigParser::createDefaultConfig().fanout;
+    fanout.inputs = {base + "/a", base + "/b"};
+    fanout.order = "memory";
+    FanOutRunner runner({"/bin/sh", "-c", "mkdir " + base + "/busy || exit 1; sleep 0.2; rmdir " + base + "/busy"},
+                        fanout);
+    runner.setSlots(std::vector<FanOutSlot>(2, FanOutSlot{-1, -1, -1}));
+    runner.setEstimates({{base + "/a", {200, 600}}, {base + "/b", {200, 600}}}, 1000);
+    int results = open((base + "/results").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    ASSERT_GE(results, 0);
+    EXPECT_EQ(runner.run(results), 0);
+    close(results);
+    EXPECT_EQ(FanOutRunner::parseResults(*Syscall::readFile(base + "/results")).size(), 2u);
+    Syscall::removeRecursive(base);
+}
+
+TEST(ModuleTest, CpuListParsing) {
+    auto cpus = Syscall::parseCpuList("0-2,5, 7-8");
+    ASSERT_TRUE(cpus.has_value());
+    EXPECT_EQ(*cpus, (std::vector<int>{0, 1, 2, 5, 7, 8}));
+    EXPECT_EQ(Syscall::formatCpuList(*cpus), "0-2,5,7-8");
+    EXPECT_FALSE(Syscall::parseCpuList("3-1").has_value());
+    EXPECT_FALSE(Syscall::parseCpuList("1-2-3").has_value());
+    EXPECT_FALSE(Syscall::parseCpuList("a").has_value());
+
+    EXPECT_EQ(Benchmark::pickCpus({0, 1, 2, 3}, 150), (std::vector<int>{2, 3}));
+    EXPECT_EQ(Benchmark::pickCpus({0, 1}, 50), (std::vector<int>{1}));
+}
+
+TEST(ModuleTest, HousekeepingLeavesWorkloadCpus) {
+    EXPECT_EQ(Housekeeping::workloadCpus({0, 1, 2, 3}, {0}), (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(Housekeeping::workloadCpus({3, 2, 5}, {4, 5}), (std::vector<int>{2, 3}));
+    EXPECT_TRUE(Housekeeping::workloadCpus({1}, {1}).empty());
+
+    // Without housekeeping CPUs nothing is pinned or changed
+    SandboxConfiguration config = ConfigParser::createDefaultConfig();
+    std::vector<int> affinity = Syscall::getAffinityCpus();
+    EXPECT_TRUE(Housekeeping::apply(config));
+    EXPECT_TRUE(config.resources.cpuset_cpus.empty());
+    EXPECT_TRUE(config.supervisor.workload_cpus.empty());
+    EXPECT_EQ(Syscall::getAffinityCpus(), affinity);
+
+    // Reserving every CPU leaves none for sandboxes
+    config.supervisor.housekeeping_cpus = Syscall::formatCpuList(affinity);
+    EXPECT_FALSE(Housekeeping::apply(config));
+    EXPECT_EQ(Syscall::getAffinityCpus(), affinity);
+    EXPECT_TRUE(config.resources.cpuset_cpus.empty());
+
+    // Sandboxes get cpuset_cpus less the housekeeping CPUs, never more
+    config.supervisor.workload_cpus = "1-3";
+    EXPECT_EQ(Housekeeping::sandboxCpus(config), "1-3");
+    config.resources.cpuset_cpus = "0-1";
+    EXPECT_EQ(Housekeeping::sandboxCpus(config), "1");
+    config.resources.cpuset_cpus = "0";
+    EXPECT_EQ(Housekeeping::sandboxCpus(config), "");
+    config.supervisor.workload_cpus.clear();
+    EXPECT_EQ(Housekeeping::sandboxCpus(config), "0");
+}
+
+TEST(ModuleTest, BenchmarkStatistics) {
+    BenchStats stats = Benchmark::summarize({10, 12, 11, 13, 11, 12, 50});
+    EXPECT_DOUBLE_EQ(stats.median, 12);
+    EXPECT_DOUBLE_EQ(stats.min, 10);
+    EXPECT_DOUBLE_EQ(stats.max, 50);
+    EXPECT_NEAR(stats.mean, 17, 1e-9);
+    EXPECT_EQ(stats.outliers, 1);
+
+    BenchStats constant = Benchmark::summarize({5, 5, 5});
+    EXPECT_DOUBLE_EQ(constant.stddev, 0);
+    EXPECT_EQ(constant.outliers, 0);
+
+    BenchStats empty = Benchmark::summarize({});
+    EXPECT_DOUBLE_EQ(empty.mean, 0);
+}
+
+TEST(ModuleTest, ImageStoreEviction) {
+    std::vector<ImageInfo> images = {
+        {"/store/old", 400, 100, false},
+        {"/store/in-use", 400, 50, true},
+        {"/store/recent", 400, 900, false},
+        {"/store/older", 400, 200, false},
+    };
+    EXPECT_TRUE(ImageStore::pickEvictions(images, 1600, 1000).empty());
+    EXPECT_EQ(ImageStore::pickEvictions(images, 900, 1000),
+              (std::vector<std::string>{"/store/old", "/store/older"}));
+    // Recently used and referenced images stay even over budget
+    EXPECT_EQ(ImageStore::pickEvictions(images, 0, 500),
+              (std::vector<std::string>{"/store/old", "/store/older"}));
+
+    char dir[] = "/tmp/sandbox-images-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string store = dir;
+    ASSERT_TRUE(Syscall::mkdirRecursive(store + "/stale/bin"));
+    ASSERT_TRUE(Syscall::writeFile(store + "/stale/bin/sh", std::string(2 * 1024 * 1024, 'x')));
+    ASSERT_TRUE(Syscall::mkdirRecursive(store + "/fresh"));
+    struct timespec longAgo[2] = {{1000, 0}, {1000, 0}};
+    ASSERT_EQ(utimensat(AT_FDCWD, (store + "/stale").c_str(), longAgo, AT_SYMLINK_NOFOLLOW), 0);
+
+    ImagesConfig config = ConfigParser::createDefaultConfig().images;
+    config.store_dirs = {store};
+    config.disk_budget_mb = 1;
+    config.min_idle_s = 0;
+    config.gc_interval_s = 0;
+    ImageStore imageStore(config);
+    EXPECT_TRUE(imageStore.markUsed(store + "/fresh/etc"));
+    EXPECT_FALSE(imageStore.markUsed("/elsewhere/image"));
+    EXPECT_GT(ImageStore::diskUsage(store + "/stale"), 0);
+
+    // The referenced image survives although it is over budget
+    std::atomic<bool> stop{false};
+    GcReport report = imageStore.collect({store + "/fresh"}, stop);
+    EXPECT_EQ(report.evicted, std::vector<std::string>{store + "/stale"});
+    EXPECT_FALSE(Syscall::exists(store + "/stale"));
+    EXPECT_TRUE(Syscall::exists(store + "/fresh"));
+
+    Syscall::removeRecursive(store);
+}
+
+TEST(ModuleTest, Xxh64Vectors) {
+    EXPECT_EQ(Xxh64::toHex(Xxh64::hash("", 0)), "ef46db3751d8e999");
+    EXPECT_EQ(Xxh64::toHex(Xxh64::hash("abc", 3)), "44bc2cf5ad770999");
+
+    std::string text = "Nobody inspects the spammish repetition";
+    EXPECT_EQ(Xxh64::hash(text.data(), text.size()), 0xfbcea83c8a378bf1ULL);
+
+    Xxh64 incremental;
+    for (char c : text) {
+        incremental.update(&c, 1);
+    }
+    EXPECT_EQ(incremental.digest(), 0xfbcea83c8a378bf1ULL);
+}
+
+TEST(ModuleTest, ImagePackRoundTrip) {
+    char dir[] = "/tmp/sandbox-pack-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string base = dir;
+    ASSERT_TRUE(Syscall::mkdirRecursive(base + "/src/etc"));
+    ASSERT_TRUE(Syscall::writeFile(base + "/src/etc/hostname", "sandbox\n"));
+    ASSERT_TRUE(Syscall::writeFile(base + "/src/etc/copy", "sandbox\n"));
+    ASSERT_TRUE(Syscall::writeFile(base + "/src/big", std::string(100000, 'a')));
+    ASSERT_EQ(symlink("etc/hostname", (base + "/src/link").c_str()), 0);
+
+    ASSERT_TRUE(ImagePack::build(base + "/src", base + "/image"));
+    ImagePack pack;
+    ASSERT_TRUE(pack.load(base + "/image/manifest.json"));
+
+    const auto& entries = pack.entries();
+    ASSERT_EQ(entries.size(), 6);
+    EXPECT_EQ(entries[0].path, "/");
+    EXPECT_EQ(entries[1].path, "/big");
+    EXPECT_EQ(entries[3].path, "/etc/copy");
+    EXPECT_EQ(entries[3].digest, entries[4].digest);
+    EXPECT_EQ(entries[5].type, "symlink");
+    EXPECT_EQ(entries[5].target, "etc/hostname");
+
+    // The compressible file is stored compressed and restored intact
+    EXPECT_LT(Syscall::readFile(base + "/image/blobs.pack")->size(), 100000u);
+    ASSERT_TRUE(Syscall::mkdirRecursive(base + "/cache"));
+    int fd = pack.fetch(entries[1].digest, base + "/cache");
+    ASSERT_GE(fd, 0);
+    close(fd);
+    EXPECT_EQ(*Syscall::readFile(base + "/cache/" + entries[1].digest), std::string(100000, 'a'));
+    EXPECT_LT(pack.fetch("0000000000000000", base + "/cache"), 0);
+
+    Syscall::removeRecursive(base);
+}
+
+TEST(ModuleTest, LazyFsServesImage) {
+    char dir[] = "/tmp/sandbox-lazy-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string base = dir;
+    ASSERT_TRUE(Syscall::mkdirRecursive(base + "/src/bin"));
+    ASSERT_TRUE(Syscall::writeFile(base + "/src/bin/tool", "#!/bin/sh\n"));
+    ASSERT_TRUE(ImagePack::build(base + "/src", base + "/image"));
+    ASSERT_TRUE(Syscall::mkdirRecursive(base + "/mnt"));
+
+    bool mounted;
+    {
+        LazyFs fs(base + "/cache", 2);
+        mounted = fs.mount(base + "/image/manifest.json", base + "/mnt");
+        if (mounted) {
+            EXPECT_FALSE(Syscall::exists(base + "/cache/" +
+                                         Xxh64::toHex(Xxh64::hash("#!/bin/sh\n", 10))));
+            EXPECT_TRUE(Syscall::isDirectory(base + "/mnt/bin"));
+            EXPECT_EQ(*Syscall::readFile(base + "/mnt/bin/tool"), "#!/bin/sh\n");
+            EXPECT_FALSE(Syscall::exists(base + "/mnt/missing"));
+            // Fetched on first access
+            EXPECT_TRUE(Syscall::exists(base + "/cache/" +
+                                        Xxh64::toHex(Xxh64::hash("#!/bin/sh\n", 10))));
+        }
+    }
+
+    Syscall::removeRecursive(base);
+    if (!mounted) {
+        GTEST_SKIP() << "FUSE unavailable";
+    }
+}
+
+TEST(ModuleTest, IntegrityManifestIncremental) {
+    char dir[] = "/tmp/sandbox-integrity-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string base = dir;
+    ASSERT_TRUE(Syscall::mkdirRecursive(base + "/root/etc"));
+    ASSERT_TRUE(Syscall::writeFile(base + "/root/etc/hostname", "sandbox\n"));
+    ASSERT_TRUE(Syscall::writeFile(base + "/root/etc/passwd", "root:x:0:0::/root:/bin/sh\n"));
+    ASSERT_EQ(symlink("etc/hostname", (base + "/root/hostname").c_str()), 0);
+
+    IntegrityManifest sealed;
+    ASSERT_TRUE(sealed.scan(base + "/root", 2));
+    EXPECT_EQ(sealed.rehashed(), 2u);
+    std::string path = IntegrityManifest::pathFor(base + "/manifests", base + "/root/");
+    ASSERT_TRUE(sealed.save(path));
+
+    // Unchanged files are trusted by their stat
+    IntegrityManifest manifest;
+    ASSERT_TRUE(manifest.load(path));
+    IntegrityReport report = manifest.verify(base + "/root", 2, false);
+    EXPECT_TRUE(report.ok());
+    EXPECT_EQ(report.rehashed, 0u);
+    EXPECT_EQ(manifest.digest(), sealed.digest());
+
+    // Runtime mount points do not count, changed contents do
+    ASSERT_TRUE(Syscall::mkdirRecursive(base + "/root/proc"));
+    ASSERT_TRUE(Syscall::writeFile(base + "/root/etc/hostname", "tampered\n"));
+    report = manifest.verify(base + "/root", 2, false);
+    EXPECT_FALSE(report.ok());
+    EXPECT_EQ(report.rehashed, 1u);
+    EXPECT_EQ(report.modified, std::vector<std::string>{"etc/hostname"});
+    EXPECT_TRUE(report.added.empty());
+
+    // Rewriting the same contents matches and refreshes the stat
+    ASSERT_TRUE(Syscall::writeFile(base + "/root/etc/hostname", "sandbox\n"));
+    report = manifest.verify(base + "/root", 2, false);
+    EXPECT_TRUE(report.ok());
+    EXPECT_EQ(report.rehashed, 1u);
+    EXPECT_EQ(manifest.verify(base + "/root", 2, false).rehashed, 0u);
+    EXPECT_EQ(manifest.verify(base + "/root", 2, true).rehashed, 2u);
+
+    ASSERT_EQ(unlink((base + "/root/etc/passwd").c_str()), 0);
+    EXPECT_EQ(manifest.verify(base + "/root", 2, false).missing, std::vector<std::string>{"etc/passwd"});
+
+    // An unreadable manifest refuses the start; only a missing one is unsealed
+    SandboxConfiguration config = ConfigParser::createDefaultConfig();
+    config.sandbox.rootfs_path = base + "/root/";
+    config.mounts.dev_template = "";
+    config.images.verify_integrity = true;
+    config.images.integrity_dir = base + "/manifests";
+    ASSERT_TRUE(Syscall::writeFile(path, "{\"algorithm\": \"xxh64\", \"entries\": ["));
+    EXPECT_FALSE(RootFS().initialize(config));
+    ASSERT_EQ(unlink(path.c_str()), 0);
+    EXPECT_TRUE(RootFS().initialize(config));
+
+    Syscall::removeRecursive(base);
+}
+
+TEST(ModuleTest, DebBootstrapResolve) {
+    EXPECT_LT(DebBootstrap::compareVersions("1.0", "1.0.1"), 0);
+    EXPECT_LT(DebBootstrap::compareVersions("1.0~rc1", "1.0"), 0);
+    EXPECT_GT(DebBootstrap::compareVersions("1:0.9", "2.0"), 0);
+    EXPECT_GT(DebBootstrap::compareVersions("2.31-0ubuntu9.2", "2.31-0ubuntu9"), 0);
+    EXPECT_EQ(DebBootstrap::compareVersions("1.01", "1.1"), 0);
+
+    char dir[] = "/tmp/sandbox-debs-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string base = dir;
+    ASSERT_TRUE(Syscall::writeFile(base + "/Packages",
+        "Package: base\nVersion: 1.0\nArchitecture: all\nPriority: required\n"
+        "Pre-Depends: libc (>= 2.0)\nDepends: mawk | gawk, other:any\nFilename: pool/base.deb\n\n"
+        "Package: libc\nVersion: 2.0\nArchitecture: all\nFilename: pool/libc-2.0.deb\n\n"
+        "Package: libc\nVersion: 2.1\nArchitecture: all\nFilename: pool/libc-2.1.deb\n\n"
+        "Package: libc\nVersion: 3.0\nArchitecture: foreign\nFilename: pool/libc-3.0.deb\n\n"
+        "Package: gawk\nVersion: 5\nArchitecture: all\nFilename: pool/gawk.deb\n\n"
+        "Package: impl\nVersion: 1\nArchitecture: all\nProvides: other\nFilename: pool/impl.deb\n\n"
+        "Package: extra\nVersion: 1\nArchitecture: all\nDepends: missing\nFilename: pool/extra.deb\n"));
+
+    DebBootstrap debs(base, "amd64", 2);
+    ASSERT_TRUE(debs.loadIndex("focal"));
+    EXPECT_EQ(debs.packages().at("libc").version, "2.1");
+    EXPECT_EQ(debs.packages().at("libc").filename, base + "/pool/libc-2.1.deb");
+    EXPECT_EQ(debs.packages().at("base").control.find("Filename"), std::string::npos);
+
+    std::vector<const DebPackage*> selected;
+    ASSERT_TRUE(debs.resolve({}, selected));
+    std::vector<std::string> names;
+    for (const auto* package : selected) {
+        names.push_back(package->name);
+    }
+    EXPECT_EQ(names, (std::vector<std::string>{"base", "gawk", "impl", "libc"}));
+
+    EXPECT_FALSE(debs.resolve({"extra"}, selected));
+    EXPECT_FALSE(debs.resolve({"nonexistent"}, selected));
+
+    Syscall::removeRecursive(base);
+}
+
+TEST(ModuleTest, ImageSlimmerKeepsDependencies) {
+    std::string interp;
+    std::vector<std::string> needed;
+    std::vector<std::string> runpath;
+    if (!ImageSlimmer::readElf("/bin/true", interp, needed, runpath) || interp.empty() || needed.empty()) {
+        GTEST_SKIP() << "/bin/true is not a dynamic 64-bit ELF program";
+    }
+    EXPECT_FALSE(ImageSlimmer::readElf("/etc/hostname", interp, needed, runpath));
+    ImageSlimmer::readElf("/bin/true", interp, needed, runpath);
+
+    char dir[] = "/tmp/sandbox-slim-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string base = dir;
+    std::string image = base + "/image";
+
+    // The interpreter is reached through a merged-/usr link, as on Debian
+    std::string top = interp.substr(1, interp.find('/', 1) - 1);
+    ASSERT_TRUE(Syscall::mkdirRecursive(image + "/usr/" + top));
+    ASSERT_EQ(symlink(("usr/" + top).c_str(), (image + "/" + top).c_str()), 0);
+    ASSERT_TRUE(Syscall::writeFile(image + "/usr" + interp, "interp"));
+    ASSERT_TRUE(Syscall::mkdirRecursive(image + "/usr/lib"));
+    for (const auto& name : needed) {
+        ASSERT_TRUE(Syscall::writeFile(image + "/usr/lib/" + name, "library"));
+    }
+    ASSERT_TRUE(Syscall::mkdirRecursive(image + "/usr/bin"));
+    ASSERT_EQ(symlink("usr/bin", (image + "/bin").c_str()), 0);
+    ASSERT_TRUE(Syscall::writeFile(image + "/usr/bin/tool", *Syscall::readFile("/bin/true")));
+    ASSERT_TRUE(Syscall::writeFile(image + "/usr/bin/unused", "unused"));
+    ASSERT_TRUE(Syscall::mkdirRecursive(image + "/etc"));
+    ASSERT_TRUE(Syscall::writeFile(image + "/etc/passwd", "root:x:0:0::/root:/bin/sh\n"));
+    ASSERT_TRUE(Syscall::writeFile(image + "/etc/shadow", "root:*::0:::::\n"));
+
+    ImageSlimmer slimmer(image);
+    slimmer.addFile("/bin/tool");
+    slimmer.addAllowed("/etc/passwd");
+    SlimReport report;
+    ASSERT_TRUE(slimmer.build(base + "/slim", report));
+
+    EXPECT_EQ(report.files, 3 + needed.size());
+    EXPECT_EQ(report.sourceFiles, 5 + needed.size());
+    EXPECT_EQ(report.libraries, 1 + needed.size());
+    EXPECT_EQ(*Syscall::readFile(base + "/slim/bin/tool"), *Syscall::readFile("/bin/true"));
+    EXPECT_TRUE(Syscall::exists(base + "/slim" + interp));
+    EXPECT_TRUE(Syscall::exists(base + "/slim/usr/lib/" + needed[0]));
+    EXPECT_TRUE(Syscall::exists(base + "/slim/etc/passwd"));
+    EXPECT_FALSE(Syscall::exists(base + "/slim/etc/shadow"));
+    EXPECT_FALSE(Syscall::exists(base + "/slim/usr/bin/unused"));
+    EXPECT_FALSE(slimmer.build(base + "/slim", report));
+
+    Syscall::removeRecursive(base);
+}
+
+TEST(ModuleTest, DevTemplateShared) {
+    char dir[] = "/tmp/sandbox-dev-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string base = dir;
+    std::string templateDir = base + "/dev";
+    if (!DevTemplate::prepare(templateDir)) {
+        Syscall::removeRecursive(base);
+        GTEST_SKIP() << "Cannot mount tmpfs or create device nodes";
+    }
+    EXPECT_TRUE(DevTemplate::isPrepared(templateDir));
+    EXPECT_TRUE(DevTemplate::prepare(templateDir));
+
+    // Read-only for everyone, yet the devices work
+    EXPECT_LT(open((templateDir + "/extra").c_str(), O_WRONLY | O_CREAT, 0644), 0);
+    EXPECT_EQ(errno, EROFS);
+    int fd = open((templateDir + "/null").c_str(), O_WRONLY);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(write(fd, "x", 1), 1);
+    close(fd);
+
+    // A sandbox attaches it and gets private pts and shm
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        bool ok = unshare(CLONE_NEWNS) == 0 &&
+                  mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr) == 0 &&
+                  Syscall::mkdirRecursive(base + "/root/dev") &&
+                  mount(templateDir.c_str(), (base + "/root/dev").c_str(), nullptr, MS_BIND | MS_REC, nullptr) == 0 &&
+                  DevTemplate::mountPrivate(base + "/root/dev") &&
+                  Syscall::writeFile(base + "/root/dev/shm/segment", "data") &&
+                  open((base + "/root/dev/ptmx").c_str(), O_RDWR) >= 0;
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    EXPECT_FALSE(Syscall::exists(templateDir + "/shm/segment"));
+
+    umount2(templateDir.c_str(), MNT_DETACH);
+    Syscall::removeRecursive(base);
+}
+
+TEST(ModuleTest, ResourceViewFollowsQuota) {
+    ResourcesConfig resources{};
+    resources.memory_mb = 512;
+    resources.cpu_quota_percent = 150;
+
+    // The quota is rounded up to whole CPUs, rotated over the allowed ones
+    ResourceView view = ResourceView::fromLimits(resources, {0, 1, 2, 3, 4, 5, 6, 7}, 7);
+    EXPECT_EQ(view.getCpus(), (std::vector<int>{0, 7}));
+    EXPECT_EQ(ResourceView::fromLimits(resources, {3}, 7).getCpus(), (std::vector<int>{3}));
+    auto hints = view.runtimeHints();
+    EXPECT_NE(std::find(hints.begin(), hints.end(), std::make_pair(std::string("GOMAXPROCS"), std::string("2"))),
+              hints.end());
+
+    std::string cpuinfo = view.renderCpuinfo(
+        "processor\t: 0\nmodel name\t: A\n\nprocessor\t: 1\nmodel name\t: B\n\n"
+        "processor\t: 7\nmodel name\t: H\n\n");
+    EXPECT_EQ(cpuinfo, "processor\t: 0\nmodel name\t: A\n\nprocessor\t: 1\nmodel name\t: H\n\n");
+
+    std::string stat = view.renderStat("cpu  9 9 9\ncpu0 1 2 3\ncpu1 5 5 5\ncpu7 10 20 30\nctxt 42\n");
+    EXPECT_EQ(stat, "cpu  11 22 33\ncpu0 1 2 3\ncpu1 10 20 30\nctxt 42\n");
+
+    std::string meminfo = view.renderMeminfo(
+        "MemTotal:       16318412 kB\nMemFree:         1000000 kB\nCached:          4000000 kB\n"
+        "Active:         10000000 kB\nHugePages_Total:       0\n");
+    EXPECT_EQ(meminfo,
+        "MemTotal:         524288 kB\nMemFree:          524288 kB\nCached:                0 kB\n"
+        "Active:           524288 kB\nHugePages_Total:       0\n");
+}
+
+TEST(ModuleTest, ElasticQuotaLendsIdleCpu) {
+    ElasticQuota quota(50, 400);
+
+    // A throttled sandbox on an idle host at most doubles per interval
+    EXPECT_EQ(quota.update(8.0, true), 100);
+    EXPECT_EQ(quota.update(8.0, true), 200);
+    EXPECT_EQ(quota.update(8.0, true), 400);
+    EXPECT_EQ(quota.update(8.0, true), 400);
+    EXPECT_EQ(quota.update(8.0, false), 400);
+
+    // Contention takes everything back at once, then holds off lending
+    EXPECT_EQ(quota.update(3.0, true), 50);
+    for (int i = 0; i < ElasticQuota::kCooldownIntervals; ++i) {
+        EXPECT_EQ(quota.update(8.0, true), 50);
+    }
+    EXPECT_EQ(quota.update(8.0, true), 100);
+
+    // Little room left lends little, and a busy host keeps the floor
+    EXPECT_EQ(quota.update(2.0, true), 125);
+    EXPECT_EQ(quota.update(0.2, true), 50);
+    EXPECT_EQ(quota.getPeakQuota(), 400);
+}
+
+TEST(ModuleTest, CgroupsUpdateLimitsInPlace) {
+    char dir[] = "/tmp/sandbox-update-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string base = dir;
+    ASSERT_TRUE(Syscall::writeFile(base + "/memory.max", "536870912\n"));
+    ASSERT_TRUE(Syscall::writeFile(base + "/memory.high", "429496729\n"));
+    ASSERT_TRUE(Syscall::writeFile(base + "/memory.current", "314572800\n"));
+    ASSERT_TRUE(Syscall::writeFile(base + "/cpu.max", "100000 100000\n"));
+    ASSERT_TRUE(Syscall::writeFile(base + "/pids.max", "100\n"));
+    ASSERT_TRUE(Syscall::writeFile(base + "/pids.current", "40\n"));
+
+    // Limits below the current usage are refused before anything is written
+    std::string error;
+    ResourceUpdate tooSmall;
+    tooSmall.memoryMb = 256;
+    tooSmall.maxPids = 500;
+    EXPECT_FALSE(Cgroups::updateLimits(base, tooSmall, error));
+    EXPECT_NE(error.find("300 MB"), std::string::npos);
+    EXPECT_EQ(*Syscall::readFile(base + "/pids.max"), "100\n");
+
+    ResourceUpdate update;
+    update.memoryMb = 2048;
+    update.cpuQuotaPercent = 150;
+    update.maxPids = 500;
+    ASSERT_TRUE(Cgroups::updateLimits(base, update, error)) << error;
+    EXPECT_EQ(*Syscall::readFile(base + "/memory.max"), "2147483648");
+    EXPECT_EQ(*Syscall::readFile(base + "/memory.high"), "1717986918");
+    EXPECT_EQ(*Syscall::readFile(base + "/cpu.max"), "150000 100000");
+    EXPECT_EQ(*Syscall::readFile(base + "/pids.max"), "500");
+    EXPECT_EQ(Cgroups::describeUpdate(update), "memory=2048M cpu=150% pids=500");
+
+    // A failed write puts back what was already written
+    ASSERT_EQ(mkdir((base + "/io.max").c_str(), 0755), 0);
+    ResourceUpdate partial;
+    partial.cpuQuotaPercent = 300;
+    partial.ioMax = "8:0 wbps=1048576";
+    EXPECT_FALSE(Cgroups::updateLimits(base, partial, error));
+    EXPECT_EQ(*Syscall::readFile(base + "/cpu.max"), "150000 100000");
+    partial.ioMax = "8:0 wbps=fast";
+    EXPECT_FALSE(Cgroups::updateLimits(base, partial, error));
+
+    // The change is kept with the sandbox record
+    StateStore store(base + "/state");
+    SandboxRecord record{};
+    record.id = "sandbox-test-1";
+    record.holderPid = -1;
+    record.cpuBurstPercent = 400;
+    ASSERT_TRUE(store.save(record));
+    ASSERT_TRUE(store.recordUpdate(record.id, Cgroups::describeUpdate(update)));
+    auto loaded = store.load(record.id);
+    ASSERT_TRUE(loaded.has_value());
+    EXPECT_EQ(loaded->cpuBurstPercent, 400);
+    ASSERT_EQ(loaded->resourceUpdates.size(), 1u);
+    EXPECT_NE(loaded->resourceUpdates[0].find(" memory=2048M"), std::string::npos);
+    Syscall::removeRecursive(base);
+}
+
+TEST(ModuleTest, FailureIndexMatchesNearDuplicates) {
+    // Only the parts that vary between runs are replaced
+    EXPECT_EQ(FailureIndex::normalize("Segfault in PID 4242 at 0x7ffd1234 reading /tmp/run-81/data.bin"),
+              "segfault in pid <n> at <addr> reading <path>/data.bin");
+    EXPECT_EQ(FailureIndex::normalize(std::string(300000, '7')), "<hex>");
+    EXPECT_EQ(FailureIndex::normalize(" /" + std::string(300000, 'a') + "/b1 "), "<path>/b<n>");
+
+    std::string first =
+        "Traceback (most recent call last):\n"
+        "  File \"/tmp/sandbox-a1/job/main.py\", line 12, in <module>\n"
+        "    load(\"/data/run-1823/input.csv\")\n"
+        "MemoryError: cannot allocate 1048576 bytes in worker 4312 at 2025-03-01T10:12:55";
+    std::string second =
+        "Traceback (most recent call last):\n"
+        "  File \"/tmp/sandbox-f9/job/main.py\", line 12, in <module>\n"
+        "    load(\"/data/run-99/input.csv\")\n"
+        "MemoryError: cannot allocate 2097152 bytes in worker 17 at 2025-06-11T08:01:02";
+    std::string unrelated = "seccomp: process killed by SIGSYS after calling unshare(CLONE_NEWUSER)";
+    uint64_t a = FailureIndex::fingerprint(first);
+    EXPECT_EQ(FailureIndex::distance(a, FailureIndex::fingerprint(second)), 0);
+    EXPECT_GT(FailureIndex::distance(a, FailureIndex::fingerprint(unrelated)), 10);
+
+    char dir[] = "/tmp/sandbox-failures-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string base = dir;
+    FailureIndex index(base + "/index");
+    ASSERT_TRUE(index.load());
+    EXPECT_FALSE(index.lookup(a, 3).has_value());
+    ASSERT_TRUE(index.add(a, "Raise memory_mb"));
+
+    FailureIndex reloaded(base + "/index");
+    ASSERT_TRUE(reloaded.load());
+    EXPECT_EQ(reloaded.lookup(FailureIndex::fingerprint(second), 3), "Raise memory_mb");
+    EXPECT_FALSE(reloaded.lookup(FailureIndex::fingerprint(unrelated), 3).has_value());
+    EXPECT_EQ(reloaded.lookup(a ^ 0x7, 3), "Raise memory_mb");
+    EXPECT_FALSE(reloaded.lookup(a ^ 0xf, 3).has_value());
+    Syscall::removeRecursive(base);
+}
+
+TEST(ModuleTest, PromptBudgetKeepsErrorsWithinBudget) {
+    SandboxConfiguration config = ConfigParser::createDefaultConfig();
+    config.ai_module.max_prompt_tokens = 0;
+    EXPECT_EQ(PromptBudget::budgetFor(config.ai_module),
+              128000 - 1000 - PromptBudget::kFramingTokens);
+    config.ai_module.max_prompt_tokens = 2000;
+    EXPECT_EQ(PromptBudget::budgetFor(config.ai_module), 2000);
+
+    // Runs differing only in counters collapse into one line
+    std::vector<std::string> retries = {"start", "retry 1 of 5 at 0x7f01", "retry 2 of 5 at 0x7f02",
+                                        "retry 3 of 5 at 0x7f03", "done"};
+    EXPECT_EQ(PromptBudget::dedupe(retries),
+              (std::vector<std::string>{"start", "retry 1 of 5 at 0x7f01 [repeated 3 times]", "done"}));
+
+    std::vector<std::string> log;
+    log.push_back("building target");
+    for (int i = 0; i < 2000; ++i) {
+        log.push_back("compiling unit " + std::string(1, static_cast<char>('a' + i % 26)) + " of batch");
+        if (i == 1000) {
+            log.push_back("fatal: linker killed by OOM");
+        }
+    }
+    log.push_back("build stopped");
+
+    auto fitted = PromptBudget::fitLines(log, 500);
+    int tokens = 0;
+    for (const auto& line : fitted) {
+        tokens += PromptBudget::estimateTokens(line) + 1;
+    }
+    EXPECT_LE(tokens, 500);
+    EXPECT_EQ(fitted.front(), "building target");
+    EXPECT_EQ(fitted.back(), "build stopped");
+    EXPECT_NE(std::find(fitted.begin(), fitted.end(), "fatal: linker killed by OOM"), fitted.end());
+    EXPECT_NE(std::find_if(fitted.begin(), fitted.end(),
+                           [](const std::string& line) { return line.find("lines omitted") != std::string::npos; }),
+              fitted.end());
+
+    // Text within budget is left alone, a long line is cut in the middle
+    EXPECT_EQ(PromptBudget::fit("short error", 100), "short error");
+    std::string cut = PromptBudget::fit(std::string(3000, 'x') + "END", 300);
+    EXPECT_LE(PromptBudget::estimateTokens(cut), 300);
+    EXPECT_EQ(cut.substr(cut.size() - 3), "END");
+
+    // Cuts fall between UTF-8 characters
+    std::string quotes;
+    for (int i = 0; i < 500; ++i) {
+        quotes += "\u2018\u2019";
+    }
+    cut = PromptBudget::fit(quotes, 200);
+    size_t marker = cut.find(" [...] ");
+    ASSERT_NE(marker, std::string::npos);
+    EXPECT_EQ(marker % 3, 0u);
+    EXPECT_EQ((cut.size() - marker - 7) % 3, 0u);
+    EXPECT_EQ(static_cast<unsigned char>(cut[marker + 7]), 0xE2);
+}
+
+namespace {
+
+/// Forked HTTP server answering every chat request with its name after a delay
+pid_t startMockEndpoint(const std::string& name, int delayMs, int& port) {
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&addr), len) < 0 ||
+        listen(listener, 16) < 0 || getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+        return -1;
+    }
+    port = ntohs(addr.sin_port);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::string body = "{\"choices\":[{\"message\":{\"content\":\"" + name + "\"}}]}";
+        std::string reply = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\n"
+                            "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        while (true) {
+            int conn = accept(listener, nullptr, nullptr);
+            if (conn < 0) {
+                continue;
+            }
+            // Read the headers and body before answering
+            std::string request;
+            char buf[4096];
+            ssize_t n;
+            while ((n = recv(conn, buf, sizeof(buf), 0)) > 0) {
+                request.append(buf, n);
+                size_t end = request.find("\r\n\r\n");
+                size_t length = request.find("Content-Length: ");
+                if (end != std::string::npos && length != std::string::npos &&
+                    request.size() >= end + 4 + std::stoul(request.substr(length + 16))) {
+                    break;
+                }
+            }
+            usleep(delayMs * 1000);
+            send(conn, reply.data(), reply.size(), MSG_NOSIGNAL);
+            close(conn);
+        }
+    }
+    close(listener);
+    return pid;
+}
+
+} // namespace
+
+TEST(ModuleTest, AIAgentHedgesAndFailsOver) {
+    using namespace std::chrono_literals;
+    auto now = EndpointPool::Clock::now();
+
+    // Unmeasured endpoints go first, then the fastest; a failing one is skipped for the cooldown
+    EndpointPool pool({"a", "b", "c"}, 2, 1000ms, 500ms);
+    pool.recordSuccess(0, 300ms);
+    pool.recordSuccess(1, 100ms);
+    EXPECT_EQ(pool.route(now), (std::vector<size_t>{2, 1, 0}));
+    EXPECT_EQ(pool.hedgeDelay(1), 500ms);
+    pool.recordFailure(2, now);
+    EXPECT_FALSE(pool.isOpen(2, now));
+    pool.recordFailure(2, now);
+    EXPECT_TRUE(pool.isOpen(2, now));
+    EXPECT_EQ(pool.route(now), (std::vector<size_t>{1, 0}));
+    EXPECT_EQ(pool.route(now + 1001ms), (std::vector<size_t>{2, 1, 0}));
+    for (int i = 0; i < 10; ++i) {
+        pool.recordSuccess(1, std::chrono::milliseconds(10 * (i + 1)));
+    }
+    EXPECT_EQ(pool.hedgeDelay(1), 100ms);
+
+    // A request cancelled after losing to its hedge still counts as slow
+    for (int i = 0; i < 20; ++i) {
+        pool.recordCancelled(1, 900ms);
+    }
+    EXPECT_EQ(pool.route(now + 1001ms), (std::vector<size_t>{2, 0, 1}));
+    pool.recordFailure(2, now + 1001ms);
+    pool.recordCancelled(2, 900ms);
+    EXPECT_TRUE(pool.isOpen(2, now + 1001ms));
+
+    int slowPort = 0;
+    int fastPort = 0;
+    pid_t slow = startMockEndpoint("slow", 1500, slowPort);
+    pid_t fast = startMockEndpoint("fast", 0, fastPort);
+    ASSERT_GT(slow, 0);
+    ASSERT_GT(fast, 0);
+
+    setenv("SANDBOX_TEST_AI_KEY", "test", 1);
+    SandboxConfiguration config = ConfigParser::createDefaultConfig();
+    config.ai_module.enabled = true;
+    config.ai_module.api_key_env = "SANDBOX_TEST_AI_KEY";
+    config.ai_module.failure_index_dir = "";
+    config.ai_module.hedge_after_ms = 100;
+    config.ai_module.breaker_failures = 1;
+    config.ai_module.endpoints = {"http://127.0.0.1:" + std::to_string(slowPort) + "/v1",
+                                  "http://127.0.0.1:" + std::to_string(fastPort) + "/v1"};
+    AIPrompt prompt{"", "hello", {}, 0.2, 10};
+
+    // The slow endpoint is hedged and the fast answer wins well before the slow one
+    {
+        AIAgent agent;
+        ASSERT_TRUE(agent.initialize(config));
+        auto start = std::chrono::steady_clock::now();
+        AIResponse response = agent.sendPrompt(prompt);
+        EXPECT_TRUE(response.success);
+        EXPECT_EQ(response.content, "fast");
+        EXPECT_LT(std::chrono::steady_clock::now() - start, 1000ms);
+    }
+
+    // A refused endpoint fails over at once, then its open breaker skips it
+    config.ai_module.endpoints[0] = "http://127.0.0.1:1/v1";
+    {
+        AIAgent agent;
+        ASSERT_TRUE(agent.initialize(config));
+        EXPECT_EQ(agent.sendPrompt(prompt).content, "fast");
+        EXPECT_EQ(agent.sendPrompt(prompt).content, "fast");
+    }
+
+    kill(slow, SIGKILL);
+    kill(fast, SIGKILL);
+    waitpid(slow, nullptr, 0);
+    waitpid(fast, nullptr, 0);
+    unsetenv("SANDBOX_TEST_AI_KEY");
+}
+
+TEST(ModuleTest, DatasetsShareSealedMemfd) {
+    char dir[] = "/tmp/sandbox-datasets-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string base = dir;
+    ASSERT_TRUE(Syscall::writeFile(base + "/weights.bin", "0123456789"));
+
+    SandboxConfiguration config = ConfigParser::createDefaultConfig();
+    config.ipc.dataset_dir = base + "/registry";
+    config.ipc.dataset_cgroup = "";
+    config.ipc.datasets = {{"weights", base + "/weights.bin", false}};
+
+    // The second supervisor gets the first one's copy, not a new load
+    Datasets first;
+    Datasets second;
+    ASSERT_TRUE(first.initialize(config));
+    if (!second.initialize(config)) {
+        first.cleanup();
+        Syscall::removeRecursive(base);
+        GTEST_SKIP() << "pidfd_getfd unavailable";
+    }
+    std::string registry = *Syscall::readFile(base + "/registry/weights.holders");
+    EXPECT_EQ(std::count(registry.begin(), registry.end(), '\n'), 2);
+
+    // Both holders are this process, so their descriptors are ours
+    std::istringstream lines(registry);
+    int fds[2];
+    struct stat st[2];
+    for (int i = 0; i < 2; ++i) {
+        pid_t pid;
+        lines >> pid >> fds[i];
+        lines.ignore(registry.size(), '\n');
+        ASSERT_EQ(fstat(fds[i], &st[i]), 0);
+    }
+    EXPECT_EQ(st[0].st_ino, st[1].st_ino);
+    EXPECT_EQ(st[0].st_size, 10);
+
+    // Sealed: readable, but neither writable nor resizable
+    char buffer[11] = {};
+    EXPECT_EQ(pread(fds[1], buffer, 10, 0), 10);
+    EXPECT_STREQ(buffer, "0123456789");
+    EXPECT_LT(pwrite(fds[1], "x", 1, 0), 0);
+    EXPECT_LT(ftruncate(fds[1], 0), 0);
+
+    first.cleanup();
+    second.cleanup();
+    EXPECT_FALSE(Syscall::exists(base + "/registry/weights.holders"));
+    Syscall::removeRecursive(base);
+}
+
+TEST(ModuleTest, CoreCollectorRoutesAndCaps) {
+    char dir[] = "/tmp/sandbox-cores-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string base = dir;
+
+    // The outermost registered cgroup owns the core
+    CoreCollector::Entry entry{base + "/out/sandbox-a-1", 256 * 1024};
+    ASSERT_TRUE(CoreCollector::registerSandbox(base + "/registry", "sandbox-a-1", entry));
+    ASSERT_TRUE(CoreCollector::registerSandbox(base + "/registry", "sandbox-b-2", {base + "/out/b", 1024}));
+    if (geteuid() == 0) {
+        auto owner = CoreCollector::lookup(base + "/registry", "/sandbox-a-1/sandbox-b-2");
+        ASSERT_TRUE(owner.has_value());
+        EXPECT_EQ(owner->outputDir, entry.outputDir);
+        EXPECT_EQ(owner->maxBytes, entry.maxBytes);
+    }
+    EXPECT_FALSE(CoreCollector::lookup(base + "/registry", "/user.slice/session-1.scope").has_value());
+    CoreCollector::unregisterSandbox(base + "/registry", "sandbox-b-2");
+    EXPECT_FALSE(CoreCollector::lookup(base + "/registry", "/sandbox-b-2").has_value());
+
+    // Random data does not compress and is cut off near the cap
+    std::string core(1024 * 1024, '\0');
+    unsigned int seed = 1;
+    for (char& c : core) {
+        c = static_cast<char>(rand_r(&seed));
+    }
+    ASSERT_TRUE(Syscall::writeFile(base + "/core", core));
+    int input = open((base + "/core").c_str(), O_RDONLY);
+    ASSERT_GE(input, 0);
+    bool truncated = false;
+    std::string gz = base + "/core.gz";
+    ASSERT_TRUE(CoreCollector::compress(input, gz, entry.maxBytes, truncated));
+    close(input);
+    EXPECT_TRUE(truncated);
+    struct stat st;
+    ASSERT_EQ(stat(gz.c_str(), &st), 0);
+    EXPECT_LE(st.st_size, entry.maxBytes + 1024);
+
+    // What was written is a valid gzip of the start of the core
+    gzFile file = gzopen(gz.c_str(), "rb");
+    ASSERT_NE(file, nullptr);
+    std::string restored(core.size(), '\0');
+    int length = gzread(file, restored.data(), static_cast<unsigned int>(restored.size()));
+    gzclose(file);
+    ASSERT_GT(length, 0);
+    EXPECT_EQ(restored.substr(0, length), core.substr(0, length));
+
+    // A compressible core fits whole
+    ASSERT_TRUE(Syscall::writeFile(base + "/core", std::string(1024 * 1024, 'x')));
+    input = open((base + "/core").c_str(), O_RDONLY);
+    ASSERT_TRUE(CoreCollector::compress(input, gz, entry.maxBytes, truncated));
+    close(input);
+    EXPECT_FALSE(truncated);
+
+    // Cores of processes outside the sandboxes go to the host's handler
+    EXPECT_EQ(CoreCollector::expandPattern("core.%e.%p.%%.%x", {{'e', "app"}, {'p', "42"}}), "core.app.42.%.");
+    struct rlimit saved;
+    ASSERT_EQ(getrlimit(RLIMIT_CORE, &saved), 0);
+    struct rlimit limit = {4, saved.rlim_max};
+    if (saved.rlim_max >= 4 && setrlimit(RLIMIT_CORE, &limit) == 0) {
+        ASSERT_TRUE(Syscall::writeFile(base + "/registry/.core_pattern", "0\n" + base + "/host.%e.%p\n"));
+        ASSERT_TRUE(Syscall::writeFile(base + "/core", "core dump"));
+        input = open((base + "/core").c_str(), O_RDONLY);
+        EXPECT_EQ(CoreCollector::collect(base + "/registry", getpid(), SIGSEGV, "app", input), 0);
+        close(input);
+        EXPECT_EQ(Syscall::readFile(base + "/host.app." + std::to_string(getpid())), "core");
+
+        // A user cannot have a core written where it may not write itself
+        int ready[2];
+        if (geteuid() == 0 && pipe(ready) == 0) {
+            pid_t pid = fork();
+            ASSERT_GE(pid, 0);
+            if (pid == 0) {
+                char ok = setresuid(65534, 65534, 65534) == 0 ? 1 : 0;
+                write(ready[1], &ok, 1);
+                pause();
+                _exit(0);
+            }
+            char ok = 0;
+            read(ready[0], &ok, 1);
+            close(ready[0]);
+            close(ready[1]);
+            if (ok) {
+                input = open((base + "/core").c_str(), O_RDONLY);
+                EXPECT_NE(CoreCollector::collect(base + "/registry", pid, SIGSEGV, "app", input), 0);
+                close(input);
+                EXPECT_FALSE(Syscall::exists(base + "/host.app." + std::to_string(pid)));
+            }
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        setrlimit(RLIMIT_CORE, &saved);
+    }
+
+    Syscall::removeRecursive(base);
+}
+
+TEST(ModuleTest, NetworkStatsSample) {
+    // The supervisor's own namespace is never accounted
+    NetworkStats own;
+    EXPECT_FALSE(own.open(getpid()));
+
+    int ready[2];
+    ASSERT_EQ(pipe(ready), 0);
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        char ok = unshare(CLONE_NEWNET) == 0 ? 1 : 0;
+        write(ready[1], &ok, 1);
+        pause();
+        _exit(0);
+    }
+
+    char ok = 0;
+    read(ready[0], &ok, 1);
+    close(ready[0]);
+    close(ready[1]);
+
+    NetworkStats stats;
+    bool opened = ok && stats.open(pid);
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    if (!opened) {
+        GTEST_SKIP() << "Network namespaces unavailable";
+    }
+
+    // A fresh namespace only has loopback, and stays readable after exit
+    NetworkUsage usage;
+    ASSERT_TRUE(stats.sample(usage));
+    EXPECT_EQ(usage.rxBytes, 0u);
+    EXPECT_EQ(usage.txPackets, 0u);
+}
+
 TEST(ConfigParserTest, UIDMapParsing) {
     std::string json = R"({
         "sandbox": {